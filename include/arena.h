@@ -0,0 +1,30 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Scratch memory for one loop() pass, a bump allocator over a static
+// buffer. Steps take their larger working buffers from here instead of the
+// 4 KB stack, which matters while the HTTP client's idle hook runs other
+// tasks on top of a waiting network step. Nothing is ever freed on its
+// own: a step rewinds to a mark when it is done, loop() resets the whole
+// arena at its end. Marks nest like the steps run from schedulerYield().
+#define ARENA_SIZE 1024
+
+typedef uint16_t ArenaMark;
+
+// size bytes aligned to 4, nullptr if the arena is full
+void *arenaAlloc(size_t size);
+
+template <typename T>
+T *arenaArray(size_t count)
+{
+  return static_cast<T *>(arenaAlloc(count * sizeof(T)));
+}
+
+ArenaMark arenaMark();
+void arenaRewind(ArenaMark mark);
+void arenaReset();
+
+// Most ever in use, and allocations that did not fit
+size_t arenaHighWater();
+uint32_t arenaFailures();
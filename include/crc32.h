@@ -0,0 +1,6 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC-32 (IEEE 802.3) used to validate state kept in RTC memory across resets
+uint32_t crc32(const void *data, size_t length);
@@ -0,0 +1,55 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Partial SSD1306 refresh. Drawing code marks the rectangles it touched,
+// flushing sends only those column ranges of the affected 8-pixel pages
+// using the controller's page/column address window instead of the whole
+// 1 KB frame.
+#define DISPLAY_PAGES 8
+#define DISPLAY_COLUMNS 128
+
+struct DisplayRegions
+{
+  uint8_t start[DISPLAY_PAGES]; // first dirty column, DISPLAY_COLUMNS if clean
+  uint8_t end[DISPLAY_PAGES];   // one past the last dirty column
+};
+
+void displayRegionsClear(DisplayRegions &regions);
+void displayRegionsMark(DisplayRegions &regions, int16_t x, int16_t y, int16_t w, int16_t h);
+void displayRegionsMarkAll(DisplayRegions &regions);
+
+bool displayRegionsDirty(const DisplayRegions &regions);
+
+// Send the dirty parts of up to maxPages pages of buffer
+// (Adafruit_SSD1306::getBuffer() layout, horizontal addressing mode) over
+// the bus manager (i2c_bus.h) and clear their marks, top page first.
+// Returns the number of bytes put on the I2C bus, address bytes included.
+size_t displayRegionsFlush(DisplayRegions &regions, const uint8_t *buffer, uint8_t address,
+                           uint8_t maxPages = DISPLAY_PAGES);
+
+// A line of text from the glyph atlas (glyph_atlas.h) that remembers what
+// it shows. Glyphs are copied straight into the frame buffer, which needs
+// the text to start on a page boundary. When the new text has the same
+// length only the changed character cells are redrawn, otherwise the old
+// text is erased and the new one drawn.
+struct TextWidget
+{
+  int16_t x;     // left edge of the box the text is placed in
+  uint8_t page;  // top row / 8
+  int16_t width; // box width, used for centering
+  uint8_t size;  // 1 for the 6x8 font, 2 for the 12x16 clock font
+  bool center;
+  bool valid = false; // text below is on the screen
+  char text[16] = {};
+};
+
+// Returns true if anything was drawn. buffer is the frame buffer
+// (Adafruit_SSD1306::getBuffer()).
+bool textWidgetDraw(TextWidget &widget, uint8_t *buffer, DisplayRegions &regions, const char *text);
+
+// Characters that fit the box and the screen, measured in glyph cells
+size_t textWidgetColumns(const TextWidget &widget);
+
+// Forget the shown text, e.g. after the screen was cleared
+void textWidgetInvalidate(TextWidget &widget);
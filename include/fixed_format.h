@@ -0,0 +1,10 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Display text of a reading without the float printf: value rounded to
+// decimals places (at most 4, halves away from zero) followed by suffix,
+// e.g. "1012.57 hPa". NAN or a value of a billion units of the last place
+// or more shows as "--" without the suffix. Returns the length, the text is
+// cut to size - 1 characters.
+size_t formatFixed(char *out, size_t size, float value, uint8_t decimals, const char *suffix);
@@ -0,0 +1,24 @@
+#pragma once
+#include <stdint.h>
+
+// Pre-rendered glyphs for the main screen in the SSD1306 page layout: one
+// byte per column with bit 0 at the top, stored page by page. A glyph whose
+// cell starts on a page boundary is copied into the frame buffer as is, no
+// per-pixel drawing. The atlas only holds what the main screen shows,
+// any other character comes out blank.
+struct GlyphFont
+{
+  const uint8_t *columns; // PROGMEM, width * pages bytes per glyph
+  const char *chars;      // the characters in atlas order
+  uint8_t width;          // cell width in pixels, spacing column included
+  uint8_t pages;          // cell height in 8 pixel pages
+};
+
+// The classic 5x7 font in a 6x8 cell: digits, " -.:" and the unit letters
+extern const GlyphFont GLYPHS_SMALL;
+// The small font doubled to a 12x16 cell for the clock: digits and " -:"
+extern const GlyphFont GLYPHS_LARGE;
+
+// Column bytes of c in the given page of its cell, nullptr if c is not in
+// the font
+const uint8_t *glyphColumns(const GlyphFont &font, char c, uint8_t page);
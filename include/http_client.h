@@ -0,0 +1,65 @@
+#pragma once
+#include <Print.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Minimal HTTP/1.1 client for the openSenseMap calls. The request head is
+// formatted into a scratch buffer and written at once, constant header lines
+// are passed as one precomputed string. Of the response only the status
+// line is parsed, headers are skipped (chunked encoding is decoded) and the
+// body is streamed to a callback. Connect, first byte and total time are
+// bounded by timeouts.
+//
+// TLS: the session of the last host is kept for an abbreviated handshake on
+// the next request, the CPU runs at 160 MHz during the handshake. Requests
+// may ask for smaller record buffers, which is used only if the server
+// supports max fragment length negotiation (probed once per host). A failed
+// probe is only kept once the server answered with full buffers, and is
+// repeated after HTTP_TLS_REPROBE_MS.
+
+#define HTTP_CONNECT_TIMEOUT_MS 5000
+#define HTTP_FIRST_BYTE_TIMEOUT_MS 5000
+#define HTTP_TOTAL_TIMEOUT_MS 15000
+#define HTTP_RETRY_BASE_MS 500 // doubled after every failed attempt
+#define HTTP_TLS_MAX_RECORD 16384
+#define HTTP_TLS_REPROBE_MS (6 * 3600000UL)
+#define HTTP_HEAD_SIZE 384 // request head, taken from the arena (arena.h)
+#define HTTP_READ_SIZE 64  // receive buffer, likewise
+
+enum
+{
+  HTTP_ERROR_CONNECT = -1,
+  HTTP_ERROR_REQUEST = -2,  // request head does not fit the buffer
+  HTTP_ERROR_TIMEOUT = -3,
+  HTTP_ERROR_RESPONSE = -4  // no valid status line
+};
+
+typedef void (*HttpBodyWriter)(Print &out, void *context);
+typedef void (*HttpBodyReader)(const uint8_t *data, size_t length, void *context);
+
+struct HttpRequest
+{
+  const char *method;
+  const char *host;
+  uint16_t port;
+  bool secure;
+  const char *path;
+  const char *headers;      // extra header lines, each ending in "\r\n", or nullptr
+  size_t contentLength;     // body length announced, 0 without body
+  HttpBodyWriter writeBody; // writes exactly contentLength bytes, or nullptr
+  HttpBodyReader readBody;  // receives the response body, or nullptr
+  void *context;
+  uint32_t *connectUs;      // if set, receives the connect (and TLS handshake) time
+  uint16_t tlsRxBuffer;     // TLS record buffer sizes (512..4096 with max fragment
+  uint16_t tlsTxBuffer;     // length), 0 for HTTP_TLS_MAX_RECORD and 512 bytes
+};
+
+// Called repeatedly while waiting for the network, e.g. to run other tasks
+void httpSetIdleHook(void (*hook)());
+
+// Returns the HTTP status code or one of the HTTP_ERROR_* codes
+int httpSend(const HttpRequest &request);
+
+// Retries connection failures and 5xx responses with exponential backoff.
+// Anything else is returned as is, a POST that may have arrived is not resent.
+int httpSendWithRetry(const HttpRequest &request, uint8_t attempts);
@@ -0,0 +1,68 @@
+#pragma once
+#include <Print.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// The I2C bus shared by the BMP280, BH1750 and SSD1306. Everything on it
+// goes through here, so each device gets its own clock and is counted:
+// - devices run at I2C_CLOCK_HZ, one that fails a transfer drops to
+//   I2C_FALLBACK_CLOCK_HZ until the next boot
+// - a failed transfer frees the bus first: a device reset halfway through
+//   a read can hold SDA low until it has clocked out its byte, nine SCL
+//   pulses and a STOP release it
+// - transfers go through i2cBusWrite() and i2cBusRead*(), which count
+//   them from the Wire status (the display pages, the sensors in
+//   i2c_sensors.cpp); only the SSD1306 library's begin() drives Wire
+//   itself and is bracketed by i2cBusAcquire() and i2cBusRelease()
+// The scheduler keeps long transfers from holding the bus: the display
+// sends a frame a few pages per step, sensor reads that fall due run in
+// between (DISPLAY_FLUSH_PAGES in main.cpp).
+#ifndef I2C_CLOCK_HZ
+#define I2C_CLOCK_HZ 400000
+#endif
+#define I2C_FALLBACK_CLOCK_HZ 100000
+
+enum I2cDevice
+{
+  I2C_BMP280,
+  I2C_BH1750,
+  I2C_SSD1306,
+  I2C_DEVICE_COUNT
+};
+
+struct I2cDeviceStats
+{
+  uint32_t transactions;
+  uint32_t bytes;  // on the wire, address bytes included
+  uint32_t errors; // failed transfers, each one triggers a bus recovery
+  uint32_t busyUs; // time on the bus
+  uint32_t clock;  // Hz, I2C_FALLBACK_CLOCK_HZ after an error
+};
+
+// Free a stuck bus, start Wire on the given pins and reset the clocks and
+// statistics
+void i2cBusBegin(uint8_t sda, uint8_t scl);
+
+// The transfers are retried once at the fallback clock if they fail and
+// return the Wire status, 0 on success. A read that comes back short
+// counts as I2C_SHORT_READ.
+#define I2C_SHORT_READ 4 // "other error", what Wire reports for a busy bus
+
+// One write transaction: a control byte or register address, then data
+uint8_t i2cBusWrite(I2cDevice device, uint8_t address, uint8_t control, const uint8_t *data, size_t length);
+
+// One read transaction of length bytes
+uint8_t i2cBusRead(I2cDevice device, uint8_t address, uint8_t *data, size_t length);
+
+// The register address, a repeated start, then length bytes from there on
+uint8_t i2cBusReadRegisters(I2cDevice device, uint8_t address, uint8_t reg, uint8_t *data, size_t length);
+
+// Around a driver call that uses Wire itself. Only its bus time is
+// counted, afterwards the device has to acknowledge its address; false
+// (and a bus recovery) if it does not.
+void i2cBusAcquire(I2cDevice device);
+bool i2cBusRelease(I2cDevice device, uint8_t address);
+
+const I2cDeviceStats &i2cBusStats(I2cDevice device);
+const char *i2cBusDeviceName(I2cDevice device);
+void i2cBusDump(Print &out);
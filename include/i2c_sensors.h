@@ -0,0 +1,45 @@
+#pragma once
+#include <stdint.h>
+
+// The BMP280 and BH1750, driven register by register through the I2C bus
+// manager (i2c_bus.h). Every transfer is counted from its Wire status, and
+// a NACK or a stuck bus is seen in the transfer it happens in, not guessed
+// from the value a driver returns. Both run single conversions: the
+// firmware starts them together with the DS18B20 and collects the results
+// once the slowest one is done.
+
+// osrs_t / osrs_p field values, each step doubles the samples
+enum Bmp280Sampling : uint8_t
+{
+  BMP280_SAMPLING_X1 = 1,
+  BMP280_SAMPLING_X2 = 2,
+  BMP280_SAMPLING_X4 = 3,
+  BMP280_SAMPLING_X8 = 4,
+  BMP280_SAMPLING_X16 = 5
+};
+
+// Check the chip id and load the trimming parameters. False if nothing
+// answers at address or it is not a BMP280.
+bool bmp280Begin(uint8_t address);
+
+// Start one forced conversion, the sensor sleeps again afterwards
+bool bmp280StartForced(Bmp280Sampling temp, Bmp280Sampling pres);
+
+// Burst read of the result registers, compensated: °C and Pa. False on a
+// bus error, before bmp280Begin() and for a skipped measurement.
+bool bmp280Read(float &temp, float &pres);
+
+// One-time measurement opcodes, the sensor powers down after each
+enum Bh1750Mode : uint8_t
+{
+  BH1750_ONE_TIME_HIGH_RES = 0x20,   // 1 lx, 120 ms typical
+  BH1750_ONE_TIME_HIGH_RES_2 = 0x21, // 0.5 lx, 120 ms typical
+  BH1750_ONE_TIME_LOW_RES = 0x23     // 4 lx, 16 ms typical
+};
+#define BH1750_ADDRESS 0x23 // ADDR pin low
+
+// Start a measurement, false if the sensor did not acknowledge
+bool bh1750Start(Bh1750Mode mode);
+
+// Lux of the last measurement, NAN on a bus error
+float bh1750Read();
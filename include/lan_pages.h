@@ -0,0 +1,43 @@
+#pragma once
+#include <Print.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// The /metrics (Prometheus text format) and /json responses of the LAN
+// mode. Both documents are rebuilt into static buffers once per sensor
+// update; a request only copies the finished text to the socket, so any
+// number of scrapers costs the device next to nothing. A sample or member
+// that does not fit is left out whole and counted, the documents stay
+// well-formed. Builds without the LAN mode never reference this module
+// and the linker drops the buffers.
+#define LAN_METRICS_SIZE 4096
+#define LAN_JSON_SIZE 1280
+#define LAN_JSON_DEPTH 4 // nested objects, the outer one included
+
+// Start both documents, the JSON one with its outer object open
+void lanPagesBegin();
+
+// A Prometheus sample, value rounded to decimals places (NaN if it has
+// none). HELP and TYPE go before the first sample of a name, so the
+// samples of one name have to follow each other. labels is the text inside
+// the braces, e.g. "phase=\"tls\"", or null.
+void lanMetric(const char *name, const char *type, const char *help, const char *labels, float value,
+               uint8_t decimals);
+// Same for a counter or an integer gauge, exact
+void lanMetricCount(const char *name, const char *type, const char *help, const char *labels, uint64_t value);
+
+// Members of the innermost open JSON object. Keys and strings are written
+// as they are, they must not need escaping.
+void lanJsonObject(const char *key); // opens a nested object
+void lanJsonClose();
+void lanJsonNumber(const char *key, float value, uint8_t decimals); // null if it has no value
+void lanJsonCount(const char *key, uint64_t value);
+void lanJsonString(const char *key, const char *value);
+
+// Close the JSON document, the pages are served from here on
+void lanPagesEnd();
+
+const char *lanMetricsText(size_t &length);
+const char *lanJsonText(size_t &length);
+
+void lanPagesDump(Print &out);
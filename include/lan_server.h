@@ -0,0 +1,28 @@
+#pragma once
+#include <Print.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// The LAN mode's web server, straight on a WiFiServer. ESP8266WebServer
+// parses every request into Strings on the heap; here the request line is
+// read into a static buffer, the headers are skipped without keeping them
+// and the answer is a ready page (lan_pages.h) written as is. A poll takes
+// what has arrived of one request and returns without waiting for more;
+// the poll that completes it answers and closes the connection.
+#define LAN_REQUEST_SIZE 128        // request line, a longer one gets 414
+#define LAN_REQUEST_TIMEOUT_MS 500  // for the rest of the request to arrive
+
+struct LanRoute
+{
+  const char *path;
+  const char *contentType;
+  const char *(*text)(size_t &length); // the page, length 0 answers 503
+};
+
+void lanServerBegin(uint16_t port, const LanRoute *routes, uint8_t count);
+
+// Read on from the request in progress or the next waiting client. Returns
+// true if one was answered or rejected.
+bool lanServerPoll();
+
+void lanServerDump(Print &out);
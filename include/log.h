@@ -0,0 +1,22 @@
+#pragma once
+#include <Arduino.h>
+
+// Verbose serial log for progress and statistics chatter. Compiled out of
+// release builds, errors are always printed with Serial directly. Debug
+// builds (build_type = debug) or -DLOG_VERBOSE=1 turn it on.
+#ifndef LOG_VERBOSE
+#ifdef __PLATFORMIO_BUILD_DEBUG__
+#define LOG_VERBOSE 1
+#else
+#define LOG_VERBOSE 0
+#endif
+#endif
+
+#if LOG_VERBOSE
+#define LOGV(...) Serial.printf(__VA_ARGS__)
+#else
+#define LOGV(...) \
+  do            \
+  {             \
+  } while (0)
+#endif
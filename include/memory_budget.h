@@ -0,0 +1,32 @@
+#pragma once
+
+// RAM per subsystem. The ESP8266 leaves about 40 KB of heap to the sketch,
+// and the TLS handshake needs a few KB of it in one piece. So after setup()
+// the firmware itself never allocates: its state is static and checked
+// against the budgets below where it is defined, scratch buffers come from
+// the per-pass arena (arena.h). Setup allocates once and keeps it: the
+// SSD1306 frame buffer (1 KB) and the driver objects.
+//
+// Static, bytes
+#define RAM_BUDGET_DISPLAY 1536    // widgets, dirty regions, graph columns
+#define RAM_BUDGET_SENSOR 64       // per SensorIndex: value, statistics, queued value, probe ROM
+#define RAM_BUDGET_RTC_MIRROR 512  // copies of the RTC user memory: state, WiFi cache, pressure history
+#define RAM_BUDGET_TELEMETRY 1024  // phase histograms and heap marks
+#define RAM_BUDGET_NETWORK 256     // TLS session kept for resumption
+#define RAM_BUDGET_PUBLISH 1280    // mirror batch buffer, MQTT client, mirror statistics
+#define RAM_BUDGET_SCRATCH 1024    // the arena, ARENA_SIZE
+#define RAM_BUDGET_LAN 5632        // prebuilt /metrics and /json and the request line, LAN mode only
+//
+// What is left on the heap are driver allocations, each freed again within
+// the step that made it, so they reuse the same holes instead of cutting
+// the heap up:
+//   TLS request    ~6 KB  BearSSL state plus the record buffers (1024/512
+//                         with max fragment length, else 16 KB + 512)
+//   TCP connection ~1.5 KB lwIP control block and buffers, two while the
+//                         MQTT connection is open next to an HTTP request
+//   open file      ~0.5 KB LittleFS handle and cache, one or two at a time
+// A LAN scrape costs only the TCP connection it arrives on: the server
+// reads the request line into its static buffer (lan_server.h) instead of
+// ESP8266WebServer's per-request Strings.
+// The native build fails with --strict-heap if the firmware allocates after
+// setup() or a driver stand-in keeps memory past a loop() pass.
@@ -0,0 +1,24 @@
+#pragma once
+#include <Client.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Minimal MQTT 3.1.1 publisher for a broker on the LAN: connect with a
+// clean session, publish at QoS 1 and wait for the PUBACK, disconnect.
+// Packets are written straight to the client, a publish as a short header
+// followed by the caller's payload, nothing is buffered or allocated.
+// Every wait is bounded by MQTT_TIMEOUT_MS and runs the idle hook.
+#define MQTT_TIMEOUT_MS 3000
+#define MQTT_KEEP_ALIVE_S 60
+
+// Called repeatedly while waiting for the broker
+void mqttSetIdleHook(void (*hook)());
+
+// TCP connect and CONNECT/CONNACK. user and password may be null.
+bool mqttConnect(Client &client, const char *host, uint16_t port, const char *clientId, const char *user,
+                 const char *password);
+
+// QoS 1 publish, true once the broker acknowledged it
+bool mqttPublish(Client &client, const char *topic, const uint8_t *payload, size_t length);
+
+void mqttDisconnect(Client &client);
@@ -0,0 +1,69 @@
+#pragma once
+#include <stdint.h>
+
+// On-device history of hourly pressure means. The struct is stored as-is in
+// RTC user memory, so it must stay a multiple of 4 bytes and free of pointers.
+#define PRESSURE_HISTORY_SLOTS 12
+#define PRESSURE_HISTORY_MAGIC 0x50484832 // "PHH2"
+
+// The trend is the least-squares slope through the newest
+// PRESSURE_SLOPE_POINTS hourly means, kept as running sums that every
+// closed hour updates in O(1). Four points span the 3 hours of the
+// standard barometric tendency.
+#define PRESSURE_SLOPE_POINTS 4
+#define PRESSURE_SLOPE_REFERENCE 1013.25f // subtracted before summing, keeps the float sums small
+
+struct PressureHistory
+{
+  uint32_t magic;
+  uint32_t currentHour; // hours since epoch covered by the running accumulator
+  float sum;            // running sum of samples in currentHour
+  uint16_t samples;     // number of samples in sum
+  uint8_t head;         // next slot to write
+  uint8_t count;        // number of valid slots
+  float means[PRESSURE_HISTORY_SLOTS];
+  float slopeSumY;  // over the slope window, y = mean - PRESSURE_SLOPE_REFERENCE
+  float slopeSumXY; // x = 0 for the newest mean, -1 for the one before, ...
+  uint32_t crc;
+};
+
+// Pressure trend categories as shown by drawTrendArrow()
+enum
+{
+  TREND_HARD_UP = 0,
+  TREND_SLIGHT_UP = 1,
+  TREND_FLAT = 2,
+  TREND_SLIGHT_DOWN = 3,
+  TREND_HARD_DOWN = 4
+};
+
+void pressureHistoryReset(PressureHistory &history);
+bool pressureHistoryValid(const PressureHistory &history);
+void pressureHistorySeal(PressureHistory &history);
+
+// Append a completed hourly mean (used by the sampler and the API backfill)
+void pressureHistoryPush(PressureHistory &history, float mean);
+
+// Feed one sample. Closes the running hour when the hour changes and
+// drops the history when hours were skipped. Returns true if a mean was stored.
+bool pressureHistoryAddSample(PressureHistory &history, uint32_t hour, float pressure);
+
+// Number of points (closed hours plus the running hour) available for trends
+int pressureHistoryPoints(const PressureHistory &history);
+
+// Slope of the hourly means in hPa per hour. Returns false with fewer than
+// two closed hours.
+bool pressureHistorySlope(const PressureHistory &history, float &hPaPerHour);
+
+// WMO code table 0200, the characteristic of the pressure tendency over the
+// last 3 hours (0..8, e.g. 2 rising, 4 steady, 7 falling, 5 falling then
+// rising). Returns -1 with fewer than four closed hours.
+int pressureTendencyCharacteristic(const PressureHistory &history);
+
+// Map a rate in hPa per 3 hours to one of the TREND_* categories. The rate
+// has to get PRESSURE_TREND_HYSTERESIS past a boundary to leave the
+// previous category, so a rate near a boundary does not flicker the arrow.
+#define PRESSURE_TREND_SLIGHT 0.5f    // hPa/3h
+#define PRESSURE_TREND_HARD 1.6f      // hPa/3h, "rising" rather than "rising slowly"
+#define PRESSURE_TREND_HYSTERESIS 0.2f
+int classifyPressureTrend(float hPaPer3h, int previous);
@@ -0,0 +1,68 @@
+#pragma once
+#include "sensors.h"
+#include "upload_queue.h"
+#include <Print.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Local mirrors of the openSenseMap uploads: an MQTT broker and InfluxDB
+// over HTTP or UDP. A batch of readings is serialised once, as InfluxDB
+// line protocol, into a static buffer, and that buffer is the MQTT payload,
+// the HTTP body and the UDP datagram alike. The mirrors are served in the
+// upload's WiFi session; the MQTT connection is opened on the first batch
+// and kept for the rest. A mirror that fails is skipped for the rest of
+// the session, the other mirrors and openSenseMap carry on.
+#define PUBLISH_BUFFER_SIZE 1024
+#define PUBLISH_MAX_MIRRORS 4
+
+enum
+{
+  MIRROR_MQTT,
+  MIRROR_HTTP, // InfluxDB write API
+  MIRROR_UDP   // InfluxDB UDP listener
+};
+
+struct MirrorDef
+{
+  bool enabled;
+  const char *name;  // in the stats print
+  uint8_t transport;
+  const char *host;
+  uint16_t port;
+  const char *target; // MQTT topic or HTTP path with query
+  const char *user;   // MQTT user, or HTTP header lines ("Authorization: Token ...\r\n"), null for none
+  const char *password; // MQTT only
+};
+
+struct MirrorStats
+{
+  uint32_t batches;  // accepted
+  uint32_t lines;
+  uint32_t bytes;
+  uint32_t failures;
+  bool down;         // failed this session
+};
+
+// Line protocol of as many of the readings as fit the buffer, one line per
+// reading: prefix (measurement and tags), the sensors' field keys with
+// their upload precision, the timestamp in seconds if the reading has one.
+// Returns the number of readings serialised.
+size_t publishSerialise(const char *prefix, const SensorDef *sensors, const QueuedReading *readings, size_t count);
+
+// The mirror table, kept for the sessions. clientId names the MQTT client.
+void publishSetup(const MirrorDef *mirrors, uint8_t count, const char *clientId);
+
+// Whether any mirror is enabled
+bool publishActive();
+
+// Start of a WiFi session, every mirror is up again
+void publishBegin();
+
+// Send the serialised batch to every enabled mirror still up. True if a
+// mirror accepted it or it had no lines.
+bool publishMirrors();
+
+// End of the session, closes the MQTT connection
+void publishEnd();
+
+void publishDump(Print &out);
@@ -0,0 +1,51 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// openSenseMap compact binary upload formats. Each measurement is the
+// 12-byte sensor id followed by the value as little-endian float32
+// (application/sbx-bytes, 16 bytes) and optionally a little-endian uint32
+// epoch timestamp (application/sbx-bytes-ts, 20 bytes).
+#define SBX_ID_LENGTH 12
+#define SBX_MEASUREMENT_LENGTH 16
+#define SBX_MEASUREMENT_TS_LENGTH 20
+
+struct SbxSensorId
+{
+  uint8_t bytes[SBX_ID_LENGTH];
+};
+
+constexpr uint8_t sbxHexNibble(char c)
+{
+  return c >= '0' && c <= '9'   ? c - '0'
+         : c >= 'a' && c <= 'f' ? c - 'a' + 10
+         : c >= 'A' && c <= 'F' ? c - 'A' + 10
+                                : 0xff;
+}
+
+// True if the id is 24 hex characters, for static_assert on SENSOR_ID_*
+constexpr bool sbxSensorIdValid(const char *hex)
+{
+  for (int i = 0; i < 2 * SBX_ID_LENGTH; i++)
+  {
+    if (sbxHexNibble(hex[i]) == 0xff)
+      return false;
+  }
+  return hex[2 * SBX_ID_LENGTH] == '\0';
+}
+
+// Decode a 24 character hex sensor id, evaluated at compile time when the
+// result initialises a constexpr
+constexpr SbxSensorId sbxSensorId(const char *hex)
+{
+  SbxSensorId id = {};
+  for (int i = 0; i < SBX_ID_LENGTH; i++)
+  {
+    id.bytes[i] = (sbxHexNibble(hex[2 * i]) << 4) | sbxHexNibble(hex[2 * i + 1]);
+  }
+  return id;
+}
+
+// Encode one measurement into out, which must hold SBX_MEASUREMENT_TS_LENGTH
+// bytes with a timestamp and SBX_MEASUREMENT_LENGTH without. Returns the length.
+size_t sbxEncode(uint8_t *out, const SbxSensorId &id, float value, bool withTimestamp, uint32_t timestamp);
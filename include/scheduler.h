@@ -0,0 +1,46 @@
+#pragma once
+#include <stdint.h>
+
+// Small cooperative scheduler. A task is a resumable step function that
+// does a bounded amount of work and returns the delay in ms until its next
+// step, or TASK_SUSPEND to sleep until schedulerWake(). Of the due tasks the
+// one with the earliest deadline runs first. Both clocks are supplied by
+// the caller so the scheduler runs against a fake clock as well.
+#define TASK_SUSPEND 0xffffffffUL
+
+typedef uint32_t (*TaskStep)();
+
+struct Task
+{
+  const char *name;
+  TaskStep step;
+  uint32_t nextRun = 0; // deadline in ms
+  bool suspended = false;
+  bool running = false;  // inside step(), not re-entered by schedulerYield()
+  // Run time statistics, excluding tasks run from a nested schedulerYield()
+  uint32_t runs = 0;
+  uint32_t maxUs = 0;
+  uint64_t totalUs = 0;
+};
+
+struct Scheduler
+{
+  Task *tasks;
+  uint8_t count;
+  uint32_t (*millisClock)();
+  uint32_t (*microsClock)();
+  uint32_t nestedUs = 0; // time spent in nested runs during the current step
+};
+
+// Make a task due after delayMs
+void schedulerWake(Scheduler &scheduler, Task &task, uint32_t delayMs);
+
+// Run every due task once, earliest deadline first. Returns the ms until
+// the next deadline, TASK_SUSPEND if all tasks are suspended.
+uint32_t schedulerRun(Scheduler &scheduler);
+
+// For steps that have to wait: runs due tasks other than the ones already
+// running, so a slow network step does not stall the other cadences
+void schedulerYield(Scheduler &scheduler);
+
+uint32_t schedulerAverageUs(const Task &task);
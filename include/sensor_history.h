@@ -0,0 +1,39 @@
+#pragma once
+#include "sensors.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Minute-by-minute history of all sensors in LittleFS, compressed so a week
+// takes a few dozen KB. Each record stores the timestamp as the change of
+// the sampling interval (delta of delta, one bit while it stays the same)
+// and every value, quantized to the sensor's upload precision, as the
+// change since the previous record in a prefix code of 1 to 36 bits.
+// Records are padded to whole bytes, so an append never rewrites flash that
+// was already written and a torn last record is simply dropped.
+//
+// The records go to a ring of HISTORY_SEGMENTS files that hold
+// HISTORY_SEGMENT_RECORDS each. When a segment is full the oldest file is
+// started over, so writes move round the files and a week of history
+// never takes more flash than the ring.
+#define HISTORY_SEGMENT_RECORDS 720 // 12 hours of minute samples
+#define HISTORY_SEGMENTS 16         // 7.5 days plus the running segment
+
+// Load the position of the ring, LittleFS must be mounted
+// (uploadQueueBegin()). The table supplies the precision of each sensor,
+// segments written with a different table are ignored.
+bool historyBegin(const SensorDef *sensors);
+
+// Append one sample, values by SensorIndex, NAN for a missing value
+bool historyAppend(uint32_t timestamp, const float *values);
+
+// Call visit for every record from the given epoch time on, oldest first.
+// Returns the number of records visited.
+typedef void (*HistoryVisitor)(uint32_t timestamp, const float *values, void *context);
+size_t historyScan(uint32_t from, HistoryVisitor visit, void *context);
+
+struct HistoryUsage
+{
+  uint32_t records;
+  uint32_t bytes; // in the segment files, headers included
+};
+void historyUsage(HistoryUsage &usage);
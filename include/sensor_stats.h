@@ -0,0 +1,45 @@
+#pragma once
+#include <stdint.h>
+
+// Statistics of one sensor over an upload interval in constant memory:
+// sample count, mean, min and max. The mean uses Welford's running update
+// instead of a sum, so it keeps its precision however many samples come in.
+// The struct is stored as-is in RTC user memory.
+//
+// With spike rejection a sample enters the statistics as the median of it
+// and the SENSOR_STATS_MEDIAN - 1 samples before it, so a single outlier
+// (a DS18B20 answering with its 85 C power-on value, a BMP280 read torn by
+// a bus error) never shows up in the mean, min or max. The first samples
+// after sensorStatsClear() are held back until the window is full, a spike
+// right at power-up is rejected like any other.
+#ifndef SENSOR_STATS_MEDIAN
+#define SENSOR_STATS_MEDIAN 3
+#endif
+static_assert(SENSOR_STATS_MEDIAN >= 3 && SENSOR_STATS_MEDIAN <= 9 && SENSOR_STATS_MEDIAN % 2 == 1,
+              "SENSOR_STATS_MEDIAN must be odd and 3..9");
+
+struct SensorStats
+{
+  float mean;
+  float min;
+  float max;
+  float recent[SENSOR_STATS_MEDIAN - 1]; // latest samples, oldest first, unfiltered
+  uint16_t count;                        // samples since the last reset
+  uint8_t recentCount;                   // valid entries in recent
+  uint8_t reserved;
+};
+
+// Start a new interval. The median window carries over, the samples
+// before the reset still tell a spike from a step.
+void sensorStatsReset(SensorStats &stats);
+
+// Forget everything, e.g. when the sensor was replaced
+void sensorStatsClear(SensorStats &stats);
+
+// Feed one sample, NAN is ignored. Returns the value that went into the
+// statistics, which is the median when rejecting spikes, NAN while the
+// window is still filling.
+float sensorStatsAdd(SensorStats &stats, float value, bool rejectSpikes);
+
+// The latest valid sample, NAN before the first
+float sensorStatsLatest(const SensorStats &stats);
@@ -0,0 +1,75 @@
+#pragma once
+#include <Arduino.h>
+#include <stdint.h>
+
+// The measured quantities. Each one is a row of the SENSORS table in
+// main.cpp that says how it is read, calibrated, uploaded and shown; the
+// read, upload and display code loops over the table. The table is built
+// at compile time and kept in flash, code takes a row with sensorDef(). Every sample feeds
+// the sensor's SensorStats, a queued reading takes the interval's mean. The upload queue
+// and the RTC state store the values in this order; a firmware with a
+// different count starts with an empty queue.
+
+// DS18B20 probes on the OneWire bus. More than one needs the DS18B20_PROBES
+// mapping from ROM codes to openSenseMap ids in secrets.h.
+#ifndef DS18B20_PROBE_COUNT
+#define DS18B20_PROBE_COUNT 1
+#endif
+
+enum SensorIndex
+{
+  SENSOR_TEMP,     // BMP280 temperature
+  SENSOR_PRES,     // BMP280 pressure
+  SENSOR_TEMP_OUT, // first DS18B20 probe
+  SENSOR_LUX,      // BH1750
+  SENSOR_PROBE_1,  // the other DS18B20 probes follow
+  SENSOR_COUNT = SENSOR_PROBE_1 + DS18B20_PROBE_COUNT - 1
+};
+
+// How a sensor is read, a case of readSensor() in main.cpp
+enum SensorKind
+{
+  SENSOR_KIND_BMP280_TEMP,
+  SENSOR_KIND_BMP280_PRES,
+  SENSOR_KIND_DS18B20, // channel is the probe
+  SENSOR_KIND_BH1750
+};
+
+struct SensorDef
+{
+  uint8_t kind;         // SensorKind
+  float scale;          // calibrated value = raw * scale + offset
+  float offset;
+  const char *osemId;   // openSenseMap sensor id, SENSOR_ID_* from secrets.h
+  uint8_t decimals;     // uploaded precision
+  uint8_t shownDecimals; // precision on the display
+  const char *unit;     // display text after the value, characters from the glyph atlas
+  uint8_t widget;       // display slot, SENSOR_NO_WIDGET if not shown
+  uint8_t phase;        // TelemetryPhase the read is timed as
+  uint8_t channel;      // which one of its kind, e.g. the probe number
+  uint8_t upload;       // SENSOR_UPLOAD_MEAN or SENSOR_UPLOAD_LAST
+  bool rejectSpikes;    // median filter before the statistics, see sensor_stats.h
+  float deadband;       // change since the last upload that sends the queue, 0 for none
+  float ratePerHour;    // or change per hour since then, see upload_policy.h
+  const char *label;    // title of the history graph page
+  const char *field;    // InfluxDB line protocol field key, see publisher.h
+};
+
+#define SENSOR_NO_WIDGET 0xff
+
+// Row i of a sensor table in flash (PROGMEM), copied out: the ESP8266 only
+// reads flash in aligned words. Tables in RAM work as well.
+inline SensorDef sensorDef(const SensorDef *sensors, int i)
+{
+  SensorDef def;
+  memcpy_P(&def, &sensors[i], sizeof(def));
+  return def;
+}
+
+// What a queued reading holds for a sensor: the mean of the samples since
+// the previous reading or the latest sample
+enum
+{
+  SENSOR_UPLOAD_MEAN,
+  SENSOR_UPLOAD_LAST
+};
@@ -0,0 +1,28 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Incremental parser for the body of the openSenseMap statistics API
+// response ("tidy" CSV of sensorId,time,value). Bytes are fed as they
+// arrive from the HTTP client, nothing is buffered beyond one line and
+// nothing is allocated. Accepted values are written to the caller's array;
+// when it is full the oldest value is dropped.
+#define STATS_CSV_LINE_MAX 80
+
+struct StatsCsvParser
+{
+  bool lineOverflow;
+  uint8_t lineLength;
+  char line[STATS_CSV_LINE_MAX];
+  float *values;
+  uint8_t capacity;
+  uint8_t count;       // values currently stored
+  uint16_t lines;      // body lines seen
+  uint16_t rejected;   // body lines with a value outside the plausible range
+};
+
+void statsCsvBegin(StatsCsvParser &parser, float *values, uint8_t capacity);
+void statsCsvFeed(StatsCsvParser &parser, const uint8_t *data, size_t length);
+
+// Flush a last line that was not terminated by a newline
+void statsCsvFinish(StatsCsvParser &parser);
@@ -0,0 +1,64 @@
+#pragma once
+#include <Print.h>
+#include <stdint.h>
+
+// Where time and memory go on the device. Phase durations are collected in
+// fixed log2 histograms, heap state as low-water marks. Nothing allocates,
+// the whole state is a few hundred bytes of static memory.
+enum TelemetryPhase
+{
+  PHASE_WIFI_JOIN,
+  PHASE_NTP_WAIT,
+  PHASE_TLS_HANDSHAKE, // connect including the handshake
+  PHASE_UPLOAD,        // one upload session, all requests
+  PHASE_TREND_FETCH,   // statistics API backfill
+  PHASE_BMP280_READ,
+  PHASE_DS18B20_READ,
+  PHASE_BH1750_READ,
+  PHASE_DISPLAY_FLUSH,
+  PHASE_HISTORY_APPEND, // one record to flash, see sensor_history.h
+  PHASE_HISTORY_SCAN,   // reading a graph page's worth
+  PHASE_MIRROR,         // one batch to the local mirrors, see publisher.h
+  PHASE_LAN_PAGES,      // rebuilding /metrics and /json, see lan_pages.h
+  PHASE_COUNT
+};
+
+// Bucket n counts durations in [2^n, 2^(n+1)) us, the last one everything
+// from ~8 s up
+#define TELEMETRY_BUCKETS 24
+
+struct PhaseStats
+{
+  uint32_t count;
+  uint32_t lastUs;
+  uint32_t maxUs;
+  uint64_t totalUs;
+  uint16_t buckets[TELEMETRY_BUCKETS]; // saturating
+};
+
+struct HeapStats
+{
+  uint32_t freeNow;
+  uint32_t freeLow;
+  uint32_t maxBlockNow; // largest allocation that would succeed
+  uint32_t maxBlockLow;
+  uint8_t fragmentationNow; // percent
+  uint8_t fragmentationHigh;
+};
+
+void telemetryRecord(TelemetryPhase phase, uint32_t us);
+
+// Short phases are timed with the CPU cycle counter, which wraps after
+// 53 s at 80 MHz
+uint32_t telemetryStart();
+void telemetryStop(TelemetryPhase phase, uint32_t startCycles);
+
+// Once per cycle, updates the low-water marks
+void telemetrySampleHeap();
+
+const PhaseStats &telemetryPhase(TelemetryPhase phase);
+const char *telemetryPhaseName(TelemetryPhase phase);
+const HeapStats &telemetryHeap();
+
+void telemetryDump(Print &out);
+void telemetryReset();
@@ -0,0 +1,34 @@
+#pragma once
+#include <stdint.h>
+
+// Drift-aware NTP scheduling. Each sync pairs the local clock (virtual
+// uptime, which keeps counting through deep sleep) with the NTP time. The
+// rate difference between two syncs is the oscillator drift, and the next
+// sync is due when the error predicted from it reaches the bound. The
+// struct is stored as-is in RTC user memory.
+struct TimeSync
+{
+  int64_t anchorUtcMs;    // NTP time at the sync the drift is measured from, 0 before the first
+  uint32_t anchorLocalMs; // local clock at that sync
+  float driftPpm;         // positive if the local clock runs fast
+  float uncertaintyPpm;   // of driftPpm, from the NTP jitter over the measured span
+  uint32_t syncs;
+};
+
+// NTP answers are trusted to TIME_SYNC_JITTER_MS, drift is only measured
+// over spans of at least TIME_SYNC_MIN_SPAN_MS
+#define TIME_SYNC_JITTER_MS 50
+#define TIME_SYNC_MIN_SPAN_MS 300000UL
+
+void timeSyncReset(TimeSync &sync);
+
+// A sync happened: the clock was set to utcMs at local time localMs
+void timeSyncRecord(TimeSync &sync, uint32_t localMs, int64_t utcMs);
+
+// Error the clock has accumulated by localMs, counted from the drift anchor
+// so an upper bound after a short re-sync
+uint32_t timeSyncPredictedErrorMs(const TimeSync &sync, uint32_t localMs);
+
+// Delay after a sync until the predicted error reaches boundMs, minMs while
+// the drift is still unknown, clamped to [minMs, maxMs]
+uint32_t timeSyncNextDelayMs(const TimeSync &sync, uint32_t boundMs, uint32_t minMs, uint32_t maxMs);
@@ -0,0 +1,26 @@
+#pragma once
+#include "sensors.h"
+#include "upload_queue.h"
+#include <stdint.h>
+
+// Change-driven uploads. Every queued reading is compared with the newest
+// one the server accepted: the queue goes out when a sensor has moved by
+// its deadband, or is moving faster than its rate, since then. Static
+// readings only go out once the heartbeat has passed, which is also the
+// longest the server goes without data while WiFi works. A sensor with
+// deadband and rate 0 never triggers an upload, it rides along.
+enum UploadReason
+{
+  UPLOAD_WAIT,     // nothing worth a WiFi session yet
+  UPLOAD_FIRST,    // no reading sent before or no clock to judge the age
+  UPLOAD_CHANGE,   // a sensor moved by its deadband
+  UPLOAD_RATE,     // a sensor moves faster than its rate
+  UPLOAD_HEARTBEAT // static readings, the heartbeat has passed
+};
+
+// sent is the newest reading on the server, null if there is none. The
+// timestamps are epoch seconds.
+UploadReason uploadPolicyCheck(const QueuedReading &reading, const QueuedReading *sent, const SensorDef *sensors,
+                               uint32_t heartbeatS);
+
+const char *uploadReasonName(UploadReason reason);
@@ -0,0 +1,36 @@
+#pragma once
+#include "sensors.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Persistent FIFO of readings waiting for upload, kept as an append-only
+// log in LittleFS. The read position is stored next to the log, so a batch
+// is only removed after the server accepted it and an interrupted upload
+// resumes with the same readings. When the queue is full the oldest
+// readings are dropped.
+#define UPLOAD_QUEUE_MAX_RECORDS 1008 // 7 days of 10 minute readings, ~20 KB
+
+struct QueuedReading
+{
+  uint32_t timestamp; // epoch seconds, 0 if the clock was not synced
+  float values[SENSOR_COUNT]; // NAN if the sensor had no value
+};
+
+// Mount LittleFS (formatting it if needed) and load the queue position
+bool uploadQueueBegin();
+
+bool uploadQueuePush(const QueuedReading &reading);
+
+// Copy up to max readings from the front of the queue, returns the count
+size_t uploadQueuePeek(QueuedReading *readings, size_t max);
+
+// Remove count readings from the front after they were uploaded. count is
+// taken from the front at the last peek or pop: readings a push into the
+// full queue dropped since then are not removed again.
+void uploadQueuePop(size_t count);
+
+// The newest reading the server accepted, kept across power cycles so the
+// upload policy knows what the server shows. False if none was sent yet.
+bool uploadQueueLastSent(QueuedReading &reading);
+
+size_t uploadQueueSize();
@@ -0,0 +1,24 @@
+#!/bin/sh
+# Runs the firmware over a trace once per upload policy and prints the
+# uploads line of each: uploads per day and the largest reporting error.
+# Every policy is a native build of its own. From the project root:
+#
+#   lib/native_sim/compare_policies.sh [trace] [hours]
+set -e
+trace=${1:-lib/native_sim/traces/cold_front.txt}
+hours=${2:-24}
+policies="FIXED ADAPTIVE"
+
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+for policy in $policies; do
+  PLATFORMIO_BUILD_FLAGS="-DUPLOAD_POLICY=UPLOAD_POLICY_$policy" pio run -s -e native
+  cp .pio/build/native/program "$work/$policy"
+done
+
+echo "$trace, $hours h"
+for policy in $policies; do
+  mkdir "$work/$policy.fs"
+  SIM_FS_DIR="$work/$policy.fs" "$work/$policy" --hours "$hours" --script "$trace" |
+    sed -n "s/^uploads */$(printf '%-9s' "$policy") /p"
+done
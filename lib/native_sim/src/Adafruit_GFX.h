@@ -0,0 +1,54 @@
+#pragma once
+#include "Arduino.h"
+
+// Drawing primitives of Adafruit_GFX. Text uses a placeholder 5x7 pattern
+// per character in the classic 6x8 cell, so layout and pixel counts match
+// the real font but the glyphs do not.
+class Adafruit_GFX : public Print
+{
+public:
+  Adafruit_GFX(int16_t w, int16_t h) : _width(w), _height(h) {}
+
+  virtual void drawPixel(int16_t x, int16_t y, uint16_t color) = 0;
+  virtual void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color);
+  virtual void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color);
+  virtual void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+  virtual void fillScreen(uint16_t color);
+  void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color);
+  void drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+  void drawBitmap(int16_t x, int16_t y, const uint8_t *bitmap, int16_t w, int16_t h, uint16_t color);
+  void drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color, uint16_t bg, uint8_t size);
+
+  void setCursor(int16_t x, int16_t y)
+  {
+    _cursorX = x;
+    _cursorY = y;
+  }
+  void setTextSize(uint8_t size) { _textSize = size > 0 ? size : 1; }
+  void setTextColor(uint16_t color) { _textColor = _textBg = color; }
+  void setTextColor(uint16_t color, uint16_t bg)
+  {
+    _textColor = color;
+    _textBg = bg;
+  }
+  void setTextWrap(bool wrap) { _wrap = wrap; }
+  void getTextBounds(const char *s, int16_t x, int16_t y, int16_t *x1, int16_t *y1, uint16_t *w, uint16_t *h);
+  int16_t getCursorX() const { return _cursorX; }
+  int16_t getCursorY() const { return _cursorY; }
+
+  size_t write(uint8_t c) override;
+  using Print::write;
+
+  int16_t width() const { return _width; }
+  int16_t height() const { return _height; }
+
+protected:
+  int16_t _width;
+  int16_t _height;
+  int16_t _cursorX = 0;
+  int16_t _cursorY = 0;
+  uint16_t _textColor = 0xffff;
+  uint16_t _textBg = 0xffff;
+  uint8_t _textSize = 1;
+  bool _wrap = true;
+};
@@ -0,0 +1,119 @@
+#pragma once
+// Host build of the small part of the ESP8266 Arduino core the firmware
+// uses. Time is simulated, see sim.h.
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define F(s) (s)
+#define IRAM_ATTR
+#define ICACHE_RAM_ATTR
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+inline uint8_t pgm_read_byte(const void *p) { return *(const uint8_t *)p; }
+inline uint16_t pgm_read_word(const void *p) { return *(const uint16_t *)p; }
+inline uint32_t pgm_read_dword(const void *p) { return *(const uint32_t *)p; }
+#define memcpy_P memcpy
+#define strlen_P strlen
+#define strncmp_P strncmp
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+// GPIO, only used to free the I2C bus. The lines idle high, nothing on the
+// simulated bus ever holds SDA low.
+#define LOW 0
+#define HIGH 1
+#define INPUT 0x00
+#define INPUT_PULLUP 0x02
+#define OUTPUT 0x01
+#define OUTPUT_OPEN_DRAIN 0x03
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t value);
+
+class Print
+{
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  size_t write(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+  size_t write(const char *s, size_t size) { return write((const uint8_t *)s, size); }
+
+  size_t print(const char *s) { return write(s); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int n) { return printf("%d", n); }
+  size_t print(unsigned int n) { return printf("%u", n); }
+  size_t print(long n) { return printf("%ld", n); }
+  size_t print(unsigned long n) { return printf("%lu", n); }
+  size_t print(double n, int digits = 2) { return printf("%.*f", digits, n); }
+
+  template <typename T>
+  size_t println(T value)
+  {
+    size_t n = print(value);
+    return n + println();
+  }
+  size_t println(double value, int digits) { return print(value, digits) + println(); }
+  size_t println() { return write("\r\n"); }
+
+  size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+  virtual void flush() {}
+};
+
+class Stream : public Print
+{
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  void setTimeout(unsigned long timeout) { _timeout = timeout; }
+
+protected:
+  unsigned long _timeout = 1000;
+};
+
+class HardwareSerial : public Stream
+{
+public:
+  void begin(unsigned long) {}
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+// The firmware's wall clock runs on simulated time as well
+time_t simTime(time_t *t);
+int simGettimeofday(struct timeval *tv, void *tz);
+int simSettimeofday(const struct timeval *tv, const struct timezone *tz);
+#define time(t) simTime(t)
+#define gettimeofday(tv, tz) simGettimeofday(tv, tz)
+#define settimeofday(tv, tz) simSettimeofday(tv, tz)
+
+void configTime(long gmtOffset, int daylightOffset, const char *server1,
+                const char *server2 = nullptr, const char *server3 = nullptr);
+// Sets TZ to a POSIX time zone string as well
+void configTime(const char *tz, const char *server1, const char *server2 = nullptr,
+                const char *server3 = nullptr);
+
+#include "Esp.h"
+#include "IPAddress.h"
@@ -0,0 +1,55 @@
+#pragma once
+#include "OneWire.h"
+
+#define DEVICE_DISCONNECTED_C -127
+#define DEVICE_DISCONNECTED_RAW -7040
+
+typedef uint8_t DeviceAddress[8];
+
+// Scripted DS18B20 probes, SIM_DS18B20_PROBES in the environment (default
+// 1). Probe n reads the outdoor temperature plus n * 0.5 K. Like the real
+// sensor a read before the conversion finished returns the previous result,
+// 85 C after power-up.
+class DallasTemperature
+{
+public:
+  struct request_t
+  {
+    bool result;
+    unsigned long timestamp;
+    operator bool() { return result; }
+  };
+
+  DallasTemperature(OneWire *wire) : _wire(wire) {}
+  void begin();
+  uint8_t getDeviceCount();
+  uint8_t getDS18Count() { return getDeviceCount(); }
+  bool getAddress(uint8_t *deviceAddress, uint8_t index);
+  bool validAddress(const uint8_t *deviceAddress);
+  bool isConnected(const uint8_t *deviceAddress);
+
+  uint8_t getResolution() { return _resolution; }
+  uint8_t getResolution(const uint8_t *deviceAddress);
+  bool setResolution(uint8_t newResolution);
+  bool setResolution(const uint8_t *deviceAddress, uint8_t newResolution, bool skipGlobalBitResolutionCalculation = false);
+  void setWaitForConversion(bool wait) { _waitForConversion = wait; }
+  bool getWaitForConversion() { return _waitForConversion; }
+  void setCheckForConversion(bool) {}
+  bool isConversionComplete();
+  int16_t millisToWaitForConversion(uint8_t bitResolution);
+
+  request_t requestTemperatures();
+  request_t requestTemperaturesByAddress(const uint8_t *deviceAddress);
+  float getTempC(const uint8_t *deviceAddress);
+  float getTempCByIndex(uint8_t index);
+
+private:
+  int probeIndex(const uint8_t *deviceAddress);
+  void finishConversions();
+  void startConversion(int probe);
+
+  OneWire *_wire;
+  bool _waitForConversion = true;
+  uint8_t _resolution = 12;
+  uint8_t _devices = 0;
+};
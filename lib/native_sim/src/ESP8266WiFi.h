@@ -0,0 +1,73 @@
+#pragma once
+#include "Arduino.h"
+#include "IPAddress.h"
+#include "WiFiClient.h"
+#include "WiFiServer.h"
+
+enum WiFiMode_t
+{
+  WIFI_OFF = 0,
+  WIFI_STA = 1,
+  WIFI_AP = 2,
+  WIFI_AP_STA = 3
+};
+
+enum wl_status_t
+{
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_SCAN_COMPLETED = 2,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_CONNECTION_LOST = 5,
+  WL_WRONG_PASSWORD = 6,
+  WL_DISCONNECTED = 7
+};
+
+enum WiFiSleepType_t
+{
+  WIFI_NONE_SLEEP = 0,
+  WIFI_LIGHT_SLEEP = 1,
+  WIFI_MODEM_SLEEP = 2
+};
+
+// One simulated access point. A join with its BSSID and channel skips the
+// scan, a static configuration skips DHCP. SIM_WIFI=0 takes it off the air.
+class ESP8266WiFiClass
+{
+public:
+  void persistent(bool) {}
+  bool setSleepMode(WiFiSleepType_t type)
+  {
+    _sleep = type;
+    return true;
+  }
+  bool mode(WiFiMode_t mode);
+  WiFiMode_t getMode() const { return _mode; }
+  bool config(IPAddress local, IPAddress gateway, IPAddress subnet, IPAddress dns1 = (uint32_t)0,
+              IPAddress dns2 = (uint32_t)0);
+  wl_status_t begin(const char *ssid, const char *passphrase = nullptr, int32_t channel = 0,
+                    const uint8_t *bssid = nullptr, bool connect = true);
+  bool disconnect(bool wifioff = false);
+  wl_status_t status();
+  bool isConnected() { return status() == WL_CONNECTED; }
+
+  uint8_t *BSSID();
+  int32_t channel();
+  int32_t RSSI() { return -60; }
+  IPAddress localIP();
+  IPAddress gatewayIP();
+  IPAddress subnetMask();
+  IPAddress dnsIP(uint8_t dns_no = 0);
+
+private:
+  WiFiMode_t _mode = WIFI_OFF;
+  bool _static = false;
+  uint32_t _ip = 0, _gateway = 0, _subnet = 0, _dns = 0;
+  bool _joining = false;
+  bool _fast = false;
+  uint64_t _connectedAt = 0;
+  WiFiSleepType_t _sleep = WIFI_MODEM_SLEEP;
+};
+
+extern ESP8266WiFiClass WiFi;
@@ -0,0 +1,55 @@
+#pragma once
+#include <stdint.h>
+
+enum RFMode
+{
+  WAKE_RF_DEFAULT = 0,
+  WAKE_RFCAL = 1,
+  WAKE_NO_RFCAL = 2,
+  WAKE_RF_DISABLED = 4
+};
+
+enum rst_reason
+{
+  REASON_DEFAULT_RST = 0,
+  REASON_WDT_RST = 1,
+  REASON_EXCEPTION_RST = 2,
+  REASON_SOFT_WDT_RST = 3,
+  REASON_SOFT_RESTART = 4,
+  REASON_DEEP_SLEEP_AWAKE = 5,
+  REASON_EXT_SYS_RST = 6
+};
+
+struct rst_info
+{
+  uint32_t reason;
+  uint32_t exccause;
+  uint32_t epc1;
+  uint32_t epc2;
+  uint32_t epc3;
+  uint32_t excvaddr;
+  uint32_t depc;
+};
+
+// 512 bytes of RTC user memory, kept across simulated deep sleep
+class EspClass
+{
+public:
+  bool rtcUserMemoryRead(uint32_t offset, uint32_t *data, size_t size);
+  bool rtcUserMemoryWrite(uint32_t offset, uint32_t *data, size_t size);
+  // Does not return: the simulation restarts setup() after the sleep time
+  [[noreturn]] void deepSleep(uint64_t timeUs, RFMode mode = WAKE_RF_DEFAULT);
+  rst_info *getResetInfoPtr();
+  uint32_t getFreeHeap();
+  uint32_t getMaxFreeBlockSize();
+  uint8_t getHeapFragmentation();
+  uint8_t getCpuFreqMHz();
+  uint32_t getCycleCount();
+  void restart();
+};
+
+extern EspClass ESP;
+
+// user_interface.h, 80 or 160 MHz
+bool system_update_cpu_freq(uint8_t freq);
+uint8_t system_get_cpu_freq();
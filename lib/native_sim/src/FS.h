@@ -0,0 +1,49 @@
+#pragma once
+#include "Arduino.h"
+
+enum SeekMode
+{
+  SeekSet = 0,
+  SeekCur = 1,
+  SeekEnd = 2
+};
+
+// A file of the simulated flash, stored in a host directory
+class File : public Stream
+{
+public:
+  File(FILE *f = nullptr) : _f(f) {}
+  File(File &&other) : _f(other._f) { other._f = nullptr; }
+  File &operator=(File &&other);
+  ~File() { close(); }
+
+  operator bool() const { return _f != nullptr; }
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *buffer, size_t size) override;
+  using Print::write;
+  int available() override;
+  int read() override;
+  int peek() override;
+  int read(uint8_t *buffer, size_t size);
+  bool seek(uint32_t pos, SeekMode mode = SeekSet);
+  size_t position() const;
+  size_t size() const;
+  bool truncate(uint32_t size);
+  void flush() override;
+  void close();
+
+private:
+  FILE *_f;
+};
+
+class FS
+{
+public:
+  bool begin();
+  void end() {}
+  bool format();
+  File open(const char *path, const char *mode);
+  bool exists(const char *path);
+  bool remove(const char *path);
+  bool rename(const char *from, const char *to);
+};
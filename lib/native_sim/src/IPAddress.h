@@ -0,0 +1,15 @@
+#pragma once
+#include <stdint.h>
+
+class IPAddress
+{
+public:
+  IPAddress() : _address(0) {}
+  IPAddress(uint32_t address) : _address(address) {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+      : _address(a | (uint32_t)b << 8 | (uint32_t)c << 16 | (uint32_t)d << 24) {}
+  operator uint32_t() const { return _address; }
+
+private:
+  uint32_t _address; // network order, like the core
+};
@@ -0,0 +1,5 @@
+#pragma once
+#include "FS.h"
+
+// Files live in SIM_FS_DIR (default .sim_littlefs in the working directory)
+extern FS LittleFS;
@@ -0,0 +1,15 @@
+#pragma once
+#include "Arduino.h"
+
+// Bus timing only, the devices are simulated by DallasTemperature.h
+class OneWire
+{
+public:
+  OneWire(uint8_t pin) { (void)pin; }
+  uint8_t reset();
+  void write(uint8_t v, uint8_t power = 0);
+  uint8_t read();
+  void select(const uint8_t rom[8]);
+  void skip();
+  static uint8_t crc8(const uint8_t *addr, uint8_t len);
+};
@@ -0,0 +1,46 @@
+#pragma once
+#include "Client.h"
+
+// TCP to the simulated openSenseMap, InfluxDB and MQTT servers, a few
+// connections at a time. An HTTP request is answered once it is complete,
+// after a simulated round trip, and the server closes the connection after
+// the response. The broker answers each packet and keeps it open.
+// WiFiServer::accept() hands out the other end of a scraper's connection.
+class WiFiClient : public Client
+{
+public:
+  WiFiClient() {}
+  WiFiClient(const WiFiClient &) = delete;
+  ~WiFiClient() { stop(); }
+  // Takes over the connection, the real client shares it by reference count
+  WiFiClient &operator=(WiFiClient &&other)
+  {
+    if (this != &other)
+    {
+      stop();
+      _open = other._open;
+      _slot = other._slot;
+      other._open = false;
+    }
+    return *this;
+  }
+  int connect(const char *host, uint16_t port) override;
+  size_t write(uint8_t b) override { return write(&b, 1); }
+  size_t write(const uint8_t *buffer, size_t size) override;
+  using Print::write;
+  int available() override;
+  int read() override;
+  int read(uint8_t *buffer, size_t size) override;
+  int peek() override;
+  uint8_t connected() override;
+  void stop() override;
+  void setNoDelay(bool) {}
+  operator bool() { return connected(); }
+
+protected:
+  friend class WiFiServer;
+  explicit WiFiClient(int slot) : _open(true), _slot(slot) {}
+  virtual uint32_t handshakeMs() { return 0; }
+  bool _open = false;
+  int _slot = 0;
+};
@@ -0,0 +1,39 @@
+#pragma once
+#include "WiFiClient.h"
+
+namespace BearSSL
+{
+// Parameters of an established session, for an abbreviated handshake
+class Session
+{
+public:
+  bool valid = false;
+};
+} // namespace BearSSL
+
+// The TLS handshake costs simulated time, the bytes are not encrypted. The
+// record buffers are allocated while connected, so they show in the heap
+// statistics. SIM_TLS_MFLN=0 makes the server ignore max fragment length.
+class WiFiClientSecure : public WiFiClient
+{
+public:
+  ~WiFiClientSecure() { stop(); }
+  int connect(const char *host, uint16_t port) override;
+  void stop() override;
+  void setInsecure() {}
+  void setSession(BearSSL::Session *session) { _session = session; }
+  void setBufferSizes(int recv, int xmit)
+  {
+    _recv = recv;
+    _xmit = xmit;
+  }
+  bool getMFLNStatus() { return _open && _recv < 16384; }
+  static bool probeMaxFragmentLength(const char *host, uint16_t port, uint16_t len);
+
+protected:
+  uint32_t handshakeMs() override;
+  int _recv = 16384;
+  int _xmit = 512;
+  BearSSL::Session *_session = nullptr;
+  void *_buffers = nullptr;
+};
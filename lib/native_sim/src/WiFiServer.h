@@ -0,0 +1,28 @@
+#pragma once
+#include "WiFiClient.h"
+
+// Scrapers on the LAN. While WiFi is up and the server listens, a GET of
+// /metrics and one of /json arrive every SIM_SCRAPE_MS of world time
+// (default 15 s, 0 for none), each on its own connection and half a
+// SIM_RTT_MS after it is accepted. When the firmware closes it the
+// response is checked: status line, Content-Length and a body of
+// Prometheus text lines or a well-formed JSON object.
+class WiFiServer
+{
+public:
+  explicit WiFiServer(uint16_t port) : _port(port) {}
+  void begin() { _listening = true; }
+  void begin(uint16_t port)
+  {
+    _port = port;
+    begin();
+  }
+  void stop() { _listening = false; }
+  WiFiClient accept();
+
+private:
+  uint16_t _port;
+  bool _listening = false;
+  uint64_t _nextScrape = 0;
+  uint8_t _pending = 0; // requests of the current scrape not yet accepted
+};
@@ -0,0 +1,12 @@
+#pragma once
+#include "Arduino.h"
+
+// Datagrams to the simulated InfluxDB UDP listener, see sim_wifi.cpp. A
+// datagram is delivered whole or not at all, up to the 1472 byte MTU.
+class WiFiUDP
+{
+public:
+  int beginPacket(const char *host, uint16_t port);
+  size_t write(const uint8_t *buffer, size_t size);
+  int endPacket();
+};
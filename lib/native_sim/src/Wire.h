@@ -0,0 +1,40 @@
+#pragma once
+#include "Arduino.h"
+
+#ifndef BUFFER_LENGTH
+#define BUFFER_LENGTH 128
+#endif
+
+// I2C master on the simulated bus. Transactions go to the attached
+// simulated devices and are counted in simStats.
+class TwoWire : public Stream
+{
+public:
+  void begin(int sda, int scl);
+  void begin();
+  void setClock(uint32_t frequency);
+  void setClockStretchLimit(uint32_t) {}
+  uint32_t getClock() const { return _clock; }
+
+  void beginTransmission(uint8_t address);
+  uint8_t endTransmission(bool sendStop = true);
+  uint8_t requestFrom(uint8_t address, size_t quantity, bool sendStop = true);
+
+  size_t write(uint8_t data) override;
+  size_t write(const uint8_t *data, size_t quantity) override;
+  using Print::write;
+  int available() override;
+  int read() override;
+  int peek() override;
+
+private:
+  uint32_t _clock = 100000;
+  uint8_t _address = 0;
+  uint8_t _tx[BUFFER_LENGTH];
+  size_t _txLength = 0;
+  uint8_t _rx[BUFFER_LENGTH];
+  size_t _rxLength = 0;
+  size_t _rxIndex = 0;
+};
+
+extern TwoWire Wire;
@@ -0,0 +1,9 @@
+#pragma once
+#include <functional>
+
+// Called whenever the wall clock is set, fromSntp tells an NTP answer from
+// settimeofday()
+using BoolCB = std::function<void(bool)>;
+using TrivialCB = std::function<void()>;
+void settimeofday_cb(const BoolCB &cb);
+void settimeofday_cb(const TrivialCB &cb);
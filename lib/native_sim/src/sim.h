@@ -0,0 +1,119 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+// Control side of the host simulation. The firmware only sees the Arduino
+// and driver APIs, the benchmark in sim_main.cpp uses this header.
+//
+// Time: delay() does not sleep, it moves the simulated clock forward, so a
+// day of firmware runs in seconds. Real CPU time still counts, millis() and
+// micros() are the real elapsed time plus everything skipped by delay().
+
+// Microseconds of simulated world time since the simulation started
+uint64_t simWorldMicros();
+
+// Skip time without running anything, e.g. deep sleep
+void simAdvance(uint64_t us);
+
+// Called by ESP.deepSleep(): power cycle everything but the RTC memory,
+// the flash and the world clock
+[[noreturn]] void simReboot(uint32_t resetReason);
+
+// Start of the simulated NTP time, SIM_EPOCH in the environment
+time_t simEpoch();
+
+// The firmware's oscillator runs SIM_CLOCK_PPM fast (negative: slow), NTP
+// answers with the true time. Firmware wall clock minus true time, false
+// while the clock was never set.
+bool simClockError(int64_t &us);
+
+// What the scripted sensors read at a given wall time
+struct SimEnvironment
+{
+  float temp;    // BMP280, before the firmware's -4 K self-heating offset
+  float pres;    // hPa
+  float ds18b20; // outdoor probe
+  float lux;
+};
+
+// Built-in diurnal cycle and passing pressure systems, or linear
+// interpolation between the rows of a script loaded with simLoadScript()
+SimEnvironment simEnvironmentAt(time_t t);
+
+// Script rows: "<seconds since SIM_EPOCH> <temp> <pres> <ds18b20> <lux>"
+bool simLoadScript(const char *path);
+
+struct SimStats
+{
+  uint32_t i2cTransactions;
+  uint32_t i2cBytes;        // address byte included
+  uint32_t i2cBusyUs;       // time the bus was clocking
+  uint32_t displayFlushes;  // data transactions to the SSD1306
+  uint32_t wifiJoins;
+  uint32_t httpRequests;
+  uint32_t httpBytesSent;
+  uint32_t httpBytesReceived;
+  uint32_t tlsHandshakes;
+  uint32_t tlsResumed;      // abbreviated handshakes with a kept session
+  uint64_t tlsHandshakeUs;  // simulated time of all handshakes
+  uint32_t tlsBufferPeak;   // largest record buffer allocation, BearSSL overhead included
+  uint32_t uploads;         // measurement POSTs the server accepted
+  uint32_t mqttPublishes;   // acknowledged by the broker
+  uint32_t mqttLines;       // line protocol lines in them
+  uint32_t influxLines;     // written through the InfluxDB HTTP API
+  uint32_t udpLines;        // sent to the InfluxDB UDP listener
+  uint32_t lanRequests;     // answered by the firmware's web server
+  uint32_t lanBytes;        // response bodies
+  uint32_t lanUnavailable;  // answered with 503, no pages yet
+  uint32_t lanInvalid;      // bodies that failed the format check
+  uint32_t deepSleeps;
+  uint32_t radioWakes;      // deep sleeps that power the radio on the wake
+  uint32_t ntpSyncs;
+  uint32_t serialBytes;
+};
+extern SimStats simStats;
+
+// Time WiFi was associated
+uint64_t simWifiUpMicros();
+
+// Newest measurement time on the upload server, 0 before the first upload.
+// The environment's change since then is the reporting error.
+time_t simServerNewest();
+
+// Answer the next HTTP request with this raw response instead of the
+// simulated server's, e.g. to try header variants. The string must stay
+// valid until the request was answered.
+void simHttpRespond(const char *response);
+
+// Serial output goes to stdout unless quiet
+void simSetQuiet(bool quiet);
+
+// Heap accounting of the malloc family, see sim_main.cpp
+size_t simHeapInUse();
+size_t simHeapPeak();
+void simHeapResetPeak();
+uint32_t simHeapAllocations(); // successful calls, drivers included
+
+// I2C faults: a device that stops acknowledging its address, and one reset
+// halfway through a read that holds SDA low for clocks more SCL pulses
+void simI2cUnplug(uint8_t address, bool unplugged);
+void simI2cStickSda(uint8_t clocks);
+
+// The transfers on the bus in order, for tests that check how they
+// interleave. The first SIM_I2C_LOG_SIZE after simI2cLogClear() are kept.
+#define SIM_I2C_LOG_SIZE 256
+struct SimI2cTransfer
+{
+  uint8_t address;
+  bool read;
+  uint8_t length;  // data bytes, without the address byte
+  uint8_t data[8]; // the first bytes written
+};
+void simI2cLogClear();
+size_t simI2cLogCount();
+const SimI2cTransfer &simI2cLogEntry(size_t index);
+
+// SSD1306 stand-in: what the controller shows, 8 pages of 128 columns
+const uint8_t *simDisplayRam();
+bool simDisplayOn();
@@ -0,0 +1,308 @@
+#include "Arduino.h"
+#include "coredecls.h"
+#include "sim_internal.h"
+
+#undef time
+#undef gettimeofday
+#undef settimeofday
+
+HardwareSerial Serial;
+EspClass ESP;
+SimStats simStats;
+
+static bool quiet = false;
+
+static uint64_t realStartUs = 0;
+static uint64_t skippedUs = 0;
+static uint64_t bootDeviceUs = 0;
+static bool wallClockSet = false;
+static int64_t wallOffsetUs = 0; // wall time minus device time
+static BoolCB timeSetCallback;
+static uint8_t cpuFreqMHz = 80;
+
+static uint32_t rtcMemory[128];
+static rst_info resetInfo = {REASON_DEFAULT_RST, 0, 0, 0, 0, 0, 0};
+
+static uint64_t realMicros()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  uint64_t us = (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+  if (realStartUs == 0)
+    realStartUs = us;
+  return us - realStartUs;
+}
+
+uint64_t simWorldMicros()
+{
+  return realMicros() + skippedUs;
+}
+
+void simAdvance(uint64_t us)
+{
+  skippedUs += us;
+}
+
+// Device clock ticks per world tick, SIM_CLOCK_PPM off from 1
+static double clockRate()
+{
+  static double rate = 0;
+  if (rate == 0)
+  {
+    const char *env = getenv("SIM_CLOCK_PPM");
+    rate = 1.0 + (env ? atof(env) : 0.0) / 1e6;
+  }
+  return rate;
+}
+
+// The firmware's oscillator, which drives millis(), micros(), the wall
+// clock between syncs and the deep sleep timer
+static uint64_t deviceMicros()
+{
+  return (uint64_t)(simWorldMicros() * clockRate());
+}
+
+// Let the given device time pass
+static void skipDevice(uint64_t us)
+{
+  skippedUs += (uint64_t)(us / clockRate());
+}
+
+time_t simEpoch()
+{
+  static time_t epoch = 0;
+  if (epoch == 0)
+  {
+    const char *env = getenv("SIM_EPOCH");
+    epoch = env ? (time_t)strtoll(env, nullptr, 10) : 1760000000; // 2025-10-09
+  }
+  return epoch;
+}
+
+void simReboot(uint32_t resetReason)
+{
+  resetInfo.reason = resetReason;
+  bootDeviceUs = deviceMicros();
+  cpuFreqMHz = 80;
+  wallClockSet = false; // the RTC counter does not survive as wall time
+  simWifiReset();
+  simRestart();
+}
+
+void simSetQuiet(bool q)
+{
+  quiet = q;
+}
+
+unsigned long millis()
+{
+  return (unsigned long)((deviceMicros() - bootDeviceUs) / 1000);
+}
+
+unsigned long micros()
+{
+  return (unsigned long)(deviceMicros() - bootDeviceUs);
+}
+
+void delay(unsigned long ms)
+{
+  skipDevice((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  skipDevice(us);
+}
+
+void yield()
+{
+}
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+  size_t n = 0;
+  while (size--)
+    n += write(*buffer++);
+  return n;
+}
+
+size_t Print::printf(const char *format, ...)
+{
+  char buffer[256];
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+  if (len < 0)
+    return 0;
+  if (len >= (int)sizeof(buffer))
+    len = sizeof(buffer) - 1;
+  return write((const uint8_t *)buffer, len);
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+  return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+  simStats.serialBytes += size;
+  if (!quiet)
+    fwrite(buffer, 1, size, stdout);
+  return size;
+}
+
+time_t simTime(time_t *t)
+{
+  struct timeval tv;
+  simGettimeofday(&tv, nullptr);
+  if (t)
+    *t = tv.tv_sec;
+  return tv.tv_sec;
+}
+
+int simGettimeofday(struct timeval *tv, void *)
+{
+  // Without a sync the clock counts from 1970 at boot, like the ESP8266
+  int64_t us = wallClockSet ? (int64_t)deviceMicros() + wallOffsetUs
+                            : (int64_t)(deviceMicros() - bootDeviceUs);
+  tv->tv_sec = (time_t)(us / 1000000);
+  tv->tv_usec = (suseconds_t)(us % 1000000);
+  return 0;
+}
+
+int simSettimeofday(const struct timeval *tv, const struct timezone *)
+{
+  wallOffsetUs = (int64_t)tv->tv_sec * 1000000 + tv->tv_usec - (int64_t)deviceMicros();
+  wallClockSet = true;
+  if (timeSetCallback)
+    timeSetCallback(false);
+  return 0;
+}
+
+bool simClockError(int64_t &us)
+{
+  if (!wallClockSet)
+    return false;
+  us = (int64_t)deviceMicros() + wallOffsetUs - ((int64_t)simEpoch() * 1000000 + (int64_t)simWorldMicros());
+  return true;
+}
+
+void settimeofday_cb(const BoolCB &cb)
+{
+  timeSetCallback = cb;
+}
+
+void settimeofday_cb(const TrivialCB &cb)
+{
+  timeSetCallback = [cb](bool) { cb(); };
+}
+
+void configTime(long, int, const char *, const char *, const char *)
+{
+  // SIM_NTP=0 makes the servers unreachable
+  const char *env = getenv("SIM_NTP");
+  if (env && strcmp(env, "0") == 0)
+    return;
+
+  // The answer arrives immediately, NTP time is the simulation's world clock
+  wallOffsetUs = (int64_t)simEpoch() * 1000000 + (int64_t)simWorldMicros() - (int64_t)deviceMicros();
+  wallClockSet = true;
+  simStats.ntpSyncs++;
+  if (timeSetCallback)
+    timeSetCallback(true);
+}
+
+void configTime(const char *tz, const char *server1, const char *server2, const char *server3)
+{
+  setenv("TZ", tz, 1);
+  tzset();
+  configTime(0, 0, server1, server2, server3);
+}
+
+bool EspClass::rtcUserMemoryRead(uint32_t offset, uint32_t *data, size_t size)
+{
+  if (offset * 4 + size > sizeof(rtcMemory))
+    return false;
+  memcpy(data, (uint8_t *)rtcMemory + offset * 4, size);
+  return true;
+}
+
+bool EspClass::rtcUserMemoryWrite(uint32_t offset, uint32_t *data, size_t size)
+{
+  if (offset * 4 + size > sizeof(rtcMemory))
+    return false;
+  memcpy((uint8_t *)rtcMemory + offset * 4, data, size);
+  return true;
+}
+
+// WAKE_RF_DISABLED leaves the radio without calibration until the next
+// deep sleep, WiFi cannot start in that wake
+static bool radioDisabled = false;
+
+bool simRadioDisabled()
+{
+  return radioDisabled;
+}
+
+void EspClass::deepSleep(uint64_t timeUs, RFMode mode)
+{
+  simStats.deepSleeps++;
+  radioDisabled = mode == WAKE_RF_DISABLED;
+  if (!radioDisabled)
+    simStats.radioWakes++;
+  skipDevice(timeUs);
+  simReboot(REASON_DEEP_SLEEP_AWAKE);
+}
+
+rst_info *EspClass::getResetInfoPtr()
+{
+  return &resetInfo;
+}
+
+uint32_t EspClass::getFreeHeap()
+{
+  const size_t heapSize = 80 * 1024; // roughly what the core leaves to the sketch
+  size_t used = simHeapInUse();
+  return used < heapSize ? heapSize - used : 0;
+}
+
+uint32_t EspClass::getMaxFreeBlockSize()
+{
+  // No fragmentation model, the free heap is one block
+  return getFreeHeap();
+}
+
+uint8_t EspClass::getHeapFragmentation()
+{
+  return 0;
+}
+
+bool system_update_cpu_freq(uint8_t freq)
+{
+  if (freq != 80 && freq != 160)
+    return false;
+  cpuFreqMHz = freq;
+  return true;
+}
+
+uint8_t system_get_cpu_freq()
+{
+  return cpuFreqMHz;
+}
+
+uint8_t EspClass::getCpuFreqMHz()
+{
+  return cpuFreqMHz;
+}
+
+uint32_t EspClass::getCycleCount()
+{
+  return (uint32_t)(micros() * getCpuFreqMHz());
+}
+
+void EspClass::restart()
+{
+  simReboot(REASON_SOFT_RESTART);
+}
@@ -0,0 +1,372 @@
+#include "Adafruit_SSD1306.h"
+#include "sim_internal.h"
+
+// --- Adafruit_GFX -----------------------------------------------------------
+
+void Adafruit_GFX::drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color)
+{
+  for (int16_t i = 0; i < h; i++)
+    drawPixel(x, y + i, color);
+}
+
+void Adafruit_GFX::drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color)
+{
+  for (int16_t i = 0; i < w; i++)
+    drawPixel(x + i, y, color);
+}
+
+void Adafruit_GFX::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+{
+  for (int16_t i = 0; i < w; i++)
+    drawFastVLine(x + i, y, h, color);
+}
+
+void Adafruit_GFX::fillScreen(uint16_t color)
+{
+  fillRect(0, 0, _width, _height, color);
+}
+
+void Adafruit_GFX::drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color)
+{
+  int16_t dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+  int16_t dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+  int16_t err = dx + dy;
+  while (true)
+  {
+    drawPixel(x0, y0, color);
+    if (x0 == x1 && y0 == y1)
+      break;
+    int16_t e2 = 2 * err;
+    if (e2 >= dy)
+    {
+      err += dy;
+      x0 += sx;
+    }
+    if (e2 <= dx)
+    {
+      err += dx;
+      y0 += sy;
+    }
+  }
+}
+
+void Adafruit_GFX::drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+{
+  drawFastHLine(x, y, w, color);
+  drawFastHLine(x, y + h - 1, w, color);
+  drawFastVLine(x, y, h, color);
+  drawFastVLine(x + w - 1, y, h, color);
+}
+
+void Adafruit_GFX::drawBitmap(int16_t x, int16_t y, const uint8_t *bitmap, int16_t w, int16_t h, uint16_t color)
+{
+  int16_t byteWidth = (w + 7) / 8;
+  for (int16_t j = 0; j < h; j++)
+  {
+    for (int16_t i = 0; i < w; i++)
+    {
+      if (pgm_read_byte(bitmap + j * byteWidth + i / 8) & (0x80 >> (i & 7)))
+        drawPixel(x + i, y + j, color);
+    }
+  }
+}
+
+// Stand-in glyph columns, blank for the space
+static uint8_t glyphColumn(unsigned char c, uint8_t column)
+{
+  if (c == ' ')
+    return 0;
+  return (uint8_t)((c * 37 + column * 11) ^ (c >> 1)) & 0x7f;
+}
+
+void Adafruit_GFX::drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color, uint16_t bg, uint8_t size)
+{
+  for (uint8_t i = 0; i < 5; i++)
+  {
+    uint8_t line = glyphColumn(c, i);
+    for (uint8_t j = 0; j < 8; j++, line >>= 1)
+    {
+      if (line & 1)
+        fillRect(x + i * size, y + j * size, size, size, color);
+      else if (bg != color)
+        fillRect(x + i * size, y + j * size, size, size, bg);
+    }
+  }
+  if (bg != color)
+    fillRect(x + 5 * size, y, size, 8 * size, bg);
+}
+
+size_t Adafruit_GFX::write(uint8_t c)
+{
+  if (c == '\n')
+  {
+    _cursorX = 0;
+    _cursorY += _textSize * 8;
+  }
+  else if (c != '\r')
+  {
+    if (_wrap && _cursorX + _textSize * 6 > _width)
+    {
+      _cursorX = 0;
+      _cursorY += _textSize * 8;
+    }
+    drawChar(_cursorX, _cursorY, c, _textColor, _textBg, _textSize);
+    _cursorX += _textSize * 6;
+  }
+  return 1;
+}
+
+void Adafruit_GFX::getTextBounds(const char *s, int16_t x, int16_t y, int16_t *x1, int16_t *y1, uint16_t *w,
+                                 uint16_t *h)
+{
+  int16_t lineLength = 0, longest = 0, lines = 1;
+  for (; *s; s++)
+  {
+    if (*s == '\n')
+    {
+      lines++;
+      lineLength = 0;
+    }
+    else if (*s != '\r')
+    {
+      lineLength++;
+      if (lineLength > longest)
+        longest = lineLength;
+    }
+  }
+  *x1 = x;
+  *y1 = y;
+  *w = longest * 6 * _textSize;
+  *h = longest ? lines * 8 * _textSize : 0;
+}
+
+// --- SSD1306 controller on the bus ----------------------------------------
+
+static struct
+{
+  uint8_t ram[8 * 128];
+  bool on;
+  uint8_t mode; // 0 horizontal, 2 page addressing
+  uint8_t colStart, colEnd, pageStart, pageEnd;
+  uint8_t col, page;
+  uint8_t command[3];
+  uint8_t commandLength;
+} controller = {{0}, false, 2, 0, 127, 0, 7, 0, 0, {0}, 0};
+
+static uint8_t commandArgs(uint8_t command)
+{
+  switch (command)
+  {
+  case 0x21:
+  case 0x22:
+    return 2;
+  case 0x20:
+  case 0x81:
+  case 0x8D:
+  case 0xA8:
+  case 0xD3:
+  case 0xD5:
+  case 0xD9:
+  case 0xDA:
+  case 0xDB:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+static void runCommand(const uint8_t *c)
+{
+  switch (c[0])
+  {
+  case 0xAE:
+    controller.on = false;
+    break;
+  case 0xAF:
+    controller.on = true;
+    break;
+  case 0x20:
+    controller.mode = c[1] & 3;
+    break;
+  case 0x21:
+    controller.colStart = controller.col = c[1] & 0x7f;
+    controller.colEnd = c[2] & 0x7f;
+    break;
+  case 0x22:
+    controller.pageStart = controller.page = c[1] & 7;
+    controller.pageEnd = c[2] & 7;
+    break;
+  }
+}
+
+static void writeData(uint8_t data)
+{
+  controller.ram[controller.page * 128 + controller.col] = data;
+  if (controller.mode != 0)
+  {
+    controller.col = (controller.col + 1) & 0x7f;
+    return;
+  }
+  if (controller.col < controller.colEnd)
+  {
+    controller.col++;
+    return;
+  }
+  controller.col = controller.colStart;
+  controller.page = controller.page < controller.pageEnd ? controller.page + 1 : controller.pageStart;
+}
+
+static void controllerReceive(const uint8_t *data, size_t length)
+{
+  if (length == 0)
+    return;
+  if (data[0] == 0x40)
+  {
+    simStats.displayFlushes++;
+    for (size_t i = 1; i < length; i++)
+      writeData(data[i]);
+    return;
+  }
+  // Command stream, arguments may arrive in later transactions
+  for (size_t i = 1; i < length; i++)
+  {
+    controller.command[controller.commandLength++] = data[i];
+    if (controller.commandLength > commandArgs(controller.command[0]))
+    {
+      runCommand(controller.command);
+      controller.commandLength = 0;
+    }
+  }
+}
+
+static const SimI2cDevice oledDevice = {0x3C, controllerReceive, nullptr};
+
+const uint8_t *simDisplayRam()
+{
+  return controller.ram;
+}
+
+bool simDisplayOn()
+{
+  return controller.on;
+}
+
+// --- Adafruit_SSD1306 -------------------------------------------------------
+
+Adafruit_SSD1306::Adafruit_SSD1306(uint8_t w, uint8_t h, TwoWire *twi, int8_t, uint32_t clkDuring, uint32_t clkAfter)
+    : Adafruit_GFX(w, h), _wire(twi), _clkDuring(clkDuring), _clkAfter(clkAfter)
+{
+}
+
+Adafruit_SSD1306::~Adafruit_SSD1306()
+{
+  free(_buffer);
+}
+
+bool Adafruit_SSD1306::begin(uint8_t, uint8_t i2caddr, bool, bool)
+{
+  // The real driver allocates the frame buffer here as well
+  if (!_buffer && !(_buffer = (uint8_t *)malloc(_width * ((_height + 7) / 8))))
+    return false;
+  clearDisplay();
+  _address = i2caddr ? i2caddr : 0x3C;
+  simI2cAttach(&oledDevice);
+
+  static const uint8_t init[] = {SSD1306_DISPLAYOFF, SSD1306_MEMORYMODE, 0x00, SSD1306_DISPLAYON};
+  _wire->setClock(_clkDuring);
+  commandList(init, sizeof(init));
+  _wire->setClock(_clkAfter);
+  return true;
+}
+
+void Adafruit_SSD1306::commandList(const uint8_t *c, uint8_t n)
+{
+  _wire->beginTransmission(_address);
+  _wire->write((uint8_t)0x00);
+  uint16_t bytesOut = 1;
+  while (n--)
+  {
+    if (bytesOut >= BUFFER_LENGTH)
+    {
+      _wire->endTransmission();
+      _wire->beginTransmission(_address);
+      _wire->write((uint8_t)0x00);
+      bytesOut = 1;
+    }
+    _wire->write(*c++);
+    bytesOut++;
+  }
+  _wire->endTransmission();
+}
+
+void Adafruit_SSD1306::ssd1306_command(uint8_t c)
+{
+  _wire->setClock(_clkDuring);
+  commandList(&c, 1);
+  _wire->setClock(_clkAfter);
+}
+
+void Adafruit_SSD1306::display()
+{
+  static const uint8_t window[] = {SSD1306_PAGEADDR, 0, 0xFF, SSD1306_COLUMNADDR, 0};
+  _wire->setClock(_clkDuring);
+  commandList(window, sizeof(window));
+  uint8_t lastColumn = _width - 1;
+  commandList(&lastColumn, 1);
+
+  uint16_t count = _width * ((_height + 7) / 8);
+  const uint8_t *ptr = _buffer;
+  _wire->beginTransmission(_address);
+  _wire->write((uint8_t)0x40);
+  uint16_t bytesOut = 1;
+  while (count--)
+  {
+    if (bytesOut >= BUFFER_LENGTH)
+    {
+      _wire->endTransmission();
+      _wire->beginTransmission(_address);
+      _wire->write((uint8_t)0x40);
+      bytesOut = 1;
+    }
+    _wire->write(*ptr++);
+    bytesOut++;
+  }
+  _wire->endTransmission();
+  _wire->setClock(_clkAfter);
+}
+
+void Adafruit_SSD1306::clearDisplay()
+{
+  memset(_buffer, 0, _width * ((_height + 7) / 8));
+}
+
+void Adafruit_SSD1306::invertDisplay(bool i)
+{
+  ssd1306_command(i ? SSD1306_INVERTDISPLAY : SSD1306_NORMALDISPLAY);
+}
+
+void Adafruit_SSD1306::dim(bool dim)
+{
+  uint8_t c[] = {SSD1306_SETCONTRAST, (uint8_t)(dim ? 0 : 0xCF)};
+  commandList(c, sizeof(c));
+}
+
+void Adafruit_SSD1306::drawPixel(int16_t x, int16_t y, uint16_t color)
+{
+  if (x < 0 || x >= _width || y < 0 || y >= _height)
+    return;
+  uint8_t &b = _buffer[x + (y / 8) * _width];
+  uint8_t bit = 1 << (y & 7);
+  switch (color)
+  {
+  case SSD1306_WHITE:
+    b |= bit;
+    break;
+  case SSD1306_BLACK:
+    b &= ~bit;
+    break;
+  case SSD1306_INVERSE:
+    b ^= bit;
+    break;
+  }
+}
@@ -0,0 +1,81 @@
+#include "sim.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MAX_SCRIPT_ROWS 2048 // a day of minutes, as the firmware's 'h' command dumps it
+
+struct ScriptRow
+{
+  uint32_t seconds;
+  SimEnvironment values;
+};
+
+// Static, so the script does not show up in the firmware's heap numbers
+static ScriptRow script[MAX_SCRIPT_ROWS];
+static size_t scriptRows = 0;
+
+bool simLoadScript(const char *path)
+{
+  FILE *f = fopen(path, "r");
+  if (!f)
+    return false;
+  char line[128];
+  scriptRows = 0;
+  while (scriptRows < MAX_SCRIPT_ROWS && fgets(line, sizeof(line), f))
+  {
+    ScriptRow &row = script[scriptRows];
+    if (line[0] == '#')
+      continue;
+    if (sscanf(line, "%u %f %f %f %f", &row.seconds, &row.values.temp, &row.values.pres,
+               &row.values.ds18b20, &row.values.lux) == 5)
+      scriptRows++;
+  }
+  fclose(f);
+  return scriptRows > 0;
+}
+
+static SimEnvironment interpolate(const SimEnvironment &a, const SimEnvironment &b, float f)
+{
+  SimEnvironment r;
+  r.temp = a.temp + (b.temp - a.temp) * f;
+  r.pres = a.pres + (b.pres - a.pres) * f;
+  r.ds18b20 = a.ds18b20 + (b.ds18b20 - a.ds18b20) * f;
+  r.lux = a.lux + (b.lux - a.lux) * f;
+  return r;
+}
+
+SimEnvironment simEnvironmentAt(time_t t)
+{
+  double seconds = (double)(t - simEpoch());
+
+  if (scriptRows > 0)
+  {
+    if (seconds <= script[0].seconds)
+      return script[0].values;
+    for (size_t i = 1; i < scriptRows; i++)
+    {
+      if (seconds <= script[i].seconds)
+      {
+        float f = (float)((seconds - script[i - 1].seconds) / (script[i].seconds - script[i - 1].seconds));
+        return interpolate(script[i - 1].values, script[i].values, f);
+      }
+    }
+    return script[scriptRows - 1].values;
+  }
+
+  // Day starting at midnight UTC, warmest at 15:00
+  double day = fmod((double)t, 86400.0) / 86400.0;
+  double diurnal = cos(2 * M_PI * (day - 15.0 / 24.0));
+  double sun = sin(2 * M_PI * (day - 6.0 / 24.0));
+
+  SimEnvironment env;
+  env.temp = (float)(25.0 + 1.5 * diurnal);
+  env.ds18b20 = (float)(12.0 + 6.0 * diurnal);
+  // Highs and lows passing every three days plus a small semidiurnal tide
+  env.pres = (float)(1013.0 + 12.0 * sin(2 * M_PI * seconds / (3 * 86400.0)) +
+                     0.8 * cos(4 * M_PI * day));
+  env.lux = sun > 0 ? (float)(20000.0 * sun) : 0.0f;
+  return env;
+}
@@ -0,0 +1,168 @@
+#include "LittleFS.h"
+#include "sim_internal.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+FS LittleFS;
+
+static const char *root()
+{
+  const char *dir = getenv("SIM_FS_DIR");
+  return dir ? dir : ".sim_littlefs";
+}
+
+// LittleFS allocates a handle and a cache per open file, host stdio a
+// buffer: every call that may take or release one is a driver allocation
+
+static void hostPath(char *out, size_t size, const char *path)
+{
+  snprintf(out, size, "%s/%s", root(), path[0] == '/' ? path + 1 : path);
+}
+
+File &File::operator=(File &&other)
+{
+  if (this != &other)
+  {
+    close();
+    _f = other._f;
+    other._f = nullptr;
+  }
+  return *this;
+}
+
+size_t File::write(const uint8_t *buffer, size_t size)
+{
+  SimDriverHeap driver;
+  return _f ? fwrite(buffer, 1, size, _f) : 0;
+}
+
+int File::available()
+{
+  return _f ? (int)(size() - position()) : 0;
+}
+
+int File::read()
+{
+  SimDriverHeap driver;
+  return _f ? fgetc(_f) : -1;
+}
+
+int File::peek()
+{
+  SimDriverHeap driver;
+  if (!_f)
+    return -1;
+  int c = fgetc(_f);
+  if (c != EOF)
+    ungetc(c, _f);
+  return c;
+}
+
+int File::read(uint8_t *buffer, size_t size)
+{
+  SimDriverHeap driver;
+  return _f ? (int)fread(buffer, 1, size, _f) : -1;
+}
+
+bool File::seek(uint32_t pos, SeekMode mode)
+{
+  SimDriverHeap driver;
+  return _f && fseek(_f, pos, mode == SeekSet ? SEEK_SET : mode == SeekCur ? SEEK_CUR : SEEK_END) == 0;
+}
+
+size_t File::position() const
+{
+  return _f ? (size_t)ftell(_f) : 0;
+}
+
+size_t File::size() const
+{
+  SimDriverHeap driver;
+  if (!_f)
+    return 0;
+  fflush(_f);
+  struct stat st;
+  return fstat(fileno(_f), &st) == 0 ? (size_t)st.st_size : 0;
+}
+
+bool File::truncate(uint32_t size)
+{
+  SimDriverHeap driver;
+  if (!_f)
+    return false;
+  fflush(_f);
+  return ftruncate(fileno(_f), size) == 0;
+}
+
+void File::flush()
+{
+  SimDriverHeap driver;
+  if (_f)
+    fflush(_f);
+}
+
+void File::close()
+{
+  SimDriverHeap driver;
+  if (_f)
+    fclose(_f);
+  _f = nullptr;
+}
+
+bool FS::begin()
+{
+  mkdir(root(), 0755);
+  struct stat st;
+  return stat(root(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+bool FS::format()
+{
+  DIR *dir = opendir(root());
+  if (!dir)
+    return begin();
+  struct dirent *entry;
+  char path[512];
+  while ((entry = readdir(dir)) != nullptr)
+  {
+    if (entry->d_name[0] == '.')
+      continue;
+    hostPath(path, sizeof(path), entry->d_name);
+    unlink(path);
+  }
+  closedir(dir);
+  return true;
+}
+
+File FS::open(const char *path, const char *mode)
+{
+  SimDriverHeap driver;
+  char host[512];
+  hostPath(host, sizeof(host), path);
+  // "r+" on LittleFS does not create the file either
+  return File(fopen(host, strcmp(mode, "r") == 0 ? "rb" : strcmp(mode, "r+") == 0 ? "r+b" : mode[0] == 'a' ? "ab" : "wb"));
+}
+
+bool FS::exists(const char *path)
+{
+  char host[512];
+  hostPath(host, sizeof(host), path);
+  return access(host, F_OK) == 0;
+}
+
+bool FS::remove(const char *path)
+{
+  char host[512];
+  hostPath(host, sizeof(host), path);
+  return unlink(host) == 0;
+}
+
+bool FS::rename(const char *from, const char *to)
+{
+  char hostFrom[512], hostTo[512];
+  hostPath(hostFrom, sizeof(hostFrom), from);
+  hostPath(hostTo, sizeof(hostTo), to);
+  return ::rename(hostFrom, hostTo) == 0;
+}
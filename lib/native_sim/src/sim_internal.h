@@ -0,0 +1,37 @@
+#pragma once
+#include "sim.h"
+
+// Shared between the simulated peripherals, not for the firmware
+
+// Restart the firmware from setup(), implemented by the benchmark driver
+[[noreturn]] void simRestart();
+
+// Power cycle of the radio on a reboot
+void simWifiReset();
+
+// The last deep sleep asked for WAKE_RF_DISABLED
+bool simRadioDisabled();
+
+// I2C devices on the simulated bus
+struct SimI2cDevice
+{
+  uint8_t address;
+  void (*receive)(const uint8_t *data, size_t length); // one write transaction
+  size_t (*transmit)(uint8_t *data, size_t length);    // one read, may be null
+};
+void simI2cAttach(const SimI2cDevice *device);
+
+// The BMP280 and BH1750, attached whenever Wire starts
+void simSensorsAttach();
+
+// Bus time of a transaction: its bytes, address byte included
+void simI2cTraffic(size_t bytes);
+
+// Around the stand-ins for drivers that allocate on the device as well:
+// file handles and TLS buffers. Their heap is counted apart from the
+// firmware's own, see --strict-heap in sim_main.cpp.
+struct SimDriverHeap
+{
+  SimDriverHeap();
+  ~SimDriverHeap();
+};
@@ -0,0 +1,319 @@
+// Runs the firmware's setup()/loop() on the host against the simulated
+// peripherals and reports CPU time and heap high-water per loop() call.
+//
+//   .pio/build/native/program [--hours H] [--loops N] [--script FILE] [--verbose] [--strict-heap]
+//
+// --strict-heap fails the run if the firmware allocates after setup().
+// Allocations of the driver stand-ins (SimDriverHeap) are allowed, as long
+// as they are freed again within the loop() pass that made them.
+#include "Arduino.h"
+#include "sim_internal.h"
+
+#include <malloc.h>
+#include <unistd.h>
+#include <setjmp.h>
+
+void setup();
+void loop();
+
+// --- Heap accounting --------------------------------------------------------
+// glibc lets the program replace the malloc family, the originals stay
+// reachable under their __libc_ names
+
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+extern "C" void __libc_free(void *ptr);
+
+static size_t heapInUse = 0;
+static size_t heapPeak = 0;
+static uint32_t heapAllocations = 0;
+
+static int driverDepth = 0;
+static size_t driverInUse = 0;  // part of heapInUse
+static size_t driverPeak = 0;
+static bool heapChecked = false; // between setup() and the next boot
+static uint32_t firmwareAllocations = 0;
+
+SimDriverHeap::SimDriverHeap()
+{
+  driverDepth++;
+}
+
+SimDriverHeap::~SimDriverHeap()
+{
+  driverDepth--;
+}
+
+static void *track(void *ptr)
+{
+  if (ptr)
+  {
+    size_t size = malloc_usable_size(ptr);
+    heapAllocations++;
+    heapInUse += size;
+    if (heapInUse > heapPeak)
+      heapPeak = heapInUse;
+    if (driverDepth > 0)
+    {
+      driverInUse += size;
+      if (driverInUse > driverPeak)
+        driverPeak = driverInUse;
+    }
+    else if (heapChecked)
+    {
+      firmwareAllocations++;
+      if (firmwareAllocations <= 10)
+        fprintf(stderr, "heap: the firmware allocated %zu bytes after setup()\n", size);
+    }
+  }
+  return ptr;
+}
+
+static void untrack(void *ptr)
+{
+  if (!ptr)
+    return;
+  size_t size = malloc_usable_size(ptr);
+  heapInUse -= size;
+  if (driverDepth > 0)
+    driverInUse -= size;
+}
+
+extern "C" void *malloc(size_t size)
+{
+  return track(__libc_malloc(size));
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+  return track(__libc_calloc(count, size));
+}
+
+extern "C" void free(void *ptr)
+{
+  untrack(ptr);
+  __libc_free(ptr);
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+  untrack(ptr);
+  return track(__libc_realloc(ptr, size));
+}
+
+size_t simHeapInUse()
+{
+  return heapInUse;
+}
+
+size_t simHeapPeak()
+{
+  return heapPeak;
+}
+
+void simHeapResetPeak()
+{
+  heapPeak = heapInUse;
+}
+
+uint32_t simHeapAllocations()
+{
+  return heapAllocations;
+}
+
+// --- Benchmark driver ---------------------------------------------------------
+// Not in the unit test builds, the tests bring their own main() and a
+// reboot has nowhere to go back to
+#ifdef PIO_UNIT_TESTING
+
+void simRestart()
+{
+  fprintf(stderr, "simRestart() in a unit test\n");
+  abort();
+}
+
+#else
+
+#define CPU_BUCKETS 24 // powers of two from 1 us
+
+static struct
+{
+  uint64_t endWorldUs;
+  unsigned long maxLoops;
+  unsigned long loops;
+  unsigned long boots;
+  uint64_t setupCpuNs;
+  uint64_t loopCpuNs;
+  uint64_t maxLoopCpuNs;
+  uint32_t cpuHistogram[CPU_BUCKETS];
+  size_t heapAtStart;   // C++ runtime and stdio, not the firmware's
+  size_t heapBaseline;  // in use after the first setup()
+  size_t maxLoopGrowth; // largest high-water above the start of a loop()
+  int64_t maxClockErrorUs; // firmware wall clock against the true time
+  SimEnvironment maxReportError; // true environment against its newest upload
+  size_t peak;
+  uint32_t driverHeld;  // loop() passes that returned with driver heap still allocated
+} bench;
+
+static char stdoutBuffer[BUFSIZ]; // stdio would allocate it on the first Serial output
+
+static jmp_buf restartPoint;
+static bool strictHeap = false; // outside main()'s frame, which longjmp() may clobber
+
+void simRestart()
+{
+  longjmp(restartPoint, 1);
+}
+
+static uint64_t cpuNs()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint32_t percentileUs(double fraction)
+{
+  uint64_t target = (uint64_t)(bench.loops * fraction);
+  uint64_t seen = 0;
+  for (int i = 0; i < CPU_BUCKETS; i++)
+  {
+    seen += bench.cpuHistogram[i];
+    if (seen > target)
+      return 1u << i;
+  }
+  return 1u << (CPU_BUCKETS - 1);
+}
+
+static void report()
+{
+  double hours = simWorldMicros() / 3600e6;
+  printf("\n--- native benchmark ---\n");
+  printf("simulated time      %.2f h, %lu boots, %u deep sleeps, %u of them waking the radio\n", hours, bench.boots,
+         simStats.deepSleeps, simStats.radioWakes);
+  printf("setup() CPU         %.1f us per boot\n", bench.setupCpuNs / 1e3 / (bench.boots ? bench.boots : 1));
+  printf("loop() calls        %lu\n", bench.loops);
+  printf("loop() CPU          avg %.1f us, p50 < %u us, p99 < %u us, max %.1f us\n",
+         bench.loops ? bench.loopCpuNs / 1e3 / bench.loops : 0.0, percentileUs(0.5), percentileUs(0.99),
+         bench.maxLoopCpuNs / 1e3);
+  printf("heap                after setup() %zu B, peak %zu B, max growth within loop() %zu B\n",
+         bench.heapBaseline - bench.heapAtStart, bench.peak - bench.heapAtStart, bench.maxLoopGrowth);
+  printf("heap after setup()  %u firmware allocations, driver peak %zu B, %u passes holding driver heap\n",
+         firmwareAllocations, driverPeak, bench.driverHeld);
+  printf("I2C                 %u transactions, %u bytes, %u display data transfers, bus busy %.1f s\n",
+         simStats.i2cTransactions, simStats.i2cBytes, simStats.displayFlushes, simStats.i2cBusyUs / 1e6);
+  printf("network             %u WiFi joins, up %.1f min, %u HTTP requests, %u B sent, %u B received\n",
+         simStats.wifiJoins, simWifiUpMicros() / 60e6, simStats.httpRequests, simStats.httpBytesSent,
+         simStats.httpBytesReceived);
+  printf("TLS                 %u handshakes, %u resumed, avg %.0f ms, record buffers peak %u B\n",
+         simStats.tlsHandshakes, simStats.tlsResumed,
+         simStats.tlsHandshakes ? simStats.tlsHandshakeUs / 1e3 / simStats.tlsHandshakes : 0.0,
+         simStats.tlsBufferPeak);
+  printf("uploads             %.1f per day, reporting error max %.2f K, %.2f hPa, %.2f K outdoor\n",
+         hours > 0 ? simStats.uploads * 24 / hours : 0.0, bench.maxReportError.temp, bench.maxReportError.pres,
+         bench.maxReportError.ds18b20);
+  printf("mirrors             %u MQTT publishes with %u lines, %u InfluxDB HTTP lines, %u UDP lines\n",
+         simStats.mqttPublishes, simStats.mqttLines, simStats.influxLines, simStats.udpLines);
+  printf("LAN server          %u requests, %u B, %u unavailable, %u invalid\n", simStats.lanRequests,
+         simStats.lanBytes, simStats.lanUnavailable, simStats.lanInvalid);
+  printf("clock               %u NTP syncs, max error %.1f ms\n", simStats.ntpSyncs, bench.maxClockErrorUs / 1e3);
+  printf("serial              %u B\n", simStats.serialBytes);
+}
+
+int main(int argc, char **argv)
+{
+  double hours = 24;
+  bench.maxLoops = 0;
+  bool verbose = false;
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--hours") == 0 && i + 1 < argc)
+      hours = atof(argv[++i]);
+    else if (strcmp(argv[i], "--loops") == 0 && i + 1 < argc)
+      bench.maxLoops = strtoul(argv[++i], nullptr, 10);
+    else if (strcmp(argv[i], "--script") == 0 && i + 1 < argc)
+    {
+      if (!simLoadScript(argv[++i]))
+      {
+        fprintf(stderr, "cannot read script %s\n", argv[i]);
+        return 1;
+      }
+    }
+    else if (strcmp(argv[i], "--verbose") == 0)
+      verbose = true;
+    else if (strcmp(argv[i], "--strict-heap") == 0)
+      strictHeap = true;
+    else
+    {
+      fprintf(stderr, "usage: %s [--hours H] [--loops N] [--script FILE] [--verbose] [--strict-heap]\n", argv[0]);
+      return 1;
+    }
+  }
+  simSetQuiet(!verbose);
+  setvbuf(stdout, stdoutBuffer, isatty(fileno(stdout)) ? _IOLBF : _IOFBF, sizeof(stdoutBuffer));
+  bench.endWorldUs = (uint64_t)(hours * 3600e6);
+  bench.heapAtStart = simHeapInUse();
+
+  // Deep sleep comes back here, like a reset
+  setjmp(restartPoint);
+  bench.boots++;
+  heapChecked = false;
+  driverDepth = 0;
+
+  uint64_t start = cpuNs();
+  simHeapResetPeak();
+  setup();
+  if (simHeapPeak() > bench.peak)
+    bench.peak = simHeapPeak();
+  bench.setupCpuNs += cpuNs() - start;
+  if (bench.boots == 1)
+    bench.heapBaseline = simHeapInUse();
+  heapChecked = true;
+
+  while (simWorldMicros() < bench.endWorldUs && (bench.maxLoops == 0 || bench.loops < bench.maxLoops))
+  {
+    size_t heapBefore = simHeapInUse();
+    size_t driverBefore = driverInUse;
+    simHeapResetPeak();
+    start = cpuNs();
+    loop();
+    uint64_t spent = cpuNs() - start;
+
+    bench.loops++;
+    if (driverInUse > driverBefore)
+      bench.driverHeld++;
+    bench.loopCpuNs += spent;
+    if (spent > bench.maxLoopCpuNs)
+      bench.maxLoopCpuNs = spent;
+    int bucket = 0;
+    while (bucket < CPU_BUCKETS - 1 && (1ull << bucket) * 1000 <= spent)
+      bucket++;
+    bench.cpuHistogram[bucket]++;
+    if (simHeapPeak() > bench.peak)
+      bench.peak = simHeapPeak();
+    if (simHeapPeak() - heapBefore > bench.maxLoopGrowth)
+      bench.maxLoopGrowth = simHeapPeak() - heapBefore;
+    int64_t clockError;
+    if (simClockError(clockError) && llabs(clockError) > bench.maxClockErrorUs)
+      bench.maxClockErrorUs = llabs(clockError);
+    if (simServerNewest() != 0)
+    {
+      SimEnvironment now = simEnvironmentAt(simEpoch() + (time_t)(simWorldMicros() / 1000000));
+      SimEnvironment sent = simEnvironmentAt(simServerNewest());
+      bench.maxReportError.temp = fmaxf(bench.maxReportError.temp, fabsf(now.temp - sent.temp));
+      bench.maxReportError.pres = fmaxf(bench.maxReportError.pres, fabsf(now.pres - sent.pres));
+      bench.maxReportError.ds18b20 = fmaxf(bench.maxReportError.ds18b20, fabsf(now.ds18b20 - sent.ds18b20));
+    }
+  }
+
+  fflush(stdout);
+  report();
+  if (strictHeap && (firmwareAllocations > 0 || bench.driverHeld > 0))
+  {
+    printf("strict heap check FAILED\n");
+    return 1;
+  }
+  return 0;
+}
+#endif // PIO_UNIT_TESTING
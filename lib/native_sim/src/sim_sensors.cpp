@@ -0,0 +1,490 @@
+#include "DallasTemperature.h"
+#include "sim_internal.h"
+#include <math.h>
+
+// Sensors follow the world clock, not the firmware's idea of the time
+static SimEnvironment environmentNow()
+{
+  return simEnvironmentAt(simEpoch() + (time_t)(simWorldMicros() / 1000000));
+}
+
+// --- BMP280 -------------------------------------------------------------
+
+// Register model at 0x76 with the trimming parameters of the datasheet
+// example. A forced conversion takes the datasheet maximum time of the
+// selected oversampling and latches the environment into the result
+// registers at its resolution.
+
+static const uint8_t BMP280_ADDRESS = 0x76;
+static const uint16_t T1 = 27504, P1 = 36477;
+static const int16_t T2 = 26435, T3 = -1000, P2 = -10685, P3 = 3024, P4 = 2855, P5 = 140, P6 = -7, P7 = 15500,
+                     P8 = -14600, P9 = 6000;
+
+static struct
+{
+  uint8_t pointer;
+  uint8_t ctrlMeas;
+  uint8_t config;
+  uint64_t readyAt;
+  bool converting;
+  int32_t adcT = 0x80000; // reset value, no measurement yet
+  int32_t adcP = 0x80000;
+} bmp;
+
+// The datasheet's integer compensation, the sim runs it backwards
+static int32_t bmpTemperature(int32_t adc, int32_t &fine)
+{
+  int32_t var1 = (((adc >> 3) - ((int32_t)T1 << 1)) * T2) >> 11;
+  int32_t var2 = (((((adc >> 4) - (int32_t)T1) * ((adc >> 4) - (int32_t)T1)) >> 12) * T3) >> 14;
+  fine = var1 + var2;
+  return (fine * 5 + 128) >> 8;
+}
+
+static int64_t bmpPressure(int32_t adc, int32_t fine)
+{
+  int64_t var1 = (int64_t)fine - 128000;
+  int64_t var2 = var1 * var1 * P6 + var1 * P5 * 131072 + (int64_t)P4 * 34359738368;
+  var1 = ((var1 * var1 * P3) >> 8) + var1 * P2 * 4096;
+  var1 = ((int64_t)140737488355328 + var1) * P1 >> 33;
+  int64_t p = ((1048576 - adc) * (int64_t)2147483648 - var2) * 3125 / var1;
+  return ((p + (((int64_t)P9 * (p >> 13) * (p >> 13)) >> 25) + (((int64_t)P8 * p) >> 19)) >> 8) + ((int64_t)P7 << 4);
+}
+
+static uint32_t oversamples(uint8_t sampling)
+{
+  return sampling ? 1u << (sampling - 1) : 0;
+}
+
+// Raw value of a measurement with the given oversampling: 16 bit at x1, one
+// more bit per step up to 20
+static int32_t bmpQuantize(int32_t adc, uint8_t sampling)
+{
+  if (!sampling)
+    return 0x80000;
+  int drop = 5 - (sampling > 5 ? 5 : sampling);
+  return adc & ~((1 << drop) - 1);
+}
+
+static void bmpLatch()
+{
+  if (!bmp.converting || simWorldMicros() < bmp.readyAt)
+    return;
+  bmp.converting = false;
+  SimEnvironment env = environmentNow();
+  // Smallest raw temperature that compensates to the environment, the
+  // formula rises with it; the pressure one falls
+  int32_t fine, lo = 0, hi = 0xFFFFF;
+  while (lo < hi)
+  {
+    int32_t mid = (lo + hi) / 2;
+    if (bmpTemperature(mid, fine) < lroundf(env.temp * 100))
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  bmp.adcT = bmpQuantize(lo, bmp.ctrlMeas >> 5 & 7);
+  bmpTemperature(bmp.adcT == 0x80000 ? lo : bmp.adcT, fine);
+  int64_t target = llroundf(env.pres * 100 * 256);
+  lo = 0;
+  hi = 0xFFFFF;
+  while (lo < hi)
+  {
+    int32_t mid = (lo + hi) / 2;
+    if (bmpPressure(mid, fine) > target)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  bmp.adcP = bmpQuantize(lo, bmp.ctrlMeas >> 2 & 7);
+}
+
+static void bmpWrite(uint8_t reg, uint8_t value)
+{
+  if (reg == 0xE0 && value == 0xB6)
+  {
+    bmp.ctrlMeas = bmp.config = 0;
+    bmp.converting = false;
+  }
+  else if (reg == 0xF5)
+    bmp.config = value;
+  else if (reg == 0xF4)
+  {
+    bmp.ctrlMeas = value;
+    uint8_t mode = value & 3;
+    if (mode != 0)
+    {
+      // Datasheet maximum: 1.25 ms + 2.3 ms per sample + 0.575 ms with pressure
+      uint8_t t = value >> 5 & 7, p = value >> 2 & 7;
+      bmp.readyAt = simWorldMicros() + 1250 + 2300 * oversamples(t) + 2300 * oversamples(p) + (p ? 575 : 0);
+      bmp.converting = true;
+    }
+  }
+}
+
+static uint8_t bmpRead(uint8_t reg)
+{
+  static const uint8_t trimming[24] = {
+      T1 & 0xFF, T1 >> 8, T2 & 0xFF, (uint8_t)(T2 >> 8), T3 & 0xFF, (uint8_t)(T3 >> 8),
+      P1 & 0xFF, P1 >> 8, P2 & 0xFF, (uint8_t)(P2 >> 8), P3 & 0xFF, (uint8_t)(P3 >> 8),
+      P4 & 0xFF, (uint8_t)(P4 >> 8), P5 & 0xFF, (uint8_t)(P5 >> 8), P6 & 0xFF, (uint8_t)(P6 >> 8),
+      P7 & 0xFF, (uint8_t)(P7 >> 8), P8 & 0xFF, (uint8_t)(P8 >> 8), P9 & 0xFF, (uint8_t)(P9 >> 8)};
+  if (reg >= 0x88 && reg < 0x88 + sizeof(trimming))
+    return trimming[reg - 0x88];
+  switch (reg)
+  {
+  case 0xD0:
+    return 0x58; // chip id
+  case 0xF3:
+    return bmp.converting ? 0x08 : 0x00;
+  case 0xF4:
+    return bmp.ctrlMeas;
+  case 0xF5:
+    return bmp.config;
+  case 0xF7:
+    return bmp.adcP >> 12;
+  case 0xF8:
+    return bmp.adcP >> 4;
+  case 0xF9:
+    return bmp.adcP << 4;
+  case 0xFA:
+    return bmp.adcT >> 12;
+  case 0xFB:
+    return bmp.adcT >> 4;
+  case 0xFC:
+    return bmp.adcT << 4;
+  default:
+    return 0;
+  }
+}
+
+// The first byte sets the register pointer, after it come register/value pairs
+static void bmpReceive(const uint8_t *data, size_t length)
+{
+  if (length > 0)
+    bmp.pointer = data[0];
+  for (size_t i = 0; i + 1 < length; i += 2)
+    bmpWrite(data[i], data[i + 1]);
+}
+
+static size_t bmpTransmit(uint8_t *data, size_t length)
+{
+  bmpLatch();
+  for (size_t i = 0; i < length; i++)
+    data[i] = bmpRead(bmp.pointer++); // auto-increment
+  return length;
+}
+
+static const SimI2cDevice bmp280Device = {BMP280_ADDRESS, bmpReceive, bmpTransmit};
+
+// --- OneWire ------------------------------------------------------------
+
+#define ONEWIRE_SLOT_US 70
+
+uint8_t OneWire::reset()
+{
+  delayMicroseconds(960);
+  return 1;
+}
+
+void OneWire::write(uint8_t, uint8_t)
+{
+  delayMicroseconds(8 * ONEWIRE_SLOT_US);
+}
+
+uint8_t OneWire::read()
+{
+  delayMicroseconds(8 * ONEWIRE_SLOT_US);
+  return 0xff;
+}
+
+void OneWire::select(const uint8_t rom[8])
+{
+  write(0x55);
+  for (int i = 0; i < 8; i++)
+    write(rom[i]);
+}
+
+void OneWire::skip()
+{
+  write(0xCC);
+}
+
+uint8_t OneWire::crc8(const uint8_t *addr, uint8_t len)
+{
+  uint8_t crc = 0;
+  while (len--)
+  {
+    uint8_t b = *addr++;
+    for (uint8_t i = 8; i; i--)
+    {
+      uint8_t mix = (crc ^ b) & 0x01;
+      crc >>= 1;
+      if (mix)
+        crc ^= 0x8C;
+      b >>= 1;
+    }
+  }
+  return crc;
+}
+
+// --- DS18B20 --------------------------------------------------------------
+
+#define MAX_PROBES 8
+
+static struct Probe
+{
+  uint8_t rom[8];
+  uint8_t resolution;
+  bool converting;
+  uint64_t readyAt;
+  float value;
+} probes[MAX_PROBES];
+static uint8_t probeCount = 0;
+
+static void createProbes()
+{
+  if (probeCount)
+    return;
+  const char *env = getenv("SIM_DS18B20_PROBES");
+  int count = env ? atoi(env) : 1;
+  probeCount = count < 0 ? 0 : count > MAX_PROBES ? MAX_PROBES : count;
+  for (uint8_t i = 0; i < probeCount; i++)
+  {
+    const uint8_t rom[7] = {0x28, 0xff, 0x64, 0x1e, 0x0f, 0x1c, (uint8_t)(0x30 + i)};
+    memcpy(probes[i].rom, rom, 7);
+    probes[i].rom[7] = OneWire::crc8(rom, 7);
+    probes[i].resolution = 12;
+    probes[i].value = 85.0f; // power-on value of the scratchpad
+  }
+}
+
+static uint32_t conversionUs(uint8_t resolution)
+{
+  return 750000u >> (12 - resolution);
+}
+
+void DallasTemperature::begin()
+{
+  createProbes();
+  // Search ROM: 64 bits, three slots each, per device
+  for (uint8_t i = 0; i <= probeCount; i++)
+  {
+    _wire->reset();
+    delayMicroseconds(64 * 3 * ONEWIRE_SLOT_US);
+  }
+  _devices = probeCount;
+}
+
+uint8_t DallasTemperature::getDeviceCount()
+{
+  return _devices;
+}
+
+bool DallasTemperature::getAddress(uint8_t *deviceAddress, uint8_t index)
+{
+  createProbes();
+  if (index >= probeCount)
+    return false;
+  memcpy(deviceAddress, probes[index].rom, 8);
+  return true;
+}
+
+bool DallasTemperature::validAddress(const uint8_t *deviceAddress)
+{
+  return OneWire::crc8(deviceAddress, 7) == deviceAddress[7];
+}
+
+int DallasTemperature::probeIndex(const uint8_t *deviceAddress)
+{
+  createProbes();
+  for (uint8_t i = 0; i < probeCount; i++)
+  {
+    if (memcmp(probes[i].rom, deviceAddress, 8) == 0)
+      return i;
+  }
+  return -1;
+}
+
+bool DallasTemperature::isConnected(const uint8_t *deviceAddress)
+{
+  _wire->reset();
+  _wire->select(deviceAddress);
+  for (int i = 0; i < 10; i++)
+    _wire->read(); // command + scratchpad
+  return probeIndex(deviceAddress) >= 0;
+}
+
+uint8_t DallasTemperature::getResolution(const uint8_t *deviceAddress)
+{
+  int i = probeIndex(deviceAddress);
+  return i < 0 ? 0 : probes[i].resolution;
+}
+
+bool DallasTemperature::setResolution(uint8_t newResolution)
+{
+  _resolution = newResolution;
+  for (uint8_t i = 0; i < probeCount; i++)
+    setResolution(probes[i].rom, newResolution, true);
+  return true;
+}
+
+bool DallasTemperature::setResolution(const uint8_t *deviceAddress, uint8_t newResolution, bool)
+{
+  int i = probeIndex(deviceAddress);
+  if (i < 0 || newResolution < 9 || newResolution > 12)
+    return false;
+  _wire->reset();
+  _wire->select(deviceAddress);
+  for (int n = 0; n < 4; n++)
+    _wire->write(0); // write scratchpad
+  probes[i].resolution = newResolution;
+  _resolution = newResolution;
+  return true;
+}
+
+int16_t DallasTemperature::millisToWaitForConversion(uint8_t bitResolution)
+{
+  return (int16_t)((conversionUs(bitResolution) + 999) / 1000);
+}
+
+void DallasTemperature::startConversion(int probe)
+{
+  probes[probe].converting = true;
+  probes[probe].readyAt = simWorldMicros() + conversionUs(probes[probe].resolution);
+}
+
+void DallasTemperature::finishConversions()
+{
+  SimEnvironment env = environmentNow();
+  for (uint8_t i = 0; i < probeCount; i++)
+  {
+    if (probes[i].converting && simWorldMicros() >= probes[i].readyAt)
+    {
+      // Quantized to the probe's resolution
+      float step = 0.0625f * (1 << (12 - probes[i].resolution));
+      probes[i].value = floorf((env.ds18b20 + i * 0.5f) / step) * step;
+      probes[i].converting = false;
+    }
+  }
+}
+
+bool DallasTemperature::isConversionComplete()
+{
+  _wire->read();
+  for (uint8_t i = 0; i < probeCount; i++)
+  {
+    if (probes[i].converting && simWorldMicros() < probes[i].readyAt)
+      return false;
+  }
+  return true;
+}
+
+DallasTemperature::request_t DallasTemperature::requestTemperatures()
+{
+  createProbes();
+  _wire->reset();
+  _wire->skip();
+  _wire->write(0x44);
+  for (uint8_t i = 0; i < probeCount; i++)
+    startConversion(i);
+  if (_waitForConversion)
+    delay(millisToWaitForConversion(_resolution));
+  return {true, millis()};
+}
+
+DallasTemperature::request_t DallasTemperature::requestTemperaturesByAddress(const uint8_t *deviceAddress)
+{
+  int i = probeIndex(deviceAddress);
+  _wire->reset();
+  _wire->select(deviceAddress);
+  _wire->write(0x44);
+  if (i < 0)
+    return {false, millis()};
+  startConversion(i);
+  if (_waitForConversion)
+    delay(millisToWaitForConversion(probes[i].resolution));
+  return {true, millis()};
+}
+
+float DallasTemperature::getTempC(const uint8_t *deviceAddress)
+{
+  if (!isConnected(deviceAddress))
+    return DEVICE_DISCONNECTED_C;
+  finishConversions();
+  return probes[probeIndex(deviceAddress)].value;
+}
+
+float DallasTemperature::getTempCByIndex(uint8_t index)
+{
+  DeviceAddress address;
+  // The library searches the bus for the index-th device on every call
+  _wire->reset();
+  delayMicroseconds((index + 1) * 64 * 3 * ONEWIRE_SLOT_US);
+  if (!getAddress(address, index))
+    return DEVICE_DISCONNECTED_C;
+  return getTempC(address);
+}
+
+// --- BH1750 ---------------------------------------------------------------
+
+// Opcode model at 0x23 with the typical conversion times and the
+// resolution of each mode. One-time modes power down after a measurement,
+// the data register keeps the last result.
+
+static struct
+{
+  uint8_t mode;
+  uint64_t readyAt;
+  bool measuring;
+  uint16_t counts;
+} bh1750;
+
+static bool lowRes(uint8_t mode)
+{
+  return (mode & 0x03) == 0x03;
+}
+
+static void bh1750Receive(const uint8_t *data, size_t length)
+{
+  for (size_t i = 0; i < length; i++)
+  {
+    uint8_t op = data[i];
+    if (op == 0x07)
+      bh1750.counts = 0; // reset
+    else if ((op & 0xEC) == 0x20 || (op & 0xEC) == 0x10)
+    {
+      bh1750.mode = op;
+      bh1750.readyAt = simWorldMicros() + (lowRes(op) ? 16000 : 120000);
+      bh1750.measuring = true;
+    }
+  }
+}
+
+static size_t bh1750Transmit(uint8_t *data, size_t length)
+{
+  if (bh1750.measuring && simWorldMicros() >= bh1750.readyAt)
+  {
+    float counts = environmentNow().lux * 1.2f;
+    if (lowRes(bh1750.mode))
+      counts = floorf(counts / 4) * 4;
+    else if (bh1750.mode & 0x01)
+      counts *= 2; // mode 2, half lux steps
+    bh1750.counts = counts > 65535 ? 65535 : (uint16_t)counts;
+    if (bh1750.mode & 0x20)
+      bh1750.measuring = false; // one-time, powered down
+    else
+      bh1750.readyAt = simWorldMicros() + (lowRes(bh1750.mode) ? 16000 : 120000);
+  }
+  uint8_t reg[2] = {(uint8_t)(bh1750.counts >> 8), (uint8_t)bh1750.counts};
+  for (size_t i = 0; i < length; i++)
+    data[i] = reg[i % 2];
+  return length;
+}
+
+static const SimI2cDevice bh1750Device = {0x23, bh1750Receive, bh1750Transmit};
+
+void simSensorsAttach()
+{
+  simI2cAttach(&bmp280Device);
+  simI2cAttach(&bh1750Device);
+}
@@ -0,0 +1,738 @@
+#include "ESP8266WiFi.h"
+#include "WiFiClientSecure.h"
+#include "WiFiUdp.h"
+#include "sim_internal.h"
+
+#include <ctype.h>
+
+ESP8266WiFiClass WiFi;
+
+static const uint8_t AP_BSSID[6] = {0x02, 0x11, 0x22, 0x33, 0x44, 0x55};
+static const int32_t AP_CHANNEL = 6;
+static const IPAddress LEASE_IP(192, 168, 178, 57);
+static const IPAddress LEASE_GATEWAY(192, 168, 178, 1);
+static const IPAddress LEASE_SUBNET(255, 255, 255, 0);
+
+// Join times: scan + association + DHCP, or association alone
+#define JOIN_FULL_MS 2600
+#define JOIN_FAST_MS 350
+
+static uint32_t envMs(const char *name, uint32_t fallback)
+{
+  const char *value = getenv(name);
+  return value ? (uint32_t)strtoul(value, nullptr, 10) : fallback;
+}
+
+static bool apOnAir()
+{
+  return envMs("SIM_WIFI", 1) != 0;
+}
+
+void simWifiReset()
+{
+  WiFi.mode(WIFI_OFF);
+}
+
+bool ESP8266WiFiClass::mode(WiFiMode_t mode)
+{
+  _mode = mode;
+  if (mode == WIFI_OFF)
+    disconnect();
+  return true;
+}
+
+bool ESP8266WiFiClass::config(IPAddress local, IPAddress gateway, IPAddress subnet, IPAddress dns1, IPAddress)
+{
+  _static = (uint32_t)local != 0;
+  _ip = local;
+  _gateway = gateway;
+  _subnet = subnet;
+  _dns = dns1;
+  return true;
+}
+
+wl_status_t ESP8266WiFiClass::begin(const char *, const char *, int32_t channel, const uint8_t *bssid, bool)
+{
+  if (_mode == WIFI_OFF)
+    _mode = WIFI_STA;
+  bool known = bssid && channel == AP_CHANNEL && memcmp(bssid, AP_BSSID, 6) == 0;
+  _joining = apOnAir() && !simRadioDisabled() && (known || !bssid);
+  _fast = known;
+  uint32_t joinMs = known ? JOIN_FAST_MS : JOIN_FULL_MS - 500;
+  if (!_static)
+    joinMs += 500; // DHCP
+  _connectedAt = simWorldMicros() + (uint64_t)joinMs * 1000;
+  return status();
+}
+
+// Associated time, the radio's share of the power budget
+static uint64_t upSince = 0;
+static uint64_t upTotal = 0;
+
+uint64_t simWifiUpMicros()
+{
+  return upTotal + (upSince ? simWorldMicros() - upSince : 0);
+}
+
+bool ESP8266WiFiClass::disconnect(bool)
+{
+  if (upSince)
+    upTotal += simWorldMicros() - upSince;
+  upSince = 0;
+  _joining = false;
+  _connectedAt = 0;
+  return true;
+}
+
+wl_status_t ESP8266WiFiClass::status()
+{
+  if (!_joining)
+    return WL_DISCONNECTED;
+  if (simWorldMicros() < _connectedAt)
+    return WL_IDLE_STATUS;
+  if (_connectedAt != 1)
+  {
+    simStats.wifiJoins++;
+    upSince = simWorldMicros();
+    _connectedAt = 1; // counted
+    if (!_static)
+    {
+      _ip = LEASE_IP;
+      _gateway = LEASE_GATEWAY;
+      _subnet = LEASE_SUBNET;
+      _dns = LEASE_GATEWAY;
+    }
+  }
+  return WL_CONNECTED;
+}
+
+uint8_t *ESP8266WiFiClass::BSSID()
+{
+  static uint8_t bssid[6];
+  memcpy(bssid, AP_BSSID, sizeof(bssid));
+  return bssid;
+}
+
+int32_t ESP8266WiFiClass::channel()
+{
+  return AP_CHANNEL;
+}
+
+IPAddress ESP8266WiFiClass::localIP()
+{
+  return status() == WL_CONNECTED ? IPAddress(_ip) : IPAddress();
+}
+
+IPAddress ESP8266WiFiClass::gatewayIP()
+{
+  return IPAddress(_gateway);
+}
+
+IPAddress ESP8266WiFiClass::subnetMask()
+{
+  return IPAddress(_subnet);
+}
+
+IPAddress ESP8266WiFiClass::dnsIP(uint8_t)
+{
+  return IPAddress(_dns);
+}
+
+// --- Simulated servers ------------------------------------------------------
+
+// openSenseMap and the InfluxDB write API answer HTTP on any port, the MQTT
+// broker listens on MQTT_PORT. A connection's request and response buffers
+// hold one HTTP exchange, or the broker's packets of a whole session,
+// consumed ones are dropped. On a scraper's connection the roles swap: the
+// response buffer holds the scraper's request, the request buffer what the
+// firmware answers.
+#define MQTT_PORT 1883
+#define CONNECTIONS 4
+
+struct Connection
+{
+  bool open;
+  bool mqtt;
+  const char *scrape; // path a scraper asks the firmware for, see WiFiServer.h
+  char request[8192];
+  size_t requestLength;
+  bool answered; // HTTP response complete
+  uint64_t responseAt;
+  char response[16384];
+  size_t responseLength;
+  size_t responseRead;
+};
+static Connection connections[CONNECTIONS];
+
+static size_t contentLength(const char *head)
+{
+  for (const char *p = head; *p; p++)
+  {
+    if (strncasecmp(p, "\r\ncontent-length:", 17) == 0)
+      return strtoul(p + 17, nullptr, 10);
+  }
+  return 0;
+}
+
+static void appendf(Connection &c, const char *format, ...) __attribute__((format(printf, 2, 3)));
+static void appendf(Connection &c, const char *format, ...)
+{
+  size_t space = sizeof(c.response) - c.responseLength;
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(c.response + c.responseLength, space, format, args);
+  va_end(args);
+  if (n > 0)
+    c.responseLength += (size_t)n < space ? (size_t)n : space - 1;
+}
+
+static uint32_t countLines(const char *text, size_t length)
+{
+  uint32_t lines = 0;
+  for (size_t i = 0; i < length; i++)
+    lines += text[i] == '\n';
+  return lines;
+}
+
+// openSenseMap statistics API: hourly means of the scripted pressure,
+// tidy CSV in chunked transfer encoding
+static void statisticsResponse(Connection &c)
+{
+  appendf(c, "HTTP/1.1 200 OK\r\nContent-Type: text/csv\r\nTransfer-Encoding: chunked\r\n\r\n");
+  char body[1024];
+  int length = snprintf(body, sizeof(body), "sensorId,time_start,arithmeticMean_1h\n");
+  time_t now = simEpoch() + (time_t)(simWorldMicros() / 1000000);
+  for (int hour = 12; hour >= 1; hour--)
+  {
+    time_t start = (now / 3600 - hour) * 3600;
+    struct tm tm;
+    gmtime_r(&start, &tm);
+    char when[32];
+    strftime(when, sizeof(when), "%Y-%m-%dT%H:%M:%S.000Z", &tm);
+    float mean = 0;
+    for (int m = 0; m < 60; m += 10)
+      mean += simEnvironmentAt(start + m * 60).pres / 6;
+    length += snprintf(body + length, sizeof(body) - length, "5f0a1b2c3d4e5f6a7b8c9d0e,%s,%.2f\n", when, mean);
+  }
+  // Two chunks so the client's chunk decoder is exercised
+  int half = length / 2;
+  appendf(c, "%x\r\n%.*s\r\n%x\r\n%s\r\n0\r\n\r\n", half, half, body, length - half, body + half);
+}
+
+// Newest measurement time the upload server holds. Measurements without a
+// timestamp are stamped with the arrival time, like openSenseMap does.
+static time_t serverNewest = 0;
+
+time_t simServerNewest()
+{
+  return serverNewest;
+}
+
+static void recordUpload(const Connection &c)
+{
+  simStats.uploads++;
+  time_t newest = simEpoch() + (time_t)(simWorldMicros() / 1000000);
+  const char *body = strstr(c.request, "\r\n\r\n");
+  if (body && strcasestr(c.request, "sbx-bytes-ts"))
+  {
+    body += 4;
+    newest = 0;
+    size_t length = c.requestLength - (body - c.request);
+    for (size_t at = 0; at + 20 <= length; at += 20)
+    {
+      const uint8_t *ts = (const uint8_t *)body + at + 16;
+      time_t t = ts[0] | ts[1] << 8 | ts[2] << 16 | (time_t)ts[3] << 24;
+      if (t > newest)
+        newest = t;
+    }
+  }
+  else if (body && strstr(body, "\"createdAt\""))
+  {
+    newest = 0;
+    for (const char *p = strstr(body, "\"createdAt\":\""); p; p = strstr(p + 1, "\"createdAt\":\""))
+    {
+      struct tm tm = {};
+      if (sscanf(p + 13, "%d-%d-%dT%d:%d:%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &tm.tm_hour, &tm.tm_min,
+                 &tm.tm_sec) != 6)
+        continue;
+      tm.tm_year -= 1900;
+      tm.tm_mon -= 1;
+      time_t t = timegm(&tm);
+      if (t > newest)
+        newest = t;
+    }
+  }
+  if (newest > serverNewest)
+    serverNewest = newest;
+}
+
+static const char *scriptedResponse = nullptr;
+
+void simHttpRespond(const char *response)
+{
+  scriptedResponse = response;
+}
+
+static void answer(Connection &c)
+{
+  c.answered = true;
+  c.responseLength = 0;
+  c.responseRead = 0;
+  simStats.httpRequests++;
+
+  if (scriptedResponse)
+  {
+    appendf(c, "%s", scriptedResponse);
+    scriptedResponse = nullptr;
+    c.responseAt = simWorldMicros() + (uint64_t)envMs("SIM_RTT_MS", 80) * 1000;
+    return;
+  }
+
+  char method[8] = {0}, path[512] = {0};
+  sscanf(c.request, "%7s %511s", method, path);
+  if (strcmp(method, "POST") == 0 && strstr(path, "/data"))
+  {
+    uint32_t status = envMs("SIM_UPLOAD_STATUS", 201);
+    const char *body = status < 300 ? "Measurements saved in box" : "Error";
+    if (status < 300)
+      recordUpload(c);
+    appendf(c, "HTTP/1.1 %u Status\r\nContent-Type: application/json\r\nContent-Length: %u\r\n\r\n%s", status,
+            (unsigned)strlen(body), body);
+  }
+  else if (strcmp(method, "POST") == 0 && strstr(path, "/write"))
+  {
+    // InfluxDB write API, 204 without a body
+    uint32_t status = envMs("SIM_INFLUX_STATUS", 204);
+    const char *body = strstr(c.request, "\r\n\r\n") + 4;
+    if (status < 300)
+      simStats.influxLines += countLines(body, c.requestLength - (body - c.request));
+    appendf(c, "HTTP/1.1 %u Status\r\nContent-Length: 0\r\n\r\n", status);
+  }
+  else if (strcmp(method, "GET") == 0 && strncmp(path, "/statistics/", 12) == 0)
+  {
+    statisticsResponse(c);
+  }
+  else
+  {
+    appendf(c, "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+  }
+  c.responseAt = simWorldMicros() + (uint64_t)envMs("SIM_RTT_MS", 80) * 1000;
+}
+
+// MQTT broker: CONNACK to CONNECT, PUBACK to a QoS 1 PUBLISH, closes on
+// DISCONNECT. The payload is counted as line protocol.
+static void broker(Connection &c)
+{
+  size_t at = 0;
+  while (at + 2 <= c.requestLength)
+  {
+    const uint8_t *packet = (const uint8_t *)c.request + at;
+    size_t remaining = 0, n = 1;
+    for (int shift = 0; n < 5; shift += 7)
+    {
+      if (at + n >= c.requestLength)
+        return;
+      remaining |= (size_t)(packet[n] & 0x7f) << shift;
+      if (!(packet[n++] & 0x80))
+        break;
+    }
+    if (at + n + remaining > c.requestLength)
+      break;
+    const uint8_t *body = packet + n;
+    uint8_t type = packet[0];
+    uint8_t ack[4] = {0, 2, 0, 0};
+    if (type == 0x10)
+    {
+      ack[0] = 0x20; // session present 0, accepted
+    }
+    else if (type == 0x32)
+    {
+      size_t topic = body[0] << 8 | body[1];
+      size_t payload = 2 + topic + 2;
+      simStats.mqttPublishes++;
+      simStats.mqttLines += countLines((const char *)body + payload, remaining - payload);
+      ack[0] = 0x40;
+      ack[2] = body[2 + topic];
+      ack[3] = body[3 + topic];
+    }
+    else if (type == 0xe0)
+    {
+      c.open = false;
+    }
+    if (ack[0] && c.responseLength + sizeof(ack) <= sizeof(c.response))
+    {
+      memcpy(c.response + c.responseLength, ack, sizeof(ack));
+      c.responseLength += sizeof(ack);
+    }
+    at += n + remaining;
+  }
+  memmove(c.request, c.request + at, c.requestLength - at);
+  c.requestLength -= at;
+  c.responseAt = simWorldMicros() + (uint64_t)envMs("SIM_RTT_MS", 80) * 1000;
+}
+
+static void pump(Connection &c)
+{
+  if (!c.open || c.answered)
+    return;
+  c.request[c.requestLength] = '\0';
+  if (c.mqtt)
+  {
+    broker(c);
+    return;
+  }
+  const char *end = strstr(c.request, "\r\n\r\n");
+  if (end && c.requestLength >= (size_t)(end + 4 - c.request) + contentLength(c.request))
+    answer(c);
+}
+
+int WiFiClient::connect(const char *, uint16_t port)
+{
+  stop();
+  if (WiFi.status() != WL_CONNECTED)
+    return 0;
+  // SIM_MQTT=0: nothing listens on the broker's port
+  if (port == MQTT_PORT && envMs("SIM_MQTT", 1) == 0)
+  {
+    delay(2 * envMs("SIM_RTT_MS", 80));
+    return 0;
+  }
+  int slot = 0;
+  while (slot < CONNECTIONS && connections[slot].open)
+    slot++;
+  if (slot == CONNECTIONS)
+    return 0;
+  // DNS and TCP handshake, then TLS if any
+  delay(2 * envMs("SIM_RTT_MS", 80) + handshakeMs());
+  Connection &c = connections[slot];
+  memset(&c, 0, sizeof(c));
+  c.open = true;
+  c.mqtt = port == MQTT_PORT;
+  _slot = slot;
+  _open = true;
+  return 1;
+}
+
+size_t WiFiClient::write(const uint8_t *buffer, size_t size)
+{
+  if (!_open || !connections[_slot].open || (connections[_slot].answered && !connections[_slot].scrape))
+    return 0;
+  Connection &c = connections[_slot];
+  size_t space = sizeof(c.request) - 1 - c.requestLength;
+  size_t n = size < space ? size : space;
+  memcpy(c.request + c.requestLength, buffer, n);
+  c.requestLength += n;
+  if (c.scrape)
+    return n;
+  simStats.httpBytesSent += n;
+  pump(c);
+  return n;
+}
+
+int WiFiClient::available()
+{
+  if (!_open)
+    return 0;
+  const Connection &c = connections[_slot];
+  if (!(c.answered || c.mqtt) || simWorldMicros() < c.responseAt)
+    return 0;
+  return (int)(c.responseLength - c.responseRead);
+}
+
+int WiFiClient::read()
+{
+  uint8_t b;
+  return read(&b, 1) == 1 ? b : -1;
+}
+
+int WiFiClient::read(uint8_t *buffer, size_t size)
+{
+  int n = available();
+  if (n <= 0)
+    return -1;
+  if ((size_t)n > size)
+    n = (int)size;
+  Connection &c = connections[_slot];
+  memcpy(buffer, c.response + c.responseRead, n);
+  c.responseRead += n;
+  if (c.mqtt && c.responseRead == c.responseLength)
+    c.responseRead = c.responseLength = 0;
+  if (!c.scrape)
+    simStats.httpBytesReceived += n;
+  return n;
+}
+
+int WiFiClient::peek()
+{
+  return available() > 0 ? (uint8_t)connections[_slot].response[connections[_slot].responseRead] : -1;
+}
+
+uint8_t WiFiClient::connected()
+{
+  // Open until the server sent everything and closed
+  if (!_open || WiFi.status() != WL_CONNECTED)
+    return 0;
+  const Connection &c = connections[_slot];
+  if (c.scrape)
+    return c.open; // the scraper waits for the answer
+  return c.open && !(c.answered && c.responseRead == c.responseLength);
+}
+
+static void checkScrape(Connection &c);
+
+void WiFiClient::stop()
+{
+  if (_open)
+  {
+    if (connections[_slot].open && connections[_slot].scrape)
+      checkScrape(connections[_slot]);
+    connections[_slot].open = false;
+  }
+  _open = false;
+}
+
+// --- UDP --------------------------------------------------------------------
+
+// The InfluxDB UDP listener takes every datagram that fits the MTU
+static char datagram[1472];
+static size_t datagramLength = 0;
+
+int WiFiUDP::beginPacket(const char *, uint16_t)
+{
+  datagramLength = 0;
+  return WiFi.status() == WL_CONNECTED;
+}
+
+size_t WiFiUDP::write(const uint8_t *buffer, size_t size)
+{
+  size_t space = sizeof(datagram) - datagramLength;
+  size_t n = size < space ? size : space;
+  memcpy(datagram + datagramLength, buffer, n);
+  datagramLength += n;
+  return n;
+}
+
+int WiFiUDP::endPacket()
+{
+  if (WiFi.status() != WL_CONNECTED)
+    return 0;
+  simStats.httpBytesSent += datagramLength;
+  simStats.udpLines += countLines(datagram, datagramLength);
+  datagramLength = 0;
+  return 1;
+}
+
+static bool serverMfln()
+{
+  return envMs("SIM_TLS_MFLN", 1) != 0;
+}
+
+bool WiFiClientSecure::probeMaxFragmentLength(const char *, uint16_t, uint16_t len)
+{
+  if (WiFi.status() != WL_CONNECTED)
+    return false;
+  // TCP handshake plus ClientHello/ServerHello
+  delay(2 * envMs("SIM_RTT_MS", 80));
+  return serverMfln() && (len == 512 || len == 1024 || len == 2048 || len == 4096);
+}
+
+int WiFiClientSecure::connect(const char *host, uint16_t port)
+{
+  SimDriverHeap driver;
+  stop();
+  bool resumed = _session && _session->valid;
+  uint32_t handshake = handshakeMs();
+  if (!WiFiClient::connect(host, port))
+    return 0;
+  // A server without max fragment length sends full 16 KB records, which
+  // a smaller receive buffer cannot take
+  if (_recv < 16384 && !serverMfln())
+  {
+    stop();
+    return 0;
+  }
+  // BearSSL's protocol overhead on top of the record sizes
+  uint32_t buffers = _recv + 325 + _xmit + 85;
+  _buffers = malloc(buffers);
+  if (_session)
+    _session->valid = true;
+  simStats.tlsHandshakes++;
+  simStats.tlsResumed += resumed;
+  simStats.tlsHandshakeUs += (uint64_t)handshake * 1000;
+  if (buffers > simStats.tlsBufferPeak)
+    simStats.tlsBufferPeak = buffers;
+  return 1;
+}
+
+void WiFiClientSecure::stop()
+{
+  SimDriverHeap driver;
+  free(_buffers);
+  _buffers = nullptr;
+  WiFiClient::stop();
+}
+
+uint32_t WiFiClientSecure::handshakeMs()
+{
+  // Full RSA handshake with BearSSL at 80 MHz, resuming a session skips the
+  // public key operations and costs one more round trip
+  uint32_t full = envMs("SIM_TLS_HANDSHAKE_MS", 1500) * 80 / ESP.getCpuFreqMHz();
+  if (_session && _session->valid)
+    return envMs("SIM_RTT_MS", 80) + full / 20;
+  return full;
+}
+
+// --- Scrapers ---------------------------------------------------------------
+
+WiFiClient WiFiServer::accept()
+{
+  uint32_t interval = envMs("SIM_SCRAPE_MS", 15000);
+  if (!_listening || interval == 0 || WiFi.status() != WL_CONNECTED)
+    return WiFiClient();
+  if (_pending == 0 && simWorldMicros() >= _nextScrape)
+  {
+    _nextScrape = simWorldMicros() + (uint64_t)interval * 1000;
+    _pending = 2;
+  }
+  if (_pending == 0)
+    return WiFiClient();
+  int slot = 0;
+  while (slot < CONNECTIONS && connections[slot].open)
+    slot++;
+  if (slot == CONNECTIONS)
+    return WiFiClient();
+
+  // What Prometheus sends, half a round trip after the connection is up
+  Connection &c = connections[slot];
+  memset(&c, 0, sizeof(c));
+  c.open = true;
+  c.scrape = _pending == 2 ? "/metrics" : "/json";
+  c.answered = true;
+  c.responseAt = simWorldMicros() + (uint64_t)envMs("SIM_RTT_MS", 80) * 500;
+  appendf(c,
+          "GET %s HTTP/1.1\r\nHost: sensebox.local\r\nUser-Agent: Prometheus/2.53.0\r\n"
+          "Accept: text/plain;version=0.0.4;q=0.9,*/*;q=0.1\r\nAccept-Encoding: gzip\r\n\r\n",
+          c.scrape);
+  _pending--;
+  return WiFiClient(slot);
+}
+
+// "name{labels} value" lines, HELP and TYPE comments
+static bool validMetrics(const char *text, size_t length)
+{
+  const char *end = text + length;
+  if (length == 0 || end[-1] != '\n')
+    return false;
+  for (const char *line = text; line < end;)
+  {
+    const char *eol = (const char *)memchr(line, '\n', end - line);
+    if (strncmp(line, "# HELP ", 7) != 0 && strncmp(line, "# TYPE ", 7) != 0)
+    {
+      const char *p = line;
+      if (!isalpha((uint8_t)*p) && *p != '_')
+        return false;
+      while (isalnum((uint8_t)*p) || *p == '_' || *p == ':')
+        p++;
+      if (*p == '{')
+      {
+        const char *close = (const char *)memchr(p, '}', eol - p);
+        if (!close)
+          return false;
+        p = close + 1;
+      }
+      if (*p++ != ' ')
+        return false;
+      char *number;
+      strtod(p, &number);
+      if (number != eol)
+        return false;
+    }
+    line = eol + 1;
+  }
+  return true;
+}
+
+// Objects, strings without escapes, numbers and null
+static bool jsonValue(const char *&p, const char *end);
+
+static bool jsonString(const char *&p, const char *end)
+{
+  if (p >= end || *p != '"')
+    return false;
+  const char *close = (const char *)memchr(p + 1, '"', end - p - 1);
+  if (!close)
+    return false;
+  p = close + 1;
+  return true;
+}
+
+static bool jsonValue(const char *&p, const char *end)
+{
+  if (p >= end)
+    return false;
+  if (*p == '"')
+    return jsonString(p, end);
+  if (end - p >= 4 && strncmp(p, "null", 4) == 0)
+  {
+    p += 4;
+    return true;
+  }
+  if (*p == '{')
+  {
+    p++;
+    if (p < end && *p == '}')
+    {
+      p++;
+      return true;
+    }
+    while (jsonString(p, end) && p < end && *p++ == ':' && jsonValue(p, end) && p < end)
+    {
+      if (*p == '}')
+      {
+        p++;
+        return true;
+      }
+      if (*p++ != ',')
+        return false;
+    }
+    return false;
+  }
+  char *number;
+  strtod(p, &number);
+  if (number == p || number > end)
+    return false;
+  p = number;
+  return true;
+}
+
+static bool validJson(const char *text, size_t length)
+{
+  const char *p = text;
+  return length > 0 && *p == '{' && jsonValue(p, text + length) && p == text + length;
+}
+
+// The firmware closed a scraper's connection, check what it sent
+static void checkScrape(Connection &c)
+{
+  c.request[c.requestLength] = '\0';
+  int status = 0;
+  const char *end = strstr(c.request, "\r\n\r\n");
+  sscanf(c.request, "HTTP/1.1 %d", &status);
+  const char *body = end ? end + 4 : c.request + c.requestLength;
+  size_t length = c.request + c.requestLength - body;
+
+  simStats.lanRequests++;
+  simStats.lanBytes += length;
+  if (status == 503)
+  {
+    simStats.lanUnavailable++;
+    return;
+  }
+  bool valid = status == 200 && end && contentLength(c.request) == length &&
+               (strcmp(c.scrape, "/metrics") == 0 ? validMetrics(body, length) : validJson(body, length));
+  if (!valid)
+  {
+    simStats.lanInvalid++;
+    fprintf(stderr, "Invalid %s response: %.*s\n", c.scrape, (int)c.requestLength, c.request);
+  }
+}
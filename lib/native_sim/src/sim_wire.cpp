@@ -0,0 +1,199 @@
+#include "Wire.h"
+#include "sim_internal.h"
+#include <string.h>
+
+TwoWire Wire;
+
+#define MAX_DEVICES 8
+
+static const SimI2cDevice *devices[MAX_DEVICES];
+static size_t deviceCount = 0;
+static uint8_t unplugged[16]; // bit per address
+static int sdaPin = -1;
+static int sclPin = -1;
+static bool sclLow = false;
+static uint8_t stuckClocks = 0; // SDA is held low until this many SCL pulses
+
+void simI2cAttach(const SimI2cDevice *device)
+{
+  for (size_t i = 0; i < deviceCount; i++)
+  {
+    if (devices[i] == device)
+      return;
+  }
+  if (deviceCount < MAX_DEVICES)
+    devices[deviceCount++] = device;
+}
+
+void simI2cUnplug(uint8_t address, bool gone)
+{
+  if (gone)
+    unplugged[address >> 3] |= 1 << (address & 7);
+  else
+    unplugged[address >> 3] &= ~(1 << (address & 7));
+}
+
+void simI2cStickSda(uint8_t clocks)
+{
+  stuckClocks = clocks;
+}
+
+// Only the I2C pins are modelled: a device holding SDA low lets go after
+// the SCL pulses it still needs to shift out its byte
+void pinMode(uint8_t pin, uint8_t mode)
+{
+  if (pin == sclPin && mode != OUTPUT && mode != OUTPUT_OPEN_DRAIN)
+    digitalWrite(pin, HIGH); // released, the pull-up takes it high
+}
+
+int digitalRead(uint8_t pin)
+{
+  return pin == sdaPin && stuckClocks > 0 ? LOW : HIGH;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+  if (pin != sclPin)
+    return;
+  if (value == HIGH && sclLow && stuckClocks > 0)
+    stuckClocks--;
+  sclLow = value == LOW;
+}
+
+static SimI2cTransfer transferLog[SIM_I2C_LOG_SIZE];
+static size_t transferCount = 0;
+
+void simI2cLogClear()
+{
+  transferCount = 0;
+}
+
+size_t simI2cLogCount()
+{
+  return transferCount;
+}
+
+const SimI2cTransfer &simI2cLogEntry(size_t index)
+{
+  return transferLog[index];
+}
+
+static void logTransfer(uint8_t address, bool read, const uint8_t *data, size_t length)
+{
+  if (transferCount >= SIM_I2C_LOG_SIZE)
+    return;
+  SimI2cTransfer &entry = transferLog[transferCount++];
+  entry.address = address;
+  entry.read = read;
+  entry.length = (uint8_t)length;
+  memset(entry.data, 0, sizeof(entry.data));
+  if (!read)
+    memcpy(entry.data, data, length < sizeof(entry.data) ? length : sizeof(entry.data));
+}
+
+void simI2cTraffic(size_t bytes)
+{
+  simStats.i2cTransactions++;
+  simStats.i2cBytes += bytes;
+  // 9 clocks per byte at the bus clock, the CPU waits for it
+  uint32_t us = (uint32_t)(bytes * 9 * 1000000ULL / Wire.getClock());
+  simStats.i2cBusyUs += us;
+  delayMicroseconds(us);
+}
+
+static const SimI2cDevice *findDevice(uint8_t address)
+{
+  if (unplugged[address >> 3] & 1 << (address & 7))
+    return nullptr;
+  for (size_t i = 0; i < deviceCount; i++)
+  {
+    if (devices[i]->address == address)
+      return devices[i];
+  }
+  return nullptr;
+}
+
+void TwoWire::begin(int sda, int scl)
+{
+  sdaPin = sda;
+  sclPin = scl;
+  begin();
+}
+
+void TwoWire::begin()
+{
+  _clock = 100000;
+  simSensorsAttach();
+}
+
+void TwoWire::setClock(uint32_t frequency)
+{
+  _clock = frequency;
+}
+
+void TwoWire::beginTransmission(uint8_t address)
+{
+  _address = address;
+  _txLength = 0;
+}
+
+uint8_t TwoWire::endTransmission(bool)
+{
+  if (stuckClocks > 0)
+  {
+    _txLength = 0;
+    return 4; // bus busy, no START possible
+  }
+  simI2cTraffic(_txLength + 1);
+  logTransfer(_address, false, _tx, _txLength);
+  const SimI2cDevice *device = findDevice(_address);
+  size_t length = _txLength;
+  _txLength = 0;
+  if (!device)
+    return 2; // address NACK
+  device->receive(_tx, length);
+  return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, size_t quantity, bool)
+{
+  if (quantity > sizeof(_rx))
+    quantity = sizeof(_rx);
+  const SimI2cDevice *device = stuckClocks > 0 ? nullptr : findDevice(address);
+  _rxIndex = 0;
+  _rxLength = device && device->transmit ? device->transmit(_rx, quantity) : 0;
+  simI2cTraffic(1 + _rxLength);
+  logTransfer(address, true, _rx, _rxLength);
+  return (uint8_t)_rxLength;
+}
+
+size_t TwoWire::write(uint8_t data)
+{
+  if (_txLength >= sizeof(_tx))
+    return 0;
+  _tx[_txLength++] = data;
+  return 1;
+}
+
+size_t TwoWire::write(const uint8_t *data, size_t quantity)
+{
+  size_t n = 0;
+  while (n < quantity && write(data[n]))
+    n++;
+  return n;
+}
+
+int TwoWire::available()
+{
+  return (int)(_rxLength - _rxIndex);
+}
+
+int TwoWire::read()
+{
+  return _rxIndex < _rxLength ? _rx[_rxIndex++] : -1;
+}
+
+int TwoWire::peek()
+{
+  return _rxIndex < _rxLength ? _rx[_rxIndex] : -1;
+}
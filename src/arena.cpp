@@ -0,0 +1,53 @@
+#include "arena.h"
+#include "memory_budget.h"
+
+static_assert(ARENA_SIZE % 4 == 0 && ARENA_SIZE <= 0xffff, "ArenaMark holds an offset into the arena");
+static_assert(ARENA_SIZE <= RAM_BUDGET_SCRATCH, "arena over its RAM budget");
+
+static uint32_t storage[ARENA_SIZE / 4];
+static size_t used = 0;
+static size_t highWater = 0;
+static uint32_t failures = 0;
+
+void *arenaAlloc(size_t size)
+{
+  // Checked before rounding up, which could wrap a huge size to 0. The
+  // space left is a multiple of 4, so the rounded size fits as well.
+  if (size > ARENA_SIZE - used)
+  {
+    failures++;
+    return nullptr;
+  }
+  size = (size + 3) & ~(size_t)3;
+  void *block = (uint8_t *)storage + used;
+  used += size;
+  if (used > highWater)
+    highWater = used;
+  return block;
+}
+
+ArenaMark arenaMark()
+{
+  return used;
+}
+
+void arenaRewind(ArenaMark mark)
+{
+  if (mark < used)
+    used = mark;
+}
+
+void arenaReset()
+{
+  used = 0;
+}
+
+size_t arenaHighWater()
+{
+  return highWater;
+}
+
+uint32_t arenaFailures()
+{
+  return failures;
+}
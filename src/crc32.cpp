@@ -0,0 +1,16 @@
+#include "crc32.h"
+
+uint32_t crc32(const void *data, size_t length)
+{
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  uint32_t crc = 0xffffffff;
+  while (length--)
+  {
+    crc ^= *bytes++;
+    for (int bit = 0; bit < 8; bit++)
+    {
+      crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
@@ -0,0 +1,197 @@
+#include "display_regions.h"
+#include "glyph_atlas.h"
+#include "i2c_bus.h"
+
+#include <Adafruit_SSD1306.h>
+#include <string.h>
+
+#define CONTROL_COMMANDS 0x00
+#define CONTROL_DATA 0x40
+
+// Payload per transaction, one byte of the Wire buffer goes to the control byte
+#ifdef BUFFER_LENGTH
+#define WIRE_CHUNK (BUFFER_LENGTH - 1)
+#else
+#define WIRE_CHUNK 31
+#endif
+
+void displayRegionsClear(DisplayRegions &regions)
+{
+  memset(regions.start, DISPLAY_COLUMNS, sizeof(regions.start));
+  memset(regions.end, 0, sizeof(regions.end));
+}
+
+void displayRegionsMark(DisplayRegions &regions, int16_t x, int16_t y, int16_t w, int16_t h)
+{
+  if (x < 0)
+  {
+    w += x;
+    x = 0;
+  }
+  if (y < 0)
+  {
+    h += y;
+    y = 0;
+  }
+  if (w <= 0 || h <= 0 || x >= DISPLAY_COLUMNS || y >= DISPLAY_PAGES * 8)
+    return;
+  int16_t right = x + w > DISPLAY_COLUMNS ? DISPLAY_COLUMNS : x + w;
+  int16_t lastPage = (y + h - 1) / 8;
+  if (lastPage >= DISPLAY_PAGES)
+    lastPage = DISPLAY_PAGES - 1;
+
+  for (int16_t page = y / 8; page <= lastPage; page++)
+  {
+    if (x < regions.start[page])
+      regions.start[page] = x;
+    if (right > regions.end[page])
+      regions.end[page] = right;
+  }
+}
+
+void displayRegionsMarkAll(DisplayRegions &regions)
+{
+  memset(regions.start, 0, sizeof(regions.start));
+  memset(regions.end, DISPLAY_COLUMNS, sizeof(regions.end));
+}
+
+bool displayRegionsDirty(const DisplayRegions &regions)
+{
+  for (uint8_t page = 0; page < DISPLAY_PAGES; page++)
+  {
+    if (regions.start[page] < regions.end[page])
+      return true;
+  }
+  return false;
+}
+
+size_t displayRegionsFlush(DisplayRegions &regions, const uint8_t *buffer, uint8_t address, uint8_t maxPages)
+{
+  size_t sent = 0;
+  uint8_t page = 0;
+  while (page < DISPLAY_PAGES && maxPages > 0)
+  {
+    uint8_t start = regions.start[page];
+    uint8_t end = regions.end[page];
+    if (start >= end)
+    {
+      page++;
+      continue;
+    }
+
+    // Consecutive pages with the same columns share one address window,
+    // the controller wraps to the next page at the end column
+    uint8_t lastPage = page;
+    while (lastPage + 1 < DISPLAY_PAGES && lastPage + 1 < page + maxPages && regions.start[lastPage + 1] == start &&
+           regions.end[lastPage + 1] == end)
+      lastPage++;
+
+    const uint8_t window[] = {SSD1306_PAGEADDR, page, lastPage, SSD1306_COLUMNADDR, start, (uint8_t)(end - 1)};
+    i2cBusWrite(I2C_SSD1306, address, CONTROL_COMMANDS, window, sizeof(window));
+    sent += 2 + sizeof(window);
+
+    for (uint8_t p = page; p <= lastPage; p++)
+    {
+      const uint8_t *data = buffer + p * DISPLAY_COLUMNS + start;
+      size_t remaining = end - start;
+      while (remaining > 0)
+      {
+        size_t n = remaining < WIRE_CHUNK ? remaining : WIRE_CHUNK;
+        i2cBusWrite(I2C_SSD1306, address, CONTROL_DATA, data, n);
+        sent += 2 + n;
+        data += n;
+        remaining -= n;
+      }
+      regions.start[p] = DISPLAY_COLUMNS;
+      regions.end[p] = 0;
+      maxPages--;
+    }
+    page = lastPage + 1;
+  }
+  return sent;
+}
+
+static const GlyphFont &widgetFont(const TextWidget &widget)
+{
+  return widget.size == 2 ? GLYPHS_LARGE : GLYPHS_SMALL;
+}
+
+// Copy the glyph into its cell, clipped to the screen
+static void drawCell(uint8_t *buffer, DisplayRegions &regions, const GlyphFont &font, int16_t x, uint8_t page, char c)
+{
+  int16_t left = x < 0 ? 0 : x;
+  int16_t right = x + font.width > DISPLAY_COLUMNS ? DISPLAY_COLUMNS : x + font.width;
+  if (left >= right)
+    return;
+  for (uint8_t p = 0; p < font.pages && page + p < DISPLAY_PAGES; p++)
+  {
+    uint8_t *row = buffer + (page + p) * DISPLAY_COLUMNS;
+    const uint8_t *glyph = glyphColumns(font, c, p);
+    if (glyph)
+      memcpy_P(row + left, glyph + (left - x), right - left);
+    else
+      memset(row + left, 0, right - left);
+  }
+  displayRegionsMark(regions, left, page * 8, right - left, font.pages * 8);
+}
+
+static void clearCells(uint8_t *buffer, DisplayRegions &regions, const GlyphFont &font, int16_t x, uint8_t page,
+                       size_t length)
+{
+  for (size_t i = 0; i < length; i++)
+    drawCell(buffer, regions, font, x + i * font.width, page, ' ');
+}
+
+static int16_t textLeft(const TextWidget &widget, size_t length)
+{
+  if (!widget.center)
+    return widget.x;
+  return widget.x + (widget.width - (int16_t)(length * widgetFont(widget).width)) / 2;
+}
+
+bool textWidgetDraw(TextWidget &widget, uint8_t *buffer, DisplayRegions &regions, const char *text)
+{
+  size_t newLength = strnlen(text, sizeof(widget.text) - 1);
+  size_t oldLength = strlen(widget.text);
+  if (widget.valid && newLength == oldLength && strncmp(widget.text, text, newLength) == 0)
+    return false;
+
+  const GlyphFont &font = widgetFont(widget);
+  if (widget.valid && newLength == oldLength)
+  {
+    // Same place, only touch the characters that changed
+    int16_t left = textLeft(widget, newLength);
+    for (size_t i = 0; i < newLength; i++)
+    {
+      if (widget.text[i] != text[i])
+        drawCell(buffer, regions, font, left + i * font.width, widget.page, text[i]);
+    }
+  }
+  else
+  {
+    if (widget.valid && oldLength > 0)
+      clearCells(buffer, regions, font, textLeft(widget, oldLength), widget.page, oldLength);
+    int16_t left = textLeft(widget, newLength);
+    for (size_t i = 0; i < newLength; i++)
+      drawCell(buffer, regions, font, left + i * font.width, widget.page, text[i]);
+  }
+
+  memcpy(widget.text, text, newLength);
+  widget.text[newLength] = '\0';
+  widget.valid = true;
+  return true;
+}
+
+size_t textWidgetColumns(const TextWidget &widget)
+{
+  int16_t left = widget.x < 0 ? 0 : widget.x;
+  int16_t right = widget.x + widget.width > DISPLAY_COLUMNS ? DISPLAY_COLUMNS : widget.x + widget.width;
+  size_t columns = left < right ? (right - left) / widgetFont(widget).width : 0;
+  return columns < sizeof(widget.text) - 1 ? columns : sizeof(widget.text) - 1;
+}
+
+void textWidgetInvalidate(TextWidget &widget)
+{
+  widget.valid = false;
+  widget.text[0] = '\0';
+}
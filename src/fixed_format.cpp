@@ -0,0 +1,58 @@
+#include "fixed_format.h"
+#include <math.h>
+#include <string.h>
+
+// Twice the scale, the last bit of the product is the rounding half
+static const int32_t DOUBLE_POWERS_OF_TEN[] = {2, 20, 200, 2000, 20000};
+
+size_t formatFixed(char *out, size_t size, float value, uint8_t decimals, const char *suffix)
+{
+  if (size == 0)
+    return 0;
+  if (decimals > 4)
+    decimals = 4;
+
+  char text[32];
+  size_t length = 0;
+  float doubled = value * DOUBLE_POWERS_OF_TEN[decimals];
+  if (!(fabsf(doubled) < 2e9f)) // NAN as well
+  {
+    strcpy(text, "--");
+    length = 2;
+  }
+  else
+  {
+    // Truncated toward zero, adding one half step and halving again rounds
+    // halves away from zero
+    int32_t halves = (int32_t)doubled;
+    int32_t fixed = (halves + (halves < 0 ? -1 : 1)) / 2;
+    uint32_t magnitude = fixed < 0 ? -(uint32_t)fixed : fixed;
+
+    // Digits from the right, then reversed
+    char digits[12];
+    size_t count = 0;
+    do
+    {
+      digits[count++] = '0' + magnitude % 10;
+      magnitude /= 10;
+    } while (magnitude > 0 || count <= decimals);
+
+    if (fixed < 0)
+      text[length++] = '-';
+    while (count > 0)
+    {
+      if (count == decimals)
+        text[length++] = '.';
+      text[length++] = digits[--count];
+    }
+    size_t suffixLength = strnlen(suffix, sizeof(text) - 1 - length);
+    memcpy(text + length, suffix, suffixLength);
+    length += suffixLength;
+  }
+
+  if (length > size - 1)
+    length = size - 1;
+  memcpy(out, text, length);
+  out[length] = '\0';
+  return length;
+}
@@ -0,0 +1,69 @@
+#include "glyph_atlas.h"
+#include <Arduino.h>
+
+// Generated from the Adafruit GFX classic font, the large glyphs are its
+// pixels doubled in both directions (what setTextSize(2) draws)
+static const uint8_t SMALL_COLUMNS[] PROGMEM = {
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // ' '
+    0x08, 0x08, 0x08, 0x08, 0x08, 0x00, // '-'
+    0x00, 0x60, 0x60, 0x00, 0x00, 0x00, // '.'
+    0x00, 0x36, 0x36, 0x00, 0x00, 0x00, // ':'
+    0x3E, 0x51, 0x49, 0x45, 0x3E, 0x00, // '0'
+    0x00, 0x42, 0x7F, 0x40, 0x00, 0x00, // '1'
+    0x72, 0x49, 0x49, 0x49, 0x46, 0x00, // '2'
+    0x21, 0x41, 0x49, 0x4D, 0x33, 0x00, // '3'
+    0x18, 0x14, 0x12, 0x7F, 0x10, 0x00, // '4'
+    0x27, 0x45, 0x45, 0x45, 0x39, 0x00, // '5'
+    0x3C, 0x4A, 0x49, 0x49, 0x31, 0x00, // '6'
+    0x41, 0x21, 0x11, 0x09, 0x07, 0x00, // '7'
+    0x36, 0x49, 0x49, 0x49, 0x36, 0x00, // '8'
+    0x46, 0x49, 0x49, 0x29, 0x1E, 0x00, // '9'
+    0x3E, 0x41, 0x41, 0x41, 0x22, 0x00, // 'C'
+    0x7F, 0x08, 0x04, 0x04, 0x78, 0x00, // 'h'
+    0x7F, 0x09, 0x09, 0x09, 0x06, 0x00, // 'P'
+    0x20, 0x54, 0x54, 0x78, 0x40, 0x00, // 'a'
+    0x00, 0x41, 0x7F, 0x40, 0x00, 0x00, // 'l'
+    0x44, 0x28, 0x10, 0x28, 0x44, 0x00, // 'x'
+};
+
+static const uint8_t LARGE_COLUMNS[] PROGMEM = {
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // ' '
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0x00, 0x00, // '-'
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x3C, 0x3C, 0x3C, 0x3C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // ':'
+    0x00, 0x00, 0x0F, 0x0F, 0x0F, 0x0F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0xFC, 0xFC, 0x03, 0x03, 0xC3, 0xC3, 0x33, 0x33, 0xFC, 0xFC, 0x00, 0x00, // '0'
+    0x0F, 0x0F, 0x33, 0x33, 0x30, 0x30, 0x30, 0x30, 0x0F, 0x0F, 0x00, 0x00,
+    0x00, 0x00, 0x0C, 0x0C, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // '1'
+    0x00, 0x00, 0x30, 0x30, 0x3F, 0x3F, 0x30, 0x30, 0x00, 0x00, 0x00, 0x00,
+    0x0C, 0x0C, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0x3C, 0x3C, 0x00, 0x00, // '2'
+    0x3F, 0x3F, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x00, 0x00,
+    0x03, 0x03, 0x03, 0x03, 0xC3, 0xC3, 0xF3, 0xF3, 0x0F, 0x0F, 0x00, 0x00, // '3'
+    0x0C, 0x0C, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x0F, 0x0F, 0x00, 0x00,
+    0xC0, 0xC0, 0x30, 0x30, 0x0C, 0x0C, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, // '4'
+    0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x3F, 0x3F, 0x03, 0x03, 0x00, 0x00,
+    0x3F, 0x3F, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0xC3, 0xC3, 0x00, 0x00, // '5'
+    0x0C, 0x0C, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x0F, 0x0F, 0x00, 0x00,
+    0xF0, 0xF0, 0xCC, 0xCC, 0xC3, 0xC3, 0xC3, 0xC3, 0x03, 0x03, 0x00, 0x00, // '6'
+    0x0F, 0x0F, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x0F, 0x0F, 0x00, 0x00,
+    0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0xC3, 0xC3, 0x3F, 0x3F, 0x00, 0x00, // '7'
+    0x30, 0x30, 0x0C, 0x0C, 0x03, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x3C, 0x3C, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0x3C, 0x3C, 0x00, 0x00, // '8'
+    0x0F, 0x0F, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x0F, 0x0F, 0x00, 0x00,
+    0x3C, 0x3C, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFC, 0xFC, 0x00, 0x00, // '9'
+    0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x0C, 0x0C, 0x03, 0x03, 0x00, 0x00,
+};
+
+const GlyphFont GLYPHS_SMALL = {SMALL_COLUMNS, " -.:0123456789ChPalx", 6, 1};
+const GlyphFont GLYPHS_LARGE = {LARGE_COLUMNS, " -:0123456789", 12, 2};
+
+const uint8_t *glyphColumns(const GlyphFont &font, char c, uint8_t page)
+{
+  for (uint8_t i = 0; font.chars[i] != '\0'; i++)
+  {
+    if (font.chars[i] == c)
+      return font.columns + (i * font.pages + page) * font.width;
+  }
+  return nullptr;
+}
@@ -0,0 +1,439 @@
+#include "http_client.h"
+#include "arena.h"
+#include "memory_budget.h"
+#include <ESP8266WiFi.h>
+#include <WiFiClientSecure.h>
+#include <ctype.h>
+#include <string.h>
+
+enum
+{
+  RESPONSE_STATUS,
+  RESPONSE_HEADERS,
+  RESPONSE_BODY,
+  RESPONSE_CHUNK_SIZE,
+  RESPONSE_CHUNK_DATA,
+  RESPONSE_CHUNK_END,
+  RESPONSE_DONE
+};
+
+// Header names and codings are case-insensitive, compared in lower case
+static const char TRANSFER_ENCODING[] = "transfer-encoding";
+static const char CHUNKED[] = "chunked";
+#define MATCH_NONE 0xff // headerMatch or codingMatch of anything else
+
+static void (*idleHook)() = nullptr;
+
+// TLS state of the last host
+static const char *tlsHost = nullptr;
+static BearSSL::Session tlsSession;
+static int8_t tlsMfln = -1; // max fragment length supported, -1 not probed
+static unsigned long tlsProbedAt = 0;
+static_assert(sizeof(tlsSession) + sizeof(tlsHost) + sizeof(tlsMfln) + sizeof(tlsProbedAt) <= RAM_BUDGET_NETWORK,
+              "TLS state over its RAM budget");
+
+struct HttpResponse
+{
+  uint8_t state;
+  bool chunked;
+  bool statusSpace;     // passed the space before the status code
+  bool sizeLineDone;    // rest of a chunk size line is ignored
+  uint8_t headerMatch;  // characters of TRANSFER_ENCODING matched on this line
+  bool headerValue;     // past the colon of a Transfer-Encoding line
+  uint8_t codingMatch;  // characters of CHUNKED matched in the current coding
+  bool codingEnded;     // whitespace after the current coding
+  bool lastChunked;     // the last non-empty coding so far was chunked
+  uint16_t lineLength;
+  int status;
+  uint32_t chunkRemaining;
+};
+
+static int hexValue(char c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  c = tolower(c);
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  return -1;
+}
+
+static bool isBlank(char c)
+{
+  return c == ' ' || c == '\t';
+}
+
+// Follow one header line character by character, nothing is buffered. The
+// body is chunked if the last coding of the last Transfer-Encoding line is
+// chunked, e.g. "Transfer-Encoding: gzip, Chunked".
+static void parseHeaderChar(HttpResponse &response, char c)
+{
+  if (!response.headerValue)
+  {
+    if (response.headerMatch == MATCH_NONE)
+    {
+      return;
+    }
+    if (response.headerMatch == sizeof(TRANSFER_ENCODING) - 1)
+    {
+      if (c == ':')
+      {
+        response.headerValue = true;
+        response.codingMatch = 0;
+        response.codingEnded = false;
+        response.lastChunked = false;
+      }
+      else if (!isBlank(c))
+      {
+        response.headerMatch = MATCH_NONE;
+      }
+    }
+    else if (tolower(c) == TRANSFER_ENCODING[response.headerMatch])
+    {
+      response.headerMatch++;
+    }
+    else
+    {
+      response.headerMatch = MATCH_NONE;
+    }
+    return;
+  }
+
+  if (c == ',')
+  {
+    // Empty list elements do not count
+    if (response.codingMatch != 0)
+    {
+      response.lastChunked = response.codingMatch == sizeof(CHUNKED) - 1;
+    }
+    response.codingMatch = 0;
+    response.codingEnded = false;
+  }
+  else if (isBlank(c))
+  {
+    response.codingEnded = response.codingMatch != 0;
+  }
+  else if (response.codingEnded || response.codingMatch >= sizeof(CHUNKED) - 1 ||
+           tolower(c) != CHUNKED[response.codingMatch])
+  {
+    response.codingMatch = MATCH_NONE;
+  }
+  else
+  {
+    response.codingMatch++;
+  }
+}
+
+static void endHeaderLine(HttpResponse &response)
+{
+  if (response.headerValue)
+  {
+    if (response.codingMatch != 0)
+    {
+      response.lastChunked = response.codingMatch == sizeof(CHUNKED) - 1;
+    }
+    response.chunked = response.lastChunked;
+  }
+  response.lineLength = 0;
+  response.headerMatch = 0;
+  response.headerValue = false;
+}
+
+// Consume received bytes, passing body bytes on in contiguous runs
+static void parseResponse(HttpResponse &response, const HttpRequest &request, const uint8_t *data, size_t length)
+{
+  size_t i = 0;
+  while (i < length && response.state != RESPONSE_DONE)
+  {
+    char c = (char)data[i];
+
+    switch (response.state)
+    {
+    case RESPONSE_STATUS:
+      // "HTTP/1.1 200 OK"
+      if (c == '\n')
+      {
+        response.state = RESPONSE_HEADERS;
+        endHeaderLine(response);
+      }
+      else if (c == ' ' && !response.statusSpace)
+      {
+        response.statusSpace = true;
+      }
+      else if (response.statusSpace && response.status < 100 && isdigit(c))
+      {
+        response.status = response.status * 10 + (c - '0');
+      }
+      i++;
+      break;
+
+    case RESPONSE_HEADERS:
+      if (c == '\n')
+      {
+        if (response.lineLength == 0)
+        {
+          response.state = response.chunked ? RESPONSE_CHUNK_SIZE : RESPONSE_BODY;
+        }
+        endHeaderLine(response);
+      }
+      else if (c != '\r')
+      {
+        parseHeaderChar(response, c);
+        response.lineLength++;
+      }
+      i++;
+      break;
+
+    case RESPONSE_BODY:
+      if (request.readBody)
+      {
+        request.readBody(data + i, length - i, request.context);
+      }
+      i = length;
+      break;
+
+    case RESPONSE_CHUNK_SIZE:
+      if (c == '\n')
+      {
+        response.state = response.chunkRemaining > 0 ? RESPONSE_CHUNK_DATA : RESPONSE_DONE;
+        response.sizeLineDone = false;
+      }
+      else if (!response.sizeLineDone)
+      {
+        int digit = hexValue(c);
+        if (digit >= 0)
+        {
+          response.chunkRemaining = (response.chunkRemaining << 4) | digit;
+        }
+        else
+        {
+          // CR or a chunk extension
+          response.sizeLineDone = true;
+        }
+      }
+      i++;
+      break;
+
+    case RESPONSE_CHUNK_DATA:
+    {
+      size_t run = length - i;
+      if (run > response.chunkRemaining)
+      {
+        run = response.chunkRemaining;
+      }
+      if (request.readBody)
+      {
+        request.readBody(data + i, run, request.context);
+      }
+      i += run;
+      response.chunkRemaining -= run;
+      if (response.chunkRemaining == 0)
+      {
+        response.state = RESPONSE_CHUNK_END;
+      }
+      break;
+    }
+
+    case RESPONSE_CHUNK_END:
+      // CRLF after the chunk data
+      if (c == '\n')
+      {
+        response.state = RESPONSE_CHUNK_SIZE;
+      }
+      i++;
+      break;
+    }
+  }
+}
+
+void httpSetIdleHook(void (*hook)())
+{
+  idleHook = hook;
+}
+
+static void idle()
+{
+  delay(1);
+  if (idleHook)
+  {
+    idleHook();
+  }
+}
+
+// The request head and receive buffer come from the arena, the caller
+// rewinds it
+static int exchange(Client &client, const HttpRequest &request)
+{
+  char *head = arenaArray<char>(HTTP_HEAD_SIZE);
+  uint8_t *buf = arenaArray<uint8_t>(HTTP_READ_SIZE);
+  if (!head || !buf)
+  {
+    return HTTP_ERROR_REQUEST;
+  }
+  int len;
+  if (request.contentLength > 0)
+  {
+    len = snprintf(head, HTTP_HEAD_SIZE,
+                   "%s %s HTTP/1.1\r\nHost: %s\r\n%sContent-Length: %u\r\nConnection: close\r\n\r\n",
+                   request.method, request.path, request.host,
+                   request.headers ? request.headers : "", (unsigned)request.contentLength);
+  }
+  else
+  {
+    len = snprintf(head, HTTP_HEAD_SIZE,
+                   "%s %s HTTP/1.1\r\nHost: %s\r\n%sConnection: close\r\n\r\n",
+                   request.method, request.path, request.host,
+                   request.headers ? request.headers : "");
+  }
+  if (len < 0 || len >= HTTP_HEAD_SIZE)
+  {
+    return HTTP_ERROR_REQUEST;
+  }
+
+  unsigned long start = millis();
+  client.setTimeout(HTTP_CONNECT_TIMEOUT_MS);
+  // The handshake is the only CPU-bound part, only it runs at 160 MHz
+  uint8_t freq = system_get_cpu_freq();
+  if (request.secure)
+  {
+    system_update_cpu_freq(160);
+  }
+  bool connected = client.connect(request.host, request.port);
+  if (request.secure)
+  {
+    system_update_cpu_freq(freq);
+  }
+  if (!connected)
+  {
+    return HTTP_ERROR_CONNECT;
+  }
+  if (request.connectUs)
+  {
+    *request.connectUs = (millis() - start) * 1000;
+  }
+
+  client.write((const uint8_t *)head, len);
+  if (request.writeBody)
+  {
+    request.writeBody(client, request.context);
+  }
+
+  HttpResponse response = {};
+  response.state = RESPONSE_STATUS;
+  unsigned long sent = millis();
+  bool received = false;
+  int result = 0;
+
+  while (response.state != RESPONSE_DONE)
+  {
+    int n = client.read(buf, HTTP_READ_SIZE);
+    if (n > 0)
+    {
+      received = true;
+      parseResponse(response, request, buf, n);
+      continue;
+    }
+
+    if (!client.connected() && !client.available())
+    {
+      break;
+    }
+    if ((!received && millis() - sent > HTTP_FIRST_BYTE_TIMEOUT_MS) ||
+        millis() - start > HTTP_TOTAL_TIMEOUT_MS)
+    {
+      result = HTTP_ERROR_TIMEOUT;
+      break;
+    }
+    idle();
+  }
+  client.stop();
+
+  if (result != 0)
+  {
+    return result;
+  }
+  return response.status >= 100 ? response.status : HTTP_ERROR_RESPONSE;
+}
+
+static int sendSecure(const HttpRequest &request)
+{
+  if (!tlsHost || strcmp(tlsHost, request.host) != 0)
+  {
+    tlsHost = request.host;
+    tlsSession = BearSSL::Session();
+    tlsMfln = -1;
+  }
+
+  WiFiClientSecure client;
+  client.setInsecure(); // Skip certificate verification for simplicity
+  client.setSession(&tlsSession);
+
+  uint16_t rx = request.tlsRxBuffer ? request.tlsRxBuffer : HTTP_TLS_MAX_RECORD;
+  if (rx < HTTP_TLS_MAX_RECORD)
+  {
+    if (tlsMfln == 0 && millis() - tlsProbedAt > HTTP_TLS_REPROBE_MS)
+    {
+      tlsMfln = -1;
+    }
+    if (tlsMfln < 0)
+    {
+      tlsMfln = WiFiClientSecure::probeMaxFragmentLength(request.host, request.port, rx);
+      tlsProbedAt = millis();
+    }
+    if (!tlsMfln)
+    {
+      rx = HTTP_TLS_MAX_RECORD;
+    }
+  }
+  client.setBufferSizes(rx, request.tlsTxBuffer ? request.tlsTxBuffer : 512);
+  int status = exchange(client, request);
+  // The probe fails the same way for a server without max fragment length
+  // and for one that was not reached. Only a server that answers tells them
+  // apart, until then the next request probes again.
+  if (tlsMfln == 0 && status < 0)
+  {
+    tlsMfln = -1;
+  }
+  return status;
+}
+
+int httpSend(const HttpRequest &request)
+{
+  ArenaMark mark = arenaMark();
+  int status;
+  if (request.secure)
+  {
+    status = sendSecure(request);
+  }
+  else
+  {
+    WiFiClient client;
+    status = exchange(client, request);
+  }
+  arenaRewind(mark);
+  return status;
+}
+
+int httpSendWithRetry(const HttpRequest &request, uint8_t attempts)
+{
+  unsigned long backoff = HTTP_RETRY_BASE_MS;
+  int status = HTTP_ERROR_CONNECT;
+  for (uint8_t attempt = 0; attempt < attempts; attempt++)
+  {
+    if (attempt > 0)
+    {
+      unsigned long start = millis();
+      while (millis() - start < backoff)
+      {
+        idle();
+      }
+      backoff *= 2;
+    }
+    status = httpSend(request);
+    if (status != HTTP_ERROR_CONNECT && status < 500)
+    {
+      break;
+    }
+  }
+  return status;
+}
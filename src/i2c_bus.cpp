@@ -0,0 +1,153 @@
+#include "i2c_bus.h"
+#include <Arduino.h>
+#include <Wire.h>
+#include <string.h>
+
+static const char *const DEVICE_NAMES[I2C_DEVICE_COUNT] = {"bmp280", "bh1750", "ssd1306"};
+
+static I2cDeviceStats devices[I2C_DEVICE_COUNT];
+static uint8_t sdaPin = 0;
+static uint8_t sclPin = 0;
+static uint32_t acquiredUs = 0;
+
+// Clock SCL until the device holding SDA low has shifted out its byte, then
+// send a STOP (SDA rising while SCL is high)
+static void recoverBus()
+{
+  pinMode(sdaPin, INPUT_PULLUP);
+  pinMode(sclPin, INPUT_PULLUP);
+  delayMicroseconds(5);
+  if (digitalRead(sdaPin) == LOW)
+  {
+    pinMode(sclPin, OUTPUT_OPEN_DRAIN);
+    for (int i = 0; i < 9 && digitalRead(sdaPin) == LOW; i++)
+    {
+      digitalWrite(sclPin, LOW);
+      delayMicroseconds(5);
+      digitalWrite(sclPin, HIGH);
+      delayMicroseconds(5);
+    }
+    pinMode(sdaPin, OUTPUT_OPEN_DRAIN);
+    digitalWrite(sdaPin, LOW);
+    delayMicroseconds(5);
+    digitalWrite(sclPin, HIGH);
+    delayMicroseconds(5);
+    digitalWrite(sdaPin, HIGH);
+    delayMicroseconds(5);
+    pinMode(sdaPin, INPUT_PULLUP);
+    pinMode(sclPin, INPUT_PULLUP);
+  }
+  Wire.begin(sdaPin, sclPin);
+}
+
+static void failed(I2cDevice device)
+{
+  devices[device].errors++;
+  devices[device].clock = I2C_FALLBACK_CLOCK_HZ;
+  recoverBus();
+}
+
+void i2cBusBegin(uint8_t sda, uint8_t scl)
+{
+  sdaPin = sda;
+  sclPin = scl;
+  memset(devices, 0, sizeof(devices));
+  for (int i = 0; i < I2C_DEVICE_COUNT; i++)
+    devices[i].clock = I2C_CLOCK_HZ;
+  recoverBus();
+  Wire.setClock(I2C_CLOCK_HZ);
+}
+
+// One attempt of a transfer, counted from what Wire reports. The address
+// byte is on the wire even when it is not acknowledged.
+static uint8_t transferOnce(I2cDevice device, uint8_t address, const uint8_t *command, size_t commandLength,
+                            const uint8_t *data, size_t length, uint8_t *in, size_t inLength)
+{
+  I2cDeviceStats &stats = devices[device];
+  Wire.setClock(stats.clock); // drivers set their own in between, e.g. Adafruit_SSD1306
+  uint32_t start = micros();
+  uint8_t status = 0;
+  if (commandLength + length > 0 || inLength == 0)
+  {
+    Wire.beginTransmission(address);
+    Wire.write(command, commandLength);
+    Wire.write(data, length);
+    status = Wire.endTransmission(inLength == 0); // repeated start before a read
+    stats.transactions++;
+    stats.bytes += 1 + (status == 0 ? commandLength + length : 0);
+  }
+  if (status == 0 && inLength > 0)
+  {
+    size_t received = Wire.requestFrom(address, inLength);
+    for (size_t i = 0; i < received; i++)
+      in[i] = Wire.read();
+    stats.transactions++;
+    stats.bytes += 1 + received;
+    if (received != inLength)
+      status = I2C_SHORT_READ;
+  }
+  stats.busyUs += micros() - start;
+  return status;
+}
+
+static uint8_t transfer(I2cDevice device, uint8_t address, const uint8_t *command, size_t commandLength,
+                        const uint8_t *data, size_t length, uint8_t *in, size_t inLength)
+{
+  uint8_t status = transferOnce(device, address, command, commandLength, data, length, in, inLength);
+  if (status != 0)
+  {
+    failed(device);
+    status = transferOnce(device, address, command, commandLength, data, length, in, inLength);
+    if (status != 0)
+      failed(device);
+  }
+  return status;
+}
+
+uint8_t i2cBusWrite(I2cDevice device, uint8_t address, uint8_t control, const uint8_t *data, size_t length)
+{
+  return transfer(device, address, &control, 1, data, length, nullptr, 0);
+}
+
+uint8_t i2cBusRead(I2cDevice device, uint8_t address, uint8_t *data, size_t length)
+{
+  return transfer(device, address, nullptr, 0, nullptr, 0, data, length);
+}
+
+uint8_t i2cBusReadRegisters(I2cDevice device, uint8_t address, uint8_t reg, uint8_t *data, size_t length)
+{
+  return transfer(device, address, &reg, 1, nullptr, 0, data, length);
+}
+
+void i2cBusAcquire(I2cDevice device)
+{
+  Wire.setClock(devices[device].clock);
+  acquiredUs = micros();
+}
+
+bool i2cBusRelease(I2cDevice device, uint8_t address)
+{
+  devices[device].busyUs += micros() - acquiredUs;
+  return transfer(device, address, nullptr, 0, nullptr, 0, nullptr, 0) == 0;
+}
+
+const I2cDeviceStats &i2cBusStats(I2cDevice device)
+{
+  return devices[device];
+}
+
+const char *i2cBusDeviceName(I2cDevice device)
+{
+  return DEVICE_NAMES[device];
+}
+
+void i2cBusDump(Print &out)
+{
+  out.println("I2C device  transactions    bytes errors    busy ms    kHz");
+  for (int i = 0; i < I2C_DEVICE_COUNT; i++)
+  {
+    const I2cDeviceStats &stats = devices[i];
+    out.printf("%-11s %12u %8u %6u %10u %6u\n", DEVICE_NAMES[i], stats.transactions, stats.bytes, stats.errors,
+               stats.busyUs / 1000, stats.clock / 1000);
+  }
+}
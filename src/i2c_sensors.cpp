@@ -0,0 +1,114 @@
+#include "i2c_sensors.h"
+#include "i2c_bus.h"
+#include <math.h>
+
+#define BMP280_CHIP_ID 0x58
+#define BMP280_REG_TRIMMING 0x88 // dig_T1 .. dig_P9, 24 bytes little endian
+#define BMP280_REG_ID 0xD0
+#define BMP280_REG_CTRL_MEAS 0xF4
+#define BMP280_REG_CONFIG 0xF5
+#define BMP280_REG_DATA 0xF7 // press_msb .. temp_xlsb
+#define BMP280_MODE_FORCED 0x01
+#define BMP280_SKIPPED 0x80000 // result of a disabled measurement
+
+static uint8_t bmpAddress = 0; // 0 until bmp280Begin() found the sensor
+static uint16_t digT1, digP1;
+static int16_t digT2, digT3, digP2, digP3, digP4, digP5, digP6, digP7, digP8, digP9;
+
+static Bh1750Mode lightMode = BH1750_ONE_TIME_HIGH_RES;
+
+bool bmp280Begin(uint8_t address)
+{
+  bmpAddress = 0;
+  uint8_t id;
+  if (i2cBusReadRegisters(I2C_BMP280, address, BMP280_REG_ID, &id, 1) != 0 || id != BMP280_CHIP_ID)
+    return false;
+
+  uint8_t t[24];
+  if (i2cBusReadRegisters(I2C_BMP280, address, BMP280_REG_TRIMMING, t, sizeof(t)) != 0)
+    return false;
+  auto u16 = [&t](int i) { return (uint16_t)(t[i] | t[i + 1] << 8); };
+  digT1 = u16(0);
+  digT2 = (int16_t)u16(2);
+  digT3 = (int16_t)u16(4);
+  digP1 = u16(6);
+  digP2 = (int16_t)u16(8);
+  digP3 = (int16_t)u16(10);
+  digP4 = (int16_t)u16(12);
+  digP5 = (int16_t)u16(14);
+  digP6 = (int16_t)u16(16);
+  digP7 = (int16_t)u16(18);
+  digP8 = (int16_t)u16(20);
+  digP9 = (int16_t)u16(22);
+  bmpAddress = address;
+  return true;
+}
+
+bool bmp280StartForced(Bmp280Sampling temp, Bmp280Sampling pres)
+{
+  if (!bmpAddress)
+    return false;
+  // Filter off, then ctrl_meas, whose forced mode starts the conversion
+  const uint8_t regs[] = {0x00, BMP280_REG_CTRL_MEAS,
+                          (uint8_t)(temp << 5 | pres << 2 | BMP280_MODE_FORCED)};
+  return i2cBusWrite(I2C_BMP280, bmpAddress, BMP280_REG_CONFIG, regs, sizeof(regs)) == 0;
+}
+
+// Compensation in integer arithmetic, from the datasheet (section 3.11.3).
+// t_fine carries the temperature into the pressure formula.
+static int32_t compensateTemperature(int32_t adc, int32_t &fine)
+{
+  int32_t var1 = (((adc >> 3) - ((int32_t)digT1 << 1)) * digT2) >> 11;
+  int32_t var2 = (((((adc >> 4) - (int32_t)digT1) * ((adc >> 4) - (int32_t)digT1)) >> 12) * digT3) >> 14;
+  fine = var1 + var2;
+  return (fine * 5 + 128) >> 8; // 0.01 °C
+}
+
+static uint32_t compensatePressure(int32_t adc, int32_t fine)
+{
+  int64_t var1 = (int64_t)fine - 128000;
+  int64_t var2 = var1 * var1 * digP6;
+  var2 += (var1 * digP5) * 131072;
+  var2 += (int64_t)digP4 * 34359738368;
+  var1 = ((var1 * var1 * digP3) >> 8) + ((var1 * digP2) * 4096);
+  var1 = ((int64_t)140737488355328 + var1) * digP1 >> 33;
+  if (var1 == 0)
+    return 0; // avoid a division by zero
+  int64_t p = 1048576 - adc;
+  p = ((p * 2147483648) - var2) * 3125 / var1;
+  var1 = ((int64_t)digP9 * (p >> 13) * (p >> 13)) >> 25;
+  var2 = ((int64_t)digP8 * p) >> 19;
+  return (uint32_t)(((p + var1 + var2) >> 8) + ((int64_t)digP7 << 4)); // Pa in Q24.8
+}
+
+bool bmp280Read(float &temp, float &pres)
+{
+  uint8_t d[6];
+  if (!bmpAddress || i2cBusReadRegisters(I2C_BMP280, bmpAddress, BMP280_REG_DATA, d, sizeof(d)) != 0)
+    return false;
+  int32_t adcP = (int32_t)d[0] << 12 | d[1] << 4 | d[2] >> 4;
+  int32_t adcT = (int32_t)d[3] << 12 | d[4] << 4 | d[5] >> 4;
+  if (adcT == BMP280_SKIPPED || adcP == BMP280_SKIPPED)
+    return false;
+  int32_t fine;
+  temp = compensateTemperature(adcT, fine) / 100.0f;
+  pres = compensatePressure(adcP, fine) / 256.0f;
+  return true;
+}
+
+bool bh1750Start(Bh1750Mode mode)
+{
+  lightMode = mode;
+  return i2cBusWrite(I2C_BH1750, BH1750_ADDRESS, mode, nullptr, 0) == 0;
+}
+
+float bh1750Read()
+{
+  uint8_t d[2];
+  if (i2cBusRead(I2C_BH1750, BH1750_ADDRESS, d, sizeof(d)) != 0)
+    return NAN;
+  float counts = (uint16_t)(d[0] << 8 | d[1]);
+  if (lightMode == BH1750_ONE_TIME_HIGH_RES_2)
+    counts /= 2; // half a count per lux step
+  return counts / 1.2f; // default measurement time register
+}
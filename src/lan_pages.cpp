@@ -0,0 +1,236 @@
+#include "lan_pages.h"
+#include "fixed_format.h"
+#include "memory_budget.h"
+#include <string.h>
+
+static char metrics[LAN_METRICS_SIZE];
+static char json[LAN_JSON_SIZE];
+static size_t metricsLength = 0;
+static size_t jsonLength = 0;
+static const char *lastName = nullptr;
+static uint8_t depth = 0;     // open JSON objects
+static uint8_t skipped = 0;   // objects left out, their members are dropped too
+static bool comma[LAN_JSON_DEPTH];
+static uint32_t dropped = 0;  // in the last build
+static uint32_t requests = 0;
+
+static_assert(sizeof(metrics) + sizeof(json) + 64 <= RAM_BUDGET_LAN, "LAN pages over their RAM budget");
+
+// Text appended to a document, nothing is kept unless all of it fits
+struct Writer
+{
+  char *text;
+  size_t limit;
+  size_t length;
+  bool ok;
+};
+
+static void put(Writer &w, const char *s, size_t n)
+{
+  if (!w.ok || w.length + n > w.limit)
+  {
+    w.ok = false;
+    return;
+  }
+  memcpy(w.text + w.length, s, n);
+  w.length += n;
+}
+
+static void put(Writer &w, const char *s)
+{
+  put(w, s, strlen(s));
+}
+
+static void putCount(Writer &w, uint64_t value)
+{
+  char digits[20];
+  size_t n = 0;
+  do
+  {
+    digits[sizeof(digits) - 1 - n++] = '0' + value % 10;
+    value /= 10;
+  } while (value);
+  put(w, digits + sizeof(digits) - n, n);
+}
+
+static void putNumber(Writer &w, float value, uint8_t decimals, const char *none)
+{
+  char text[16];
+  size_t n = formatFixed(text, sizeof(text), value, decimals, "");
+  if (strcmp(text, "--") == 0)
+    put(w, none);
+  else
+    put(w, text, n);
+}
+
+void lanPagesBegin()
+{
+  metricsLength = 0;
+  lastName = nullptr;
+  json[0] = '{';
+  jsonLength = 1;
+  depth = 1;
+  skipped = 0;
+  comma[0] = false;
+  dropped = 0;
+}
+
+// --- /metrics ---------------------------------------------------------------
+
+static Writer metricHead(const char *name, const char *type, const char *help, const char *labels)
+{
+  Writer w = {metrics, LAN_METRICS_SIZE, metricsLength, true};
+  if (!lastName || strcmp(lastName, name) != 0)
+  {
+    put(w, "# HELP ");
+    put(w, name);
+    put(w, " ");
+    put(w, help);
+    put(w, "\n# TYPE ");
+    put(w, name);
+    put(w, " ");
+    put(w, type);
+    put(w, "\n");
+  }
+  put(w, name);
+  if (labels)
+  {
+    put(w, "{");
+    put(w, labels);
+    put(w, "}");
+  }
+  put(w, " ");
+  return w;
+}
+
+static void metricEnd(Writer &w, const char *name)
+{
+  put(w, "\n");
+  if (!w.ok)
+  {
+    dropped++;
+    return;
+  }
+  metricsLength = w.length;
+  lastName = name;
+}
+
+void lanMetric(const char *name, const char *type, const char *help, const char *labels, float value,
+               uint8_t decimals)
+{
+  Writer w = metricHead(name, type, help, labels);
+  putNumber(w, value, decimals, "NaN");
+  metricEnd(w, name);
+}
+
+void lanMetricCount(const char *name, const char *type, const char *help, const char *labels, uint64_t value)
+{
+  Writer w = metricHead(name, type, help, labels);
+  putCount(w, value);
+  metricEnd(w, name);
+}
+
+// --- /json ------------------------------------------------------------------
+
+// Room is kept for the closing braces of the objects open after this member
+static Writer jsonMember(const char *key, uint8_t opens)
+{
+  Writer w = {json, (size_t)(LAN_JSON_SIZE - depth - opens), jsonLength, skipped == 0};
+  if (comma[depth - 1])
+    put(w, ",");
+  put(w, "\"");
+  put(w, key);
+  put(w, "\":");
+  return w;
+}
+
+static void jsonEnd(Writer &w)
+{
+  if (!w.ok)
+  {
+    dropped++;
+    return;
+  }
+  jsonLength = w.length;
+  comma[depth - 1] = true;
+}
+
+void lanJsonObject(const char *key)
+{
+  Writer w = jsonMember(key, 1);
+  put(w, "{");
+  if (depth == LAN_JSON_DEPTH)
+    w.ok = false;
+  jsonEnd(w);
+  if (w.ok)
+    comma[depth++] = false;
+  else
+    skipped++;
+}
+
+void lanJsonClose()
+{
+  if (skipped > 0)
+  {
+    skipped--;
+    return;
+  }
+  if (depth > 1)
+  {
+    json[jsonLength++] = '}';
+    depth--;
+  }
+}
+
+void lanJsonNumber(const char *key, float value, uint8_t decimals)
+{
+  Writer w = jsonMember(key, 0);
+  putNumber(w, value, decimals, "null");
+  jsonEnd(w);
+}
+
+void lanJsonCount(const char *key, uint64_t value)
+{
+  Writer w = jsonMember(key, 0);
+  putCount(w, value);
+  jsonEnd(w);
+}
+
+void lanJsonString(const char *key, const char *value)
+{
+  Writer w = jsonMember(key, 0);
+  put(w, "\"");
+  put(w, value);
+  put(w, "\"");
+  jsonEnd(w);
+}
+
+void lanPagesEnd()
+{
+  skipped = 0;
+  while (depth > 0)
+  {
+    json[jsonLength++] = '}';
+    depth--;
+  }
+}
+
+const char *lanMetricsText(size_t &length)
+{
+  requests++;
+  length = metricsLength;
+  return metrics;
+}
+
+const char *lanJsonText(size_t &length)
+{
+  requests++;
+  length = jsonLength;
+  return json;
+}
+
+void lanPagesDump(Print &out)
+{
+  out.printf("LAN pages /metrics %u of %u bytes, /json %u of %u bytes, %u left out, %u requests\n",
+             (unsigned)metricsLength, LAN_METRICS_SIZE, (unsigned)jsonLength, LAN_JSON_SIZE, dropped, requests);
+}
@@ -0,0 +1,154 @@
+#include "lan_server.h"
+#include "lan_pages.h"
+#include "memory_budget.h"
+#include <ESP8266WiFi.h>
+#include <string.h>
+
+static WiFiServer server(0);
+static const LanRoute *routes = nullptr;
+static uint8_t routeCount = 0;
+static char request[LAN_REQUEST_SIZE]; // request line, then the response head
+static uint32_t served = 0;
+static uint32_t rejected = 0; // timed out, malformed or not a GET
+
+// The request in progress, it may take several polls to arrive
+static WiFiClient client;
+static bool reading = false;
+static unsigned long readStart = 0;
+static size_t readLength = 0;   // of the request line so far
+static bool lineDone = false;   // past the request line, skipping headers
+static uint16_t lineLength = 0; // of the current line, CR left out
+
+#define REQUEST_PENDING ((size_t)-1)
+
+static_assert(LAN_METRICS_SIZE + LAN_JSON_SIZE + 64 + sizeof(request) <= RAM_BUDGET_LAN,
+              "LAN pages and request buffer over their RAM budget");
+
+void lanServerBegin(uint16_t port, const LanRoute *newRoutes, uint8_t count)
+{
+  routes = newRoutes;
+  routeCount = count;
+  server.begin(port);
+}
+
+// Read what has arrived: the request line into request, the header lines
+// skipped up to the blank one. Returns the length of the line, 0 if the
+// request did not arrive in time, sizeof(request) if the line does not
+// fit and REQUEST_PENDING if the rest is still on its way.
+static size_t readRequest()
+{
+  while (true)
+  {
+    int c = client.read();
+    if (c < 0)
+    {
+      if (!client.connected() || millis() - readStart > LAN_REQUEST_TIMEOUT_MS)
+        return 0;
+      return REQUEST_PENDING;
+    }
+    if (c == '\n')
+    {
+      if (lineDone && lineLength == 0)
+        return readLength;
+      lineDone = true;
+      lineLength = 0;
+    }
+    else if (c != '\r')
+    {
+      if (!lineDone)
+      {
+        if (readLength < sizeof(request) - 1)
+          request[readLength] = c;
+        readLength++;
+      }
+      lineLength++;
+    }
+  }
+}
+
+static void respond(int status, const char *reason, const char *contentType, const char *body, size_t length)
+{
+  int n = snprintf(request, sizeof(request),
+                   "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %u\r\nConnection: close\r\n\r\n", status,
+                   reason, contentType, (unsigned)length);
+  client.write((const uint8_t *)request, n);
+  client.write((const uint8_t *)body, length);
+}
+
+static void respondText(int status, const char *reason, const char *text)
+{
+  respond(status, reason, "text/plain", text, strlen(text));
+}
+
+bool lanServerPoll()
+{
+  if (!reading)
+  {
+    client = server.accept();
+    if (!client)
+      return false;
+    reading = true;
+    readStart = millis();
+    readLength = 0;
+    lineDone = false;
+    lineLength = 0;
+  }
+
+  size_t length = readRequest();
+  if (length == REQUEST_PENDING)
+    return false;
+  reading = false;
+  if (length == 0)
+  {
+    rejected++;
+    client.stop();
+    return true;
+  }
+  if (length >= sizeof(request))
+  {
+    rejected++;
+    respondText(414, "URI Too Long", "request line too long\n");
+    client.stop();
+    return true;
+  }
+  request[length] = '\0';
+
+  // "GET /metrics HTTP/1.1", a query string is ignored
+  if (strncmp(request, "GET ", 4) != 0)
+  {
+    rejected++;
+    respondText(405, "Method Not Allowed", "GET only\n");
+    client.stop();
+    return true;
+  }
+  const char *path = request + 4;
+  size_t pathLength = strcspn(path, " ?");
+
+  const LanRoute *route = nullptr;
+  for (uint8_t i = 0; i < routeCount; i++)
+  {
+    if (strlen(routes[i].path) == pathLength && strncmp(routes[i].path, path, pathLength) == 0)
+      route = &routes[i];
+  }
+  if (!route)
+  {
+    respondText(404, "Not Found", "not found\n");
+  }
+  else
+  {
+    size_t textLength;
+    const char *text = route->text(textLength);
+    if (textLength == 0)
+      respondText(503, "Service Unavailable", "no reading yet\n");
+    else
+      respond(200, "OK", route->contentType, text, textLength);
+  }
+  served++;
+  client.stop();
+  return true;
+}
+
+void lanServerDump(Print &out)
+{
+  out.printf("LAN server %u requests, %u rejected\n", served, rejected);
+}
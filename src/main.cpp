@@ -1,42 +1,687 @@
 // Optimized senseBox ESP8266 sketch - low power mode with 1min updates
+// (left out of the unit test builds, they link the modules on their own)
+#ifndef PIO_UNIT_TESTING
 #include <ESP8266WiFi.h>
-#include <WiFiClientSecure.h>
-#include <Adafruit_BMP280.h>
 #include <Adafruit_SSD1306.h>
 #include <Wire.h>
-#include <ArduinoJson.h>
 #include <time.h>
 #include <OneWire.h>
 #include <DallasTemperature.h>
-#include <BH1750.h>
+#include <coredecls.h>
+#include "arena.h"
+#include "crc32.h"
+#include "display_regions.h"
+#include "fixed_format.h"
+#include "http_client.h"
+#include "i2c_bus.h"
+#include "i2c_sensors.h"
+#include "lan_pages.h"
+#include "lan_server.h"
+#include "log.h"
+#include "memory_budget.h"
+#include "mqtt_client.h"
+#include "pressure_history.h"
+#include "publisher.h"
+#include "scheduler.h"
+#include "sensor_history.h"
+#include "sensor_stats.h"
+#include "sensors.h"
+#include "sbx_encoder.h"
+#include "stats_csv_parser.h"
+#include "telemetry.h"
+#include "time_sync.h"
+#include "upload_policy.h"
+#include "upload_queue.h"
 
 #define SCREEN_WIDTH 128
 #define SCREEN_HEIGHT 64
 #define OLED_RESET -1
+#define OLED_ADDRESS 0x3C
 Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET);
 
-Adafruit_BMP280 bmp;
+// The library's init sequence does not check what Wire reports, the bus
+// manager checks that the controller answers afterwards
+bool beginDisplay()
+{
+  i2cBusAcquire(I2C_SSD1306);
+  bool ok = display.begin(SSD1306_SWITCHCAPVCC, OLED_ADDRESS);
+  return i2cBusRelease(I2C_SSD1306, OLED_ADDRESS) && ok;
+}
+
+void displayCommand(uint8_t command)
+{
+  i2cBusWrite(I2C_SSD1306, OLED_ADDRESS, 0x00, &command, 1); // control byte: a command follows
+}
+
+// Show seconds on the clock (redraws once per second, not with deep sleep)
+#ifndef CLOCK_SHOW_SECONDS
+#define CLOCK_SHOW_SECONDS 0
+#endif
+
+// The main screen is made of widgets that only redraw and flush what
+// changed, see display_regions.h. Text sits on whole 8 pixel pages so the
+// glyphs can be copied into the frame buffer.
+enum
+{
+  WIDGET_DATE,
+  WIDGET_TIME,
+  WIDGET_TEMP,
+  WIDGET_PRES,
+  WIDGET_TEMP_OUT,
+  WIDGET_LUX,
+  WIDGET_COUNT
+};
+
+#define TREND_ARROW_X 2 // small margin from the edge
+#define TREND_ARROW_Y 2
+
+#if CLOCK_SHOW_SECONDS
+#define TIME_WIDGET_X 18 // "hh:mm:ss" is 96 px wide, keep clear of the trend arrow
+#else
+#define TIME_WIDGET_X 0
+#endif
+
+TextWidget widgets[WIDGET_COUNT] = {
+    {0, 0, SCREEN_WIDTH, 1, true},
+    {TIME_WIDGET_X, 2, SCREEN_WIDTH - TIME_WIDGET_X, 2, true},
+    {0, 5, 64, 1, false},
+    {64, 5, 64, 1, false},
+    {0, 7, 64, 1, false},
+    {64, 7, 64, 1, false}};
+DisplayRegions displayRegions;
+bool displayLayoutValid = false; // cleared by full-screen messages
+bool displayOn = true;
+int shownTrend = -1;
+uint32_t displayLastBytes = 0;
+uint32_t displayFlushes = 0;
+uint32_t displayTotalBytes = 0;
+
+// Pages sent per display step. A full frame takes 4 steps, a sensor read
+// that falls due meanwhile gets the bus after at most 2 pages (~7 ms at
+// 400 kHz) instead of after the whole 1 KB.
+#define DISPLAY_FLUSH_PAGES 2
+
+// Every few minutes the screen shows the recent history of each shown
+// sensor for a minute: a band from the minimum to the maximum of each
+// column, read from the flash history (sensor_history.h). 0 hours turns
+// the graph pages off.
+#ifndef DISPLAY_GRAPH_HOURS
+#define DISPLAY_GRAPH_HOURS 24
+#endif
+#define DISPLAY_MAIN_MINUTES 4 // main screen minutes before the graphs
+#define GRAPH_TOP 10
+#define GRAPH_BOTTOM 53
+
+#if DISPLAY_GRAPH_HOURS
+struct GraphColumns
+{
+  uint32_t from; // epoch time of the left edge
+  uint8_t sensor;
+  float min[SCREEN_WIDTH];
+  float max[SCREEN_WIDTH];
+};
+GraphColumns graphColumns; // 1 KB, kept off the stack
+int shownPage = -1;        // SensorIndex of the graph on the screen, -1 for the main screen
+static_assert(sizeof(widgets) + sizeof(displayRegions) + sizeof(graphColumns) <= RAM_BUDGET_DISPLAY,
+              "display state over its RAM budget");
+#else
+static_assert(sizeof(widgets) + sizeof(displayRegions) <= RAM_BUDGET_DISPLAY, "display state over its RAM budget");
+#endif
+
 OneWire oneWire(0); // D3 (GPIO 0)
 DallasTemperature ds18b20(&oneWire);
-BH1750 lightMeter;
+#define DS18B20_RESET_C 85.0f // scratchpad after power-on, before the first conversion
+// Found once at cold boot, reads select the probe by ROM code instead of
+// searching the bus. Family code 0 marks a missing probe.
+DeviceAddress ds18b20Addresses[DS18B20_PROBE_COUNT];
+bool ds18b20Ok = false; // any probe found
+
+// Acquisition latency, from starting the conversions to having all values
+uint32_t acquisitionStartUs = 0;
+uint32_t acquisitionLastUs = 0;
+uint32_t acquisitionMaxUs = 0;
+uint32_t acquisitionReadUs = 0; // bus time of the collect step alone
 
 #include "secrets.h"
 #define HOST "ingress.opensensemap.org"
+#define API_HOST "api.opensensemap.org"
+
+// Constant parts of the upload request, concatenated at compile time
+#define OSEM_UPLOAD_PATH "/boxes/" OSEM_BOX_ID "/data"
+#define OSEM_AUTH_HEADER "Authorization: " OSEM_AUTH "\r\n"
+
+// Upload body encoding, select with build_flags = -DUPLOAD_ENCODING=...
+// SBX sends 16/20 bytes per measurement instead of ~90 bytes of JSON. It uses
+// sbx-bytes-ts when every reading is timestamped, else sbx-bytes for a single
+// reading and JSON for an unstamped batch (only before the first NTP sync).
+#define UPLOAD_ENCODING_JSON 0
+#define UPLOAD_ENCODING_SBX 1
+#ifndef UPLOAD_ENCODING
+#define UPLOAD_ENCODING UPLOAD_ENCODING_JSON
+#endif
+
+// Encoding of one request body
+enum
+{
+  BODY_JSON,
+  BODY_SBX,
+  BODY_SBX_TS
+};
+
+const char *const UPLOAD_HEADERS[] = {
+    OSEM_AUTH_HEADER "Content-Type: application/json\r\n",
+    OSEM_AUTH_HEADER "Content-Type: application/sbx-bytes\r\n",
+    OSEM_AUTH_HEADER "Content-Type: application/sbx-bytes-ts\r\n"};
+
+// Heap low-water mark, fragmentation high-water mark and the last WiFi join
+// time as three extra box sensors, sent with the first request of a session.
+// The sensors have to be created on openSenseMap and added to secrets.h.
+#ifndef TELEMETRY_UPLOAD
+#define TELEMETRY_UPLOAD 0
+#endif
+#if TELEMETRY_UPLOAD
+#if !defined(SENSOR_ID_HEAP_FREE) || !defined(SENSOR_ID_HEAP_FRAGMENTATION) || !defined(SENSOR_ID_WIFI_JOIN)
+#error "TELEMETRY_UPLOAD needs SENSOR_ID_HEAP_FREE, SENSOR_ID_HEAP_FRAGMENTATION and SENSOR_ID_WIFI_JOIN in secrets.h"
+#endif
+#if UPLOAD_ENCODING == UPLOAD_ENCODING_SBX
+#error "TELEMETRY_UPLOAD is only supported with JSON uploads"
+#endif
+#endif
+
+// A reading is queued every upload interval. The upload policy decides
+// when the queue is sent as bulk requests in one WiFi session:
+//   FIXED     every UPLOAD_BATCH_INTERVALS intervals
+//   ADAPTIVE  when a sensor moved past its deadband or rate in the SENSORS
+//             table, at least every UPLOAD_HEARTBEAT_MS (upload_policy.h)
+// Without a working queue every reading is sent right away.
+#define UPLOAD_INTERVAL_MS 600000
+#define UPLOAD_POLICY_FIXED 0
+#define UPLOAD_POLICY_ADAPTIVE 1
+#ifndef UPLOAD_POLICY
+#define UPLOAD_POLICY UPLOAD_POLICY_ADAPTIVE
+#endif
+#ifndef UPLOAD_BATCH_INTERVALS
+#define UPLOAD_BATCH_INTERVALS 1
+#endif
+#ifndef UPLOAD_HEARTBEAT_MS
+#define UPLOAD_HEARTBEAT_MS 3600000
+#endif
+#if UPLOAD_POLICY != UPLOAD_POLICY_FIXED && UPLOAD_POLICY != UPLOAD_POLICY_ADAPTIVE
+#error "UPLOAD_POLICY must be UPLOAD_POLICY_FIXED or UPLOAD_POLICY_ADAPTIVE"
+#endif
+#define UPLOAD_BATCH_RECORDS 8 // readings per request (4 measurements each)
+#define UPLOAD_MAX_REQUESTS 6  // per session, the rest waits for the next one
+
+// Where the readings go, see publisher.h. openSenseMap is the one the
+// queue follows: a batch leaves it once openSenseMap accepted it, the
+// mirrors get it alongside (a batch sent again is overwritten in InfluxDB,
+// the points carry the same timestamps). Without openSenseMap a batch
+// leaves the queue once a mirror took it. The mirrors' hosts go in
+// secrets.h, e.g. #define MQTT_HOST "192.168.178.10".
+#ifndef PUBLISH_OSEM
+#define PUBLISH_OSEM 1
+#endif
+#ifndef PUBLISH_MQTT
+#define PUBLISH_MQTT 0
+#endif
+#ifndef PUBLISH_INFLUX_HTTP
+#define PUBLISH_INFLUX_HTTP 0
+#endif
+#ifndef PUBLISH_INFLUX_UDP
+#define PUBLISH_INFLUX_UDP 0
+#endif
+#if PUBLISH_MQTT && !defined(MQTT_HOST)
+#error "PUBLISH_MQTT needs MQTT_HOST in secrets.h"
+#endif
+#if (PUBLISH_INFLUX_HTTP || PUBLISH_INFLUX_UDP) && !defined(INFLUX_HOST)
+#error "PUBLISH_INFLUX_HTTP and PUBLISH_INFLUX_UDP need INFLUX_HOST in secrets.h"
+#endif
+#if !PUBLISH_OSEM && !PUBLISH_MQTT && !PUBLISH_INFLUX_HTTP && !PUBLISH_INFLUX_UDP
+#error "Nothing to publish to, enable PUBLISH_OSEM or a mirror"
+#endif
+#ifndef MQTT_HOST
+#define MQTT_HOST ""
+#endif
+#ifndef MQTT_PORT
+#define MQTT_PORT 1883
+#endif
+#ifndef MQTT_TOPIC
+#define MQTT_TOPIC "sensebox/" OSEM_BOX_ID
+#endif
+#ifndef MQTT_CLIENT_ID
+#define MQTT_CLIENT_ID "sensebox-" OSEM_BOX_ID
+#endif
+#ifndef MQTT_USER
+#define MQTT_USER nullptr
+#endif
+#ifndef MQTT_PASS
+#define MQTT_PASS nullptr
+#endif
+#ifndef INFLUX_HOST
+#define INFLUX_HOST ""
+#endif
+#ifndef INFLUX_PORT
+#define INFLUX_PORT 8086
+#endif
+#ifndef INFLUX_UDP_PORT
+#define INFLUX_UDP_PORT 8089
+#endif
+#ifndef INFLUX_WRITE_PATH
+#define INFLUX_WRITE_PATH "/api/v2/write?org=sensebox&bucket=sensebox&precision=s"
+#endif
+#ifdef INFLUX_TOKEN
+#define INFLUX_HEADERS "Authorization: Token " INFLUX_TOKEN "\r\n"
+#else
+#define INFLUX_HEADERS nullptr
+#endif
+#define LINE_PROTOCOL_PREFIX "sensebox,box=" OSEM_BOX_ID
+
+const MirrorDef MIRRORS[] = {
+    {PUBLISH_MQTT, "mqtt", MIRROR_MQTT, MQTT_HOST, MQTT_PORT, MQTT_TOPIC, MQTT_USER, MQTT_PASS},
+    {PUBLISH_INFLUX_HTTP, "influx", MIRROR_HTTP, INFLUX_HOST, INFLUX_PORT, INFLUX_WRITE_PATH, INFLUX_HEADERS, nullptr},
+    {PUBLISH_INFLUX_UDP, "udp", MIRROR_UDP, INFLUX_HOST, INFLUX_UDP_PORT, nullptr, nullptr, nullptr}};
+
+#define SENSOR_INTERVAL_MS 60000
+
+// Sensor profiles: resolution and oversampling of all three sensors.
+// The conversions run side by side, so the slowest one sets the latency.
+//   LOW_POWER  DS18B20  9 bit,  BMP280 T x1 P x1,  BH1750 low res     ~94 ms
+//   BALANCED   DS18B20 11 bit,  BMP280 T x2 P x4,  BH1750 high res   ~375 ms
+//   PRECISE    DS18B20 12 bit,  BMP280 T x2 P x16, BH1750 high res 2 ~750 ms
+// Single settings can still be overridden, e.g. -DDS18B20_RESOLUTION=10
+#define SENSOR_PROFILE_LOW_POWER 0
+#define SENSOR_PROFILE_BALANCED 1
+#define SENSOR_PROFILE_PRECISE 2
+#ifndef SENSOR_PROFILE
+#define SENSOR_PROFILE SENSOR_PROFILE_PRECISE
+#endif
+
+#if SENSOR_PROFILE == SENSOR_PROFILE_LOW_POWER
+#define PROFILE_DS18B20_RESOLUTION 9
+#define PROFILE_BMP280_TEMP_OVERSAMPLING BMP280_SAMPLING_X1
+#define PROFILE_BMP280_PRES_OVERSAMPLING BMP280_SAMPLING_X1
+#define PROFILE_BH1750_MODE BH1750_ONE_TIME_LOW_RES
+#elif SENSOR_PROFILE == SENSOR_PROFILE_BALANCED
+#define PROFILE_DS18B20_RESOLUTION 11
+#define PROFILE_BMP280_TEMP_OVERSAMPLING BMP280_SAMPLING_X2
+#define PROFILE_BMP280_PRES_OVERSAMPLING BMP280_SAMPLING_X4
+#define PROFILE_BH1750_MODE BH1750_ONE_TIME_HIGH_RES
+#else
+#define PROFILE_DS18B20_RESOLUTION 12
+#define PROFILE_BMP280_TEMP_OVERSAMPLING BMP280_SAMPLING_X2
+#define PROFILE_BMP280_PRES_OVERSAMPLING BMP280_SAMPLING_X16
+#define PROFILE_BH1750_MODE BH1750_ONE_TIME_HIGH_RES_2
+#endif
+
+#ifndef DS18B20_RESOLUTION
+#define DS18B20_RESOLUTION PROFILE_DS18B20_RESOLUTION
+#endif
+#ifndef BMP280_TEMP_OVERSAMPLING
+#define BMP280_TEMP_OVERSAMPLING PROFILE_BMP280_TEMP_OVERSAMPLING
+#endif
+#ifndef BMP280_PRES_OVERSAMPLING
+#define BMP280_PRES_OVERSAMPLING PROFILE_BMP280_PRES_OVERSAMPLING
+#endif
+#ifndef BH1750_MODE
+#define BH1750_MODE PROFILE_BH1750_MODE
+#endif
+
+static_assert(DS18B20_RESOLUTION >= 9 && DS18B20_RESOLUTION <= 12, "DS18B20_RESOLUTION must be 9..12");
+static_assert(BH1750_MODE == BH1750_ONE_TIME_LOW_RES || BH1750_MODE == BH1750_ONE_TIME_HIGH_RES ||
+                  BH1750_MODE == BH1750_ONE_TIME_HIGH_RES_2,
+              "BH1750_MODE must be one of the Bh1750Mode values");
+
+// Worst case conversion times from the datasheets
+constexpr uint32_t ds18b20ConversionMs(int resolution)
+{
+  return resolution == 9 ? 94 : resolution == 10 ? 188 : resolution == 11 ? 375 : 750;
+}
+
+constexpr uint32_t bmp280ConversionMs(Bmp280Sampling temp, Bmp280Sampling pres)
+{
+  // 1.25 ms + 2.3 ms per temperature sample + 2.3 ms per pressure sample + 0.575 ms, rounded up
+  return (1250 + 2300 * (1 << (temp - 1)) + 2300 * (1 << (pres - 1)) + 575 + 999) / 1000;
+}
+
+constexpr uint32_t bh1750ConversionMs(Bh1750Mode mode)
+{
+  return mode == BH1750_ONE_TIME_LOW_RES ? 24 : 180;
+}
+
+constexpr uint32_t maxMs(uint32_t a, uint32_t b)
+{
+  return a > b ? a : b;
+}
+
+constexpr uint32_t SENSOR_CONVERSION_MS =
+    maxMs(ds18b20ConversionMs(DS18B20_RESOLUTION),
+          maxMs(bmp280ConversionMs(BMP280_TEMP_OVERSAMPLING, BMP280_PRES_OVERSAMPLING),
+                bh1750ConversionMs(BH1750_MODE)));
+#define NTP_TIMEOUT_MS 10000 // per sync attempt
+#define TIMEZONE "CET-1CEST,M3.5.0,M10.5.0/3"
+#define BACKFILL_PATH_SIZE 256 // statistics API query, from the arena
+
+// The network task is the only arena user. Its deepest request holds the
+// query or an upload batch under the HTTP client's buffers.
+static_assert(maxMs(BACKFILL_PATH_SIZE, UPLOAD_BATCH_RECORDS * sizeof(QueuedReading)) + HTTP_HEAD_SIZE +
+                      HTTP_READ_SIZE <= ARENA_SIZE,
+              "ARENA_SIZE too small for a network request");
+
+// The clock is resynced when the error predicted from the measured drift
+// reaches TIME_SYNC_ERROR_MS (see time_sync.h). Until the drift is known,
+// and as the retry after a failed attempt, syncs are one session apart.
+#ifndef TIME_SYNC_ERROR_MS
+#define TIME_SYNC_ERROR_MS 1000
+#endif
+#define TIME_SYNC_MIN_INTERVAL_MS (UPLOAD_INTERVAL_MS * UPLOAD_BATCH_INTERVALS)
+#define TIME_SYNC_MAX_INTERVAL_MS (24 * 3600000UL)
+#define BOOT_SCREEN_MS 2000
+
+// Cooperative tasks, see scheduler.h. Each step is a small state machine
+// that returns instead of blocking; network waits yield to the other tasks.
+enum
+{
+  TASK_SENSOR,  // start conversions, collect them a moment later
+  TASK_DISPLAY, // redraw, woken by new readings or a synced clock
+  TASK_UPLOAD,  // queue a reading every upload interval
+  TASK_TREND,   // recompute the trend after each pressure sample
+  TASK_NTP,     // request a time sync when the clock error gets too large
+  TASK_NETWORK, // WiFi session running the requested network jobs
+  TASK_LAN,     // LAN mode: answer /metrics and /json, rejoin a lost WiFi
+  TASK_COUNT
+};
+
+uint32_t sensorStep();
+uint32_t displayStep();
+uint32_t uploadStep();
+uint32_t trendStep();
+uint32_t ntpStep();
+uint32_t networkStep();
+uint32_t lanStep();
+uint32_t schedulerMillis();
+uint32_t schedulerMicros();
+
+Task tasks[TASK_COUNT] = {
+    {"sensor", sensorStep},
+    {"display", displayStep},
+    {"upload", uploadStep},
+    {"trend", trendStep},
+    {"ntp", ntpStep},
+    {"network", networkStep},
+    {"lan", lanStep}};
+Scheduler scheduler = {tasks, TASK_COUNT, schedulerMillis, schedulerMicros};
+
+// Jobs for the next WiFi session, all run in one connection
+enum
+{
+  JOB_TIME_SYNC = 1,
+  JOB_UPLOAD = 2,
+  JOB_BACKFILL = 4,
+  JOB_LAN = 8 // nothing to do but to be connected
+};
+uint8_t networkJobs = 0;
 
-unsigned long lastSensorRead = 0;
-unsigned long lastDisplayUpdate = 0;
-unsigned long lastUpload = 0;
-unsigned long lastTimeSync = 0;
+TimeSync timeSync;
+volatile bool ntpAnswered = false; // set from the SNTP callback
 
 bool bmpOk = false;
-float currentTemp = 0.0;
-float currentPres = 0.0;
-float currentDS18B20 = 0.0;
-float currentLux = 0.0;
+bool queueOk = false;
+bool radioOff = false; // woke with WAKE_RF_DISABLED, WiFi needs another wake
+QueuedReading lastReading; // sent directly if the queue is unavailable
+float sensorValues[SENSOR_COUNT]; // calibrated, by SensorIndex
+SensorStats sensorStats[SENSOR_COUNT]; // samples since the last queued reading
+static_assert(sizeof(sensorValues) + sizeof(sensorStats) + sizeof(lastReading) + sizeof(ds18b20Addresses) <=
+                  RAM_BUDGET_SENSOR * SENSOR_COUNT,
+              "sensor state over its RAM budget");
+
+// Which DS18B20 is which. With several probes secrets.h lists them in
+// probe order as ROM code (16 hex digits, printed at boot) and sensor id:
+//   #define DS18B20_PROBES {"28FF641E0F1C3012", SENSOR_ID_TEMP_OUT}, {"28FF641E0F1C3129", "5f0a..."}
+// and build_flags has -DDS18B20_PROBE_COUNT=2. A single probe needs no
+// mapping, it is whatever is on the bus.
+struct Ds18b20Probe
+{
+  const char *rom;
+  const char *osemId;
+};
+
+#ifdef DS18B20_PROBES
+constexpr Ds18b20Probe PROBES[] = {DS18B20_PROBES};
+static_assert(sizeof(PROBES) / sizeof(PROBES[0]) == DS18B20_PROBE_COUNT,
+              "DS18B20_PROBES must have DS18B20_PROBE_COUNT entries");
+#else
+#if DS18B20_PROBE_COUNT > 1
+#error "DS18B20_PROBE_COUNT > 1 needs the DS18B20_PROBES mapping in secrets.h"
+#endif
+constexpr Ds18b20Probe PROBES[] = {{nullptr, SENSOR_ID_TEMP_OUT}};
+#endif
+
+// Line protocol field keys of the probes, see publisher.h
+constexpr const char *PROBE_FIELDS[] = {"temp_out", "probe_1", "probe_2", "probe_3",
+                                        "probe_4", "probe_5", "probe_6", "probe_7"};
+static_assert(DS18B20_PROBE_COUNT <= sizeof(PROBE_FIELDS) / sizeof(PROBE_FIELDS[0]),
+              "name the line protocol fields of the extra probes in PROBE_FIELDS");
+
+struct Ds18b20Roms
+{
+  uint8_t rom[DS18B20_PROBE_COUNT][8];
+};
+
+constexpr Ds18b20Roms decodeProbeRoms()
+{
+  Ds18b20Roms decoded = {};
+  for (int p = 0; p < DS18B20_PROBE_COUNT; p++)
+  {
+    for (int i = 0; PROBES[p].rom && i < 8; i++)
+    {
+      decoded.rom[p][i] = (sbxHexNibble(PROBES[p].rom[2 * i]) << 4) | sbxHexNibble(PROBES[p].rom[2 * i + 1]);
+    }
+  }
+  return decoded;
+}
+
+constexpr bool probeRomsValid()
+{
+  for (int p = 0; p < DS18B20_PROBE_COUNT; p++)
+  {
+    for (int i = 0; PROBES[p].rom && i < 17; i++)
+    {
+      if (i < 16 ? sbxHexNibble(PROBES[p].rom[i]) == 0xff : PROBES[p].rom[i] != '\0')
+        return false;
+    }
+  }
+  return true;
+}
+static_assert(probeRomsValid(), "DS18B20_PROBES ROM codes must be 16 hex digits");
+constexpr Ds18b20Roms PROBE_ROMS = decodeProbeRoms();
+
+// Raw value of a sensor, NAN if it did not deliver one. Each BMP280 value
+// is a burst read of both results, the pressure needs the temperature for
+// its compensation anyway.
+float readSensor(const SensorDef &def)
+{
+  float temp, pres;
+  switch (def.kind)
+  {
+  case SENSOR_KIND_BMP280_TEMP:
+    return bmpOk && bmp280Read(temp, pres) ? temp : NAN;
+  case SENSOR_KIND_BMP280_PRES:
+    return bmpOk && bmp280Read(temp, pres) ? pres : NAN;
+  case SENSOR_KIND_DS18B20:
+    if (ds18b20Addresses[def.channel][0] == 0)
+      return NAN;
+    temp = ds18b20.getTempC(ds18b20Addresses[def.channel]);
+    // 85 C is the power-on value of the scratchpad: the probe reset (a
+    // brown-out on the bus) and did not convert, it is not a reading
+    return temp == DEVICE_DISCONNECTED_C || temp == DS18B20_RESET_C ? NAN : temp;
+  case SENSOR_KIND_BH1750:
+    return bh1750Read();
+  }
+  return NAN;
+}
+
+// One row per SensorIndex, see sensors.h. The BMP280 sits on the board next
+// to the ESP and reads 4 K high. Probes after the first are not shown.
+// Light is not spike filtered, a passing cloud or shadow is real, and does
+// not trigger uploads: it changes all day.
+struct SensorTable
+{
+  SensorDef rows[SENSOR_COUNT];
+};
+
+constexpr SensorTable buildSensorTable()
+{
+  SensorTable table = {{
+      {SENSOR_KIND_BMP280_TEMP, 1.0f, -4.0f, SENSOR_ID_TEMP, 2, 2, " C", WIDGET_TEMP, PHASE_BMP280_READ, 0,
+       SENSOR_UPLOAD_MEAN, true, 0.5f, 1.0f, "Temp in", "temp"},
+      {SENSOR_KIND_BMP280_PRES, 0.01f, 0.0f, SENSOR_ID_PRES, 2, 2, " hPa", WIDGET_PRES, PHASE_BMP280_READ, 0,
+       SENSOR_UPLOAD_MEAN, true, 1.0f, 1.0f, "Pressure", "pressure"},
+      {SENSOR_KIND_DS18B20, 1.0f, 0.0f, PROBES[0].osemId, 2, 2, " C", WIDGET_TEMP_OUT, PHASE_DS18B20_READ, 0,
+       SENSOR_UPLOAD_MEAN, true, 1.0f, 2.0f, "Temp out", PROBE_FIELDS[0]},
+      {SENSOR_KIND_BH1750, 1.0f, 0.0f, SENSOR_ID_LUM, 2, 0, " lx", WIDGET_LUX, PHASE_BH1750_READ, 0,
+       SENSOR_UPLOAD_MEAN, false, 0.0f, 0.0f, "Light", "lux"},
+  }};
+  for (int p = 1; p < DS18B20_PROBE_COUNT; p++)
+  {
+    table.rows[SENSOR_PROBE_1 + p - 1] = {SENSOR_KIND_DS18B20, 1.0f, 0.0f, PROBES[p].osemId, 2, 2, " C",
+                                          SENSOR_NO_WIDGET, PHASE_DS18B20_READ, (uint8_t)p,
+                                          SENSOR_UPLOAD_MEAN, true, 1.0f, 2.0f, "Probe", PROBE_FIELDS[p]};
+  }
+  return table;
+}
+// SENSOR_TABLE is for the compile-time checks below, the firmware reads
+// the copy in flash
+constexpr SensorTable SENSOR_TABLE = buildSensorTable();
+const SensorTable SENSOR_ROWS PROGMEM = SENSOR_TABLE;
+const SensorDef *const SENSORS = SENSOR_ROWS.rows;
+
+#if UPLOAD_ENCODING == UPLOAD_ENCODING_SBX
+constexpr bool sensorIdsValid()
+{
+  for (int i = 0; i < SENSOR_COUNT; i++)
+  {
+    if (!sbxSensorIdValid(SENSOR_TABLE.rows[i].osemId))
+      return false;
+  }
+  return true;
+}
+static_assert(sensorIdsValid(), "SENSOR_ID_* must be 24 hex characters for binary uploads");
+
+// The ids decoded at compile time, by SensorIndex
+struct SbxSensorIds
+{
+  SbxSensorId ids[SENSOR_COUNT];
+};
+
+constexpr SbxSensorIds decodeSensorIds()
+{
+  SbxSensorIds decoded = {};
+  for (int i = 0; i < SENSOR_COUNT; i++)
+  {
+    decoded.ids[i] = sbxSensorId(SENSOR_TABLE.rows[i].osemId);
+  }
+  return decoded;
+}
+constexpr SbxSensorIds SBX_SENSOR_IDS = decodeSensorIds();
+#endif
 
 // Pressure trend variables
 int pressureTrend = 2; // 0=hard up, 1=slight up, 2=no trend, 3=slight down, 4=hard down
-unsigned long lastTrendUpdate = 0;
+
+// Hourly pressure means, kept in RTC user memory so they survive resets.
+// The first 128 bytes of RTC user memory are reserved for OTA, start behind them.
+#define RTC_PRESSURE_HISTORY_OFFSET 32
+PressureHistory pressureHistory;
+
+// Deep-sleep duty cycling: wake once per minute, read sensors, redraw, upload
+// or sync time when due and sleep again. Needs GPIO16 (D0) wired to RST.
+// Enable with build_flags = -DDEEP_SLEEP_MODE=1
+#ifndef DEEP_SLEEP_MODE
+#define DEEP_SLEEP_MODE 0
+#endif
+#if DEEP_SLEEP_MODE && CLOCK_SHOW_SECONDS
+#error "CLOCK_SHOW_SECONDS keeps the CPU awake, it cannot be combined with DEEP_SLEEP_MODE"
+#endif
+#define DEEP_SLEEP_MIN_MS 3000 // shorter waits are spent awake
+#define DEEP_SLEEP_RADIO_RESTART_MS 10 // a wake without the radio that needs it sleeps this long
+
+// Always-on LAN mode: WiFi stays joined in modem sleep between the
+// network jobs and a web server on LAN_PORT answers /metrics (Prometheus)
+// and /json from pages rebuilt after every sensor update, see lan_pages.h
+// and lan_server.h.
+// Enable with build_flags = -DLAN_MODE=1
+#ifndef LAN_MODE
+#define LAN_MODE 0
+#endif
+#if LAN_MODE && DEEP_SLEEP_MODE
+#error "LAN_MODE keeps WiFi up, it cannot be combined with DEEP_SLEEP_MODE"
+#endif
+#ifndef LAN_PORT
+#define LAN_PORT 80
+#endif
+#define LAN_POLL_MS 50       // between looks for a request
+#define LAN_REJOIN_MS 60000  // after a failed join
+
+#define RTC_STATE_OFFSET (RTC_PRESSURE_HISTORY_OFFSET + sizeof(PressureHistory) / 4)
+#define RTC_STATE_MAGIC 0x53425835 // "SBX5"
+
+// Everything a warm wake needs to continue without probing or a time sync
+struct RtcState
+{
+  uint32_t magic;
+  uint32_t uptimeMs;      // virtual uptime at the next wake
+  uint32_t taskNextRun[TASK_COUNT];
+  uint32_t taskSuspended; // bit per task
+  int64_t wallClockOffsetMs; // epoch ms minus virtual uptime, 0 if never synced
+  TimeSync timeSync;
+  int32_t pressureTrend;
+  SensorStats sensorStats[SENSOR_COUNT]; // the values shown come back from these
+  uint32_t bmpAddress;
+  uint8_t ds18b20Addresses[DS18B20_PROBE_COUNT][8];
+  uint32_t lastAwakeMs;
+  uint8_t networkJobs; // requested but not run, carried into the next wake
+  uint8_t radioOff;    // the wake runs with WAKE_RF_DISABLED
+  uint8_t reserved[2];
+  uint32_t crc;
+};
+
+RtcState rtcState;
+unsigned long uptimeBase = 0; // virtual uptime carried over deep sleep
+
+// Last good access point and DHCP lease, so a join can skip the scan and
+// DHCP. Every WIFI_CACHE_MAX_FAST_JOINS fast joins a full join renews the
+// lease, the cached address must not outlive it on the router.
+#define RTC_WIFI_OFFSET (RTC_STATE_OFFSET + sizeof(RtcState) / 4)
+#define RTC_WIFI_MAGIC 0x57494631 // "WIF1"
+#define WIFI_FAST_TIMEOUT_MS 3000
+#define WIFI_FULL_TIMEOUT_MS 10000
+#define WIFI_CACHE_MAX_FAST_JOINS 24
+
+struct WifiCache
+{
+  uint32_t magic;
+  uint8_t bssid[6];
+  uint8_t channel;
+  uint8_t valid;
+  uint32_t ip;
+  uint32_t gateway;
+  uint32_t subnet;
+  uint32_t dns;
+  uint16_t fastJoinsSinceDhcp;
+  // Connect latency statistics, kept when the cached network is invalidated
+  uint16_t fastJoins;
+  uint16_t fullJoins;
+  uint16_t failures;
+  uint32_t fastTotalMs;
+  uint32_t fullTotalMs;
+  uint32_t lastConnectMs;
+  uint32_t crc;
+};
+static_assert(RTC_WIFI_OFFSET * 4 + sizeof(WifiCache) <= 512, "RTC user memory is 512 bytes, fewer DS18B20 probes");
+
+WifiCache wifiCache;
+static_assert(sizeof(pressureHistory) + sizeof(rtcState) + sizeof(wifiCache) <= RAM_BUDGET_RTC_MIRROR,
+              "RTC mirrors over their RAM budget");
 
 // Arrow bitmaps (16x16 pixels each)
 // Each byte represents 8 horizontal pixels, MSB first
@@ -135,36 +780,124 @@ const unsigned char PROGMEM arrow_hard_down[] = {
   0x01, 0x80  // -------■■-------
 };
 
-void connectWiFi();
+void beginWiFiJoin(bool fast);
+void finishWiFiJoin(bool connected, bool fast, unsigned long elapsed);
+void loadWifiCache();
+void saveWifiCache();
 void disconnectWiFi();
-void syncTime();
-void uploadToOSeM();
-void postCombinedValues();
+void requestNetwork(uint8_t jobs);
+uint32_t msUntilNextMinute();
+bool timeValid();
+bool uploadDue();
+void queueReading();
+void publishReadings();
+bool publishBatch(const QueuedReading *readings, size_t count, bool telemetry);
+bool postCombinedValues(const QueuedReading *readings, size_t count, bool telemetry);
+int formatMeasurement(char *buf, size_t size, bool first, const char *sensorId, float value, uint8_t decimals,
+                      uint32_t timestamp);
+size_t writeMeasurements(Print *out, const QueuedReading *readings, size_t count, bool telemetry);
+size_t writeSbxMeasurements(Print *out, const QueuedReading *readings, size_t count, bool withTimestamp);
+uint8_t uploadBodyEncoding(const QueuedReading *readings, size_t count);
+void writeUploadBody(Print &out, void *context);
+void readStatsBody(const uint8_t *data, size_t length, void *context);
+bool radioDueAt(unsigned long t);
+void flushDisplay(uint8_t maxPages);
 void showBootScreen();
 void showError(const char *msg);
 bool isNight();
+void startSensorConversion();
 void updateSensor();
 void updateDisplay();
 void calculatePressureTrend();
+void buildLanPages();
+void backfillPressureHistory();
+void loadPressureHistory();
+void savePressureHistory();
 void drawTrendArrow();
+unsigned long nowMs();
+void setTimezone();
+bool loadRtcState();
+void enterDeepSleep(uint32_t sleepMs);
+bool coldBoot();
+void warmWake();
+
+void loadWifiCache()
+{
+  ESP.rtcUserMemoryRead(RTC_WIFI_OFFSET, (uint32_t *)&wifiCache, sizeof(wifiCache));
+  if (wifiCache.magic != RTC_WIFI_MAGIC || wifiCache.crc != crc32(&wifiCache, offsetof(WifiCache, crc)))
+  {
+    memset(&wifiCache, 0, sizeof(wifiCache));
+    wifiCache.magic = RTC_WIFI_MAGIC;
+  }
+}
+
+void saveWifiCache()
+{
+  wifiCache.crc = crc32(&wifiCache, offsetof(WifiCache, crc));
+  ESP.rtcUserMemoryWrite(RTC_WIFI_OFFSET, (uint32_t *)&wifiCache, sizeof(wifiCache));
+}
 
-void connectWiFi()
+void beginWiFiJoin(bool fast)
 {
-  WiFi.begin(WIFI_SSID, WIFI_PASS);
-  int tries = 0;
-  while (WiFi.status() != WL_CONNECTED && tries < 20)
+  WiFi.persistent(false); // don't rewrite the credentials in flash on every join
+  WiFi.mode(WIFI_STA);
+  if (LAN_MODE)
+    WiFi.setSleepMode(WIFI_MODEM_SLEEP); // radio dozes between beacons, stays associated
+
+  if (fast)
   {
-    delay(500);
-    Serial.print(".");
-    tries++;
+    // Direct join: known BSSID and channel skip the scan, static lease skips DHCP
+    WiFi.config(IPAddress(wifiCache.ip), IPAddress(wifiCache.gateway), IPAddress(wifiCache.subnet), IPAddress(wifiCache.dns));
+    WiFi.begin(WIFI_SSID, WIFI_PASS, wifiCache.channel, wifiCache.bssid);
   }
-  if (WiFi.status() == WL_CONNECTED)
+  else
   {
-    Serial.println("\nWiFi connected");
+    WiFi.config(IPAddress(0u), IPAddress(0u), IPAddress(0u)); // back to DHCP
+    WiFi.begin(WIFI_SSID, WIFI_PASS);
+  }
+}
+
+void finishWiFiJoin(bool connected, bool fast, unsigned long elapsed)
+{
+  wifiCache.lastConnectMs = elapsed;
+
+  if (connected && fast)
+  {
+    wifiCache.fastJoins++;
+    wifiCache.fastTotalMs += elapsed;
+    wifiCache.fastJoinsSinceDhcp++;
+  }
+  else if (connected)
+  {
+    wifiCache.fullJoins++;
+    wifiCache.fullTotalMs += elapsed;
+    memcpy(wifiCache.bssid, WiFi.BSSID(), sizeof(wifiCache.bssid));
+    wifiCache.channel = WiFi.channel();
+    wifiCache.ip = WiFi.localIP();
+    wifiCache.gateway = WiFi.gatewayIP();
+    wifiCache.subnet = WiFi.subnetMask();
+    wifiCache.dns = WiFi.dnsIP();
+    wifiCache.fastJoinsSinceDhcp = 0;
+    wifiCache.valid = 1;
   }
   else
   {
-    Serial.println("\nWiFi failed");
+    wifiCache.failures++;
+  }
+  saveWifiCache();
+
+  if (connected)
+  {
+    telemetryRecord(PHASE_WIFI_JOIN, elapsed * 1000);
+    LOGV("WiFi connected (%s) in %lu ms, avg fast %u ms, avg scan %u ms, failures %u\n",
+         fast ? "fast" : "scan", elapsed,
+         (unsigned)(wifiCache.fastJoins ? wifiCache.fastTotalMs / wifiCache.fastJoins : 0),
+         (unsigned)(wifiCache.fullJoins ? wifiCache.fullTotalMs / wifiCache.fullJoins : 0),
+         (unsigned)wifiCache.failures);
+  }
+  else
+  {
+    Serial.printf("WiFi failed after %lu ms, failures %u\n", elapsed, (unsigned)wifiCache.failures);
   }
 }
 
@@ -175,447 +908,1198 @@ void disconnectWiFi()
   delay(100);
 }
 
-void syncTime()
+unsigned long nowMs()
 {
-  configTime(3600, 3600, "pool.ntp.org", "time.nist.gov");
-  setenv("TZ", "CET-1CEST,M3.5.0,M10.5.0/3", 1);
-  tzset();
-  time_t now = time(nullptr);
-  while (now < 100000)
-  {
-    delay(500);
-    Serial.print(".");
-    now = time(nullptr);
-  }
-  Serial.println("\nTime synced");
+  return uptimeBase + millis();
 }
 
-void uploadToOSeM()
+// Set once at boot, the syncs pass the same string, which the C library
+// then overwrites in place instead of allocating a new environment entry
+void setTimezone()
 {
-  if (!bmpOk)
-    return;
-  postCombinedValues();
+  setenv("TZ", TIMEZONE, 1);
+  tzset();
 }
 
-void postCombinedValues()
+bool timeValid()
 {
-  WiFiClient client;
-  if (!client.connect(HOST, 80))
-  {
-    Serial.println("Connection to OSeM failed");
-    return;
-  }
-
-  String json = "[";
-  json += "{\"sensor\":\"" + String(SENSOR_ID_TEMP) + "\",\"value\":\"" + String(currentTemp, 2) + "\"},";
-  json += "{\"sensor\":\"" + String(SENSOR_ID_PRES) + "\",\"value\":\"" + String(currentPres, 2) + "\"},";
-  json += "{\"sensor\":\"" + String(SENSOR_ID_TEMP_OUT) + "\",\"value\":\"" + String(currentDS18B20, 2) + "\"},";
-  json += "{\"sensor\":\"" + String(SENSOR_ID_LUM) + "\",\"value\":\"" + String(currentLux, 2) + "\"}";
-  json += "]";
-
-  client.print(String("POST /boxes/") + OSEM_BOX_ID + "/data HTTP/1.1\r\n" +
-               "Host: " + HOST + "\r\n" +
-               "Authorization: " + OSEM_AUTH + "\r\n" +
-               "Content-Type: application/json\r\n" +
-               "Connection: close\r\n" +
-               "Content-Length: " + json.length() + "\r\n\r\n" +
-               json);
+  return time(nullptr) > 100000;
+}
 
-  while (client.connected())
+uint32_t msUntilNextMinute()
+{
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  if (tv.tv_sec <= 100000)
   {
-    if (client.available())
-    {
-      String line = client.readStringUntil('\n');
-      Serial.println(line);
-    }
+    return 60000;
   }
-  client.stop();
+  return 60000 - (tv.tv_sec % 60) * 1000 - tv.tv_usec / 1000;
 }
 
-void showBootScreen()
+uint32_t schedulerMillis()
 {
-  display.clearDisplay();
-  display.setTextSize(2);
-  display.setCursor(10, 10);
-  display.println("senseBox");
-  display.setTextSize(1);
-  display.setCursor(10, 35);
-  display.println("Starting...");
-  display.setCursor(10, 45);
-  display.println("Connecting WiFi");
-  display.display();
-  delay(2000);
+  return nowMs();
 }
 
-void showError(const char *msg)
+uint32_t schedulerMicros()
 {
-  display.clearDisplay();
-  display.setTextSize(1);
-  display.setCursor(10, 28);
-  display.println(msg);
-  display.display();
+  return micros();
 }
 
-bool isNight()
+void requestNetwork(uint8_t jobs)
 {
-  time_t now = time(nullptr);
-  struct tm *t = localtime(&now);
-  return (t->tm_hour >= 22 || t->tm_hour < 8);
+  networkJobs |= jobs;
+  if (tasks[TASK_NETWORK].suspended)
+  {
+    schedulerWake(scheduler, tasks[TASK_NETWORK], 0);
+  }
 }
 
-void updateSensor()
+uint32_t sensorStep()
 {
-  if (bmpOk)
+  static bool converting = false;
+
+  if (!converting)
   {
-    currentTemp = bmp.readTemperature() - 4.0;
-    currentPres = bmp.readPressure() / 100.0F;
+    startSensorConversion();
+    converting = true;
+    return SENSOR_CONVERSION_MS;
   }
 
-  ds18b20.requestTemperatures();
-  currentDS18B20 = ds18b20.getTempCByIndex(0);
+  converting = false;
+  updateSensor();
+  telemetrySampleHeap();
+  schedulerWake(scheduler, tasks[TASK_TREND], 0);
+  schedulerWake(scheduler, tasks[TASK_DISPLAY], 0);
+
+  // Start the next conversion so the readings land right when the minute changes
+  uint32_t untilMinute = msUntilNextMinute();
+  return untilMinute > SENSOR_CONVERSION_MS ? untilMinute - SENSOR_CONVERSION_MS
+                                            : untilMinute + 60000 - SENSOR_CONVERSION_MS;
+}
 
-  currentLux = lightMeter.readLightLevel();
+uint32_t displayStep()
+{
+  updateDisplay();
+  if (displayOn && displayRegionsDirty(displayRegions))
+    return 0; // rest of the frame next step, due sensor reads go first
+#if CLOCK_SHOW_SECONDS
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  return 1000 - tv.tv_usec / 1000; // next second
+#else
+  return TASK_SUSPEND; // woken with each new reading, right at the minute
+#endif
 }
 
-void updateDisplay()
+void printStats(Print &out)
 {
-  if (isNight())
-  {
-    display.ssd1306_command(SSD1306_DISPLAYOFF);
-    return;
-  }
-  else
+  out.println("Task      runs   avg us   max us");
+  for (int i = 0; i < TASK_COUNT; i++)
   {
-    display.ssd1306_command(SSD1306_DISPLAYON);
+    out.printf("%-8s %5u %8u %8u\n", tasks[i].name, tasks[i].runs,
+               schedulerAverageUs(tasks[i]), tasks[i].maxUs);
   }
-
-  time_t now = time(nullptr);
-  struct tm *t = localtime(&now);
-
-  char dateStr[32];  // Much larger buffer to satisfy compiler warning checks
-  snprintf(dateStr, sizeof(dateStr), "%02d.%02d.%04d", t->tm_mday, t->tm_mon + 1, 1900 + t->tm_year);
-
-  char timeStr[6];
-  snprintf(timeStr, sizeof(timeStr), "%02d:%02d", t->tm_hour, t->tm_min);
-
-  char tempStr[16];
-  snprintf(tempStr, sizeof(tempStr), "%.2f C", currentTemp);
-
-  char presStr[16];
-  snprintf(presStr, sizeof(presStr), "%.2f hPa", currentPres);
-
-  char extTempStr[16];
-  snprintf(extTempStr, sizeof(extTempStr), "%.2f C", currentDS18B20);
-
-  char luxStr[16];
-  snprintf(luxStr, sizeof(luxStr), "%.0f lx", currentLux);
-
-  display.clearDisplay();
-  display.setTextSize(1);
-  int16_t x1, y1;
-  uint16_t w, h;
-
-  // Draw pressure trend arrow first (top-left corner)
-  drawTrendArrow();
-
-  display.getTextBounds(dateStr, 0, 0, &x1, &y1, &w, &h);
-  display.setCursor((SCREEN_WIDTH - w) / 2, 0);
-  display.println(dateStr);
-
-  display.setTextSize(2);
-  display.getTextBounds(timeStr, 0, 0, &x1, &y1, &w, &h);
-  display.setCursor((SCREEN_WIDTH - w) / 2, 12);
-  display.println(timeStr);
-
-  display.setTextSize(1);
-  display.setCursor(0, 38);
-  display.println(tempStr);
-  display.setCursor(64, 38);
-  display.println(presStr);
-  display.setCursor(0, 50);
-  display.println(extTempStr);
-  display.setCursor(64, 50);
-  display.println(luxStr);
-
-  display.display();
+  out.printf("Display %u bytes last flush, %u avg\n", displayLastBytes,
+             displayFlushes ? displayTotalBytes / displayFlushes : 0);
+  out.printf("Acquisition %u us (read %u us), max %u us, budget %u ms\n",
+             acquisitionLastUs, acquisitionReadUs, acquisitionMaxUs, SENSOR_CONVERSION_MS);
+  HistoryUsage history;
+  historyUsage(history);
+  out.printf("History %u records, %u bytes, %.1f bytes per record (raw %u)\n", history.records, history.bytes,
+             history.records ? (float)history.bytes / history.records : 0.0f, 4 + 4 * SENSOR_COUNT);
+  out.printf("Arena %u of %u bytes high water, %u failed\n", (unsigned)arenaHighWater(), ARENA_SIZE,
+             (unsigned)arenaFailures());
+  publishDump(out);
+#if LAN_MODE
+  lanPagesDump(out);
+  lanServerDump(out);
+#endif
+  i2cBusDump(out);
+  telemetryDump(out);
 }
 
-void calculatePressureTrend()
+uint32_t uploadStep()
 {
-  Serial.println("Starting pressure trend calculation using OpenSenseMap statistics API...");
-  
-  WiFiClientSecure client;
-  client.setInsecure(); // Skip certificate verification for simplicity
-  String host = "api.opensensemap.org";
-
-  Serial.print("Connecting to: ");
-  Serial.println(host);
-  
-  if (!client.connect(host.c_str(), 443)) // HTTPS port 443
+  if (bmpOk)
   {
-    Serial.println("Failed to connect to OpenSenseMap API");
-    return;
+    queueReading();
+    if (uploadDue())
+    {
+      requestNetwork(JOB_UPLOAD);
+    }
   }
-  
-  Serial.println("Connected to API server");
-
-  // Get current time for API request
-  time_t now = time(nullptr);
-  time_t twelveHoursAgo = now - (12 * 3600); // 12 hours ago
-  time_t sixHoursAgo = now - (6 * 3600);     // 6 hours ago
-  time_t threeHoursAgo = now - (3 * 3600);   // 3 hours ago
 
-  // Copy the tm structures to avoid overwriting by subsequent gmtime calls
-  struct tm tm_now = *gmtime(&now);
-  struct tm tm_12h = *gmtime(&twelveHoursAgo);
-  struct tm tm_6h = *gmtime(&sixHoursAgo);
-  struct tm tm_3h = *gmtime(&threeHoursAgo);
+#if LOG_VERBOSE
+  printStats(Serial);
+#endif
+  return UPLOAD_INTERVAL_MS;
+}
 
-  char time_now[32], time_12h[32], time_6h[32], time_3h[32];
-  strftime(time_now, sizeof(time_now), "%Y-%m-%dT%H:%M:%SZ", &tm_now);
-  strftime(time_12h, sizeof(time_12h), "%Y-%m-%dT%H:%M:%SZ", &tm_12h);
-  strftime(time_6h, sizeof(time_6h), "%Y-%m-%dT%H:%M:%SZ", &tm_6h);
-  strftime(time_3h, sizeof(time_3h), "%Y-%m-%dT%H:%M:%SZ", &tm_3h);
-
-  // Debug time calculations
-  Serial.print("Current time: ");
-  Serial.println(time_now);
-  Serial.print("12 hours ago: ");
-  Serial.println(time_12h);
-  
-  // Use statistics API to get arithmetic means for 1-hour windows (more data points)
-  String url = "/statistics/descriptive?boxId=" + String(OSEM_BOX_ID) + 
-               "&phenomenon=Pressure" +
-               "&from-date=" + String(time_12h) +
-               "&to-date=" + String(time_now) +
-               "&operation=arithmeticMean" +
-               "&window=1h" +
-               "&format=tidy";
-  
-  Serial.print("Requesting URL: ");
-  Serial.println(url);
-  Serial.print("Box ID: ");
-  Serial.println(OSEM_BOX_ID);
-  Serial.print("Time range: ");
-  Serial.print(time_12h);
-  Serial.print(" to ");
-  Serial.println(time_now);
-
-  client.print(String("GET ") + url + " HTTP/1.1\r\n" +
-               "Host: " + host + "\r\n" +
-               "Connection: close\r\n\r\n");
-
-  Serial.println("HTTP request sent, waiting for response...");
-  
-  String payload = "";
-  bool headersPassed = false;
-  unsigned long timeout = millis();
+uint32_t trendStep()
+{
+  calculatePressureTrend();
+#if LAN_MODE
+  buildLanPages();
+#endif
+  return TASK_SUSPEND;
+}
 
-  while (client.connected() || client.available())
+#if LAN_MODE
+// Sensor readings, the pressure trend and the instrumentation counters,
+// run after each sensor update. Scrapes in between get the same text.
+void buildLanPages()
+{
+  uint32_t start = telemetryStart();
+  lanPagesBegin();
+  lanMetricCount("sensebox_uptime_seconds", "counter", "Time since power-up", nullptr, nowMs() / 1000);
+  lanJsonCount("uptime_s", nowMs() / 1000);
+  if (timeValid())
   {
-    if (millis() - timeout > 15000) // 15 second timeout for HTTPS
-    {
-      Serial.println("HTTP request timeout");
-      break;
-    }
-    
-    if (client.available())
-    {
-      if (!headersPassed)
-      {
-        String line = client.readStringUntil('\n');
-        if (line == "\r")
-        {
-          headersPassed = true;
-          Serial.println("Headers received, reading payload...");
-        }
-      }
-      else
-      {
-        char c = client.read();
-        if (c > 0)
-        {
-          payload += c;
-        }
-      }
-    }
+    lanMetricCount("sensebox_time_seconds", "gauge", "Wall clock, Unix time", nullptr, time(nullptr));
+    lanJsonCount("time", time(nullptr));
   }
-  client.stop();
-  
-  Serial.print("Statistics API Response length: ");
-  Serial.println(payload.length());
-  Serial.println("CSV Response:");
-  Serial.println(payload);
 
-  if (payload.length() == 0)
-  {
-    Serial.println("No statistics data received");
-    return;
-  }
-  
-  // Parse CSV response
-  // Expected format: sensorId,time_start,arithmeticMean_3h
-  // But let's be more flexible and debug what we're actually getting
-  
-  float pressureMeans[15] = {0}; // Increase array size to handle more windows
-  int validMeans = 0;
-  int totalLines = 0;
-  
-  // Split response into lines
-  int lineStart = 0;
-  
-  for (int i = 0; i <= (int)payload.length(); i++)
+  char labels[48];
+  lanJsonObject("sensors");
+  for (int i = 0; i < SENSOR_COUNT; i++)
   {
-    if (i == (int)payload.length() || payload.charAt(i) == '\n')
-    {
-      if (i > lineStart)
-      {
-        String line = payload.substring(lineStart, i);
-        line.trim(); // Remove whitespace and carriage returns
-        totalLines++;
-        
-        Serial.print("Line ");
-        Serial.print(totalLines);
-        Serial.print(": '");
-        Serial.print(line);
-        Serial.println("'");
-        
-        if (line.length() > 0 && validMeans < 15)
-        {
-          // Skip obvious header lines but be less restrictive
-          if (line.startsWith("sensorId,") || line == "ad" || line == "0")
-          {
-            Serial.println("  -> Skipping header/empty line");
-          }
-          else if (line.indexOf(',') == -1)
-          {
-            Serial.println("  -> Skipping line without comma");
-          }
-          else
-          {
-            // Parse CSV line - be more flexible with field count
-            int firstComma = line.indexOf(',');
-            int secondComma = line.indexOf(',', firstComma + 1);
-            
-            if (firstComma > 0 && secondComma > firstComma)
-            {
-              String sensorId = line.substring(0, firstComma);
-              String timeStart = line.substring(firstComma + 1, secondComma);
-              
-              // Get value - could be in 3rd field or beyond
-              String remainingPart = line.substring(secondComma + 1);
-              int nextComma = remainingPart.indexOf(',');
-              String valueStr = (nextComma > 0) ? remainingPart.substring(0, nextComma) : remainingPart;
-              
-              float pressureValue = valueStr.toFloat();
-              
-              Serial.print("  -> Parsed: SensorID='");
-              Serial.print(sensorId);
-              Serial.print("' Time='");
-              Serial.print(timeStart);
-              Serial.print("' Value='");
-              Serial.print(valueStr);
-              Serial.print("' (");
-              Serial.print(pressureValue);
-              Serial.println(" hPa)");
-              
-              // More relaxed validation - focus on reasonable pressure values
-              if (pressureValue > 800 && pressureValue < 1200 && sensorId.length() > 10)
-              {
-                Serial.print("    -> ACCEPTED as valid measurement #");
-                Serial.println(validMeans + 1);
-                
-                // Store the pressure value
-                pressureMeans[validMeans] = pressureValue;
-                validMeans++;
-              }
-              else
-              {
-                Serial.print("    -> REJECTED: pressure=");
-                Serial.print(pressureValue);
-                Serial.print(" (need 800-1200), sensorID len=");
-                Serial.println(sensorId.length());
-              }
-            }
-            else
-            {
-              Serial.println("  -> Malformed CSV structure (not enough commas)");
-            }
-          }
-        }
-      }
-      lineStart = i + 1;
-    }
+    SensorDef def = sensorDef(SENSORS, i);
+    snprintf(labels, sizeof(labels), "sensor=\"%s\"", def.field);
+    lanMetric("sensebox_reading", "gauge", "Latest calibrated reading", labels, sensorValues[i], def.decimals);
+    lanJsonNumber(def.field, sensorValues[i], def.decimals);
   }
-  
-  Serial.print("Total lines processed: ");
-  Serial.print(totalLines);
-  Serial.print(", Valid measurements found: ");
-  Serial.println(validMeans);
-
-  if (validMeans < 2)
+  lanJsonClose();
+
+  static const char *const TREND_NAMES[] = {"rising fast", "rising", "steady", "falling", "falling fast"};
+  float hPaPerHour;
+  float tendency = pressureHistorySlope(pressureHistory, hPaPerHour) ? 3 * hPaPerHour : NAN;
+  lanMetricCount("sensebox_pressure_trend", "gauge", "Pressure trend, 0 rising fast to 4 falling fast", nullptr,
+                 pressureTrend);
+  lanMetric("sensebox_pressure_tendency_hpa", "gauge", "Pressure change over 3 hours", nullptr, tendency, 2);
+  lanJsonCount("pressure_trend", pressureTrend);
+  lanJsonString("pressure_trend_name", TREND_NAMES[pressureTrend]);
+  lanJsonNumber("pressure_tendency_hpa_3h", tendency, 2);
+
+  size_t queued = queueOk ? uploadQueueSize() : 0;
+  lanMetricCount("sensebox_upload_queue_readings", "gauge", "Readings waiting for upload", nullptr, queued);
+  lanJsonCount("upload_queue", queued);
+
+  const HeapStats &heap = telemetryHeap();
+  lanMetricCount("sensebox_heap_free_bytes", "gauge", "Free heap", nullptr, heap.freeNow);
+  lanMetricCount("sensebox_heap_free_low_bytes", "gauge", "Lowest free heap", nullptr, heap.freeLow);
+  lanMetricCount("sensebox_heap_max_block_low_bytes", "gauge", "Lowest largest free block", nullptr,
+                 heap.maxBlockLow);
+  lanJsonObject("heap");
+  lanJsonCount("free", heap.freeNow);
+  lanJsonCount("free_low", heap.freeLow);
+  lanJsonCount("max_block_low", heap.maxBlockLow);
+  lanJsonClose();
+
+  lanMetricCount("sensebox_wifi_joins_total", "counter", "WiFi joins since power-up", "kind=\"fast\"",
+                 wifiCache.fastJoins);
+  lanMetricCount("sensebox_wifi_joins_total", "counter", "WiFi joins since power-up", "kind=\"scan\"",
+                 wifiCache.fullJoins);
+  lanMetricCount("sensebox_wifi_join_failures_total", "counter", "WiFi joins given up", nullptr,
+                 wifiCache.failures);
+  lanJsonObject("wifi");
+  lanJsonCount("fast_joins", wifiCache.fastJoins);
+  lanJsonCount("scan_joins", wifiCache.fullJoins);
+  lanJsonCount("failures", wifiCache.failures);
+  lanJsonClose();
+
+  // Phase histograms as count and total time, the rate of the two is the
+  // mean. The longest runs are in /json only, the text would not fit.
+  for (int p = 0; p < PHASE_COUNT; p++)
   {
-    Serial.print("Not enough time windows for trend calculation. Found: ");
-    Serial.print(validMeans);
-    Serial.println(" valid data points (need at least 2)");
-    return;
+    snprintf(labels, sizeof(labels), "phase=\"%s\"", telemetryPhaseName((TelemetryPhase)p));
+    lanMetricCount("sensebox_phase_count", "counter", "Timed phases", labels, telemetryPhase((TelemetryPhase)p).count);
   }
-
-  Serial.print("Successfully parsed ");
-  Serial.print(validMeans);
-  Serial.println(" valid pressure measurements");
-
-  // Calculate trend based on difference between recent and older pressure means
-  // Compare most recent window with oldest available window
-  float recentPressure = pressureMeans[validMeans - 1]; // Most recent
-  float olderPressure = pressureMeans[0]; // Oldest
-  float pressureDiff = recentPressure - olderPressure;
-
-  Serial.print("Pressure difference (recent - old): ");
-  Serial.print(pressureDiff);
-  Serial.println(" hPa");
-
-  // Convert to trend categories based on pressure difference over time
-  // Thresholds based on typical barometric pressure change rates
-  if (pressureDiff > 1.5)
+  for (int p = 0; p < PHASE_COUNT; p++)
   {
-    pressureTrend = 0; // Hard upward trend
-    Serial.println("-> Hard upward trend");
+    snprintf(labels, sizeof(labels), "phase=\"%s\"", telemetryPhaseName((TelemetryPhase)p));
+    lanMetric("sensebox_phase_seconds_total", "counter", "Time spent in the phase", labels,
+              telemetryPhase((TelemetryPhase)p).totalUs / 1e6f, 3);
   }
-  else if (pressureDiff > 0.5)
+  lanJsonObject("phases"); // count and longest run
+  for (int p = 0; p < PHASE_COUNT; p++)
   {
-    pressureTrend = 1; // Slight upward trend
-    Serial.println("-> Slight upward trend");
+    const PhaseStats &stats = telemetryPhase((TelemetryPhase)p);
+    lanJsonObject(telemetryPhaseName((TelemetryPhase)p));
+    lanJsonCount("count", stats.count);
+    lanJsonNumber("max_ms", stats.maxUs / 1000.0f, 1);
+    lanJsonClose();
   }
-  else if (pressureDiff > -0.5)
+  lanJsonClose();
+
+  for (int i = 0; i < TASK_COUNT; i++)
   {
-    pressureTrend = 2; // No significant trend
-    Serial.println("-> No significant trend");
+    snprintf(labels, sizeof(labels), "task=\"%s\"", tasks[i].name);
+    lanMetricCount("sensebox_task_runs_total", "counter", "Scheduler steps", labels, tasks[i].runs);
   }
-  else if (pressureDiff > -1.5)
+  for (int d = 0; d < I2C_DEVICE_COUNT; d++)
   {
-    pressureTrend = 3; // Slight downward trend
-    Serial.println("-> Slight downward trend");
+    snprintf(labels, sizeof(labels), "device=\"%s\"", i2cBusDeviceName((I2cDevice)d));
+    lanMetricCount("sensebox_i2c_errors_total", "counter", "Failed I2C transfers", labels,
+                   i2cBusStats((I2cDevice)d).errors);
   }
-  else
+  lanPagesEnd();
+  telemetryStop(PHASE_LAN_PAGES, start);
+}
+
+static const LanRoute LAN_ROUTES[] = {
+    {"/metrics", "text/plain; version=0.0.4", lanMetricsText},
+    {"/json", "application/json", lanJsonText},
+};
+
+void beginLanServer()
+{
+  lanServerBegin(LAN_PORT, LAN_ROUTES, sizeof(LAN_ROUTES) / sizeof(LAN_ROUTES[0]));
+}
+#endif
+
+uint32_t lanStep()
+{
+#if LAN_MODE
+  if (WiFi.status() == WL_CONNECTED)
   {
-    pressureTrend = 4; // Hard downward trend
-    Serial.println("-> Hard downward trend");
+    lanServerPoll();
+    return LAN_POLL_MS;
   }
+  // Lost the access point: join again, the network task wakes this one
+  // when it is connected or gave up
+  requestNetwork(JOB_LAN);
+#endif
+  return TASK_SUSPEND;
+}
 
-  Serial.print("Pressure trend calculated: ");
-  Serial.print(pressureDiff);
-  Serial.print(" hPa difference, category: ");
-  Serial.println(pressureTrend);
+uint32_t ntpStep()
+{
+  requestNetwork(JOB_TIME_SYNC);
+  // Retry unless the sync reschedules this task from the measured drift
+  return TIME_SYNC_MIN_INTERVAL_MS;
 }
 
-void drawTrendArrow()
+void onTimeSet(bool fromSntp)
 {
-  // Draw 16x16 pixel arrow in top-left corner
-  int x = 2;  // Small margin from edge
-  int y = 2;
+  if (fromSntp)
+    ntpAnswered = true;
+}
 
-  const unsigned char* bitmap = nullptr;
+// Called once the new time is set
+void timeSynced()
+{
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  timeSyncRecord(timeSync, nowMs(), (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000);
+  uint32_t next = timeSyncNextDelayMs(timeSync, TIME_SYNC_ERROR_MS, TIME_SYNC_MIN_INTERVAL_MS,
+                                      TIME_SYNC_MAX_INTERVAL_MS);
+  schedulerWake(scheduler, tasks[TASK_NTP], next);
+  LOGV("Time synced, drift %.1f ppm (+-%.1f), next sync in %u s\n", timeSync.driftPpm,
+       timeSync.uncertaintyPpm, (unsigned)(next / 1000));
+}
+
+uint32_t networkStep()
+{
+  enum
+  {
+    NET_IDLE,
+    NET_JOINING,
+    NET_JOBS,
+    NET_TIME_WAIT
+  };
+  static uint8_t state = NET_IDLE;
+  static bool fastJoin;
+  static unsigned long sessionStart;
+  static unsigned long stateStart;
+
+  switch (state)
+  {
+  case NET_IDLE:
+    if (networkJobs == 0)
+    {
+      return TASK_SUSPEND;
+    }
+    if (DEEP_SLEEP_MODE && radioOff)
+    {
+      // The sleep before this wake expected no network jobs (radioDueAt()),
+      // the radio only comes back with another wake. The jobs and the
+      // queued reading wait for it.
+      LOGV("Radio off, waking again with it\n");
+      enterDeepSleep(DEEP_SLEEP_RADIO_RESTART_MS);
+    }
+    // Sync early and send what is queued while the radio is up anyway, it
+    // may save a session later
+    if (timeSyncPredictedErrorMs(timeSync, nowMs()) > TIME_SYNC_ERROR_MS / 2)
+    {
+      networkJobs |= JOB_TIME_SYNC;
+    }
+    if (queueOk && uploadQueueSize() > 0)
+    {
+      networkJobs |= JOB_UPLOAD;
+    }
+    if (LAN_MODE && WiFi.status() == WL_CONNECTED)
+    {
+      sessionStart = millis();
+      state = NET_JOBS; // still joined from the last session
+      return 0;
+    }
+    fastJoin = wifiCache.valid && wifiCache.fastJoinsSinceDhcp < WIFI_CACHE_MAX_FAST_JOINS;
+    beginWiFiJoin(fastJoin);
+    sessionStart = stateStart = millis();
+    state = NET_JOINING;
+    return 10;
+
+  case NET_JOINING:
+    if (WiFi.status() == WL_CONNECTED)
+    {
+      finishWiFiJoin(true, fastJoin, millis() - sessionStart);
+      state = NET_JOBS;
+      return 0;
+    }
+    if (millis() - stateStart < (fastJoin ? WIFI_FAST_TIMEOUT_MS : WIFI_FULL_TIMEOUT_MS))
+    {
+      return 10;
+    }
+    if (fastJoin)
+    {
+      Serial.println("WiFi fast join failed, scanning");
+      wifiCache.valid = 0;
+      WiFi.disconnect();
+      fastJoin = false;
+      beginWiFiJoin(false);
+      stateStart = millis();
+      return 10;
+    }
+    // Give up, queued readings stay queued and the other jobs come round again
+    finishWiFiJoin(false, false, millis() - sessionStart);
+    networkJobs = 0;
+    disconnectWiFi();
+    if (LAN_MODE)
+      schedulerWake(scheduler, tasks[TASK_LAN], LAN_REJOIN_MS);
+    state = NET_IDLE;
+    return TASK_SUSPEND;
+
+  case NET_JOBS:
+    // Time first, uploads get timestamps and the backfill needs the date
+    if (networkJobs & JOB_TIME_SYNC)
+    {
+      networkJobs &= ~JOB_TIME_SYNC;
+      ntpAnswered = false;
+      configTime(TIMEZONE, "pool.ntp.org", "time.nist.gov");
+      stateStart = millis();
+      state = NET_TIME_WAIT;
+      return 100;
+    }
+    if (networkJobs & JOB_UPLOAD)
+    {
+      networkJobs &= ~JOB_UPLOAD;
+      publishReadings();
+      // Retry the backfill while WiFi is up if the cold-boot fetch failed
+      if (pressureHistoryPoints(pressureHistory) < 2)
+      {
+        networkJobs |= JOB_BACKFILL;
+      }
+      return 0;
+    }
+    if (networkJobs & JOB_BACKFILL)
+    {
+      networkJobs &= ~JOB_BACKFILL;
+      backfillPressureHistory();
+      return 0;
+    }
+    networkJobs &= ~JOB_LAN;
+    if (LAN_MODE)
+      schedulerWake(scheduler, tasks[TASK_LAN], 0);
+    else
+      disconnectWiFi();
+    telemetrySampleHeap();
+    state = NET_IDLE;
+    return TASK_SUSPEND;
+
+  case NET_TIME_WAIT:
+    if (ntpAnswered)
+    {
+      telemetryRecord(PHASE_NTP_WAIT, (millis() - stateStart) * 1000);
+      timeSynced();
+      schedulerWake(scheduler, tasks[TASK_DISPLAY], 0);
+      state = NET_JOBS;
+      return 0;
+    }
+    if (millis() - stateStart >= NTP_TIMEOUT_MS)
+    {
+      Serial.println("NTP sync timed out");
+      state = NET_JOBS;
+      return 0;
+    }
+    return 100;
+  }
+  return TASK_SUSPEND;
+}
+
+// Whether the reading just queued starts a WiFi session, see UPLOAD_POLICY
+bool uploadDue()
+{
+  if (!queueOk)
+    return true;
+#if UPLOAD_POLICY == UPLOAD_POLICY_ADAPTIVE
+  QueuedReading sent;
+  UploadReason reason = uploadPolicyCheck(lastReading, uploadQueueLastSent(sent) ? &sent : nullptr, SENSORS,
+                                          UPLOAD_HEARTBEAT_MS / 1000);
+  LOGV("Upload policy: %s, %u readings queued\n", uploadReasonName(reason), (unsigned)uploadQueueSize());
+  return reason != UPLOAD_WAIT;
+#else
+  return uploadQueueSize() >= UPLOAD_BATCH_INTERVALS;
+#endif
+}
+
+void queueReading()
+{
+  time_t now = time(nullptr);
+  lastReading.timestamp = now > 100000 ? now : 0;
+  for (int i = 0; i < SENSOR_COUNT; i++)
+  {
+    const SensorStats &stats = sensorStats[i];
+    SensorDef def = sensorDef(SENSORS, i);
+    lastReading.values[i] = def.upload == SENSOR_UPLOAD_MEAN ? stats.mean : sensorValues[i];
+    LOGV("%s: %u samples, mean %.2f, min %.2f, max %.2f\n", def.osemId, stats.count, stats.mean,
+         stats.min, stats.max);
+    sensorStatsReset(sensorStats[i]);
+  }
+
+  if (queueOk && !uploadQueuePush(lastReading))
+  {
+    Serial.println("Upload queue write failed");
+  }
+}
+
+void publishReadings()
+{
+  if (!bmpOk)
+    return;
+
+  unsigned long start = millis();
+  publishBegin();
+  if (!queueOk)
+  {
+    publishBatch(&lastReading, 1, TELEMETRY_UPLOAD);
+  }
+  else
+  {
+    // Drain oldest first, a failed request leaves its batch queued for the next session
+    ArenaMark mark = arenaMark();
+    QueuedReading *batch = arenaArray<QueuedReading>(UPLOAD_BATCH_RECORDS);
+    for (int request = 0; batch && request < UPLOAD_MAX_REQUESTS; request++)
+    {
+      size_t count = uploadQueuePeek(batch, UPLOAD_BATCH_RECORDS);
+      if (count == 0 || !publishBatch(batch, count, TELEMETRY_UPLOAD && request == 0))
+      {
+        break;
+      }
+      uploadQueuePop(count);
+    }
+    arenaRewind(mark);
+    LOGV("Readings left in upload queue: %u\n", (unsigned)uploadQueueSize());
+  }
+  publishEnd();
+  telemetryRecord(PHASE_UPLOAD, (millis() - start) * 1000);
+}
+
+// One batch to openSenseMap and the mirrors, the mirrors get it in as many
+// parts as the line protocol buffer needs. True if it may leave the queue.
+bool publishBatch(const QueuedReading *readings, size_t count, bool telemetry)
+{
+  bool accepted = PUBLISH_OSEM && postCombinedValues(readings, count, telemetry);
+  if (!publishActive())
+    return accepted;
+
+  unsigned long start = millis();
+  bool mirrored = true;
+  for (size_t done = 0; done < count;)
+  {
+    size_t n = publishSerialise(LINE_PROTOCOL_PREFIX, SENSORS, readings + done, count - done);
+    if (n == 0)
+    {
+      mirrored = false;
+      break;
+    }
+    mirrored &= publishMirrors();
+    done += n;
+  }
+  telemetryRecord(PHASE_MIRROR, (millis() - start) * 1000);
+  return PUBLISH_OSEM ? accepted : mirrored;
+}
+
+// One element of the bulk JSON array, with a leading comma unless first
+int formatMeasurement(char *buf, size_t size, bool first, const char *sensorId, float value, uint8_t decimals,
+                      uint32_t timestamp)
+{
+  int len = snprintf(buf, size, "%s{\"sensor\":\"%s\",\"value\":\"%.*f\"", first ? "" : ",", sensorId,
+                     decimals, value);
+  if (timestamp != 0)
+  {
+    time_t t = timestamp;
+    struct tm tm_utc;
+    gmtime_r(&t, &tm_utc);
+    len += strftime(buf + len, size - len, ",\"createdAt\":\"%Y-%m-%dT%H:%M:%SZ\"", &tm_utc);
+  }
+  len += snprintf(buf + len, size - len, "}");
+  return len;
+}
+
+// Writes the JSON array to out, or only measures it if out is null
+size_t writeMeasurements(Print *out, const QueuedReading *readings, size_t count, bool telemetry)
+{
+  char buf[128];
+  size_t total = 2; // brackets
+  bool first = true;
+  if (out)
+    out->print('[');
+
+  for (size_t i = 0; i < count; i++)
+  {
+    const QueuedReading &r = readings[i];
+    for (int s = 0; s < SENSOR_COUNT; s++)
+    {
+      if (isnan(r.values[s]))
+        continue;
+      SensorDef def = sensorDef(SENSORS, s);
+      int len = formatMeasurement(buf, sizeof(buf), first, def.osemId, r.values[s], def.decimals, r.timestamp);
+      first = false;
+      total += len;
+      if (out)
+        out->write((const uint8_t *)buf, len);
+    }
+  }
+
+#if TELEMETRY_UPLOAD
+  if (telemetry)
+  {
+    // Current values, no timestamp
+    const HeapStats &heap = telemetryHeap();
+    const char *telemetryIds[3] = {SENSOR_ID_HEAP_FREE, SENSOR_ID_HEAP_FRAGMENTATION, SENSOR_ID_WIFI_JOIN};
+    float telemetryValues[3] = {(float)heap.freeLow, (float)heap.fragmentationHigh,
+                                telemetryPhase(PHASE_WIFI_JOIN).lastUs / 1000.0f};
+    for (int s = 0; s < 3; s++)
+    {
+      int len = formatMeasurement(buf, sizeof(buf), first, telemetryIds[s], telemetryValues[s], 0, 0);
+      first = false;
+      total += len;
+      if (out)
+        out->write((const uint8_t *)buf, len);
+    }
+  }
+#else
+  (void)telemetry;
+#endif
+
+  if (out)
+    out->print(']');
+  return total;
+}
+
+// Writes the binary sbx-bytes(-ts) body to out, or only measures it if out is null
+size_t writeSbxMeasurements(Print *out, const QueuedReading *readings, size_t count, bool withTimestamp)
+{
+  size_t perMeasurement = withTimestamp ? SBX_MEASUREMENT_TS_LENGTH : SBX_MEASUREMENT_LENGTH;
+  size_t total = 0;
+  for (size_t i = 0; i < count; i++)
+  {
+    for (int s = 0; s < SENSOR_COUNT; s++)
+    {
+      if (!isnan(readings[i].values[s]))
+        total += perMeasurement;
+    }
+  }
+  if (!out)
+    return total;
+
+#if UPLOAD_ENCODING == UPLOAD_ENCODING_SBX
+  uint8_t buf[SENSOR_COUNT * SBX_MEASUREMENT_TS_LENGTH];
+  for (size_t i = 0; i < count; i++)
+  {
+    const QueuedReading &r = readings[i];
+    size_t len = 0;
+    for (int s = 0; s < SENSOR_COUNT; s++)
+    {
+      if (!isnan(r.values[s]))
+        len += sbxEncode(buf + len, SBX_SENSOR_IDS.ids[s], r.values[s], withTimestamp, r.timestamp);
+    }
+    out->write(buf, len);
+  }
+#endif
+  return total;
+}
+
+uint8_t uploadBodyEncoding(const QueuedReading *readings, size_t count)
+{
+  if (UPLOAD_ENCODING != UPLOAD_ENCODING_SBX)
+    return BODY_JSON;
+
+  for (size_t i = 0; i < count; i++)
+  {
+    if (readings[i].timestamp == 0)
+      return count == 1 ? BODY_SBX : BODY_JSON;
+  }
+  return BODY_SBX_TS;
+}
+
+struct UploadBatch
+{
+  const QueuedReading *readings;
+  size_t count;
+  uint8_t encoding;
+  bool telemetry;
+};
+
+size_t writeUploadBatch(Print *out, const UploadBatch &batch)
+{
+  if (batch.encoding == BODY_JSON)
+    return writeMeasurements(out, batch.readings, batch.count, batch.telemetry);
+  return writeSbxMeasurements(out, batch.readings, batch.count, batch.encoding == BODY_SBX_TS);
+}
+
+void writeUploadBody(Print &out, void *context)
+{
+  writeUploadBatch(&out, *(const UploadBatch *)context);
+}
+
+bool postCombinedValues(const QueuedReading *readings, size_t count, bool telemetry)
+{
+  UploadBatch batch = {readings, count, uploadBodyEncoding(readings, count), telemetry};
+  HttpRequest request = {};
+  request.method = "POST";
+  request.host = HOST;
+  request.port = 80;
+  request.path = OSEM_UPLOAD_PATH;
+  request.headers = UPLOAD_HEADERS[batch.encoding];
+  request.contentLength = writeUploadBatch(nullptr, batch);
+  request.writeBody = writeUploadBody;
+  request.context = &batch;
+
+  int status = httpSendWithRetry(request, 3);
+  bool accepted = status >= 200 && status < 300;
+  if (accepted)
+  {
+    LOGV("Uploaded %u readings (%u bytes), status %d\n", (unsigned)count, (unsigned)request.contentLength, status);
+  }
+  else
+  {
+    Serial.printf("Upload of %u readings (%u bytes) FAILED, status %d\n", (unsigned)count,
+                  (unsigned)request.contentLength, status);
+  }
+  return accepted;
+}
+
+// The reading uploadStep() will queue at t, as far as it is known now: the
+// samples so far and one more that continues the recent trend
+void predictReading(QueuedReading &next, unsigned long t)
+{
+  time_t now = time(nullptr);
+  next.timestamp = now > 100000 ? now + (int32_t)(t - nowMs()) / 1000 : 0;
+  for (int i = 0; i < SENSOR_COUNT; i++)
+  {
+    const SensorStats &stats = sensorStats[i];
+    float latest = sensorStatsLatest(stats);
+    float step = stats.recentCount >= 2 ? (latest - stats.recent[0]) / (stats.recentCount - 1) : 0;
+    float sample = latest + step;
+    if (sensorDef(SENSORS, i).upload == SENSOR_UPLOAD_LAST || stats.count == 0)
+      next.values[i] = sample;
+    else if (isnan(sample))
+      next.values[i] = stats.mean;
+    else
+      next.values[i] = (stats.mean * stats.count + sample) / (stats.count + 1);
+  }
+}
+
+// Whether the reading queued at t will start a WiFi session, uploadDue()
+// ahead of time
+bool uploadLikelyAt(unsigned long t)
+{
+  if (!queueOk)
+    return true;
+#if UPLOAD_POLICY == UPLOAD_POLICY_ADAPTIVE
+  QueuedReading next;
+  predictReading(next, t);
+  QueuedReading sent;
+  return uploadPolicyCheck(next, uploadQueueLastSent(sent) ? &sent : nullptr, SENSORS,
+                           UPLOAD_HEARTBEAT_MS / 1000) != UPLOAD_WAIT;
+#else
+  (void)t;
+  return uploadQueueSize() + 1 >= UPLOAD_BATCH_INTERVALS;
+#endif
+}
+
+bool radioDueAt(unsigned long t)
+{
+  // Mirrors uploadStep(). A wake the prediction gets wrong finds the radio
+  // off and sleeps again briefly to get it, see networkStep().
+  const Task &upload = tasks[TASK_UPLOAD];
+  const Task &ntp = tasks[TASK_NTP];
+  bool readingDue = !upload.suspended && (int32_t)(t - upload.nextRun) >= 0;
+  bool flushDue = readingDue && bmpOk && uploadLikelyAt(t);
+  bool syncDue = !ntp.suspended && (int32_t)(t - ntp.nextRun) >= 0;
+  return networkJobs != 0 || flushDue || syncDue;
+}
+
+void showBootScreen()
+{
+  display.clearDisplay();
+  display.setTextSize(2);
+  display.setCursor(10, 10);
+  display.println("senseBox");
+  display.setTextSize(1);
+  display.setCursor(10, 35);
+  display.println("Starting...");
+  display.setCursor(10, 45);
+  display.println("Connecting WiFi");
+  displayRegionsMarkAll(displayRegions);
+  flushDisplay(DISPLAY_PAGES);
+  displayLayoutValid = false;
+}
+
+void showError(const char *msg)
+{
+  display.clearDisplay();
+  display.setTextSize(1);
+  display.setCursor(10, 28);
+  display.println(msg);
+  displayRegionsMarkAll(displayRegions);
+  flushDisplay(DISPLAY_PAGES);
+  displayLayoutValid = false;
+}
+
+bool isNight()
+{
+  if (!timeValid())
+    return false;
+  time_t now = time(nullptr);
+  struct tm *t = localtime(&now);
+  return (t->tm_hour >= 22 || t->tm_hour < 8);
+}
+
+void startSensorConversion()
+{
+  // All three return right away and convert in parallel, updateSensor()
+  // collects the results SENSOR_CONVERSION_MS later
+  acquisitionStartUs = micros();
+
+  if (ds18b20Ok)
+  {
+    ds18b20.requestTemperatures(); // skip ROM, setWaitForConversion(false)
+  }
+
+  if (bmpOk)
+  {
+    // A single conversion, after which the BMP280 goes back to sleep
+    bmp280StartForced(BMP280_TEMP_OVERSAMPLING, BMP280_PRES_OVERSAMPLING);
+  }
+
+  bh1750Start(BH1750_MODE); // one-time, powers down afterwards
+}
+
+void updateSensor()
+{
+  uint32_t readStartUs = micros();
+
+  for (int i = 0; i < SENSOR_COUNT; i++)
+  {
+    SensorDef def = sensorDef(SENSORS, i);
+    uint32_t start = telemetryStart();
+    float raw = readSensor(def);
+    telemetryStop((TelemetryPhase)def.phase, start);
+    sensorValues[i] = raw * def.scale + def.offset;
+    sensorStatsAdd(sensorStats[i], sensorValues[i], def.rejectSpikes);
+  }
+
+  if (!isnan(sensorValues[SENSOR_PRES]) && timeValid()) // hours must be real hours
+  {
+    pressureHistoryAddSample(pressureHistory, time(nullptr) / 3600, sensorValues[SENSOR_PRES]);
+    savePressureHistory();
+  }
+
+  uint32_t doneUs = micros();
+  acquisitionReadUs = doneUs - readStartUs;
+  acquisitionLastUs = doneUs - acquisitionStartUs;
+  if (acquisitionLastUs > acquisitionMaxUs)
+    acquisitionMaxUs = acquisitionLastUs;
+
+  if (queueOk && timeValid())
+  {
+    uint32_t start = telemetryStart();
+    historyAppend(time(nullptr), sensorValues);
+    telemetryStop(PHASE_HISTORY_APPEND, start);
+  }
+}
+
+// Send up to maxPages dirty pages, a frame counts as flushed once all are out
+void flushDisplay(uint8_t maxPages)
+{
+  static uint32_t frameBytes = 0;
+  uint32_t flushStart = telemetryStart();
+  size_t sent = displayRegionsFlush(displayRegions, display.getBuffer(), OLED_ADDRESS, maxPages);
+  if (sent == 0)
+    return;
+  telemetryStop(PHASE_DISPLAY_FLUSH, flushStart);
+  frameBytes += sent;
+  if (!displayRegionsDirty(displayRegions))
+  {
+    displayLastBytes = frameBytes;
+    displayFlushes++;
+    displayTotalBytes += frameBytes;
+    frameBytes = 0;
+  }
+}
+
+#if DISPLAY_GRAPH_HOURS
+// Page for this minute: -1 for the main screen, else the SensorIndex to graph
+int displayPage()
+{
+  if (!queueOk || !timeValid())
+    return -1;
+  int8_t graphs[SENSOR_COUNT];
+  int count = 0;
+  for (int i = 0; i < SENSOR_COUNT; i++)
+  {
+    if (sensorDef(SENSORS, i).widget != SENSOR_NO_WIDGET)
+      graphs[count++] = i;
+  }
+  uint32_t slot = time(nullptr) / 60 % (DISPLAY_MAIN_MINUTES + count);
+  return slot < DISPLAY_MAIN_MINUTES ? -1 : graphs[slot - DISPLAY_MAIN_MINUTES];
+}
+
+void collectGraphColumn(uint32_t timestamp, const float *values, void *context)
+{
+  GraphColumns &graph = *(GraphColumns *)context;
+  float value = values[graph.sensor];
+  if (isnan(value))
+    return;
+  uint32_t x = (timestamp - graph.from) * SCREEN_WIDTH / (DISPLAY_GRAPH_HOURS * 3600UL);
+  if (x >= SCREEN_WIDTH)
+    x = SCREEN_WIDTH - 1;
+  if (isnan(graph.min[x]) || value < graph.min[x])
+    graph.min[x] = value;
+  if (isnan(graph.max[x]) || value > graph.max[x])
+    graph.max[x] = value;
+}
+
+// Label and maximum at the top, the min-max band scaled to the range in
+// between, the time span and minimum at the bottom
+void drawGraphPage(int sensor)
+{
+  graphColumns.from = time(nullptr) - DISPLAY_GRAPH_HOURS * 3600UL;
+  graphColumns.sensor = sensor;
+  for (int x = 0; x < SCREEN_WIDTH; x++)
+  {
+    graphColumns.min[x] = NAN;
+    graphColumns.max[x] = NAN;
+  }
+  uint32_t start = telemetryStart();
+  historyScan(graphColumns.from, collectGraphColumn, &graphColumns);
+  telemetryStop(PHASE_HISTORY_SCAN, start);
+
+  float low = NAN;
+  float high = NAN;
+  for (int x = 0; x < SCREEN_WIDTH; x++)
+  {
+    if (isnan(graphColumns.min[x]))
+      continue;
+    if (isnan(low) || graphColumns.min[x] < low)
+      low = graphColumns.min[x];
+    if (isnan(high) || graphColumns.max[x] > high)
+      high = graphColumns.max[x];
+  }
+
+  display.clearDisplay();
+  display.setTextSize(1);
+  display.setTextColor(SSD1306_WHITE);
+  display.setCursor(0, 0);
+  SensorDef def = sensorDef(SENSORS, sensor);
+  display.print(def.label);
+  display.setCursor(0, 56);
+  display.printf("%dh", DISPLAY_GRAPH_HOURS);
+
+  if (!isnan(low))
+  {
+    char text[16];
+    formatFixed(text, sizeof(text), high, def.shownDecimals, def.unit);
+    display.setCursor(SCREEN_WIDTH - 6 * strlen(text), 0);
+    display.print(text);
+    formatFixed(text, sizeof(text), low, def.shownDecimals, def.unit);
+    display.setCursor(SCREEN_WIDTH - 6 * strlen(text), 56);
+    display.print(text);
+
+    float span = high > low ? high - low : 1.0f; // flat line at the bottom
+    float pixels = GRAPH_BOTTOM - GRAPH_TOP;
+    for (int x = 0; x < SCREEN_WIDTH; x++)
+    {
+      if (isnan(graphColumns.min[x]))
+        continue;
+      int top = GRAPH_BOTTOM - lroundf((graphColumns.max[x] - low) / span * pixels);
+      int bottom = GRAPH_BOTTOM - lroundf((graphColumns.min[x] - low) / span * pixels);
+      display.drawFastVLine(x, top, bottom - top + 1, SSD1306_WHITE);
+    }
+  }
+
+  displayRegionsMarkAll(displayRegions);
+  displayLayoutValid = false; // the main screen starts over afterwards
+}
+#endif
+
+// A reading as it fits the widget, e.g. "1013.25 hPa" is 66 pixels in a
+// 64 pixel half: without the space before the unit first, then with one
+// decimal less at a time. out holds sizeof(TextWidget::text) characters.
+size_t formatWidgetValue(char *out, const TextWidget &widget, float value, uint8_t decimals, const char *unit)
+{
+  const size_t size = sizeof(widget.text);
+  size_t columns = textWidgetColumns(widget);
+  size_t length = formatFixed(out, size, value, decimals, unit);
+  if (length <= columns)
+    return length;
+  if (unit[0] == ' ')
+    unit++;
+  length = formatFixed(out, size, value, decimals, unit);
+  while (length > columns && decimals > 0)
+    length = formatFixed(out, size, value, --decimals, unit);
+  return length;
+}
+
+void updateDisplay()
+{
+  // The controller keeps its RAM while off, so nothing needs redrawing after the night
+  if (isNight())
+  {
+    if (displayOn)
+    {
+      displayCommand(SSD1306_DISPLAYOFF);
+      displayOn = false;
+    }
+    return;
+  }
+  if (!displayOn)
+  {
+    displayCommand(SSD1306_DISPLAYON);
+    displayOn = true;
+  }
+
+#if DISPLAY_GRAPH_HOURS
+  int page = displayPage();
+  if (page >= 0)
+  {
+    if (page != shownPage)
+    {
+      drawGraphPage(page);
+      shownPage = page;
+    }
+    flushDisplay(DISPLAY_FLUSH_PAGES);
+    return;
+  }
+  shownPage = -1;
+#endif
+
+  char dateStr[32];  // Much larger buffer to satisfy compiler warning checks
+  char timeStr[16];
+  if (timeValid())
+  {
+    time_t now = time(nullptr);
+    struct tm *t = localtime(&now);
+    snprintf(dateStr, sizeof(dateStr), "%02d.%02d.%04d", t->tm_mday, t->tm_mon + 1, 1900 + t->tm_year);
+#if CLOCK_SHOW_SECONDS
+    snprintf(timeStr, sizeof(timeStr), "%02d:%02d:%02d", t->tm_hour, t->tm_min, t->tm_sec);
+#else
+    snprintf(timeStr, sizeof(timeStr), "%02d:%02d", t->tm_hour, t->tm_min);
+#endif
+  }
+  else
+  {
+    // Not synced yet
+    strcpy(dateStr, "--.--.----");
+    strcpy(timeStr, CLOCK_SHOW_SECONDS ? "--:--:--" : "--:--");
+  }
+
+  if (!displayLayoutValid)
+  {
+    // Something else used the whole screen, start from a blank frame
+    display.clearDisplay();
+    for (int i = 0; i < WIDGET_COUNT; i++)
+    {
+      textWidgetInvalidate(widgets[i]);
+    }
+    shownTrend = -1;
+    displayRegionsMarkAll(displayRegions);
+    displayLayoutValid = true;
+  }
+
+  if (pressureTrend != shownTrend)
+  {
+    display.fillRect(TREND_ARROW_X, TREND_ARROW_Y, 16, 16, SSD1306_BLACK);
+    drawTrendArrow();
+    displayRegionsMark(displayRegions, TREND_ARROW_X, TREND_ARROW_Y, 16, 16);
+    shownTrend = pressureTrend;
+  }
+
+  textWidgetDraw(widgets[WIDGET_DATE], display.getBuffer(), displayRegions, dateStr);
+  textWidgetDraw(widgets[WIDGET_TIME], display.getBuffer(), displayRegions, timeStr);
+  for (int i = 0; i < SENSOR_COUNT; i++)
+  {
+    SensorDef def = sensorDef(SENSORS, i);
+    if (def.widget == SENSOR_NO_WIDGET)
+      continue;
+    TextWidget &widget = widgets[def.widget];
+    char valueStr[sizeof(widget.text)];
+    formatWidgetValue(valueStr, widget, sensorValues[i], def.shownDecimals, def.unit);
+    textWidgetDraw(widget, display.getBuffer(), displayRegions, valueStr);
+  }
+
+  flushDisplay(DISPLAY_FLUSH_PAGES);
+}
+
+void loadPressureHistory()
+{
+  ESP.rtcUserMemoryRead(RTC_PRESSURE_HISTORY_OFFSET, (uint32_t *)&pressureHistory, sizeof(pressureHistory));
+  if (!pressureHistoryValid(pressureHistory))
+  {
+    LOGV("No pressure history in RTC memory (cold boot)\n");
+    pressureHistoryReset(pressureHistory);
+    return;
+  }
+  LOGV("Pressure history restored, hours: %u\n", (unsigned)pressureHistory.count);
+}
+
+void savePressureHistory()
+{
+  pressureHistorySeal(pressureHistory);
+  ESP.rtcUserMemoryWrite(RTC_PRESSURE_HISTORY_OFFSET, (uint32_t *)&pressureHistory, sizeof(pressureHistory));
+}
+
+void calculatePressureTrend()
+{
+  // Slope of the last hours of locally recorded hourly means, no network needed
+  float hPaPerHour;
+  if (!pressureHistorySlope(pressureHistory, hPaPerHour))
+  {
+    return;
+  }
+
+  int trend = classifyPressureTrend(3 * hPaPerHour, pressureTrend);
+  if (trend == pressureTrend)
+  {
+    return;
+  }
+  pressureTrend = trend;
+  LOGV("Pressure trend changed: %.2f hPa/3h, tendency characteristic %d, category: %d\n", 3 * hPaPerHour,
+       pressureTendencyCharacteristic(pressureHistory), pressureTrend);
+}
+
+void readStatsBody(const uint8_t *data, size_t length, void *context)
+{
+  statsCsvFeed(*(StatsCsvParser *)context, data, length);
+}
+
+void backfillPressureHistory()
+{
+  // Only needed after a cold boot, when the RTC memory holds no local history
+  LOGV("Backfilling pressure history from OpenSenseMap statistics API...\n");
+
+  // Get current time for API request
+  time_t now = time(nullptr);
+  time_t twelveHoursAgo = now - (12 * 3600); // 12 hours ago
+
+  // Copy the tm structures to avoid overwriting by subsequent gmtime calls
+  struct tm tm_now = *gmtime(&now);
+  struct tm tm_12h = *gmtime(&twelveHoursAgo);
+
+  char time_now[32], time_12h[32];
+  strftime(time_now, sizeof(time_now), "%Y-%m-%dT%H:%M:%SZ", &tm_now);
+  strftime(time_12h, sizeof(time_12h), "%Y-%m-%dT%H:%M:%SZ", &tm_12h);
+
+  // Use statistics API to get arithmetic means for 1-hour windows (more data points)
+  ArenaMark mark = arenaMark();
+  char *path = arenaArray<char>(BACKFILL_PATH_SIZE);
+  if (!path)
+  {
+    return;
+  }
+  snprintf(path, BACKFILL_PATH_SIZE,
+           "/statistics/descriptive?boxId=%s&phenomenon=Pressure&from-date=%s&to-date=%s"
+           "&operation=arithmeticMean&window=1h&format=tidy",
+           OSEM_BOX_ID, time_12h, time_now);
+
+  LOGV("Time range: %s to %s\n", time_12h, time_now);
+
+  // Parse the response as it arrives, no payload buffering
+  float pressureMeans[15] = {0};
+  StatsCsvParser parser;
+  statsCsvBegin(parser, pressureMeans, 15);
+
+  HttpRequest request = {};
+  request.method = "GET";
+  request.host = API_HOST;
+  request.port = 443;
+  request.secure = true;
+  request.path = path;
+  request.readBody = readStatsBody;
+  request.context = &parser;
+  // The CSV arrives in small records if the server negotiates max fragment length
+  request.tlsRxBuffer = 1024;
+  request.tlsTxBuffer = 512;
+  uint32_t connectUs = 0;
+  request.connectUs = &connectUs;
+
+  unsigned long start = millis();
+  int status = httpSendWithRetry(request, 3);
+  statsCsvFinish(parser);
+  arenaRewind(mark);
+  telemetryRecord(PHASE_TREND_FETCH, (millis() - start) * 1000);
+  if (connectUs)
+    telemetryRecord(PHASE_TLS_HANDSHAKE, connectUs);
+
+  int validMeans = parser.count;
+  LOGV("HTTP status: %d, CSV lines: %u, rejected: %u, valid measurements: %d\n", status,
+       (unsigned)parser.lines, (unsigned)parser.rejected, validMeans);
+
+  if (status != 200)
+  {
+    Serial.println("No statistics data received");
+    return;
+  }
+
+  if (validMeans < 2)
+  {
+    Serial.print("Not enough time windows to backfill history. Found: ");
+    Serial.print(validMeans);
+    Serial.println(" valid data points (need at least 2)");
+    return;
+  }
+
+  LOGV("Successfully parsed %d valid pressure measurements\n", validMeans);
+
+  // The last window is the running hour, which the local sampler covers from now on
+  uint32_t nowHour = time(nullptr) / 3600;
+  PressureHistory running = pressureHistory;
+  pressureHistoryReset(pressureHistory);
+  for (int i = 0; i < validMeans - 1; i++)
+  {
+    pressureHistoryPush(pressureHistory, pressureMeans[i]);
+  }
+  pressureHistory.currentHour = nowHour;
+  if (running.currentHour == nowHour)
+  {
+    pressureHistory.sum = running.sum;
+    pressureHistory.samples = running.samples;
+  }
+  savePressureHistory();
+  calculatePressureTrend();
+}
+
+void drawTrendArrow()
+{
+  // Draw 16x16 pixel arrow in top-left corner
+  int x = TREND_ARROW_X;
+  int y = TREND_ARROW_Y;
+
+  const unsigned char* bitmap = nullptr;
   
   // Select the appropriate arrow bitmap
   switch (pressureTrend)
@@ -647,100 +2131,308 @@ void drawTrendArrow()
   }
 }
 
-void setup()
+bool loadRtcState()
 {
-  Serial.begin(115200);
-  Wire.begin(2, 14);
+  ESP.rtcUserMemoryRead(RTC_STATE_OFFSET, (uint32_t *)&rtcState, sizeof(rtcState));
+  return rtcState.magic == RTC_STATE_MAGIC &&
+         rtcState.crc == crc32(&rtcState, offsetof(RtcState, crc));
+}
+
+void enterDeepSleep(uint32_t sleepMs)
+{
+  unsigned long now = nowMs();
+  unsigned long wakeAt = now + sleepMs;
+
+  rtcState.magic = RTC_STATE_MAGIC;
+  rtcState.uptimeMs = wakeAt;
+  rtcState.taskSuspended = 0;
+  for (int i = 0; i < TASK_COUNT; i++)
+  {
+    rtcState.taskNextRun[i] = tasks[i].nextRun;
+    if (tasks[i].suspended)
+      rtcState.taskSuspended |= 1UL << i;
+  }
+  rtcState.timeSync = timeSync;
+  rtcState.pressureTrend = pressureTrend;
+  memcpy(rtcState.sensorStats, sensorStats, sizeof(sensorStats));
+  memcpy(rtcState.ds18b20Addresses, ds18b20Addresses, sizeof(ds18b20Addresses));
+  rtcState.lastAwakeMs = millis();
+
+  rtcState.wallClockOffsetMs = 0;
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  if (tv.tv_sec > 100000)
+  {
+    rtcState.wallClockOffsetMs = (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000 - now;
+  }
+
+  // Only power up the radio on the wake that will need it. Tasks due shortly
+  // after the wake run in the same wake, so they count as well.
+  bool radioNeeded = radioDueAt(wakeAt + DEEP_SLEEP_MIN_MS);
+  rtcState.networkJobs = networkJobs;
+  rtcState.radioOff = !radioNeeded;
+
+  rtcState.crc = crc32(&rtcState, offsetof(RtcState, crc));
+  ESP.rtcUserMemoryWrite(RTC_STATE_OFFSET, (uint32_t *)&rtcState, sizeof(rtcState));
+
+  LOGV("Awake for %u ms, sleeping %u ms\n", (unsigned)rtcState.lastAwakeMs, (unsigned)sleepMs);
+  ESP.deepSleep((uint64_t)sleepMs * 1000, radioNeeded ? WAKE_RF_DEFAULT : WAKE_RF_DISABLED);
+}
+
+void warmWake()
+{
+  // Fast path: no boot screen, no sensor probing, clock restored from RTC memory
+  uptimeBase = rtcState.uptimeMs;
+  for (int i = 0; i < TASK_COUNT; i++)
+  {
+    tasks[i].nextRun = rtcState.taskNextRun[i];
+    tasks[i].suspended = rtcState.taskSuspended & (1UL << i);
+  }
+  timeSync = rtcState.timeSync;
+  pressureTrend = rtcState.pressureTrend;
+  networkJobs = rtcState.networkJobs;
+  radioOff = rtcState.radioOff;
+  memcpy(sensorStats, rtcState.sensorStats, sizeof(sensorStats));
+  for (int i = 0; i < SENSOR_COUNT; i++)
+  {
+    sensorValues[i] = sensorStatsLatest(sensorStats[i]);
+  }
+
+  if (rtcState.wallClockOffsetMs != 0)
+  {
+    int64_t epochMs = rtcState.wallClockOffsetMs + nowMs();
+    struct timeval tv = {(time_t)(epochMs / 1000), (suseconds_t)(epochMs % 1000) * 1000};
+    settimeofday(&tv, nullptr);
+    setTimezone();
+  }
+
+  i2cBusBegin(2, 14);
+  if (!beginDisplay())
+  {
+    Serial.println("OLED failed");
+    return;
+  }
+  display.setTextColor(SSD1306_WHITE);
+
+  bmpOk = bmp280Begin(rtcState.bmpAddress);
+  // The probe keeps its resolution while powered, the cached ROM skips the bus search of begin()
+  memcpy(ds18b20Addresses, rtcState.ds18b20Addresses, sizeof(ds18b20Addresses));
+  ds18b20Ok = false;
+  for (int p = 0; p < DS18B20_PROBE_COUNT; p++)
+    ds18b20Ok |= ds18b20Addresses[p][0] != 0;
+  ds18b20.setWaitForConversion(false);
+
+  loadPressureHistory();
+  loadWifiCache();
+  queueOk = uploadQueueBegin();
+  if (queueOk)
+    historyBegin(SENSORS);
+}
+
+// Enumerate the OneWire bus once and assign the ROM codes to the probes
+void findDs18b20Probes()
+{
+  memset(ds18b20Addresses, 0, sizeof(ds18b20Addresses));
+  ds18b20Ok = false;
+  ds18b20.begin();
+  uint8_t found = ds18b20.getDeviceCount();
+  uint8_t next = 0;
+  for (uint8_t i = 0; i < found; i++)
+  {
+    DeviceAddress rom;
+    if (!ds18b20.getAddress(rom, i))
+      continue;
+
+    int probe = -1;
+    for (int p = 0; p < DS18B20_PROBE_COUNT; p++)
+    {
+      if (PROBES[p].rom ? memcmp(rom, PROBE_ROMS.rom[p], 8) == 0 : p == next)
+        probe = p;
+    }
+    char hex[17];
+    for (int b = 0; b < 8; b++)
+      snprintf(hex + 2 * b, 3, "%02X", rom[b]);
+    if (probe < 0)
+    {
+      Serial.printf("DS18B20 %s is not assigned, see DS18B20_PROBES\n", hex);
+      continue;
+    }
+    LOGV("DS18B20 %s is probe %d\n", hex, probe);
+    memcpy(ds18b20Addresses[probe], rom, 8);
+    ds18b20.setResolution(rom, DS18B20_RESOLUTION);
+    ds18b20Ok = true;
+    next++;
+  }
+
+  for (int p = 0; p < DS18B20_PROBE_COUNT; p++)
+  {
+    if (ds18b20Addresses[p][0] == 0)
+      Serial.printf("DS18B20 probe %d not found\n", p);
+  }
+}
+
+bool coldBoot()
+{
+  i2cBusBegin(2, 14);
   delay(100);
 
-  if (!display.begin(SSD1306_SWITCHCAPVCC, 0x3C))
+  if (!beginDisplay())
   {
     Serial.println("OLED failed");
     while (1)
       ;
   }
 
-  display.clearDisplay();
   display.setTextColor(SSD1306_WHITE);
-  display.display();
   showBootScreen();
 
-  if (!bmp.begin(0x76))
+  rtcState.bmpAddress = 0x76;
+  if (!bmp280Begin(0x76))
   {
-    if (!bmp.begin(0x77))
+    rtcState.bmpAddress = 0x77;
+    if (!bmp280Begin(0x77))
     {
       showError("BMP280 MISSING");
-      return;
+      return false;
     }
   }
   bmpOk = true;
 
-  ds18b20.begin();
+  findDs18b20Probes();
+  ds18b20.setWaitForConversion(false);
 
-  if (!lightMeter.begin(BH1750::CONTINUOUS_HIGH_RES_MODE))
+  if (!bh1750Start(BH1750_MODE))
   {
     showError("BH1750 MISSING");
-    return;
+    return false;
   }
 
-  connectWiFi();
-  syncTime();
-  
-  // Calculate initial pressure trend during startup
-  calculatePressureTrend();
-  lastTrendUpdate = millis();
-  
-  disconnectWiFi();
+  loadPressureHistory();
+  loadWifiCache();
+  queueOk = uploadQueueBegin();
+  if (!queueOk)
+  {
+    Serial.println("LittleFS mount failed, uploads are not queued");
+  }
+  else
+  {
+    historyBegin(SENSORS);
+  }
 
-  lastSensorRead = millis();
-  lastDisplayUpdate = millis();
-  lastUpload = millis();
-  lastTimeSync = millis();
+  timeSyncReset(timeSync);
 
-  updateSensor();
-  updateDisplay();
+  // Local history is lost on power-up, fetch it once from the API
+  uint8_t jobs = JOB_TIME_SYNC;
+  if (pressureHistoryPoints(pressureHistory) < 2)
+  {
+    jobs |= JOB_BACKFILL;
+  }
+  requestNetwork(jobs);
+  return true;
 }
 
-void loop()
+void setup()
 {
-  unsigned long now = millis();
+  Serial.begin(115200);
+  setTimezone();
+  httpSetIdleHook([]() { schedulerYield(scheduler); });
+  mqttSetIdleHook([]() { schedulerYield(scheduler); });
+  publishSetup(MIRRORS, sizeof(MIRRORS) / sizeof(MIRRORS[0]), MQTT_CLIENT_ID);
+  settimeofday_cb(onTimeSet);
+
+  bool deepSleepWake = ESP.getResetInfoPtr()->reason == REASON_DEEP_SLEEP_AWAKE;
+  if (DEEP_SLEEP_MODE && deepSleepWake && loadRtcState())
+  {
+    warmWake();
+    return;
+  }
 
-  if (now - lastSensorRead >= 60000)
+  // Everything starts suspended, the network task was woken by coldBoot() if it has jobs
+  for (int i = 0; i < TASK_COUNT; i++)
+  {
+    tasks[i].suspended = true;
+  }
+  for (int i = 0; i < SENSOR_COUNT; i++)
   {
-    updateSensor();
-    lastSensorRead = now;
+    sensorStatsClear(sensorStats[i]);
   }
+  bool ok = coldBoot();
+#if LAN_MODE
+  beginLanServer();
+#endif
+
+  // The boot screen (or the error) stays up until the first redraw
+  schedulerWake(scheduler, tasks[TASK_SENSOR], 0);
+  schedulerWake(scheduler, tasks[TASK_DISPLAY], ok ? BOOT_SCREEN_MS : SENSOR_INTERVAL_MS);
+  schedulerWake(scheduler, tasks[TASK_UPLOAD], UPLOAD_INTERVAL_MS);
+  schedulerWake(scheduler, tasks[TASK_NTP], TIME_SYNC_MIN_INTERVAL_MS);
+}
+
+struct TraceDump
+{
+  Print *out;
+  uint32_t first; // 0 until the first row is out
+};
 
-  if (now - lastDisplayUpdate >= 60000)
+void dumpTraceRow(uint32_t timestamp, const float *values, void *context)
+{
+  TraceDump &dump = *(TraceDump *)context;
+  static const uint8_t columns[] = {SENSOR_TEMP, SENSOR_PRES, SENSOR_TEMP_OUT, SENSOR_LUX};
+  for (uint8_t s : columns)
   {
-    updateDisplay();
-    lastDisplayUpdate = now;
+    if (isnan(values[s]))
+      return;
   }
+  if (dump.first == 0)
+    dump.first = timestamp;
+  // undo the calibration offset, the simulated BMP280 reports what the chip reads
+  dump.out->printf("%u %.2f %.2f %.2f %.1f\n", timestamp - dump.first,
+                   values[SENSOR_TEMP] - sensorDef(SENSORS, SENSOR_TEMP).offset, values[SENSOR_PRES],
+                   values[SENSOR_TEMP_OUT], values[SENSOR_LUX]);
+}
 
-  bool uploadDue = (now - lastUpload >= 600000);
-  bool timeSyncDue = (now - lastTimeSync >= 600000);
-  
-  if (uploadDue || timeSyncDue)
+// The last day of the flash history as a native simulator script, see
+// lib/native_sim/compare_policies.sh
+void dumpTrace(Print &out)
+{
+  if (!queueOk || !timeValid())
+    return;
+  uint32_t now = time(nullptr);
+  out.printf("# recorded from %u: seconds temp pres ds18b20 lux\n", now - 86400);
+  TraceDump dump = {&out, 0};
+  historyScan(now - 86400, dumpTraceRow, &dump);
+}
+
+// Single-key commands on the serial console: 't' prints the statistics,
+// 'r' resets the telemetry, 'h' dumps the last day as a simulator trace
+void handleConsole()
+{
+  while (Serial.available() > 0)
   {
-    connectWiFi();
-    
-    if (uploadDue)
-    {
-      uploadToOSeM();
-      // Calculate pressure trend after uploading data (while WiFi is still connected)
-      calculatePressureTrend();
-      lastTrendUpdate = millis();
-      lastUpload = now;
-    }
-    
-    if (timeSyncDue)
-    {
-      syncTime();
-      lastTimeSync = now;
-    }
-    
-    disconnectWiFi();
+    int c = Serial.read();
+    if (c == 't')
+      printStats(Serial);
+    else if (c == 'r')
+      telemetryReset();
+    else if (c == 'h')
+      dumpTrace(Serial);
   }
+}
 
-  delay(5000);
-}
\ No newline at end of file
+void loop()
+{
+  uint32_t wait = schedulerRun(scheduler);
+  handleConsole();
+
+#if DEEP_SLEEP_MODE
+  if (wait >= DEEP_SLEEP_MIN_MS)
+  {
+    enterDeepSleep(wait == TASK_SUSPEND ? SENSOR_INTERVAL_MS : wait);
+  }
+#endif
+
+  // Nothing is due before then, idle (the WiFi stack keeps running in delay)
+  arenaReset();
+  delay(wait < 1000 ? wait : 1000);
+}
+#endif // PIO_UNIT_TESTING
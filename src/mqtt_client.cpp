@@ -0,0 +1,136 @@
+#include "mqtt_client.h"
+#include <Arduino.h>
+#include <string.h>
+
+enum
+{
+  MQTT_CONNECT = 0x10,
+  MQTT_CONNACK = 0x20,
+  MQTT_PUBLISH_QOS1 = 0x32,
+  MQTT_PUBACK = 0x40,
+  MQTT_DISCONNECT = 0xe0
+};
+
+static void (*idleHook)() = nullptr;
+static uint16_t packetId = 0;
+
+void mqttSetIdleHook(void (*hook)())
+{
+  idleHook = hook;
+}
+
+// Remaining length, 1 to 4 bytes of 7 bits each
+static size_t putLength(uint8_t *out, size_t length)
+{
+  size_t n = 0;
+  do
+  {
+    uint8_t byte = length & 0x7f;
+    length >>= 7;
+    out[n++] = length ? byte | 0x80 : byte;
+  } while (length && n < 4);
+  return n;
+}
+
+static size_t putString(uint8_t *out, const char *s)
+{
+  size_t length = strlen(s);
+  out[0] = length >> 8;
+  out[1] = length & 0xff;
+  memcpy(out + 2, s, length);
+  return length + 2;
+}
+
+// The 4 byte answer to CONNECT or PUBLISH: type, length 2, two bytes
+static bool readAck(Client &client, uint8_t type, uint8_t *body)
+{
+  uint8_t packet[4];
+  size_t received = 0;
+  unsigned long start = millis();
+  while (received < sizeof(packet))
+  {
+    int n = client.read(packet + received, sizeof(packet) - received);
+    if (n > 0)
+    {
+      received += n;
+      continue;
+    }
+    if (!client.connected() || millis() - start > MQTT_TIMEOUT_MS)
+      return false;
+    delay(1);
+    if (idleHook)
+      idleHook();
+  }
+  memcpy(body, packet + 2, 2);
+  return packet[0] == type && packet[1] == 2;
+}
+
+bool mqttConnect(Client &client, const char *host, uint16_t port, const char *clientId, const char *user,
+                 const char *password)
+{
+  size_t idLength = strlen(clientId);
+  size_t userLength = user ? strlen(user) : 0;
+  size_t passwordLength = password ? strlen(password) : 0;
+  uint8_t packet[160];
+  size_t remaining = 10 + 2 + idLength + (user ? 2 + userLength : 0) + (password ? 2 + passwordLength : 0);
+  if (remaining + 5 > sizeof(packet))
+    return false;
+
+  client.setTimeout(MQTT_TIMEOUT_MS);
+  if (!client.connect(host, port))
+    return false;
+
+  static const uint8_t PROTOCOL[] = {0, 4, 'M', 'Q', 'T', 'T', 4};
+  size_t n = 0;
+  packet[n++] = MQTT_CONNECT;
+  n += putLength(packet + n, remaining);
+  memcpy(packet + n, PROTOCOL, sizeof(PROTOCOL));
+  n += sizeof(PROTOCOL);
+  packet[n++] = 0x02 | (user ? 0x80 : 0) | (password ? 0x40 : 0); // clean session
+  packet[n++] = MQTT_KEEP_ALIVE_S >> 8;
+  packet[n++] = MQTT_KEEP_ALIVE_S & 0xff;
+  n += putString(packet + n, clientId);
+  if (user)
+    n += putString(packet + n, user);
+  if (password)
+    n += putString(packet + n, password);
+  client.write(packet, n);
+
+  // Session present flag and return code, 0 is accepted
+  uint8_t ack[2];
+  if (!readAck(client, MQTT_CONNACK, ack) || ack[1] != 0)
+  {
+    client.stop();
+    return false;
+  }
+  return true;
+}
+
+bool mqttPublish(Client &client, const char *topic, const uint8_t *payload, size_t length)
+{
+  size_t topicLength = strlen(topic);
+  uint8_t head[5 + 2 + 64 + 2];
+  if (topicLength > 64)
+    return false;
+
+  packetId = packetId == 0xffff ? 1 : packetId + 1;
+  size_t n = 0;
+  head[n++] = MQTT_PUBLISH_QOS1;
+  n += putLength(head + n, 2 + topicLength + 2 + length);
+  n += putString(head + n, topic);
+  head[n++] = packetId >> 8;
+  head[n++] = packetId & 0xff;
+  if (client.write(head, n) != n || client.write(payload, length) != length)
+    return false;
+
+  uint8_t ack[2];
+  return readAck(client, MQTT_PUBACK, ack) && ack[0] == (packetId >> 8) && ack[1] == (packetId & 0xff);
+}
+
+void mqttDisconnect(Client &client)
+{
+  static const uint8_t PACKET[] = {MQTT_DISCONNECT, 0};
+  if (client.connected())
+    client.write(PACKET, sizeof(PACKET));
+  client.stop();
+}
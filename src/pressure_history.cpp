@@ -0,0 +1,162 @@
+#include "pressure_history.h"
+#include "crc32.h"
+#include <stddef.h>
+#include <string.h>
+
+static uint32_t pressureHistoryCrc(const PressureHistory &history)
+{
+  return crc32(&history, offsetof(PressureHistory, crc));
+}
+
+void pressureHistoryReset(PressureHistory &history)
+{
+  memset(&history, 0, sizeof(history));
+  history.magic = PRESSURE_HISTORY_MAGIC;
+  pressureHistorySeal(history);
+}
+
+bool pressureHistoryValid(const PressureHistory &history)
+{
+  return history.magic == PRESSURE_HISTORY_MAGIC &&
+         history.head < PRESSURE_HISTORY_SLOTS &&
+         history.count <= PRESSURE_HISTORY_SLOTS &&
+         history.crc == pressureHistoryCrc(history);
+}
+
+void pressureHistorySeal(PressureHistory &history)
+{
+  history.crc = pressureHistoryCrc(history);
+}
+
+// Mean of a closed hour, age 0 is the newest
+static float closedMean(const PressureHistory &history, int age)
+{
+  return history.means[(history.head + 2 * PRESSURE_HISTORY_SLOTS - 1 - age) % PRESSURE_HISTORY_SLOTS];
+}
+
+void pressureHistoryPush(PressureHistory &history, float mean)
+{
+  // Every x moves one hour back, which takes sum(y) off sum(xy). The mean
+  // leaving the window is at x = -PRESSURE_SLOPE_POINTS by then.
+  history.slopeSumXY -= history.slopeSumY;
+  if (history.count >= PRESSURE_SLOPE_POINTS)
+  {
+    float leaving = closedMean(history, PRESSURE_SLOPE_POINTS - 1) - PRESSURE_SLOPE_REFERENCE;
+    history.slopeSumY -= leaving;
+    history.slopeSumXY += PRESSURE_SLOPE_POINTS * leaving;
+  }
+  history.slopeSumY += mean - PRESSURE_SLOPE_REFERENCE;
+
+  history.means[history.head] = mean;
+  history.head = (history.head + 1) % PRESSURE_HISTORY_SLOTS;
+  if (history.count < PRESSURE_HISTORY_SLOTS)
+  {
+    history.count++;
+  }
+}
+
+bool pressureHistoryAddSample(PressureHistory &history, uint32_t hour, float pressure)
+{
+  bool stored = false;
+
+  if (hour != history.currentHour)
+  {
+    if (hour == history.currentHour + 1 && history.samples > 0)
+    {
+      pressureHistoryPush(history, history.sum / history.samples);
+      stored = true;
+    }
+    else if (hour != history.currentHour + 1)
+    {
+      // Hours were skipped (or the clock jumped), the slots are no longer consecutive
+      history.head = 0;
+      history.count = 0;
+      history.slopeSumY = 0;
+      history.slopeSumXY = 0;
+    }
+    history.currentHour = hour;
+    history.sum = 0;
+    history.samples = 0;
+  }
+
+  history.sum += pressure;
+  history.samples++;
+  return stored;
+}
+
+int pressureHistoryPoints(const PressureHistory &history)
+{
+  return history.count + (history.samples > 0 ? 1 : 0);
+}
+
+bool pressureHistorySlope(const PressureHistory &history, float &hPaPerHour)
+{
+  int n = history.count < PRESSURE_SLOPE_POINTS ? history.count : PRESSURE_SLOPE_POINTS;
+  if (n < 2)
+  {
+    return false;
+  }
+  // x runs from -(n - 1) to 0
+  float sumX = -0.5f * n * (n - 1);
+  float sumXX = (n - 1) * n * (2 * n - 1) / 6.0f;
+  hPaPerHour = (n * history.slopeSumXY - sumX * history.slopeSumY) / (n * sumXX - sumX * sumX);
+  return true;
+}
+
+int pressureTendencyCharacteristic(const PressureHistory &history)
+{
+  if (history.count < 4)
+  {
+    return -1;
+  }
+  // Changes in the first and second half of the 3 hours and overall. Below
+  // 0.1 hPa, the resolution of a station report, a change counts as steady.
+  const float steady = 0.1f;
+  float middle = (closedMean(history, 1) + closedMean(history, 2)) / 2;
+  float first = middle - closedMean(history, 3);
+  float second = closedMean(history, 0) - middle;
+  float total = closedMean(history, 0) - closedMean(history, 3);
+
+  if (first > steady && second < -steady)
+    return total >= 0 ? 0 : 8; // up then down
+  if (first < -steady && second > steady)
+    return total <= 0 ? 5 : 3; // down then up
+  if (total > steady)
+  {
+    if (second <= steady || second < first / 2)
+      return 1; // then steady or slower
+    return second > 2 * first ? 3 : 2;
+  }
+  if (total < -steady)
+  {
+    if (second >= -steady || second > first / 2)
+      return 6;
+    return second < 2 * first ? 8 : 7;
+  }
+  return 4;
+}
+
+static int trendCategory(float hPaPer3h)
+{
+  if (hPaPer3h >= PRESSURE_TREND_HARD)
+    return TREND_HARD_UP;
+  if (hPaPer3h >= PRESSURE_TREND_SLIGHT)
+    return TREND_SLIGHT_UP;
+  if (hPaPer3h > -PRESSURE_TREND_SLIGHT)
+    return TREND_FLAT;
+  if (hPaPer3h > -PRESSURE_TREND_HARD)
+    return TREND_SLIGHT_DOWN;
+  return TREND_HARD_DOWN;
+}
+
+int classifyPressureTrend(float hPaPer3h, int previous)
+{
+  int category = trendCategory(hPaPer3h);
+  if (category == previous || previous < TREND_HARD_UP || previous > TREND_HARD_DOWN)
+  {
+    return category;
+  }
+  // Judge the move with the rate pulled back towards the previous category
+  return trendCategory(category < previous ? hPaPer3h - PRESSURE_TREND_HYSTERESIS
+                                           : hPaPer3h + PRESSURE_TREND_HYSTERESIS);
+}
@@ -0,0 +1,187 @@
+#include "publisher.h"
+#include "fixed_format.h"
+#include "http_client.h"
+#include "memory_budget.h"
+#include "mqtt_client.h"
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+#include <math.h>
+#include <string.h>
+
+static char buffer[PUBLISH_BUFFER_SIZE];
+static size_t bufferLength = 0;
+static size_t bufferLines = 0;
+
+static const MirrorDef *mirrors = nullptr;
+static uint8_t mirrorCount = 0;
+static const char *mqttClientId = nullptr;
+static MirrorStats stats[PUBLISH_MAX_MIRRORS];
+static WiFiClient mqttClient; // open from the first batch to publishEnd()
+static bool mqttOpen = false;
+
+static_assert(sizeof(buffer) + sizeof(stats) + sizeof(mqttClient) <= RAM_BUDGET_PUBLISH,
+              "publisher over its RAM budget");
+
+// Appends text, false if it does not fit
+static bool append(char *line, size_t &length, const char *text, size_t textLength)
+{
+  if (length + textLength > PUBLISH_BUFFER_SIZE - bufferLength)
+    return false;
+  memcpy(line + length, text, textLength);
+  length += textLength;
+  return true;
+}
+
+size_t publishSerialise(const char *prefix, const SensorDef *sensors, const QueuedReading *readings, size_t count)
+{
+  bufferLength = 0;
+  bufferLines = 0;
+  size_t done = 0;
+  for (; done < count; done++)
+  {
+    const QueuedReading &r = readings[done];
+    char *line = buffer + bufferLength;
+    size_t length = 0;
+    bool fit = append(line, length, prefix, strlen(prefix));
+    char separator = ' ';
+    for (int s = 0; fit && s < SENSOR_COUNT; s++)
+    {
+      if (isnan(r.values[s]))
+        continue;
+      SensorDef def = sensorDef(sensors, s);
+      char value[16];
+      size_t valueLength = formatFixed(value, sizeof(value), r.values[s], def.decimals, "");
+      fit = append(line, length, &separator, 1) && append(line, length, def.field, strlen(def.field)) &&
+            append(line, length, "=", 1) && append(line, length, value, valueLength);
+      separator = ',';
+    }
+    if (fit && r.timestamp != 0)
+    {
+      char timestamp[12];
+      int timestampLength = snprintf(timestamp, sizeof(timestamp), " %u", (unsigned)r.timestamp);
+      fit = append(line, length, timestamp, timestampLength);
+    }
+    fit = fit && append(line, length, "\n", 1);
+    if (!fit)
+      break;
+    if (separator == ',') // a line without fields is not valid line protocol
+    {
+      bufferLength += length;
+      bufferLines++;
+    }
+  }
+  return done;
+}
+
+void publishSetup(const MirrorDef *table, uint8_t count, const char *clientId)
+{
+  mirrors = table;
+  mirrorCount = count < PUBLISH_MAX_MIRRORS ? count : PUBLISH_MAX_MIRRORS;
+  mqttClientId = clientId;
+}
+
+bool publishActive()
+{
+  for (uint8_t i = 0; i < mirrorCount; i++)
+  {
+    if (mirrors[i].enabled)
+      return true;
+  }
+  return false;
+}
+
+void publishBegin()
+{
+  for (uint8_t i = 0; i < mirrorCount; i++)
+    stats[i].down = false;
+}
+
+static void writeBuffer(Print &out, void *)
+{
+  out.write((const uint8_t *)buffer, bufferLength);
+}
+
+static bool sendMqtt(const MirrorDef &mirror)
+{
+  if (!mqttOpen)
+  {
+    mqttOpen = mqttConnect(mqttClient, mirror.host, mirror.port, mqttClientId, mirror.user, mirror.password);
+    if (!mqttOpen)
+      return false;
+  }
+  if (mqttPublish(mqttClient, mirror.target, (const uint8_t *)buffer, bufferLength))
+    return true;
+  mqttClient.stop(); // the broker may still acknowledge it, QoS 1 allows the resend
+  mqttOpen = false;
+  return false;
+}
+
+static bool sendHttp(const MirrorDef &mirror)
+{
+  HttpRequest request = {};
+  request.method = "POST";
+  request.host = mirror.host;
+  request.port = mirror.port;
+  request.path = mirror.target;
+  request.headers = mirror.user;
+  request.contentLength = bufferLength;
+  request.writeBody = writeBuffer;
+  int status = httpSend(request); // the next session resends, no retries here
+  return status >= 200 && status < 300;
+}
+
+static bool sendUdp(const MirrorDef &mirror)
+{
+  WiFiUDP udp;
+  return udp.beginPacket(mirror.host, mirror.port) &&
+         udp.write((const uint8_t *)buffer, bufferLength) == bufferLength && udp.endPacket();
+}
+
+bool publishMirrors()
+{
+  bool accepted = false;
+  if (bufferLines == 0)
+    return true;
+  for (uint8_t i = 0; i < mirrorCount; i++)
+  {
+    const MirrorDef &mirror = mirrors[i];
+    MirrorStats &s = stats[i];
+    if (!mirror.enabled || s.down)
+      continue;
+    bool ok = mirror.transport == MIRROR_MQTT ? sendMqtt(mirror)
+              : mirror.transport == MIRROR_HTTP ? sendHttp(mirror)
+                                                : sendUdp(mirror);
+    if (ok)
+    {
+      s.batches++;
+      s.lines += bufferLines;
+      s.bytes += bufferLength;
+      accepted = true;
+    }
+    else
+    {
+      s.failures++;
+      s.down = true;
+      Serial.printf("Mirror %s failed, skipped until the next session\n", mirror.name);
+    }
+  }
+  return accepted;
+}
+
+void publishEnd()
+{
+  if (mqttOpen)
+    mqttDisconnect(mqttClient);
+  mqttOpen = false;
+}
+
+void publishDump(Print &out)
+{
+  for (uint8_t i = 0; i < mirrorCount; i++)
+  {
+    if (!mirrors[i].enabled)
+      continue;
+    out.printf("Mirror %-6s %u batches, %u lines, %u bytes, %u failures\n", mirrors[i].name, stats[i].batches,
+               stats[i].lines, stats[i].bytes, stats[i].failures);
+  }
+}
@@ -0,0 +1,25 @@
+#include "sbx_encoder.h"
+#include <string.h>
+
+static void putLittleEndian(uint8_t *out, uint32_t value)
+{
+  out[0] = value;
+  out[1] = value >> 8;
+  out[2] = value >> 16;
+  out[3] = value >> 24;
+}
+
+size_t sbxEncode(uint8_t *out, const SbxSensorId &id, float value, bool withTimestamp, uint32_t timestamp)
+{
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+
+  memcpy(out, id.bytes, SBX_ID_LENGTH);
+  putLittleEndian(out + SBX_ID_LENGTH, bits);
+  if (!withTimestamp)
+  {
+    return SBX_MEASUREMENT_LENGTH;
+  }
+  putLittleEndian(out + SBX_MEASUREMENT_LENGTH, timestamp);
+  return SBX_MEASUREMENT_TS_LENGTH;
+}
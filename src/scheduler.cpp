@@ -0,0 +1,96 @@
+#include "scheduler.h"
+
+static bool isDue(const Task &task, uint32_t now)
+{
+  return !task.suspended && !task.running && (int32_t)(task.nextRun - now) <= 0;
+}
+
+// Earliest due task, or nullptr
+static Task *nextDue(Scheduler &scheduler, uint32_t now, uint32_t ranMask)
+{
+  Task *best = nullptr;
+  for (uint8_t i = 0; i < scheduler.count; i++)
+  {
+    Task &task = scheduler.tasks[i];
+    if ((ranMask & (1UL << i)) || !isDue(task, now))
+      continue;
+    if (!best || (int32_t)(task.nextRun - best->nextRun) < 0)
+      best = &task;
+  }
+  return best;
+}
+
+static void runTask(Scheduler &scheduler, Task &task)
+{
+  uint32_t outerNestedUs = scheduler.nestedUs;
+  scheduler.nestedUs = 0;
+
+  uint32_t startMs = scheduler.millisClock();
+  uint32_t startUs = scheduler.microsClock();
+  task.running = true;
+  uint32_t delayMs = task.step();
+  task.running = false;
+  uint32_t elapsedUs = scheduler.microsClock() - startUs;
+
+  uint32_t ownUs = elapsedUs - scheduler.nestedUs;
+  task.runs++;
+  task.totalUs += ownUs;
+  if (ownUs > task.maxUs)
+    task.maxUs = ownUs;
+  scheduler.nestedUs = outerNestedUs + elapsedUs;
+
+  if (delayMs == TASK_SUSPEND)
+  {
+    task.suspended = true;
+  }
+  else
+  {
+    // Relative to the start of the step, so the step's own duration does not drift the cadence
+    task.suspended = false;
+    task.nextRun = startMs + delayMs;
+  }
+}
+
+void schedulerWake(Scheduler &scheduler, Task &task, uint32_t delayMs)
+{
+  task.suspended = false;
+  task.nextRun = scheduler.millisClock() + delayMs;
+}
+
+uint32_t schedulerRun(Scheduler &scheduler)
+{
+  scheduler.nestedUs = 0;
+  schedulerYield(scheduler);
+
+  uint32_t now = scheduler.millisClock();
+  uint32_t wait = TASK_SUSPEND;
+  for (uint8_t i = 0; i < scheduler.count; i++)
+  {
+    const Task &task = scheduler.tasks[i];
+    if (task.suspended)
+      continue;
+    int32_t remaining = (int32_t)(task.nextRun - now);
+    uint32_t taskWait = remaining > 0 ? (uint32_t)remaining : 0;
+    if (taskWait < wait)
+      wait = taskWait;
+  }
+  return wait;
+}
+
+void schedulerYield(Scheduler &scheduler)
+{
+  // Each due task runs at most once per call, a task that is due again
+  // right away cannot starve the others
+  uint32_t ranMask = 0;
+  Task *task;
+  while ((task = nextDue(scheduler, scheduler.millisClock(), ranMask)) != nullptr)
+  {
+    ranMask |= 1UL << (task - scheduler.tasks);
+    runTask(scheduler, *task);
+  }
+}
+
+uint32_t schedulerAverageUs(const Task &task)
+{
+  return task.runs ? (uint32_t)(task.totalUs / task.runs) : 0;
+}
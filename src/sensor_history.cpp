@@ -0,0 +1,414 @@
+#include "sensor_history.h"
+#include "crc32.h"
+#include <LittleFS.h>
+#include <math.h>
+#include <string.h>
+
+#define HISTORY_POS "/hist.pos"
+#define HISTORY_MAGIC 0x53424831 // "SBH1"
+#define HISTORY_MISSING INT32_MIN // no value, also the escape in the value code
+#define HISTORY_MAX_QUANTIZED 1000000000 // keeps differences clear of INT32_MIN
+
+struct SegmentHeader
+{
+  uint32_t magic;
+  uint32_t layout; // CRC of the sensor count and precisions
+  uint32_t seq;    // segment number, stored in file seq % HISTORY_SEGMENTS
+  uint32_t firstTimestamp;
+};
+
+// What encoder and decoder remember between records
+struct Cursor
+{
+  uint32_t records; // in the segment so far
+  uint32_t timestamp;
+  int32_t delta;
+  int32_t values[SENSOR_COUNT]; // quantized
+};
+
+// A record is at most a raw timestamp plus a 36 bit code per value
+struct BitWriter
+{
+  uint8_t bytes[(32 + 36 * SENSOR_COUNT + 7) / 8];
+  uint16_t bits;
+};
+
+struct BitReader
+{
+  File *file;
+  uint8_t buffer[64];
+  uint8_t length;    // bytes in buffer
+  uint8_t next;      // next unread byte in buffer
+  uint8_t current;   // byte the bits come from
+  uint8_t bitsLeft;  // unread bits in current
+  uint32_t consumed; // bytes taken from the file
+  bool eof;
+};
+
+static bool historyReady = false;
+static uint32_t historyLayout = 0;
+static float historyScales[SENSOR_COUNT]; // quantization steps per unit
+static uint32_t currentSeq = 0;           // running segment
+static Cursor writer;
+static bool writerLoaded = false; // writer mirrors the running segment
+
+static void segmentPath(char *path, size_t size, uint32_t seq)
+{
+  snprintf(path, size, "/hist%02u", (unsigned)(seq % HISTORY_SEGMENTS));
+}
+
+static bool openSegment(File &f, uint32_t seq, SegmentHeader &header)
+{
+  char path[16];
+  segmentPath(path, sizeof(path), seq);
+  f = LittleFS.open(path, "r");
+  return f && f.read((uint8_t *)&header, sizeof(header)) == sizeof(header) && header.magic == HISTORY_MAGIC &&
+         header.layout == historyLayout && header.seq == seq;
+}
+
+static void savePosition()
+{
+  File f = LittleFS.open(HISTORY_POS, "w");
+  if (f)
+  {
+    f.write((const uint8_t *)&currentSeq, sizeof(currentSeq));
+    f.close();
+  }
+}
+
+// --- Bit level coding -------------------------------------------------------
+
+static void putBits(BitWriter &w, uint32_t value, uint8_t count)
+{
+  for (int i = count - 1; i >= 0; i--)
+  {
+    if (value >> i & 1)
+      w.bytes[w.bits / 8] |= 0x80 >> (w.bits % 8);
+    w.bits++;
+  }
+}
+
+// Prefix code for small signed numbers: 0 | 10 + 5 bits | 110 + 9 bits |
+// 1110 + 16 bits | 1111 + 32 bits
+static void putSigned(BitWriter &w, int32_t v)
+{
+  if (v == 0)
+  {
+    putBits(w, 0, 1);
+  }
+  else if (v >= -16 && v < 16)
+  {
+    putBits(w, 0x2, 2);
+    putBits(w, v & 0x1f, 5);
+  }
+  else if (v >= -256 && v < 256)
+  {
+    putBits(w, 0x6, 3);
+    putBits(w, v & 0x1ff, 9);
+  }
+  else if (v >= -32768 && v < 32768)
+  {
+    putBits(w, 0xe, 4);
+    putBits(w, v & 0xffff, 16);
+  }
+  else
+  {
+    putBits(w, 0xf, 4);
+    putBits(w, (uint32_t)v, 32);
+  }
+}
+
+static int getBit(BitReader &r)
+{
+  if (r.bitsLeft == 0)
+  {
+    if (r.next == r.length)
+    {
+      int n = r.file->read(r.buffer, sizeof(r.buffer));
+      if (n <= 0)
+      {
+        r.eof = true;
+        return 0;
+      }
+      r.length = n;
+      r.next = 0;
+    }
+    r.current = r.buffer[r.next++];
+    r.bitsLeft = 8;
+    r.consumed++;
+  }
+  r.bitsLeft--;
+  return r.current >> r.bitsLeft & 1;
+}
+
+static uint32_t getBits(BitReader &r, uint8_t count)
+{
+  uint32_t value = 0;
+  while (count--)
+    value = value << 1 | getBit(r);
+  return value;
+}
+
+static int32_t getSignedBits(BitReader &r, uint8_t count)
+{
+  uint32_t value = getBits(r, count);
+  uint32_t sign = 1UL << (count - 1);
+  return (int32_t)((value ^ sign) - sign);
+}
+
+static int32_t getSigned(BitReader &r)
+{
+  if (!getBit(r))
+    return 0;
+  if (!getBit(r))
+    return getSignedBits(r, 5);
+  if (!getBit(r))
+    return getSignedBits(r, 9);
+  if (!getBit(r))
+    return getSignedBits(r, 16);
+  return (int32_t)getBits(r, 32);
+}
+
+// --- Records ----------------------------------------------------------------
+
+static int32_t quantize(float value, int sensor)
+{
+  float q = value * historyScales[sensor];
+  if (!(fabsf(q) < HISTORY_MAX_QUANTIZED)) // NAN as well
+    return HISTORY_MISSING;
+  return lroundf(q);
+}
+
+// The first record of a segment carries the raw timestamp and values, the
+// others the change of the interval and of each value
+static void encodeRecord(BitWriter &w, Cursor &c, uint32_t timestamp, const float *values)
+{
+  if (c.records == 0)
+  {
+    putBits(w, timestamp, 32);
+    c.delta = 0;
+  }
+  else
+  {
+    int32_t delta = timestamp - c.timestamp;
+    putSigned(w, delta - c.delta);
+    c.delta = delta;
+  }
+  c.timestamp = timestamp;
+
+  for (int i = 0; i < SENSOR_COUNT; i++)
+  {
+    int32_t q = quantize(values[i], i);
+    int32_t previous = c.records == 0 ? HISTORY_MISSING : c.values[i];
+    if (q == HISTORY_MISSING || previous == HISTORY_MISSING)
+      putSigned(w, q);
+    else
+      putSigned(w, q - previous);
+    c.values[i] = q;
+  }
+  c.records++;
+}
+
+// False at the end of the file, c is undefined after a torn record
+static bool decodeRecord(BitReader &r, Cursor &c)
+{
+  if (c.records == 0)
+  {
+    c.timestamp = getBits(r, 32);
+    c.delta = 0;
+  }
+  else
+  {
+    c.delta += getSigned(r);
+    c.timestamp += c.delta;
+  }
+
+  for (int i = 0; i < SENSOR_COUNT; i++)
+  {
+    int32_t v = getSigned(r);
+    if (v == HISTORY_MISSING || c.records == 0 || c.values[i] == HISTORY_MISSING)
+      c.values[i] = v;
+    else
+      c.values[i] += v;
+  }
+  r.bitsLeft = 0; // records end on a byte boundary
+  if (r.eof)
+    return false;
+  c.records++;
+  return true;
+}
+
+static void readerBegin(BitReader &r, File &f)
+{
+  memset(&r, 0, sizeof(r));
+  r.file = &f;
+}
+
+// Continue the running segment after a reset: replay it to get the
+// encoder state back and cut off a record torn by a reset during append
+static void loadWriter()
+{
+  writerLoaded = true;
+  memset(&writer, 0, sizeof(writer));
+
+  File f;
+  SegmentHeader header;
+  if (!openSegment(f, currentSeq, header))
+    return; // rewritten on the next append
+
+  BitReader r;
+  readerBegin(r, f);
+  Cursor c = writer;
+  uint32_t good = sizeof(header);
+  while (decodeRecord(r, c))
+  {
+    writer = c;
+    good = sizeof(header) + r.consumed;
+  }
+  bool torn = good < f.size();
+  f.close();
+  if (torn)
+  {
+    char path[16];
+    segmentPath(path, sizeof(path), currentSeq);
+    File rw = LittleFS.open(path, "r+");
+    rw.truncate(good);
+    rw.close();
+  }
+}
+
+bool historyBegin(const SensorDef *sensors)
+{
+  uint8_t layout[SENSOR_COUNT + 1];
+  layout[0] = SENSOR_COUNT;
+  for (int i = 0; i < SENSOR_COUNT; i++)
+  {
+    layout[i + 1] = sensorDef(sensors, i).decimals;
+    historyScales[i] = powf(10, layout[i + 1]);
+  }
+  historyLayout = crc32(layout, sizeof(layout));
+
+  currentSeq = 0;
+  File pos = LittleFS.open(HISTORY_POS, "r");
+  if (!pos || pos.read((uint8_t *)&currentSeq, sizeof(currentSeq)) != sizeof(currentSeq))
+  {
+    // No position yet or lost, continue the newest segment there is
+    for (uint32_t i = 0; i < HISTORY_SEGMENTS; i++)
+    {
+      char path[16];
+      segmentPath(path, sizeof(path), i);
+      File f = LittleFS.open(path, "r");
+      SegmentHeader header;
+      if (f && f.read((uint8_t *)&header, sizeof(header)) == sizeof(header) && header.magic == HISTORY_MAGIC &&
+          header.seq > currentSeq)
+        currentSeq = header.seq;
+    }
+  }
+  pos.close();
+  writerLoaded = false;
+  historyReady = true;
+  return true;
+}
+
+bool historyAppend(uint32_t timestamp, const float *values)
+{
+  if (!historyReady)
+    return false;
+  if (!writerLoaded)
+    loadWriter();
+
+  if (writer.records >= HISTORY_SEGMENT_RECORDS)
+  {
+    currentSeq++;
+    savePosition();
+    writer.records = 0;
+  }
+
+  char path[16];
+  segmentPath(path, sizeof(path), currentSeq);
+  File f = LittleFS.open(path, writer.records == 0 ? "w" : "a");
+  if (!f)
+    return false;
+  if (writer.records == 0)
+  {
+    SegmentHeader header = {HISTORY_MAGIC, historyLayout, currentSeq, timestamp};
+    f.write((const uint8_t *)&header, sizeof(header));
+  }
+
+  BitWriter w;
+  memset(&w, 0, sizeof(w));
+  Cursor next = writer;
+  encodeRecord(w, next, timestamp, values);
+  size_t length = (w.bits + 7) / 8;
+  bool ok = f.write(w.bytes, length) == length;
+  f.close();
+  if (ok)
+    writer = next;
+  else
+    writerLoaded = false; // cut the partial record before the next append
+  return ok;
+}
+
+size_t historyScan(uint32_t from, HistoryVisitor visit, void *context)
+{
+  if (!historyReady)
+    return 0;
+  uint32_t oldest = currentSeq >= HISTORY_SEGMENTS - 1 ? currentSeq - (HISTORY_SEGMENTS - 1) : 0;
+
+  // Segments before the newest one starting at or before from hold nothing newer
+  uint32_t start = oldest;
+  for (uint32_t seq = currentSeq; seq > oldest; seq--)
+  {
+    File f;
+    SegmentHeader header;
+    if (openSegment(f, seq, header) && header.firstTimestamp <= from)
+    {
+      start = seq;
+      break;
+    }
+  }
+
+  size_t visited = 0;
+  float values[SENSOR_COUNT];
+  for (uint32_t seq = start; seq <= currentSeq; seq++)
+  {
+    File f;
+    SegmentHeader header;
+    if (!openSegment(f, seq, header))
+      continue;
+    BitReader r;
+    readerBegin(r, f);
+    Cursor c;
+    memset(&c, 0, sizeof(c));
+    while (decodeRecord(r, c))
+    {
+      if (c.timestamp < from)
+        continue;
+      for (int i = 0; i < SENSOR_COUNT; i++)
+        values[i] = c.values[i] == HISTORY_MISSING ? NAN : c.values[i] / historyScales[i];
+      visit(c.timestamp, values, context);
+      visited++;
+    }
+  }
+  return visited;
+}
+
+void historyUsage(HistoryUsage &usage)
+{
+  usage.records = 0;
+  usage.bytes = 0;
+  if (!historyReady)
+    return;
+  if (!writerLoaded)
+    loadWriter();
+  uint32_t oldest = currentSeq >= HISTORY_SEGMENTS - 1 ? currentSeq - (HISTORY_SEGMENTS - 1) : 0;
+  for (uint32_t seq = oldest; seq <= currentSeq; seq++)
+  {
+    File f;
+    SegmentHeader header;
+    if (!openSegment(f, seq, header))
+      continue;
+    usage.bytes += f.size();
+    usage.records += seq == currentSeq ? writer.records : HISTORY_SEGMENT_RECORDS;
+  }
+}
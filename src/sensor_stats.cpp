@@ -0,0 +1,82 @@
+#include "sensor_stats.h"
+#include <math.h>
+#include <string.h>
+
+void sensorStatsReset(SensorStats &stats)
+{
+  stats.count = 0;
+  stats.mean = NAN;
+  stats.min = NAN;
+  stats.max = NAN;
+}
+
+void sensorStatsClear(SensorStats &stats)
+{
+  memset(&stats, 0, sizeof(stats));
+  sensorStatsReset(stats);
+}
+
+static float median(const SensorStats &stats, float value)
+{
+  // Insertion sort of at most 9 values, cheaper than anything clever
+  float sorted[SENSOR_STATS_MEDIAN];
+  sorted[0] = value;
+  for (int i = 0; i < SENSOR_STATS_MEDIAN - 1; i++)
+  {
+    float v = stats.recent[i];
+    int j = i + 1;
+    while (j > 0 && sorted[j - 1] > v)
+    {
+      sorted[j] = sorted[j - 1];
+      j--;
+    }
+    sorted[j] = v;
+  }
+  return sorted[SENSOR_STATS_MEDIAN / 2];
+}
+
+float sensorStatsAdd(SensorStats &stats, float value, bool rejectSpikes)
+{
+  if (isnan(value))
+    return NAN;
+
+  // Until the window is full a sample cannot be told from a spike: with
+  // rejection it is held back and only counts through the medians after it
+  float sample = value;
+  bool full = stats.recentCount == SENSOR_STATS_MEDIAN - 1;
+  if (full)
+  {
+    if (rejectSpikes)
+      sample = median(stats, value);
+    memmove(stats.recent, stats.recent + 1, sizeof(stats.recent) - sizeof(stats.recent[0]));
+  }
+  else
+  {
+    stats.recentCount++;
+  }
+  stats.recent[stats.recentCount - 1] = value;
+  if (rejectSpikes && !full)
+    return NAN;
+
+  if (stats.count == 0)
+  {
+    stats.count = 1;
+    stats.mean = sample;
+    stats.min = sample;
+    stats.max = sample;
+    return sample;
+  }
+  if (stats.count < UINT16_MAX)
+    stats.count++;
+  stats.mean += (sample - stats.mean) / stats.count;
+  if (sample < stats.min)
+    stats.min = sample;
+  if (sample > stats.max)
+    stats.max = sample;
+  return sample;
+}
+
+float sensorStatsLatest(const SensorStats &stats)
+{
+  return stats.recentCount > 0 ? stats.recent[stats.recentCount - 1] : NAN;
+}
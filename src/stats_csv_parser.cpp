@@ -0,0 +1,100 @@
+#include "stats_csv_parser.h"
+#include <stdlib.h>
+#include <string.h>
+
+void statsCsvBegin(StatsCsvParser &parser, float *values, uint8_t capacity)
+{
+  memset(&parser, 0, sizeof(parser));
+  parser.values = values;
+  parser.capacity = capacity;
+}
+
+static void storeValue(StatsCsvParser &parser, float value)
+{
+  if (parser.capacity == 0)
+    return;
+  if (parser.count == parser.capacity)
+  {
+    memmove(parser.values, parser.values + 1, (parser.capacity - 1) * sizeof(float));
+    parser.count--;
+  }
+  parser.values[parser.count++] = value;
+}
+
+static void parseLine(StatsCsvParser &parser)
+{
+  char *line = parser.line;
+  parser.lines++;
+
+  // Header row and blank lines
+  if (parser.lineLength == 0 || strncmp(line, "sensorId,", 9) == 0)
+    return;
+
+  char *firstComma = strchr(line, ',');
+  if (!firstComma)
+    return;
+  char *secondComma = strchr(firstComma + 1, ',');
+  if (!secondComma)
+    return;
+
+  char *end;
+  float value = strtof(secondComma + 1, &end);
+  bool parsed = end != secondComma + 1 && (*end == '\0' || *end == ',');
+
+  if (parsed && value > 800 && value < 1200 && firstComma - line > 10)
+  {
+    storeValue(parser, value);
+  }
+  else
+  {
+    parser.rejected++;
+  }
+}
+
+static void endLine(StatsCsvParser &parser)
+{
+  // Strip the CR of CRLF and trailing blanks
+  while (parser.lineLength > 0 &&
+         (parser.line[parser.lineLength - 1] == '\r' || parser.line[parser.lineLength - 1] == ' '))
+  {
+    parser.lineLength--;
+  }
+  parser.line[parser.lineLength] = '\0';
+
+  // Overlong lines cannot be valid measurements
+  if (!parser.lineOverflow)
+  {
+    parseLine(parser);
+  }
+
+  parser.lineLength = 0;
+  parser.lineOverflow = false;
+}
+
+void statsCsvFeed(StatsCsvParser &parser, const uint8_t *data, size_t length)
+{
+  for (size_t i = 0; i < length; i++)
+  {
+    char c = (char)data[i];
+    if (c == '\n')
+    {
+      endLine(parser);
+    }
+    else if (parser.lineLength < STATS_CSV_LINE_MAX - 1)
+    {
+      parser.line[parser.lineLength++] = c;
+    }
+    else
+    {
+      parser.lineOverflow = true;
+    }
+  }
+}
+
+void statsCsvFinish(StatsCsvParser &parser)
+{
+  if (parser.lineLength > 0)
+  {
+    endLine(parser);
+  }
+}
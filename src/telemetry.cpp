@@ -0,0 +1,113 @@
+#include "telemetry.h"
+#include "memory_budget.h"
+#include <Arduino.h>
+#include <string.h>
+
+static const char *const PHASE_NAMES[PHASE_COUNT] = {
+    "wifi join", "ntp wait", "tls", "upload", "trend fetch",
+    "bmp280", "ds18b20", "bh1750", "display", "hist append", "hist scan", "mirrors", "lan pages"};
+
+static PhaseStats phases[PHASE_COUNT];
+static HeapStats heap = {0, UINT32_MAX, 0, UINT32_MAX, 0, 0};
+static_assert(sizeof(phases) + sizeof(heap) <= RAM_BUDGET_TELEMETRY, "telemetry over its RAM budget");
+
+void telemetryRecord(TelemetryPhase phase, uint32_t us)
+{
+  PhaseStats &stats = phases[phase];
+  stats.count++;
+  stats.lastUs = us;
+  stats.totalUs += us;
+  if (us > stats.maxUs)
+    stats.maxUs = us;
+
+  uint8_t bucket = 0;
+  while (bucket < TELEMETRY_BUCKETS - 1 && (us >> (bucket + 1)) != 0)
+    bucket++;
+  if (stats.buckets[bucket] != UINT16_MAX)
+    stats.buckets[bucket]++;
+}
+
+uint32_t telemetryStart()
+{
+  return ESP.getCycleCount();
+}
+
+void telemetryStop(TelemetryPhase phase, uint32_t startCycles)
+{
+  telemetryRecord(phase, (ESP.getCycleCount() - startCycles) / ESP.getCpuFreqMHz());
+}
+
+void telemetrySampleHeap()
+{
+  heap.freeNow = ESP.getFreeHeap();
+  heap.maxBlockNow = ESP.getMaxFreeBlockSize();
+  heap.fragmentationNow = ESP.getHeapFragmentation();
+  if (heap.freeNow < heap.freeLow)
+    heap.freeLow = heap.freeNow;
+  if (heap.maxBlockNow < heap.maxBlockLow)
+    heap.maxBlockLow = heap.maxBlockNow;
+  if (heap.fragmentationNow > heap.fragmentationHigh)
+    heap.fragmentationHigh = heap.fragmentationNow;
+}
+
+const PhaseStats &telemetryPhase(TelemetryPhase phase)
+{
+  return phases[phase];
+}
+
+const char *telemetryPhaseName(TelemetryPhase phase)
+{
+  return PHASE_NAMES[phase];
+}
+
+const HeapStats &telemetryHeap()
+{
+  return heap;
+}
+
+// Upper bound of the bucket holding the given fraction of the samples
+static uint32_t percentileUs(const PhaseStats &stats, uint8_t percent)
+{
+  uint32_t target = (uint32_t)((uint64_t)stats.count * percent / 100);
+  uint32_t seen = 0;
+  for (uint8_t i = 0; i < TELEMETRY_BUCKETS; i++)
+  {
+    seen += stats.buckets[i];
+    if (seen > target)
+    {
+      uint32_t upper = i == TELEMETRY_BUCKETS - 1 ? stats.maxUs : (2UL << i) - 1;
+      return upper < stats.maxUs ? upper : stats.maxUs;
+    }
+  }
+  return stats.maxUs;
+}
+
+void telemetryDump(Print &out)
+{
+  out.println("phase          count    last us     avg us     p90 us     max us");
+  for (uint8_t p = 0; p < PHASE_COUNT; p++)
+  {
+    const PhaseStats &stats = phases[p];
+    if (stats.count == 0)
+      continue;
+    out.printf("%-12s %7u %10u %10u %10u %10u\n", PHASE_NAMES[p], stats.count, stats.lastUs,
+               (uint32_t)(stats.totalUs / stats.count), percentileUs(stats, 90), stats.maxUs);
+    out.print("  log2 us:");
+    for (uint8_t i = 0; i < TELEMETRY_BUCKETS; i++)
+    {
+      if (stats.buckets[i])
+        out.printf(" %u:%u", i, stats.buckets[i]);
+    }
+    out.println();
+  }
+  out.printf("heap free %u (low %u), max block %u (low %u), fragmentation %u%% (high %u%%)\n",
+             heap.freeNow, heap.freeLow, heap.maxBlockNow, heap.maxBlockLow,
+             heap.fragmentationNow, heap.fragmentationHigh);
+}
+
+void telemetryReset()
+{
+  memset(phases, 0, sizeof(phases));
+  heap.freeLow = heap.maxBlockLow = UINT32_MAX;
+  heap.fragmentationHigh = 0;
+}
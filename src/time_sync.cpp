@@ -0,0 +1,67 @@
+#include "time_sync.h"
+#include <math.h>
+#include <string.h>
+
+void timeSyncReset(TimeSync &sync)
+{
+  memset(&sync, 0, sizeof(sync));
+}
+
+void timeSyncRecord(TimeSync &sync, uint32_t localMs, int64_t utcMs)
+{
+  sync.syncs++;
+  uint32_t localSpan = localMs - sync.anchorLocalMs;
+  if (sync.anchorUtcMs == 0)
+  {
+    sync.anchorLocalMs = localMs;
+    sync.anchorUtcMs = utcMs;
+    return;
+  }
+  // A re-sync right after another one says little about the rate, keep
+  // measuring from the older anchor
+  if (localSpan < TIME_SYNC_MIN_SPAN_MS)
+    return;
+
+  int64_t utcSpanMs = utcMs - sync.anchorUtcMs;
+  float utcSpan = (float)utcSpanMs;
+  float sample = (float)((int64_t)localSpan - utcSpanMs) * 1e6f / utcSpan;
+  float uncertainty = 2.0f * TIME_SYNC_JITTER_MS * 1e6f / utcSpan;
+  if (sync.uncertaintyPpm == 0)
+  {
+    sync.driftPpm = sample;
+    sync.uncertaintyPpm = uncertainty;
+  }
+  else
+  {
+    // The oscillator drifts with temperature, follow it slowly
+    sync.driftPpm += (sample - sync.driftPpm) / 4;
+    sync.uncertaintyPpm += (uncertainty - sync.uncertaintyPpm) / 4;
+  }
+  sync.anchorLocalMs = localMs;
+  sync.anchorUtcMs = utcMs;
+}
+
+static float errorRatePpm(const TimeSync &sync)
+{
+  return fabsf(sync.driftPpm) + sync.uncertaintyPpm;
+}
+
+uint32_t timeSyncPredictedErrorMs(const TimeSync &sync, uint32_t localMs)
+{
+  if (sync.anchorUtcMs == 0)
+    return UINT32_MAX;
+  float elapsedMs = (float)(uint32_t)(localMs - sync.anchorLocalMs);
+  return TIME_SYNC_JITTER_MS + (uint32_t)(elapsedMs * errorRatePpm(sync) / 1e6f);
+}
+
+uint32_t timeSyncNextDelayMs(const TimeSync &sync, uint32_t boundMs, uint32_t minMs, uint32_t maxMs)
+{
+  if (sync.uncertaintyPpm == 0 || boundMs <= TIME_SYNC_JITTER_MS)
+    return minMs;
+  float delayMs = (boundMs - TIME_SYNC_JITTER_MS) * 1e6f / errorRatePpm(sync);
+  if (delayMs < minMs)
+    return minMs;
+  if (delayMs > maxMs)
+    return maxMs;
+  return (uint32_t)delayMs;
+}
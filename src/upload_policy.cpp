@@ -0,0 +1,34 @@
+#include "upload_policy.h"
+#include <math.h>
+
+UploadReason uploadPolicyCheck(const QueuedReading &reading, const QueuedReading *sent, const SensorDef *sensors,
+                               uint32_t heartbeatS)
+{
+  if (!sent || reading.timestamp == 0 || sent->timestamp == 0 || reading.timestamp <= sent->timestamp)
+    return UPLOAD_FIRST;
+
+  uint32_t elapsedS = reading.timestamp - sent->timestamp;
+  bool fast = false;
+  for (int i = 0; i < SENSOR_COUNT; i++)
+  {
+    // A sensor that dropped out or came back is a change as well, but
+    // not one worth a session of its own
+    if (isnan(reading.values[i]) || isnan(sent->values[i]))
+      continue;
+    float change = fabsf(reading.values[i] - sent->values[i]);
+    SensorDef def = sensorDef(sensors, i);
+    if (def.deadband > 0 && change >= def.deadband)
+      return UPLOAD_CHANGE;
+    if (def.ratePerHour > 0 && change * 3600 >= def.ratePerHour * elapsedS)
+      fast = true;
+  }
+  if (fast)
+    return UPLOAD_RATE;
+  return elapsedS >= heartbeatS ? UPLOAD_HEARTBEAT : UPLOAD_WAIT;
+}
+
+const char *uploadReasonName(UploadReason reason)
+{
+  static const char *const NAMES[] = {"wait", "first", "change", "rate", "heartbeat"};
+  return reason <= UPLOAD_HEARTBEAT ? NAMES[reason] : "?";
+}
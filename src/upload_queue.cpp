@@ -0,0 +1,259 @@
+#include "upload_queue.h"
+#include <LittleFS.h>
+
+#define QUEUE_LOG "/queue.bin"
+#define QUEUE_POS "/queue.pos"
+#define QUEUE_TMP "/queue.tmp"
+#define QUEUE_LAST "/queue.last"
+
+static bool queueMounted = false;
+static uint32_t queueHead = 0; // byte offset of the first pending reading
+static uint32_t queueEnd = 0;  // size of the log file
+static uint32_t queueDropped = 0; // readings removed from the front since boot
+static uint32_t peekDropped = 0;  // queueDropped at the last peek or pop
+static QueuedReading lastSent;
+static bool lastSentLoaded = false; // lastSent mirrors QUEUE_LAST
+static bool lastSentValid = false;
+
+// The position file also records the record size, a firmware with a
+// different sensor count must not read the old log
+static void saveHead()
+{
+  File f = LittleFS.open(QUEUE_POS, "w");
+  if (f)
+  {
+    uint32_t pos[2] = {queueHead, sizeof(QueuedReading)};
+    f.write((const uint8_t *)pos, sizeof(pos));
+    f.close();
+  }
+}
+
+static void clearQueue()
+{
+  LittleFS.remove(QUEUE_LOG);
+  LittleFS.remove(QUEUE_POS);
+  queueHead = 0;
+  queueEnd = 0;
+}
+
+static void dropFront(size_t count)
+{
+  queueDropped += count;
+  queueHead += count * sizeof(QueuedReading);
+  if (queueHead >= queueEnd)
+  {
+    clearQueue();
+    return;
+  }
+  saveHead();
+}
+
+// Rewrite the log without the consumed prefix so the file stays bounded.
+// The copy is complete before the head is reset to 0, and the rename
+// replaces the log in one step, so a reset at any point leaves either the
+// old log with its head or a finished copy that uploadQueueBegin() moves
+// into place.
+static void compactQueue()
+{
+  File in = LittleFS.open(QUEUE_LOG, "r");
+  File out = LittleFS.open(QUEUE_TMP, "w");
+  if (!in || !out)
+  {
+    return;
+  }
+
+  uint8_t buf[sizeof(QueuedReading) * 8];
+  in.seek(queueHead, SeekSet);
+  size_t copied = 0;
+  int n;
+  while ((n = in.read(buf, sizeof(buf))) > 0)
+  {
+    copied += out.write(buf, n);
+  }
+  in.close();
+  out.close();
+  if (copied != queueEnd - queueHead)
+  {
+    LittleFS.remove(QUEUE_TMP); // flash full, keep the old log
+    return;
+  }
+
+  queueEnd -= queueHead;
+  queueHead = 0;
+  saveHead();
+  LittleFS.rename(QUEUE_TMP, QUEUE_LOG);
+}
+
+// A copy left by a reset during compactQueue(): once the head was reset it
+// is the log, before that the old log and head still hold
+static void recoverCompaction(uint32_t head)
+{
+  if (!LittleFS.exists(QUEUE_TMP))
+  {
+    return;
+  }
+  if (head == 0)
+  {
+    LittleFS.rename(QUEUE_TMP, QUEUE_LOG);
+  }
+  else
+  {
+    LittleFS.remove(QUEUE_TMP);
+  }
+}
+
+bool uploadQueueBegin()
+{
+  if (!LittleFS.begin())
+  {
+    if (!LittleFS.format() || !LittleFS.begin())
+    {
+      return false;
+    }
+  }
+  queueMounted = true;
+
+  uint32_t saved[2] = {0, sizeof(QueuedReading)}; // older files only hold the head
+  File pos = LittleFS.open(QUEUE_POS, "r");
+  if (pos)
+  {
+    pos.read((uint8_t *)saved, sizeof(saved));
+    pos.close();
+  }
+  queueHead = saved[0];
+  recoverCompaction(queueHead);
+
+  File log = LittleFS.open(QUEUE_LOG, "r");
+  queueEnd = log ? log.size() : 0;
+  log.close();
+  if (saved[1] != sizeof(QueuedReading))
+  {
+    clearQueue();
+  }
+
+  // Drop a torn trailing record from a reset during append
+  if (queueEnd % sizeof(QueuedReading) != 0)
+  {
+    queueEnd -= queueEnd % sizeof(QueuedReading);
+    File f = LittleFS.open(QUEUE_LOG, "r+");
+    f.truncate(queueEnd);
+    f.close();
+  }
+  if (queueHead > queueEnd || queueHead % sizeof(QueuedReading) != 0)
+  {
+    clearQueue();
+  }
+  return true;
+}
+
+bool uploadQueuePush(const QueuedReading &reading)
+{
+  if (!queueMounted)
+  {
+    return false;
+  }
+
+  if (uploadQueueSize() >= UPLOAD_QUEUE_MAX_RECORDS)
+  {
+    dropFront(1);
+  }
+  if (queueHead >= (UPLOAD_QUEUE_MAX_RECORDS / 2) * sizeof(QueuedReading))
+  {
+    compactQueue();
+  }
+
+  File f = LittleFS.open(QUEUE_LOG, "a");
+  if (!f)
+  {
+    return false;
+  }
+  size_t written = f.write((const uint8_t *)&reading, sizeof(reading));
+  f.close();
+  if (written != sizeof(reading))
+  {
+    return false;
+  }
+  queueEnd += sizeof(reading);
+  return true;
+}
+
+size_t uploadQueuePeek(QueuedReading *readings, size_t max)
+{
+  peekDropped = queueDropped;
+  size_t count = uploadQueueSize();
+  if (count > max)
+  {
+    count = max;
+  }
+  if (count == 0)
+  {
+    return 0;
+  }
+
+  File f = LittleFS.open(QUEUE_LOG, "r");
+  if (!f)
+  {
+    return 0;
+  }
+  f.seek(queueHead, SeekSet);
+  int n = f.read((uint8_t *)readings, count * sizeof(QueuedReading));
+  f.close();
+  return n > 0 ? n / sizeof(QueuedReading) : 0;
+}
+
+size_t uploadQueueSize()
+{
+  return (queueEnd - queueHead) / sizeof(QueuedReading);
+}
+
+void uploadQueuePop(size_t count)
+{
+  // A push into the full queue may have dropped some of the peeked readings
+  // meanwhile, e.g. from a task run while the upload waited for the network
+  size_t gone = queueDropped - peekDropped;
+  count = count > gone ? count - gone : 0;
+  peekDropped = queueDropped;
+  if (count == 0 || count > uploadQueueSize())
+  {
+    return;
+  }
+
+  // Keep the newest of the sent readings, the log prefix goes away
+  File f = LittleFS.open(QUEUE_LOG, "r");
+  if (f)
+  {
+    f.seek(queueHead + (count - 1) * sizeof(QueuedReading), SeekSet);
+    lastSentValid = f.read((uint8_t *)&lastSent, sizeof(lastSent)) == sizeof(lastSent);
+    f.close();
+    lastSentLoaded = true;
+    File out = LittleFS.open(QUEUE_LAST, "w");
+    if (out && lastSentValid)
+    {
+      out.write((const uint8_t *)&lastSent, sizeof(lastSent));
+    }
+    out.close();
+  }
+  dropFront(count);
+  peekDropped = queueDropped;
+}
+
+bool uploadQueueLastSent(QueuedReading &reading)
+{
+  if (!queueMounted)
+  {
+    return false;
+  }
+  if (!lastSentLoaded)
+  {
+    File f = LittleFS.open(QUEUE_LAST, "r");
+    lastSentValid = f && f.size() == sizeof(lastSent) &&
+                    f.read((uint8_t *)&lastSent, sizeof(lastSent)) == sizeof(lastSent);
+    f.close();
+    lastSentLoaded = true;
+  }
+  if (lastSentValid)
+  {
+    reading = lastSent;
+  }
+  return lastSentValid;
+}
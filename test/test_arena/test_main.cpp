@@ -0,0 +1,115 @@
+#include "arena.h"
+#include <stdint.h>
+#include <unity.h>
+
+void setUp()
+{
+  arenaReset();
+}
+
+void tearDown() {}
+
+void test_blocks_are_aligned_and_packed()
+{
+  uint8_t *a = (uint8_t *)arenaAlloc(1);
+  uint8_t *b = (uint8_t *)arenaAlloc(5);
+  uint8_t *c = (uint8_t *)arenaAlloc(4);
+  TEST_ASSERT_NOT_NULL(a);
+  TEST_ASSERT_EQUAL(0, (uintptr_t)a % 4);
+  TEST_ASSERT_EQUAL(4, b - a);
+  TEST_ASSERT_EQUAL(8, c - b);
+  TEST_ASSERT_EQUAL(16, arenaMark());
+}
+
+void test_array_of_a_type()
+{
+  uint16_t *a = arenaArray<uint16_t>(3);
+  float *b = arenaArray<float>(2);
+  TEST_ASSERT_EQUAL(8, (uint8_t *)b - (uint8_t *)a);
+  TEST_ASSERT_EQUAL(16, arenaMark());
+}
+
+void test_reset_frees_everything()
+{
+  void *first = arenaAlloc(100);
+  arenaAlloc(200);
+  arenaReset();
+  TEST_ASSERT_EQUAL(0, arenaMark());
+  TEST_ASSERT_EQUAL_PTR(first, arenaAlloc(8));
+}
+
+void test_marks_nest()
+{
+  ArenaMark outer = arenaMark();
+  void *a = arenaAlloc(100);
+  ArenaMark inner = arenaMark();
+  void *b = arenaAlloc(200);
+  arenaRewind(inner);
+  TEST_ASSERT_EQUAL_PTR(b, arenaAlloc(16));
+  arenaRewind(outer);
+  TEST_ASSERT_EQUAL_PTR(a, arenaAlloc(16));
+}
+
+// A mark taken after the current position, e.g. before a reset, does not
+// hand out memory still in use
+void test_rewind_forward_is_ignored()
+{
+  arenaAlloc(64);
+  ArenaMark stale = arenaMark();
+  arenaRewind(0);
+  arenaAlloc(16);
+  arenaRewind(stale);
+  TEST_ASSERT_EQUAL(16, arenaMark());
+}
+
+void test_exact_fill_then_overflow()
+{
+  uint32_t failures = arenaFailures();
+  TEST_ASSERT_NOT_NULL(arenaAlloc(ARENA_SIZE - 8));
+  TEST_ASSERT_NULL(arenaAlloc(9));
+  TEST_ASSERT_EQUAL(failures + 1, arenaFailures());
+  TEST_ASSERT_EQUAL(ARENA_SIZE - 8, arenaMark()); // a failed request takes nothing
+  TEST_ASSERT_NOT_NULL(arenaAlloc(8));
+  TEST_ASSERT_NULL(arenaAlloc(1));
+  TEST_ASSERT_EQUAL(failures + 2, arenaFailures());
+
+  arenaReset();
+  TEST_ASSERT_NOT_NULL(arenaAlloc(ARENA_SIZE));
+  TEST_ASSERT_NULL(arenaAlloc(1));
+}
+
+// Sizes that wrap when rounded up, or a count times a size that does not
+// fit the arena, fail instead of returning a small block
+void test_huge_requests_fail()
+{
+  uint32_t failures = arenaFailures();
+  TEST_ASSERT_NULL(arenaAlloc(SIZE_MAX));
+  TEST_ASSERT_NULL(arenaAlloc(SIZE_MAX - 2));
+  TEST_ASSERT_NULL(arenaAlloc(ARENA_SIZE + 1));
+  TEST_ASSERT_NULL(arenaArray<uint32_t>(ARENA_SIZE / 4 + 1));
+  TEST_ASSERT_EQUAL(failures + 4, arenaFailures());
+  TEST_ASSERT_EQUAL(0, arenaMark());
+}
+
+void test_high_water_keeps_the_peak()
+{
+  arenaAlloc(ARENA_SIZE / 2);
+  arenaReset();
+  arenaAlloc(16);
+  TEST_ASSERT_GREATER_OR_EQUAL(ARENA_SIZE / 2, arenaHighWater());
+  TEST_ASSERT_LESS_OR_EQUAL(ARENA_SIZE, arenaHighWater());
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_blocks_are_aligned_and_packed);
+  RUN_TEST(test_array_of_a_type);
+  RUN_TEST(test_reset_frees_everything);
+  RUN_TEST(test_marks_nest);
+  RUN_TEST(test_rewind_forward_is_ignored);
+  RUN_TEST(test_exact_fill_then_overflow);
+  RUN_TEST(test_huge_requests_fail);
+  RUN_TEST(test_high_water_keeps_the_peak);
+  return UNITY_END();
+}
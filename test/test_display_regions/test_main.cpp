@@ -0,0 +1,181 @@
+#include "display_regions.h"
+#include "i2c_bus.h"
+#include <Adafruit_SSD1306.h>
+#include <sim.h>
+#include <string.h>
+#include <unity.h>
+
+#define OLED_ADDRESS 0x3C
+
+static Adafruit_SSD1306 display(128, 64);
+static DisplayRegions regions;
+static uint8_t *buffer;
+
+// Bring the simulated controller's RAM in line with the frame buffer
+static void sync()
+{
+  displayRegionsMarkAll(regions);
+  displayRegionsFlush(regions, buffer, OLED_ADDRESS);
+}
+
+void setUp()
+{
+  i2cBusBegin(2, 14);
+  buffer = display.getBuffer();
+  memset(buffer, 0, DISPLAY_PAGES * DISPLAY_COLUMNS);
+  sync();
+}
+
+void tearDown() {}
+
+static void fillPattern()
+{
+  for (int i = 0; i < DISPLAY_PAGES * DISPLAY_COLUMNS; i++)
+    buffer[i] = (uint8_t)(i * 7 + 1);
+}
+
+void test_mark_covers_the_touched_pages()
+{
+  displayRegionsClear(regions);
+  TEST_ASSERT_FALSE(displayRegionsDirty(regions));
+  displayRegionsMark(regions, 10, 12, 5, 10); // rows 12..21, pages 1..2
+  TEST_ASSERT_TRUE(displayRegionsDirty(regions));
+  TEST_ASSERT_EQUAL(DISPLAY_COLUMNS, regions.start[0]);
+  TEST_ASSERT_EQUAL(10, regions.start[1]);
+  TEST_ASSERT_EQUAL(15, regions.end[1]);
+  TEST_ASSERT_EQUAL(10, regions.start[2]);
+  TEST_ASSERT_EQUAL(DISPLAY_COLUMNS, regions.start[3]);
+
+  displayRegionsMark(regions, 2, 8, 3, 1); // widens page 1 only
+  TEST_ASSERT_EQUAL(2, regions.start[1]);
+  TEST_ASSERT_EQUAL(15, regions.end[1]);
+  TEST_ASSERT_EQUAL(10, regions.start[2]);
+}
+
+void test_mark_clips_to_the_screen()
+{
+  displayRegionsClear(regions);
+  displayRegionsMark(regions, -4, -4, 8, 8);
+  TEST_ASSERT_EQUAL(0, regions.start[0]);
+  TEST_ASSERT_EQUAL(4, regions.end[0]);
+  TEST_ASSERT_EQUAL(DISPLAY_COLUMNS, regions.start[1]);
+
+  displayRegionsMark(regions, 120, 60, 20, 20);
+  TEST_ASSERT_EQUAL(120, regions.start[7]);
+  TEST_ASSERT_EQUAL(DISPLAY_COLUMNS, regions.end[7]);
+
+  displayRegionsClear(regions);
+  displayRegionsMark(regions, 128, 0, 5, 5);
+  displayRegionsMark(regions, 0, 64, 5, 5);
+  displayRegionsMark(regions, -10, 0, 10, 5);
+  TEST_ASSERT_FALSE(displayRegionsDirty(regions));
+}
+
+void test_flush_sends_only_the_dirty_parts()
+{
+  fillPattern();
+  displayRegionsClear(regions);
+  displayRegionsMark(regions, 30, 16, 40, 8);  // page 2
+  displayRegionsMark(regions, 100, 56, 28, 8); // page 7
+  uint32_t before = i2cBusStats(I2C_SSD1306).bytes;
+  size_t sent = displayRegionsFlush(regions, buffer, OLED_ADDRESS);
+  TEST_ASSERT_EQUAL(i2cBusStats(I2C_SSD1306).bytes - before, sent);
+  TEST_ASSERT_FALSE(displayRegionsDirty(regions));
+
+  const uint8_t *ram = simDisplayRam();
+  for (int page = 0; page < DISPLAY_PAGES; page++)
+  {
+    for (int col = 0; col < DISPLAY_COLUMNS; col++)
+    {
+      int i = page * DISPLAY_COLUMNS + col;
+      bool dirty = (page == 2 && col >= 30 && col < 70) || (page == 7 && col >= 100);
+      TEST_ASSERT_EQUAL_HEX8(dirty ? buffer[i] : 0, ram[i]);
+    }
+  }
+}
+
+// Pages with the same columns share one address window
+void test_equal_pages_share_a_window()
+{
+  fillPattern();
+  displayRegionsClear(regions);
+  displayRegionsMark(regions, 0, 0, 16, 16);
+  size_t shared = displayRegionsFlush(regions, buffer, OLED_ADDRESS);
+  displayRegionsMark(regions, 0, 0, 16, 8);
+  displayRegionsMark(regions, 0, 8, 17, 8);
+  size_t separate = displayRegionsFlush(regions, buffer, OLED_ADDRESS);
+  TEST_ASSERT_EQUAL(separate - 1 - (2 + 6), shared); // one data column and one window less
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(buffer, simDisplayRam(), 16);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(buffer + DISPLAY_COLUMNS, simDisplayRam() + DISPLAY_COLUMNS, 17);
+}
+
+void test_flush_in_steps()
+{
+  fillPattern();
+  displayRegionsMarkAll(regions);
+  displayRegionsFlush(regions, buffer, OLED_ADDRESS, 2);
+  TEST_ASSERT_EQUAL(DISPLAY_COLUMNS, regions.start[1]); // pages 0 and 1 went out
+  TEST_ASSERT_EQUAL(0, regions.start[2]);
+  for (int step = 0; step < 3; step++)
+    displayRegionsFlush(regions, buffer, OLED_ADDRESS, 2);
+  TEST_ASSERT_FALSE(displayRegionsDirty(regions));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(buffer, simDisplayRam(), DISPLAY_PAGES * DISPLAY_COLUMNS);
+}
+
+void test_widget_redraws_only_changed_cells()
+{
+  TextWidget widget;
+  widget.x = 0;
+  widget.page = 3;
+  widget.width = DISPLAY_COLUMNS;
+  widget.size = 1;
+  widget.center = false;
+  displayRegionsClear(regions);
+  TEST_ASSERT_TRUE(textWidgetDraw(widget, buffer, regions, "12.5 C"));
+  TEST_ASSERT_EQUAL(0, regions.start[3]);
+  TEST_ASSERT_EQUAL(36, regions.end[3]);
+
+  displayRegionsClear(regions);
+  TEST_ASSERT_FALSE(textWidgetDraw(widget, buffer, regions, "12.5 C"));
+  TEST_ASSERT_FALSE(displayRegionsDirty(regions));
+
+  TEST_ASSERT_TRUE(textWidgetDraw(widget, buffer, regions, "12.7 C"));
+  TEST_ASSERT_EQUAL(18, regions.start[3]); // the fourth cell only
+  TEST_ASSERT_EQUAL(24, regions.end[3]);
+
+  // A shorter text erases the old one
+  displayRegionsClear(regions);
+  TEST_ASSERT_TRUE(textWidgetDraw(widget, buffer, regions, "9 C"));
+  TEST_ASSERT_EQUAL(0, regions.start[3]);
+  TEST_ASSERT_EQUAL(36, regions.end[3]);
+  for (int col = 18; col < 36; col++)
+    TEST_ASSERT_EQUAL_HEX8(0, buffer[3 * DISPLAY_COLUMNS + col]);
+}
+
+void test_widget_columns_stop_at_the_screen_edge()
+{
+  TextWidget half = {64, 5, 64, 1, false};
+  TEST_ASSERT_EQUAL(10, textWidgetColumns(half)); // "1013.25 hPa" does not fit
+  TextWidget past = {100, 5, 64, 1, false};
+  TEST_ASSERT_EQUAL(4, textWidgetColumns(past));
+  TextWidget clock = {0, 2, DISPLAY_COLUMNS, 2, true};
+  TEST_ASSERT_EQUAL(10, textWidgetColumns(clock));
+  TextWidget wide = {0, 0, DISPLAY_COLUMNS, 1, true};
+  TEST_ASSERT_EQUAL(sizeof(wide.text) - 1, textWidgetColumns(wide)); // limited by the text buffer
+  TextWidget off = {DISPLAY_COLUMNS, 0, 64, 1, false};
+  TEST_ASSERT_EQUAL(0, textWidgetColumns(off));
+}
+
+int main()
+{
+  display.begin(SSD1306_SWITCHCAPVCC, OLED_ADDRESS);
+  UNITY_BEGIN();
+  RUN_TEST(test_mark_covers_the_touched_pages);
+  RUN_TEST(test_mark_clips_to_the_screen);
+  RUN_TEST(test_flush_sends_only_the_dirty_parts);
+  RUN_TEST(test_equal_pages_share_a_window);
+  RUN_TEST(test_flush_in_steps);
+  RUN_TEST(test_widget_redraws_only_changed_cells);
+  RUN_TEST(test_widget_columns_stop_at_the_screen_edge);
+  return UNITY_END();
+}
@@ -0,0 +1,295 @@
+#include "display_regions.h"
+#include "fixed_format.h"
+#include "glyph_atlas.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unity.h>
+
+// The characters the atlas holds as they are in glcdfont.c of Adafruit
+// GFX, five columns with bit 0 at the top
+static const struct
+{
+  char c;
+  uint8_t columns[5];
+} REFERENCE_FONT[] = {
+    {' ', {0x00, 0x00, 0x00, 0x00, 0x00}}, {'-', {0x08, 0x08, 0x08, 0x08, 0x08}},
+    {'.', {0x00, 0x60, 0x60, 0x00, 0x00}}, {':', {0x00, 0x36, 0x36, 0x00, 0x00}},
+    {'0', {0x3E, 0x51, 0x49, 0x45, 0x3E}}, {'1', {0x00, 0x42, 0x7F, 0x40, 0x00}},
+    {'2', {0x72, 0x49, 0x49, 0x49, 0x46}}, {'3', {0x21, 0x41, 0x49, 0x4D, 0x33}},
+    {'4', {0x18, 0x14, 0x12, 0x7F, 0x10}}, {'5', {0x27, 0x45, 0x45, 0x45, 0x39}},
+    {'6', {0x3C, 0x4A, 0x49, 0x49, 0x31}}, {'7', {0x41, 0x21, 0x11, 0x09, 0x07}},
+    {'8', {0x36, 0x49, 0x49, 0x49, 0x36}}, {'9', {0x46, 0x49, 0x49, 0x29, 0x1E}},
+    {'C', {0x3E, 0x41, 0x41, 0x41, 0x22}}, {'h', {0x7F, 0x08, 0x04, 0x04, 0x78}},
+    {'P', {0x7F, 0x09, 0x09, 0x09, 0x06}}, {'a', {0x20, 0x54, 0x54, 0x78, 0x40}},
+    {'l', {0x00, 0x41, 0x7F, 0x40, 0x00}}, {'x', {0x44, 0x28, 0x10, 0x28, 0x44}},
+};
+
+static uint8_t buffer[DISPLAY_PAGES * DISPLAY_COLUMNS];
+static uint8_t reference[DISPLAY_PAGES * DISPLAY_COLUMNS];
+
+static const uint8_t *referenceColumns(char c)
+{
+  for (auto &glyph : REFERENCE_FONT)
+  {
+    if (glyph.c == c)
+      return glyph.columns;
+  }
+  return nullptr;
+}
+
+static void setPixel(uint8_t *frame, int x, int y)
+{
+  if (x >= 0 && x < DISPLAY_COLUMNS && y >= 0 && y < 8 * DISPLAY_PAGES)
+    frame[y / 8 * DISPLAY_COLUMNS + x] |= 1 << (y % 8);
+}
+
+// What Adafruit_GFX::drawChar() puts on the screen, pixel by pixel: each
+// font pixel becomes a size x size square, the sixth column stays blank
+static void referenceChar(uint8_t *frame, int x, int y, char c, int size)
+{
+  const uint8_t *columns = referenceColumns(c);
+  TEST_ASSERT_NOT_NULL(columns);
+  for (int i = 0; i < 5; i++)
+  {
+    for (int j = 0; j < 8; j++)
+    {
+      if (!(columns[i] >> j & 1))
+        continue;
+      for (int dx = 0; dx < size; dx++)
+      {
+        for (int dy = 0; dy < size; dy++)
+          setPixel(frame, x + i * size + dx, y + j * size + dy);
+      }
+    }
+  }
+}
+
+static void referenceText(uint8_t *frame, int x, int y, const char *text, int size)
+{
+  for (; *text; text++, x += 6 * size)
+    referenceChar(frame, x, y, *text, size);
+}
+
+void setUp()
+{
+  memset(buffer, 0, sizeof(buffer));
+  memset(reference, 0, sizeof(reference));
+}
+
+void tearDown() {}
+
+static void assertGlyphs(const GlyphFont &font, int size)
+{
+  TEST_ASSERT_EQUAL(6 * size, font.width);
+  TEST_ASSERT_EQUAL(size, font.pages);
+  for (const char *c = font.chars; *c; c++)
+  {
+    uint8_t expected[2 * 12] = {};
+    uint8_t frame[DISPLAY_PAGES * DISPLAY_COLUMNS] = {};
+    referenceChar(frame, 0, 0, *c, size);
+    for (int p = 0; p < font.pages; p++)
+      memcpy(expected + p * font.width, frame + p * DISPLAY_COLUMNS, font.width);
+    for (int p = 0; p < font.pages; p++)
+      TEST_ASSERT_EQUAL_HEX8_ARRAY(expected + p * font.width, glyphColumns(font, *c, p), font.width);
+  }
+}
+
+void test_small_glyphs_match_the_font()
+{
+  assertGlyphs(GLYPHS_SMALL, 1);
+}
+
+// The clock glyphs are setTextSize(2) output, every pixel doubled
+void test_large_glyphs_are_the_doubled_font()
+{
+  assertGlyphs(GLYPHS_LARGE, 2);
+}
+
+void test_unknown_characters()
+{
+  TEST_ASSERT_NULL(glyphColumns(GLYPHS_SMALL, 'Z', 0));
+  TEST_ASSERT_NULL(glyphColumns(GLYPHS_LARGE, 'h', 0)); // units are only in the small font
+  TEST_ASSERT_NULL(glyphColumns(GLYPHS_SMALL, '\0', 0));
+}
+
+static void assertWidgetMatches(TextWidget &widget, const char *text, int referenceX)
+{
+  DisplayRegions regions;
+  displayRegionsClear(regions);
+  textWidgetDraw(widget, buffer, regions, text);
+  referenceText(reference, referenceX, widget.page * 8, text, widget.size);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(reference, buffer, sizeof(buffer));
+}
+
+// A blitted line is the same picture the font renderer draws
+void test_widget_blit_matches_the_reference_render()
+{
+  TextWidget widget;
+  widget.x = 3;
+  widget.page = 5;
+  widget.width = DISPLAY_COLUMNS;
+  widget.size = 1;
+  widget.center = false;
+  assertWidgetMatches(widget, "1013.2 hPa", 3);
+}
+
+void test_centered_clock_matches_the_reference_render()
+{
+  TextWidget widget;
+  widget.x = 0;
+  widget.page = 0;
+  widget.width = DISPLAY_COLUMNS;
+  widget.size = 2;
+  widget.center = true;
+  assertWidgetMatches(widget, "12:34", (DISPLAY_COLUMNS - 5 * 12) / 2);
+}
+
+// Cells past the right edge are clipped like the renderer clips pixels
+void test_blit_is_clipped_at_the_edge()
+{
+  TextWidget widget;
+  widget.x = DISPLAY_COLUMNS - 20;
+  widget.page = 7;
+  widget.width = DISPLAY_COLUMNS;
+  widget.size = 1;
+  widget.center = false;
+  assertWidgetMatches(widget, "-12.5 C", DISPLAY_COLUMNS - 20);
+}
+
+static uint64_t wallNs()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// The main screen of the firmware: date, clock and four readings
+#define BENCH_FRAMES 2000
+#define BENCH_WIDGETS 6
+static const TextWidget BENCH_LAYOUT[BENCH_WIDGETS] = {
+    {0, 0, DISPLAY_COLUMNS, 1, true},  {32, 2, DISPLAY_COLUMNS - 32, 2, true}, {0, 5, 64, 1, false},
+    {64, 5, 64, 1, false},             {0, 7, 64, 1, false},                    {64, 7, 64, 1, false}};
+static const char *const BENCH_UNITS[4] = {" C", " hPa", " C", " lx"};
+static const char *const BENCH_FORMATS[4] = {"%.2f C", "%.2f hPa", "%.2f C", "%.0f lx"};
+static const uint8_t BENCH_DECIMALS[4] = {2, 2, 2, 0};
+
+static void benchReadings(int frame, float *values)
+{
+  values[0] = 21.5f + 0.01f * (frame % 37);
+  values[1] = 1013.25f - 0.01f * (frame % 50);
+  values[2] = -3.5f + 0.0625f * (frame % 8);
+  values[3] = (frame * 37) % 2000;
+}
+
+static void benchClock(int frame, char *date, char *clock)
+{
+  int minute = frame / 4; // a frame every 15 s
+  snprintf(date, 16, "%02d.10.2026", 16 + minute / 1440);
+  snprintf(clock, 16, "%02d:%02d", minute / 60 % 24, minute % 60);
+}
+
+static void clearCell(uint8_t *frame, int x, int y, int size)
+{
+  for (int dx = 0; dx < 6 * size; dx++)
+  {
+    for (int dy = 0; dy < 8 * size; dy++)
+    {
+      if (x + dx >= 0 && x + dx < DISPLAY_COLUMNS)
+        frame[(y + dy) / 8 * DISPLAY_COLUMNS + x + dx] &= ~(1 << ((y + dy) % 8));
+    }
+  }
+}
+
+// textWidgetDraw() as it was on Adafruit GFX: a changed cell is filled
+// black and its character drawn pixel by pixel
+static void gfxWidgetDraw(TextWidget &widget, uint8_t *frame, DisplayRegions &regions, const char *text)
+{
+  int cell = 6 * widget.size;
+  int length = strlen(text);
+  int oldLength = strlen(widget.text);
+  int left = widget.center ? widget.x + (widget.width - length * cell) / 2 : widget.x;
+  int y = widget.page * 8;
+  bool sameLength = widget.valid && length == oldLength;
+  if (widget.valid && !sameLength)
+  {
+    int oldLeft = widget.center ? widget.x + (widget.width - oldLength * cell) / 2 : widget.x;
+    for (int i = 0; i < oldLength; i++)
+      clearCell(frame, oldLeft + i * cell, y, widget.size);
+    displayRegionsMark(regions, oldLeft, y, oldLength * cell, 8 * widget.size);
+  }
+  for (int i = 0; i < length; i++)
+  {
+    if (sameLength && text[i] == widget.text[i])
+      continue;
+    clearCell(frame, left + i * cell, y, widget.size);
+    referenceChar(frame, left + i * cell, y, text[i], widget.size);
+    displayRegionsMark(regions, left + i * cell, y, cell, 8 * widget.size);
+  }
+  strcpy(widget.text, text);
+  widget.valid = true;
+}
+
+// Per-frame time of formatting and drawing the main screen, glyph atlas
+// against the GFX renderer with the float printf
+void test_benchmark_frame()
+{
+  TextWidget atlas[BENCH_WIDGETS];
+  TextWidget gfx[BENCH_WIDGETS];
+  memcpy(atlas, BENCH_LAYOUT, sizeof(atlas));
+  memcpy(gfx, BENCH_LAYOUT, sizeof(gfx));
+  DisplayRegions regions;
+  char date[16], clock[16], text[4][16];
+  float values[4];
+
+  uint64_t start = wallNs();
+  for (int f = 0; f < BENCH_FRAMES; f++)
+  {
+    benchClock(f, date, clock);
+    benchReadings(f, values);
+    for (int i = 0; i < 4; i++)
+      formatFixed(text[i], sizeof(text[i]), values[i], BENCH_DECIMALS[i], BENCH_UNITS[i]);
+    displayRegionsClear(regions);
+    textWidgetDraw(atlas[0], buffer, regions, date);
+    textWidgetDraw(atlas[1], buffer, regions, clock);
+    for (int i = 0; i < 4; i++)
+      textWidgetDraw(atlas[2 + i], buffer, regions, text[i]);
+  }
+  uint64_t atlasNs = wallNs() - start;
+
+  char expected[4][16];
+  start = wallNs();
+  for (int f = 0; f < BENCH_FRAMES; f++)
+  {
+    benchClock(f, date, clock);
+    benchReadings(f, values);
+    for (int i = 0; i < 4; i++)
+      snprintf(expected[i], sizeof(expected[i]), BENCH_FORMATS[i], values[i]);
+    displayRegionsClear(regions);
+    gfxWidgetDraw(gfx[0], reference, regions, date);
+    gfxWidgetDraw(gfx[1], reference, regions, clock);
+    for (int i = 0; i < 4; i++)
+      gfxWidgetDraw(gfx[2 + i], reference, regions, expected[i]);
+  }
+  uint64_t gfxNs = wallNs() - start;
+
+  printf("Main screen: %.2f us per frame from the glyph atlas, %.2f us with GFX and printf on the host\n",
+         atlasNs / 1e3 / BENCH_FRAMES, gfxNs / 1e3 / BENCH_FRAMES);
+  for (int i = 0; i < 4; i++)
+    TEST_ASSERT_EQUAL_STRING(expected[i], text[i]);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(reference, buffer, sizeof(buffer));
+  TEST_ASSERT_LESS_THAN(gfxNs, atlasNs);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_small_glyphs_match_the_font);
+  RUN_TEST(test_large_glyphs_are_the_doubled_font);
+  RUN_TEST(test_unknown_characters);
+  RUN_TEST(test_widget_blit_matches_the_reference_render);
+  RUN_TEST(test_centered_clock_matches_the_reference_render);
+  RUN_TEST(test_blit_is_clipped_at_the_edge);
+  RUN_TEST(test_benchmark_frame);
+  return UNITY_END();
+}
@@ -0,0 +1,278 @@
+#include "http_client.h"
+#include <ESP8266WiFi.h>
+#include <sim.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unity.h>
+
+#define CHUNKED_BODY "5\r\nhello\r\n6\r\n world\r\n0\r\n\r\n"
+
+static char body[256];
+static size_t bodyLength;
+
+static void collect(const uint8_t *data, size_t length, void *)
+{
+  if (bodyLength + length < sizeof(body))
+  {
+    memcpy(body + bodyLength, data, length);
+    bodyLength += length;
+    body[bodyLength] = '\0';
+  }
+}
+
+// GET answered with the given raw response, the body ends up in body
+static int get(const char *response)
+{
+  simHttpRespond(response);
+  bodyLength = 0;
+  body[0] = '\0';
+  HttpRequest request = {};
+  request.method = "GET";
+  request.host = "api.opensensemap.org";
+  request.port = 80;
+  request.path = "/test";
+  request.readBody = collect;
+  return httpSend(request);
+}
+
+static void assertChunked(const char *headers)
+{
+  char response[256];
+  snprintf(response, sizeof(response), "HTTP/1.1 200 OK\r\n%s\r\n\r\n" CHUNKED_BODY, headers);
+  TEST_ASSERT_EQUAL(200, get(response));
+  TEST_ASSERT_EQUAL_STRING("hello world", body);
+}
+
+// Without chunked coding the body runs to the end of the connection
+static void assertNotChunked(const char *headers)
+{
+  char response[256];
+  snprintf(response, sizeof(response), "HTTP/1.1 200 OK\r\n%s\r\n\r\n" CHUNKED_BODY, headers);
+  TEST_ASSERT_EQUAL(200, get(response));
+  TEST_ASSERT_EQUAL_STRING(CHUNKED_BODY, body);
+}
+
+void setUp()
+{
+  if (WiFi.status() != WL_CONNECTED)
+  {
+    WiFi.mode(WIFI_STA);
+    WiFi.begin("ssid", "password");
+    while (WiFi.status() != WL_CONNECTED)
+      delay(10);
+  }
+}
+
+void tearDown() {}
+
+void test_header_name_is_case_insensitive()
+{
+  assertChunked("transfer-encoding: chunked");
+  assertChunked("Transfer-Encoding: chunked");
+  assertChunked("TRANSFER-ENCODING: CHUNKED");
+}
+
+void test_value_whitespace_is_trimmed()
+{
+  assertChunked("Transfer-Encoding:chunked");
+  assertChunked("Transfer-Encoding:   Chunked \t ");
+  assertChunked("Transfer-Encoding : chunked");
+}
+
+void test_last_coding_decides()
+{
+  assertChunked("Transfer-Encoding: gzip, chunked");
+  assertChunked("Transfer-Encoding: gzip,Chunked");
+  assertChunked("Transfer-Encoding: gzip, chunked, "); // empty list elements are skipped
+  assertChunked("Transfer-Encoding: gzip\r\nTransfer-Encoding: chunked");
+  assertNotChunked("Transfer-Encoding: chunked, gzip");
+  assertNotChunked("Transfer-Encoding: chunked\r\nTransfer-Encoding: gzip");
+}
+
+void test_other_headers_and_codings_are_not_chunked()
+{
+  assertNotChunked("Content-Type: text/plain");
+  assertNotChunked("X-Transfer-Encoding: chunked");
+  assertNotChunked("Transfer-Encodings: chunked");
+  assertNotChunked("X-Note: transfer-encoding: chunked");
+  assertNotChunked("Transfer-Encoding: chunkedx");
+  assertNotChunked("Transfer-Encoding: notchunked");
+  assertNotChunked("Transfer-Encoding: chun ked");
+}
+
+// Header lines longer than the receive buffer are followed across reads
+void test_long_headers_before_the_coding()
+{
+  assertChunked("Set-Cookie: session=0123456789012345678901234567890123456789012345678901234567890123456789\r\n"
+                "Transfer-Encoding:                                                                      chunked");
+}
+
+// The parser keeps its state in a few bytes, whatever the response
+void test_parsing_does_not_allocate()
+{
+  get("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n" CHUNKED_BODY); // warm up the connection slots
+  size_t before = simHeapInUse();
+  simHeapResetPeak();
+  for (int i = 0; i < 20; i++)
+  {
+    assertChunked("Content-Type: text/csv\r\nTransfer-Encoding: GZIP , chunked");
+    assertNotChunked("Content-Type: text/csv");
+  }
+  TEST_ASSERT_EQUAL(before, simHeapPeak());
+}
+
+#define BENCH_REQUESTS 500
+#define BENCH_BODY "[{\"sensor\":\"5a0c2cc89fd3c200111118f0\",\"value\":\"1013.25\"}]"
+
+static void writeBenchBody(Print &out, void *)
+{
+  out.print(BENCH_BODY);
+}
+
+static uint64_t wallNs()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Host benchmark: uploads through httpSendWithRetry() against the simulated
+// server, heap allocations and wall time per request. The simulated network
+// time is not in the wall time, delay() skips it.
+void test_benchmark_requests()
+{
+  HttpRequest request = {};
+  request.method = "POST";
+  request.host = "ingress.opensensemap.org";
+  request.port = 80;
+  request.path = "/boxes/5a0c2cc89fd3c200111118f0/data";
+  request.headers = "Content-Type: application/json\r\nAuthorization: token\r\n";
+  request.contentLength = strlen(BENCH_BODY);
+  request.writeBody = writeBenchBody;
+  TEST_ASSERT_EQUAL(201, httpSendWithRetry(request, 3)); // warm up the connection slots
+
+  uint32_t allocations = simHeapAllocations();
+  uint64_t worldStart = simWorldMicros();
+  uint64_t start = wallNs();
+  for (int i = 0; i < BENCH_REQUESTS; i++)
+    TEST_ASSERT_EQUAL(201, httpSendWithRetry(request, 3));
+  uint64_t spent = wallNs() - start;
+  allocations = simHeapAllocations() - allocations;
+
+  printf("HTTP client: %d requests, %u heap allocations, %.1f us per request on the host, %.0f ms simulated\n",
+         BENCH_REQUESTS, (unsigned)allocations, spent / 1e3 / BENCH_REQUESTS,
+         (simWorldMicros() - worldStart) / 1e3 / BENCH_REQUESTS);
+  TEST_ASSERT_EQUAL(0, allocations);
+}
+
+// Backfill-like GET over TLS, each test on its own host so the TLS state
+// starts over
+static HttpRequest tlsRequest(const char *host, uint16_t rxBuffer)
+{
+  HttpRequest request = {};
+  request.method = "GET";
+  request.host = host;
+  request.port = 443;
+  request.secure = true;
+  request.path = "/statistics/descriptive";
+  request.tlsRxBuffer = rxBuffer;
+  request.tlsTxBuffer = 512;
+  return request;
+}
+
+// Heap peak of one request, the TLS buffers and the driver's
+static size_t tlsHeap(const HttpRequest &request)
+{
+  size_t before = simHeapInUse();
+  simHeapResetPeak();
+  TEST_ASSERT_EQUAL(200, httpSend(request));
+  return simHeapPeak() - before;
+}
+
+// Record buffers a successful request took
+static uint32_t tlsBuffers(const HttpRequest &request)
+{
+  simStats.tlsBufferPeak = 0;
+  TEST_ASSERT_EQUAL(200, httpSend(request));
+  return simStats.tlsBufferPeak;
+}
+
+// A probe that failed while the network was down is not kept
+void test_failed_probe_is_retried()
+{
+  HttpRequest request = tlsRequest("offline.example", 1024);
+  WiFi.disconnect();
+  TEST_ASSERT_EQUAL(HTTP_ERROR_CONNECT, httpSend(request));
+  setUp();
+  TEST_ASSERT_LESS_THAN(4096, tlsBuffers(request));
+}
+
+// A server that answered without max fragment length is asked again only
+// after HTTP_TLS_REPROBE_MS
+void test_refused_probe_is_kept_for_a_while()
+{
+  HttpRequest request = tlsRequest("nomfln.example", 1024);
+  setenv("SIM_TLS_MFLN", "0", 1);
+  TEST_ASSERT_GREATER_THAN(16384, tlsBuffers(request));
+  setenv("SIM_TLS_MFLN", "1", 1);
+  TEST_ASSERT_GREATER_THAN(16384, tlsBuffers(request));
+  simAdvance(HTTP_TLS_REPROBE_MS * 1000ull);
+  TEST_ASSERT_LESS_THAN(4096, tlsBuffers(request));
+}
+
+#define BENCH_TLS_REQUESTS 20
+
+struct TlsBench
+{
+  double handshakeMs; // connect time, TCP and TLS handshake
+  size_t heapPeak;
+};
+
+// hosts alternating between two names never resume a session
+static TlsBench benchTls(const char *hosts[2], uint16_t rxBuffer)
+{
+  TlsBench bench = {0, 0};
+  for (int i = 0; i < BENCH_TLS_REQUESTS; i++)
+  {
+    HttpRequest request = tlsRequest(hosts[i % 2], rxBuffer);
+    uint32_t connectUs = 0;
+    request.connectUs = &connectUs;
+    size_t heap = tlsHeap(request);
+    bench.handshakeMs += connectUs / 1e3 / BENCH_TLS_REQUESTS;
+    if (heap > bench.heapPeak)
+      bench.heapPeak = heap;
+  }
+  return bench;
+}
+
+// Before: a full handshake with 16 KB records every time. After: the kept
+// session and a 1 KB receive buffer after max fragment length negotiation.
+void test_benchmark_tls()
+{
+  const char *fresh[2] = {"a.example", "b.example"};
+  const char *kept[2] = {"api.example", "api.example"};
+  TlsBench before = benchTls(fresh, 0);
+  TlsBench after = benchTls(kept, 1024);
+  printf("TLS before: %.0f ms connect, %zu B heap peak\n", before.handshakeMs, before.heapPeak);
+  printf("TLS after:  %.0f ms connect, %zu B heap peak\n", after.handshakeMs, after.heapPeak);
+  TEST_ASSERT_LESS_THAN(before.handshakeMs / 2, after.handshakeMs);
+  TEST_ASSERT_LESS_THAN(before.heapPeak / 4, after.heapPeak);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_header_name_is_case_insensitive);
+  RUN_TEST(test_value_whitespace_is_trimmed);
+  RUN_TEST(test_last_coding_decides);
+  RUN_TEST(test_other_headers_and_codings_are_not_chunked);
+  RUN_TEST(test_long_headers_before_the_coding);
+  RUN_TEST(test_parsing_does_not_allocate);
+  RUN_TEST(test_benchmark_requests);
+  RUN_TEST(test_failed_probe_is_retried);
+  RUN_TEST(test_refused_probe_is_kept_for_a_while);
+  RUN_TEST(test_benchmark_tls);
+  return UNITY_END();
+}
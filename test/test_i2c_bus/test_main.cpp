@@ -0,0 +1,259 @@
+#include "display_regions.h"
+#include "i2c_bus.h"
+#include "i2c_sensors.h"
+#include "scheduler.h"
+#include <Adafruit_SSD1306.h>
+#include <Arduino.h>
+#include <sim.h>
+#include <stdio.h>
+#include <unity.h>
+
+#define SDA_PIN 2
+#define SCL_PIN 14
+#define BMP280_ADDRESS 0x76
+#define OLED_ADDRESS 0x3C
+#define FLUSH_PAGES 2 // DISPLAY_FLUSH_PAGES in main.cpp
+
+static Adafruit_SSD1306 display(128, 64);
+static DisplayRegions frame;
+
+void setUp()
+{
+  simI2cStickSda(0);
+  simI2cUnplug(BMP280_ADDRESS, false);
+  i2cBusBegin(SDA_PIN, SCL_PIN);
+}
+
+void tearDown() {}
+
+static SimEnvironment environment()
+{
+  return simEnvironmentAt(simEpoch() + (time_t)(simWorldMicros() / 1000000));
+}
+
+void test_counts_come_from_the_transfers()
+{
+  TEST_ASSERT_TRUE(bmp280Begin(BMP280_ADDRESS));
+  const I2cDeviceStats &stats = i2cBusStats(I2C_BMP280);
+  // Chip id and trimming: register address, repeated start, the bytes
+  TEST_ASSERT_EQUAL(4, stats.transactions);
+  TEST_ASSERT_EQUAL((2 + 2) + (2 + 25), stats.bytes);
+  TEST_ASSERT_EQUAL(0, stats.errors);
+  TEST_ASSERT_EQUAL(I2C_CLOCK_HZ, stats.clock);
+}
+
+void test_missing_device_is_an_error()
+{
+  TEST_ASSERT_FALSE(bmp280Begin(0x77));
+  const I2cDeviceStats &stats = i2cBusStats(I2C_BMP280);
+  TEST_ASSERT_EQUAL(2, stats.errors); // the transfer and its retry
+  TEST_ASSERT_EQUAL(2, stats.transactions);
+  TEST_ASSERT_EQUAL(2, stats.bytes); // only the address bytes
+  TEST_ASSERT_EQUAL(I2C_FALLBACK_CLOCK_HZ, stats.clock);
+}
+
+// The old success check looked at the value, a NACK still gave a number
+void test_nack_fails_the_reading()
+{
+  TEST_ASSERT_TRUE(bmp280Begin(BMP280_ADDRESS));
+  TEST_ASSERT_TRUE(bmp280StartForced(BMP280_SAMPLING_X1, BMP280_SAMPLING_X1));
+  delay(10);
+  float temp, pres;
+  simI2cUnplug(BMP280_ADDRESS, true);
+  TEST_ASSERT_FALSE(bmp280Read(temp, pres));
+  TEST_ASSERT_EQUAL(2, i2cBusStats(I2C_BMP280).errors);
+
+  simI2cUnplug(BMP280_ADDRESS, false);
+  TEST_ASSERT_TRUE(bmp280Read(temp, pres));
+  TEST_ASSERT_EQUAL(2, i2cBusStats(I2C_BMP280).errors);
+}
+
+void test_bmp280_compensation()
+{
+  TEST_ASSERT_TRUE(bmp280Begin(BMP280_ADDRESS));
+  TEST_ASSERT_TRUE(bmp280StartForced(BMP280_SAMPLING_X2, BMP280_SAMPLING_X16));
+  delay(45);
+  float temp, pres;
+  TEST_ASSERT_TRUE(bmp280Read(temp, pres));
+  SimEnvironment env = environment();
+  TEST_ASSERT_FLOAT_WITHIN(0.02f, env.temp, temp);
+  TEST_ASSERT_FLOAT_WITHIN(1.0f, env.pres * 100, pres);
+}
+
+void test_bh1750_one_time_measurement()
+{
+  TEST_ASSERT_TRUE(bh1750Start(BH1750_ONE_TIME_HIGH_RES_2));
+  delay(180);
+  float lux = bh1750Read();
+  TEST_ASSERT_FLOAT_WITHIN(0.5f, environment().lux, lux);
+  const I2cDeviceStats &stats = i2cBusStats(I2C_BH1750);
+  TEST_ASSERT_EQUAL(2, stats.transactions);
+  TEST_ASSERT_EQUAL(2 + 3, stats.bytes);
+}
+
+// A device reset halfway through a read holds SDA low: the transfer fails,
+// the recovery clocks it free and the retry at the fallback clock delivers
+void test_stuck_sda_then_recovery()
+{
+  TEST_ASSERT_TRUE(bmp280Begin(BMP280_ADDRESS));
+  TEST_ASSERT_TRUE(bmp280StartForced(BMP280_SAMPLING_X1, BMP280_SAMPLING_X1));
+  delay(10);
+  simI2cStickSda(5);
+  TEST_ASSERT_EQUAL(LOW, digitalRead(SDA_PIN));
+  float temp, pres;
+  TEST_ASSERT_TRUE(bmp280Read(temp, pres));
+  TEST_ASSERT_EQUAL(HIGH, digitalRead(SDA_PIN));
+  const I2cDeviceStats &stats = i2cBusStats(I2C_BMP280);
+  TEST_ASSERT_EQUAL(1, stats.errors);
+  TEST_ASSERT_EQUAL(I2C_FALLBACK_CLOCK_HZ, stats.clock);
+  TEST_ASSERT_FLOAT_WITHIN(0.1f, environment().temp, temp);
+}
+
+void test_begin_frees_a_stuck_bus()
+{
+  simI2cStickSda(9);
+  i2cBusBegin(SDA_PIN, SCL_PIN);
+  TEST_ASSERT_EQUAL(HIGH, digitalRead(SDA_PIN));
+  TEST_ASSERT_TRUE(bmp280Begin(BMP280_ADDRESS));
+  TEST_ASSERT_EQUAL(0, i2cBusStats(I2C_BMP280).errors);
+}
+
+void test_bus_that_stays_stuck()
+{
+  TEST_ASSERT_TRUE(bmp280Begin(BMP280_ADDRESS));
+  simI2cStickSda(100);
+  float temp, pres;
+  TEST_ASSERT_FALSE(bmp280Read(temp, pres));
+  TEST_ASSERT_EQUAL(2, i2cBusStats(I2C_BMP280).errors);
+  TEST_ASSERT_FLOAT_IS_NAN(bh1750Read());
+  TEST_ASSERT_EQUAL(2, i2cBusStats(I2C_BH1750).errors);
+}
+
+// displayStep() and sensorStep() of main.cpp reduced to their bus traffic
+static bool readOk;
+
+static uint32_t flushStep()
+{
+  displayRegionsFlush(frame, display.getBuffer(), OLED_ADDRESS, FLUSH_PAGES);
+  return displayRegionsDirty(frame) ? 0 : TASK_SUSPEND;
+}
+
+static uint32_t readStep()
+{
+  float temp, pres;
+  readOk = bmp280Read(temp, pres);
+  return TASK_SUSPEND;
+}
+
+static uint32_t clockMs()
+{
+  return millis();
+}
+
+static uint32_t clockUs()
+{
+  return micros();
+}
+
+// A reading that falls due while a full frame goes out is read between two
+// page windows, never between a window and its data
+void test_sensor_read_lands_between_page_windows()
+{
+  TEST_ASSERT_TRUE(display.begin(SSD1306_SWITCHCAPVCC, OLED_ADDRESS));
+  TEST_ASSERT_TRUE(bmp280Begin(BMP280_ADDRESS));
+  TEST_ASSERT_TRUE(bmp280StartForced(BMP280_SAMPLING_X1, BMP280_SAMPLING_X1));
+  Task tasks[2] = {{"display", flushStep}, {"sensor", readStep}};
+  Scheduler scheduler = {tasks, 2, clockMs, clockUs};
+  for (int i = 0; i < DISPLAY_PAGES * DISPLAY_COLUMNS; i++)
+    display.getBuffer()[i] = (uint8_t)(i * 7 + 1);
+  displayRegionsMarkAll(frame);
+  simI2cLogClear();
+  schedulerWake(scheduler, tasks[0], 0);
+  schedulerWake(scheduler, tasks[1], 10); // the conversion is done halfway through the frame
+  readOk = false;
+  for (uint32_t wait = 0; wait != TASK_SUSPEND; wait = schedulerRun(scheduler))
+    delay(wait);
+  TEST_ASSERT_TRUE(readOk);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(display.getBuffer(), simDisplayRam(), DISPLAY_PAGES * DISPLAY_COLUMNS);
+
+  int windows = 0;
+  int windowsBeforeRead = -1;
+  int pending = 0; // data bytes the open window still expects
+  TEST_ASSERT_LESS_THAN(SIM_I2C_LOG_SIZE, simI2cLogCount());
+  for (size_t i = 0; i < simI2cLogCount(); i++)
+  {
+    const SimI2cTransfer &t = simI2cLogEntry(i);
+    if (t.address == BMP280_ADDRESS)
+    {
+      TEST_ASSERT_TRUE_MESSAGE(pending == 0, "sensor read inside a page window");
+      if (windowsBeforeRead < 0)
+        windowsBeforeRead = windows;
+    }
+    else if (t.data[0] == 0x00 && t.data[1] == SSD1306_PAGEADDR)
+    {
+      TEST_ASSERT_EQUAL(0, pending);
+      pending = (t.data[3] - t.data[2] + 1) * (t.data[6] - t.data[5] + 1);
+      windows++;
+    }
+    else
+    {
+      TEST_ASSERT_EQUAL_HEX8(0x40, t.data[0]);
+      pending -= t.length - 1;
+    }
+  }
+  TEST_ASSERT_EQUAL(0, pending);
+  TEST_ASSERT_EQUAL(DISPLAY_PAGES / FLUSH_PAGES, windows);
+  TEST_ASSERT_GREATER_THAN(0, windowsBeforeRead);
+  TEST_ASSERT_LESS_THAN(windows, windowsBeforeRead);
+}
+
+static uint32_t flushFrame(uint32_t &bytes)
+{
+  const I2cDeviceStats &stats = i2cBusStats(I2C_SSD1306);
+  uint32_t busyUs = stats.busyUs;
+  displayRegionsMarkAll(frame);
+  bytes = displayRegionsFlush(frame, display.getBuffer(), OLED_ADDRESS);
+  return stats.busyUs - busyUs;
+}
+
+// A full frame at 400 kHz takes a quarter of the bus time it takes at the
+// 100 kHz fallback
+void test_frame_bus_time_by_clock()
+{
+  TEST_ASSERT_TRUE(display.begin(SSD1306_SWITCHCAPVCC, OLED_ADDRESS));
+  uint32_t fastBytes, slowBytes;
+  uint32_t fastUs = flushFrame(fastBytes);
+  TEST_ASSERT_EQUAL(I2C_CLOCK_HZ, i2cBusStats(I2C_SSD1306).clock);
+
+  simI2cUnplug(OLED_ADDRESS, true);
+  uint8_t off = SSD1306_DISPLAYOFF;
+  TEST_ASSERT_NOT_EQUAL(0, i2cBusWrite(I2C_SSD1306, OLED_ADDRESS, 0x00, &off, 1));
+  simI2cUnplug(OLED_ADDRESS, false);
+  TEST_ASSERT_EQUAL(I2C_FALLBACK_CLOCK_HZ, i2cBusStats(I2C_SSD1306).clock);
+  uint32_t slowUs = flushFrame(slowBytes);
+
+  uint32_t fastRate = (uint64_t)fastBytes * 1000000 / fastUs;
+  uint32_t slowRate = (uint64_t)slowBytes * 1000000 / slowUs;
+  printf("SSD1306 frame: %u bytes, %u us (%u B/s) at %u kHz, %u us (%u B/s) at %u kHz\n", (unsigned)fastBytes,
+         (unsigned)fastUs, (unsigned)fastRate, I2C_CLOCK_HZ / 1000, (unsigned)slowUs, (unsigned)slowRate,
+         I2C_FALLBACK_CLOCK_HZ / 1000);
+  TEST_ASSERT_EQUAL(fastBytes, slowBytes);
+  TEST_ASSERT_UINT32_WITHIN(slowUs / 20, slowUs, fastUs * (I2C_CLOCK_HZ / I2C_FALLBACK_CLOCK_HZ));
+  TEST_ASSERT_UINT32_WITHIN(I2C_CLOCK_HZ / 9 / 20, I2C_CLOCK_HZ / 9, fastRate); // 9 clocks a byte
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_counts_come_from_the_transfers);
+  RUN_TEST(test_missing_device_is_an_error);
+  RUN_TEST(test_nack_fails_the_reading);
+  RUN_TEST(test_bmp280_compensation);
+  RUN_TEST(test_bh1750_one_time_measurement);
+  RUN_TEST(test_stuck_sda_then_recovery);
+  RUN_TEST(test_begin_frees_a_stuck_bus);
+  RUN_TEST(test_bus_that_stays_stuck);
+  RUN_TEST(test_sensor_read_lands_between_page_windows);
+  RUN_TEST(test_frame_bus_time_by_clock);
+  return UNITY_END();
+}
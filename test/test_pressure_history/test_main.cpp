@@ -0,0 +1,130 @@
+#include "crc32.h"
+#include "pressure_history.h"
+#include <string.h>
+#include <unity.h>
+
+static PressureHistory history;
+
+void setUp()
+{
+  pressureHistoryReset(history);
+}
+
+void tearDown() {}
+
+// Whole hours of samples at a constant pressure each, from hour on
+static void feedHours(uint32_t hour, const float *means, int count)
+{
+  for (int h = 0; h < count; h++)
+  {
+    for (int s = 0; s < 60; s++)
+      pressureHistoryAddSample(history, hour + h, means[h]);
+  }
+}
+
+void test_crc32_check_value()
+{
+  TEST_ASSERT_EQUAL_HEX32(0xCBF43926, crc32("123456789", 9));
+  TEST_ASSERT_EQUAL_HEX32(0x00000000, crc32("", 0));
+}
+
+void test_reset_is_valid()
+{
+  TEST_ASSERT_TRUE(pressureHistoryValid(history));
+  TEST_ASSERT_EQUAL(0, history.count);
+}
+
+void test_sealed_history_survives_a_copy()
+{
+  const float means[] = {1010.0f, 1011.0f, 1012.0f};
+  feedHours(1000, means, 3);
+  pressureHistorySeal(history);
+  PressureHistory rtc; // what comes back out of RTC memory
+  memcpy(&rtc, &history, sizeof(rtc));
+  TEST_ASSERT_TRUE(pressureHistoryValid(rtc));
+  TEST_ASSERT_EQUAL(2, rtc.count);
+}
+
+// RTC memory keeps random content after a power loss, and a brown-out can
+// flip single bits
+void test_corrupted_rtc_memory_is_rejected()
+{
+  const float means[] = {1010.0f, 1011.0f};
+  feedHours(1000, means, 2);
+  pressureHistorySeal(history);
+
+  for (size_t byte = 0; byte < sizeof(history); byte++)
+  {
+    PressureHistory rtc;
+    memcpy(&rtc, &history, sizeof(rtc));
+    ((uint8_t *)&rtc)[byte] ^= 0x10;
+    TEST_ASSERT_FALSE(pressureHistoryValid(rtc));
+  }
+
+  PressureHistory garbage;
+  memset(&garbage, 0xA5, sizeof(garbage));
+  TEST_ASSERT_FALSE(pressureHistoryValid(garbage));
+}
+
+void test_fields_out_of_range_are_rejected_despite_the_crc()
+{
+  history.head = PRESSURE_HISTORY_SLOTS;
+  pressureHistorySeal(history);
+  TEST_ASSERT_FALSE(pressureHistoryValid(history));
+
+  pressureHistoryReset(history);
+  history.count = PRESSURE_HISTORY_SLOTS + 1;
+  pressureHistorySeal(history);
+  TEST_ASSERT_FALSE(pressureHistoryValid(history));
+
+  pressureHistoryReset(history);
+  history.magic ^= 1;
+  pressureHistorySeal(history);
+  TEST_ASSERT_FALSE(pressureHistoryValid(history));
+}
+
+void test_hour_change_stores_the_mean()
+{
+  TEST_ASSERT_FALSE(pressureHistoryAddSample(history, 500, 1000.0f));
+  TEST_ASSERT_FALSE(pressureHistoryAddSample(history, 500, 1002.0f));
+  TEST_ASSERT_TRUE(pressureHistoryAddSample(history, 501, 1005.0f));
+  TEST_ASSERT_EQUAL(1, history.count);
+  TEST_ASSERT_EQUAL_FLOAT(1001.0f, history.means[0]);
+  TEST_ASSERT_EQUAL(2, pressureHistoryPoints(history));
+}
+
+void test_skipped_hours_drop_the_history()
+{
+  const float means[] = {1010.0f, 1011.0f, 1012.0f};
+  feedHours(1000, means, 3);
+  TEST_ASSERT_EQUAL(2, history.count);
+  pressureHistoryAddSample(history, 1005, 1013.0f);
+  TEST_ASSERT_EQUAL(0, history.count);
+  TEST_ASSERT_EQUAL(1, pressureHistoryPoints(history));
+}
+
+void test_ring_keeps_the_newest_slots()
+{
+  float means[PRESSURE_HISTORY_SLOTS + 4];
+  for (int i = 0; i < PRESSURE_HISTORY_SLOTS + 4; i++)
+    means[i] = 1000.0f + i;
+  feedHours(0, means, PRESSURE_HISTORY_SLOTS + 4);
+  TEST_ASSERT_EQUAL(PRESSURE_HISTORY_SLOTS, history.count);
+  // The newest closed hour sits just before head
+  int newest = (history.head + PRESSURE_HISTORY_SLOTS - 1) % PRESSURE_HISTORY_SLOTS;
+  TEST_ASSERT_EQUAL_FLOAT(1000.0f + PRESSURE_HISTORY_SLOTS + 2, history.means[newest]);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_crc32_check_value);
+  RUN_TEST(test_reset_is_valid);
+  RUN_TEST(test_sealed_history_survives_a_copy);
+  RUN_TEST(test_corrupted_rtc_memory_is_rejected);
+  RUN_TEST(test_fields_out_of_range_are_rejected_despite_the_crc);
+  RUN_TEST(test_hour_change_stores_the_mean);
+  RUN_TEST(test_skipped_hours_drop_the_history);
+  RUN_TEST(test_ring_keeps_the_newest_slots);
+  return UNITY_END();
+}
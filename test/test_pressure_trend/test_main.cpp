@@ -0,0 +1,188 @@
+#include "pressure_history.h"
+#include <unity.h>
+
+static PressureHistory history;
+
+void setUp()
+{
+  pressureHistoryReset(history);
+}
+
+void tearDown() {}
+
+static void push(const float *means, int count)
+{
+  for (int i = 0; i < count; i++)
+    pressureHistoryPush(history, means[i]);
+}
+
+// Mean of a closed hour, age 0 is the newest
+static float closedMean(int age)
+{
+  return history.means[(history.head + 2 * PRESSURE_HISTORY_SLOTS - 1 - age) % PRESSURE_HISTORY_SLOTS];
+}
+
+// Least-squares slope through the newest n means, straight from the points
+static float directSlope(int n)
+{
+  float sumX = 0, sumY = 0, sumXY = 0, sumXX = 0;
+  for (int age = 0; age < n; age++)
+  {
+    float x = -age;
+    float y = closedMean(age);
+    sumX += x;
+    sumY += y;
+    sumXY += x * y;
+    sumXX += x * x;
+  }
+  return (n * sumXY - sumX * sumY) / (n * sumXX - sumX * sumX);
+}
+
+void test_slope_needs_two_hours()
+{
+  float slope = 123.0f;
+  TEST_ASSERT_FALSE(pressureHistorySlope(history, slope));
+  pressureHistoryPush(history, 1010.0f);
+  TEST_ASSERT_FALSE(pressureHistorySlope(history, slope));
+  TEST_ASSERT_EQUAL_FLOAT(123.0f, slope);
+  pressureHistoryPush(history, 1010.5f);
+  TEST_ASSERT_TRUE(pressureHistorySlope(history, slope));
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, 0.5f, slope);
+}
+
+void test_linear_ramp_gives_its_slope()
+{
+  const float means[] = {1020.0f, 1019.4f, 1018.8f, 1018.2f, 1017.6f, 1017.0f};
+  push(means, 6);
+  float slope;
+  TEST_ASSERT_TRUE(pressureHistorySlope(history, slope));
+  TEST_ASSERT_FLOAT_WITHIN(1e-3f, -0.6f, slope);
+}
+
+// Only the newest PRESSURE_SLOPE_POINTS hours count
+void test_slope_window_drops_old_hours()
+{
+  const float means[] = {990.0f, 1030.0f, 1010.0f, 1011.0f, 1012.0f, 1013.0f};
+  push(means, 6);
+  float slope;
+  TEST_ASSERT_TRUE(pressureHistorySlope(history, slope));
+  TEST_ASSERT_FLOAT_WITHIN(1e-3f, 1.0f, slope);
+}
+
+// The O(1) running sums agree with a full fit, also long after the ring wrapped
+void test_running_sums_match_a_direct_fit()
+{
+  uint32_t seed = 7;
+  float slope;
+  for (int i = 0; i < 20 * PRESSURE_HISTORY_SLOTS; i++)
+  {
+    seed = seed * 1103515245 + 12345;
+    pressureHistoryPush(history, 985.0f + (seed >> 16) % 5000 / 100.0f);
+    int n = history.count < PRESSURE_SLOPE_POINTS ? history.count : PRESSURE_SLOPE_POINTS;
+    if (n < 2)
+      continue;
+    TEST_ASSERT_TRUE(pressureHistorySlope(history, slope));
+    TEST_ASSERT_FLOAT_WITHIN(2e-3f, directSlope(n), slope);
+  }
+}
+
+void test_skipped_hours_reset_the_slope()
+{
+  const float means[] = {1010.0f, 1011.0f, 1012.0f};
+  for (int h = 0; h < 3; h++)
+    pressureHistoryAddSample(history, 100 + h, means[h]);
+  pressureHistoryAddSample(history, 110, 1000.0f);
+  pressureHistoryAddSample(history, 111, 998.0f);
+  float slope;
+  TEST_ASSERT_FALSE(pressureHistorySlope(history, slope)); // one closed hour since the gap
+  pressureHistoryAddSample(history, 112, 996.0f);
+  TEST_ASSERT_TRUE(pressureHistorySlope(history, slope));
+  TEST_ASSERT_FLOAT_WITHIN(1e-3f, -2.0f, slope);
+}
+
+void test_boundaries_without_a_previous_category()
+{
+  TEST_ASSERT_EQUAL(TREND_HARD_UP, classifyPressureTrend(PRESSURE_TREND_HARD, -1));
+  TEST_ASSERT_EQUAL(TREND_SLIGHT_UP, classifyPressureTrend(1.59f, -1));
+  TEST_ASSERT_EQUAL(TREND_SLIGHT_UP, classifyPressureTrend(PRESSURE_TREND_SLIGHT, -1));
+  TEST_ASSERT_EQUAL(TREND_FLAT, classifyPressureTrend(0.49f, -1));
+  TEST_ASSERT_EQUAL(TREND_FLAT, classifyPressureTrend(0.0f, -1));
+  TEST_ASSERT_EQUAL(TREND_FLAT, classifyPressureTrend(-0.49f, -1));
+  TEST_ASSERT_EQUAL(TREND_SLIGHT_DOWN, classifyPressureTrend(-PRESSURE_TREND_SLIGHT, -1));
+  TEST_ASSERT_EQUAL(TREND_SLIGHT_DOWN, classifyPressureTrend(-1.59f, -1));
+  TEST_ASSERT_EQUAL(TREND_HARD_DOWN, classifyPressureTrend(-PRESSURE_TREND_HARD, -1));
+  TEST_ASSERT_EQUAL(TREND_FLAT, classifyPressureTrend(0.49f, 7)); // stale value from RTC
+}
+
+// A rate has to get the hysteresis past a boundary to change the arrow
+void test_hysteresis_at_the_boundaries()
+{
+  TEST_ASSERT_EQUAL(TREND_FLAT, classifyPressureTrend(PRESSURE_TREND_SLIGHT, TREND_FLAT));
+  TEST_ASSERT_EQUAL(TREND_FLAT, classifyPressureTrend(0.69f, TREND_FLAT));
+  TEST_ASSERT_EQUAL(TREND_SLIGHT_UP, classifyPressureTrend(0.71f, TREND_FLAT));
+  TEST_ASSERT_EQUAL(TREND_SLIGHT_UP, classifyPressureTrend(0.31f, TREND_SLIGHT_UP));
+  TEST_ASSERT_EQUAL(TREND_FLAT, classifyPressureTrend(0.29f, TREND_SLIGHT_UP));
+
+  TEST_ASSERT_EQUAL(TREND_SLIGHT_UP, classifyPressureTrend(1.79f, TREND_SLIGHT_UP));
+  TEST_ASSERT_EQUAL(TREND_HARD_UP, classifyPressureTrend(1.81f, TREND_SLIGHT_UP));
+  TEST_ASSERT_EQUAL(TREND_HARD_UP, classifyPressureTrend(1.41f, TREND_HARD_UP));
+  TEST_ASSERT_EQUAL(TREND_SLIGHT_UP, classifyPressureTrend(1.39f, TREND_HARD_UP));
+
+  TEST_ASSERT_EQUAL(TREND_FLAT, classifyPressureTrend(-0.69f, TREND_FLAT));
+  TEST_ASSERT_EQUAL(TREND_SLIGHT_DOWN, classifyPressureTrend(-0.71f, TREND_FLAT));
+  TEST_ASSERT_EQUAL(TREND_SLIGHT_DOWN, classifyPressureTrend(-1.79f, TREND_SLIGHT_DOWN));
+  TEST_ASSERT_EQUAL(TREND_HARD_DOWN, classifyPressureTrend(-1.81f, TREND_SLIGHT_DOWN));
+  TEST_ASSERT_EQUAL(TREND_SLIGHT_DOWN, classifyPressureTrend(-1.39f, TREND_HARD_DOWN));
+}
+
+// A big jump lands where the hysteresis allows, not just one step on
+void test_jump_across_categories()
+{
+  TEST_ASSERT_EQUAL(TREND_HARD_DOWN, classifyPressureTrend(-3.0f, TREND_HARD_UP));
+  TEST_ASSERT_EQUAL(TREND_SLIGHT_DOWN, classifyPressureTrend(-1.7f, TREND_HARD_UP));
+  TEST_ASSERT_EQUAL(TREND_FLAT, classifyPressureTrend(0.0f, TREND_HARD_UP));
+}
+
+void test_tendency_characteristic_codes()
+{
+  const float tooFew[] = {1010.0f, 1011.0f, 1012.0f};
+  push(tooFew, 3);
+  TEST_ASSERT_EQUAL(-1, pressureTendencyCharacteristic(history));
+
+  struct
+  {
+    float means[4];
+    int code;
+  } cases[] = {
+      {{1010.0f, 1012.0f, 1012.0f, 1010.0f}, 0}, // up then down, back to the start
+      {{1010.0f, 1011.0f, 1012.0f, 1012.0f}, 1}, // up then steady
+      {{1010.0f, 1011.0f, 1012.0f, 1013.0f}, 2}, // steadily up
+      {{1012.0f, 1011.0f, 1011.0f, 1013.0f}, 3}, // down then up, higher
+      {{1010.0f, 1010.05f, 1009.95f, 1010.0f}, 4}, // steady
+      {{1012.0f, 1010.0f, 1010.0f, 1012.0f}, 5}, // down then up, back to the start
+      {{1013.0f, 1012.0f, 1011.0f, 1011.0f}, 6}, // down then steady
+      {{1013.0f, 1012.0f, 1011.0f, 1010.0f}, 7}, // steadily down
+      {{1010.0f, 1011.0f, 1011.0f, 1009.0f}, 8}, // up then down, lower
+  };
+  for (auto &c : cases)
+  {
+    pressureHistoryReset(history);
+    push(c.means, 4);
+    TEST_ASSERT_EQUAL(c.code, pressureTendencyCharacteristic(history));
+  }
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_slope_needs_two_hours);
+  RUN_TEST(test_linear_ramp_gives_its_slope);
+  RUN_TEST(test_slope_window_drops_old_hours);
+  RUN_TEST(test_running_sums_match_a_direct_fit);
+  RUN_TEST(test_skipped_hours_reset_the_slope);
+  RUN_TEST(test_boundaries_without_a_previous_category);
+  RUN_TEST(test_hysteresis_at_the_boundaries);
+  RUN_TEST(test_jump_across_categories);
+  RUN_TEST(test_tendency_characteristic_codes);
+  return UNITY_END();
+}
@@ -0,0 +1,65 @@
+#include "sbx_encoder.h"
+#include <string.h>
+#include <unity.h>
+
+static constexpr SbxSensorId ID = sbxSensorId("5a0c2cc89fd3c200111118f0");
+static_assert(sbxSensorIdValid("5a0c2cc89fd3c200111118f0"), "hex id");
+static_assert(sbxSensorIdValid("5A0C2CC89FD3C200111118F0"), "upper case hex id");
+static_assert(!sbxSensorIdValid("5a0c2cc89fd3c200111118f"), "short id");
+static_assert(!sbxSensorIdValid("5a0c2cc89fd3c200111118f0a"), "long id");
+static_assert(!sbxSensorIdValid("5a0c2cc89fd3c200111118g0"), "not hex");
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_sensor_id_decodes_at_compile_time()
+{
+  const uint8_t expected[SBX_ID_LENGTH] = {0x5a, 0x0c, 0x2c, 0xc8, 0x9f, 0xd3, 0xc2, 0x00, 0x11, 0x11, 0x18, 0xf0};
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, ID.bytes, SBX_ID_LENGTH);
+}
+
+void test_sbx_bytes_vector()
+{
+  // 1013.25f is 0x447D5000, little endian after the id
+  const uint8_t expected[SBX_MEASUREMENT_LENGTH] = {0x5a, 0x0c, 0x2c, 0xc8, 0x9f, 0xd3, 0xc2, 0x00,
+                                                    0x11, 0x11, 0x18, 0xf0, 0x00, 0x50, 0x7d, 0x44};
+  uint8_t out[SBX_MEASUREMENT_TS_LENGTH];
+  memset(out, 0xee, sizeof(out));
+  TEST_ASSERT_EQUAL(SBX_MEASUREMENT_LENGTH, sbxEncode(out, ID, 1013.25f, false, 0));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, out, SBX_MEASUREMENT_LENGTH);
+  TEST_ASSERT_EQUAL_HEX8(0xee, out[SBX_MEASUREMENT_LENGTH]); // nothing past the record
+}
+
+void test_sbx_bytes_ts_vector()
+{
+  // -3.5f is 0xC0600000, 1700000000 is 0x6553F100
+  const uint8_t expected[SBX_MEASUREMENT_TS_LENGTH] = {0x5a, 0x0c, 0x2c, 0xc8, 0x9f, 0xd3, 0xc2,
+                                                       0x00, 0x11, 0x11, 0x18, 0xf0, 0x00, 0x00,
+                                                       0x60, 0xc0, 0x00, 0xf1, 0x53, 0x65};
+  uint8_t out[SBX_MEASUREMENT_TS_LENGTH];
+  TEST_ASSERT_EQUAL(SBX_MEASUREMENT_TS_LENGTH, sbxEncode(out, ID, -3.5f, true, 1700000000));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, out, SBX_MEASUREMENT_TS_LENGTH);
+}
+
+void test_records_concatenate()
+{
+  uint8_t body[2 * SBX_MEASUREMENT_TS_LENGTH];
+  size_t n = sbxEncode(body, ID, 21.5f, true, 1);
+  n += sbxEncode(body + n, ID, 21.5f, true, 2);
+  TEST_ASSERT_EQUAL(sizeof(body), n);
+  const uint8_t value[4] = {0x00, 0x00, 0xac, 0x41}; // 21.5f
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(value, body + SBX_ID_LENGTH, 4);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(value, body + SBX_MEASUREMENT_TS_LENGTH + SBX_ID_LENGTH, 4);
+  TEST_ASSERT_EQUAL_HEX8(0x02, body[SBX_MEASUREMENT_TS_LENGTH + SBX_MEASUREMENT_LENGTH]);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_sensor_id_decodes_at_compile_time);
+  RUN_TEST(test_sbx_bytes_vector);
+  RUN_TEST(test_sbx_bytes_ts_vector);
+  RUN_TEST(test_records_concatenate);
+  return UNITY_END();
+}
@@ -0,0 +1,217 @@
+#include "scheduler.h"
+#include <string.h>
+#include <unity.h>
+
+// Fake clocks, steps move them forward to model their run time
+static uint32_t nowMs;
+static uint32_t nowUs;
+
+static uint32_t fakeMillis()
+{
+  return nowMs;
+}
+
+static uint32_t fakeMicros()
+{
+  return nowUs;
+}
+
+static void spend(uint32_t us)
+{
+  nowUs += us;
+  nowMs += us / 1000;
+}
+
+static char order[32]; // names of the steps in the order they ran
+static uint32_t nextDelay[3];
+static Scheduler scheduler;
+static Task tasks[3];
+
+static void ran(char name)
+{
+  size_t n = strlen(order);
+  if (n + 1 < sizeof(order))
+  {
+    order[n] = name;
+    order[n + 1] = '\0';
+  }
+}
+
+static uint32_t stepA()
+{
+  ran('a');
+  spend(100);
+  return nextDelay[0];
+}
+
+static uint32_t stepB()
+{
+  ran('b');
+  spend(200);
+  return nextDelay[1];
+}
+
+static uint32_t stepC()
+{
+  ran('c');
+  spend(300);
+  return nextDelay[2];
+}
+
+// A step that waits for something and lets the others run meanwhile
+static uint32_t yieldingStep()
+{
+  ran('A');
+  spend(1000);
+  schedulerYield(scheduler);
+  spend(1000);
+  return 10;
+}
+
+static uint32_t slowStep()
+{
+  spend(40000); // 40 ms of work
+  return 60000;
+}
+
+static uint32_t nestedYieldingStep()
+{
+  ran('B');
+  schedulerYield(scheduler); // a is running, c is due
+  return TASK_SUSPEND;
+}
+
+void setUp()
+{
+  nowMs = 1000;
+  nowUs = 1000000;
+  order[0] = '\0';
+  TaskStep steps[3] = {stepA, stepB, stepC};
+  const char *names[3] = {"a", "b", "c"};
+  for (int i = 0; i < 3; i++)
+  {
+    tasks[i] = Task();
+    tasks[i].name = names[i];
+    tasks[i].step = steps[i];
+    tasks[i].suspended = true;
+    nextDelay[i] = TASK_SUSPEND;
+  }
+  scheduler = {tasks, 3, fakeMillis, fakeMicros};
+}
+
+void tearDown() {}
+
+void test_earliest_deadline_runs_first()
+{
+  schedulerWake(scheduler, tasks[0], 0);
+  schedulerWake(scheduler, tasks[1], 0);
+  schedulerWake(scheduler, tasks[2], 0);
+  tasks[0].nextRun = 900; // all overdue, by different amounts
+  tasks[1].nextRun = 700;
+  tasks[2].nextRun = 800;
+  schedulerRun(scheduler);
+  TEST_ASSERT_EQUAL_STRING("bca", order);
+}
+
+void test_tasks_not_due_wait()
+{
+  schedulerWake(scheduler, tasks[0], 50);
+  schedulerWake(scheduler, tasks[1], 0);
+  nextDelay[1] = 20;
+  TEST_ASSERT_EQUAL(20, schedulerRun(scheduler)); // b is next, 20 ms after it started
+  TEST_ASSERT_EQUAL_STRING("b", order);
+  nowMs += 20;
+  schedulerRun(scheduler);
+  TEST_ASSERT_EQUAL_STRING("bb", order);
+  nowMs += 30; // b was due at 1040, a at 1050
+  schedulerRun(scheduler);
+  TEST_ASSERT_EQUAL_STRING("bbba", order);
+}
+
+void test_due_again_runs_once_per_pass()
+{
+  schedulerWake(scheduler, tasks[0], 0);
+  schedulerWake(scheduler, tasks[1], 0);
+  nextDelay[0] = 0;
+  nextDelay[1] = 0;
+  TEST_ASSERT_EQUAL(0, schedulerRun(scheduler));
+  TEST_ASSERT_EQUAL_STRING("ab", order);
+}
+
+void test_suspend_and_wake()
+{
+  TEST_ASSERT_EQUAL(TASK_SUSPEND, schedulerRun(scheduler));
+  schedulerWake(scheduler, tasks[2], 5);
+  TEST_ASSERT_EQUAL(5, schedulerRun(scheduler));
+  nowMs += 5;
+  TEST_ASSERT_EQUAL(TASK_SUSPEND, schedulerRun(scheduler)); // c suspends itself again
+  TEST_ASSERT_EQUAL_STRING("c", order);
+  TEST_ASSERT_TRUE(tasks[2].suspended);
+}
+
+// The cadence counts from the start of a step, its run time does not drift it
+void test_cadence_from_step_start()
+{
+  schedulerWake(scheduler, tasks[2], 0);
+  tasks[2].step = slowStep;
+  uint32_t start = nowMs;
+  schedulerRun(scheduler);
+  TEST_ASSERT_EQUAL(start + 60000, tasks[2].nextRun);
+}
+
+void test_deadlines_across_millis_wraparound()
+{
+  nowMs = 0xFFFFFFF0;
+  schedulerWake(scheduler, tasks[0], 0x20); // wraps to 0x10
+  schedulerWake(scheduler, tasks[1], 0x08); // before the wrap
+  TEST_ASSERT_EQUAL(0x08, schedulerRun(scheduler));
+  nowMs += 0x20;
+  schedulerRun(scheduler);
+  TEST_ASSERT_EQUAL_STRING("ba", order);
+}
+
+// A yielding step is not re-entered, the others run inside it, and their
+// time is not charged to it
+void test_yield_does_not_reenter()
+{
+  tasks[0].step = yieldingStep;
+  schedulerWake(scheduler, tasks[0], 0);
+  schedulerWake(scheduler, tasks[1], 0);
+  tasks[0].nextRun = nowMs - 10; // a first
+  schedulerRun(scheduler);
+  TEST_ASSERT_EQUAL_STRING("Ab", order);
+  TEST_ASSERT_EQUAL(1, tasks[0].runs);
+  TEST_ASSERT_EQUAL(1, tasks[1].runs);
+  TEST_ASSERT_EQUAL(2000, tasks[0].totalUs);
+  TEST_ASSERT_EQUAL(200, tasks[1].totalUs);
+  TEST_ASSERT_FALSE(tasks[0].running);
+  TEST_ASSERT_EQUAL(2000, schedulerAverageUs(tasks[0]));
+}
+
+void test_nested_yield_skips_running_tasks()
+{
+  tasks[0].step = yieldingStep;
+  tasks[1].step = nestedYieldingStep;
+  schedulerWake(scheduler, tasks[0], 0);
+  schedulerWake(scheduler, tasks[1], 0);
+  schedulerWake(scheduler, tasks[2], 0);
+  tasks[0].nextRun = nowMs - 20;
+  tasks[1].nextRun = nowMs - 10;
+  schedulerRun(scheduler);
+  TEST_ASSERT_EQUAL_STRING("ABc", order);
+  TEST_ASSERT_EQUAL(1, tasks[0].runs);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_earliest_deadline_runs_first);
+  RUN_TEST(test_tasks_not_due_wait);
+  RUN_TEST(test_due_again_runs_once_per_pass);
+  RUN_TEST(test_suspend_and_wake);
+  RUN_TEST(test_cadence_from_step_start);
+  RUN_TEST(test_deadlines_across_millis_wraparound);
+  RUN_TEST(test_yield_does_not_reenter);
+  RUN_TEST(test_nested_yield_skips_running_tasks);
+  return UNITY_END();
+}
@@ -0,0 +1,242 @@
+#include "sensor_history.h"
+#include <LittleFS.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unity.h>
+
+#define T0 1700000000UL
+
+// Only the precisions matter to the history, set in setUp()
+static SensorDef SENSORS[SENSOR_COUNT];
+
+static struct
+{
+  uint32_t timestamps[4 * HISTORY_SEGMENT_RECORDS];
+  float values[4 * HISTORY_SEGMENT_RECORDS][SENSOR_COUNT];
+  size_t count;
+} scanned;
+
+static void collect(uint32_t timestamp, const float *values, void *)
+{
+  if (scanned.count < sizeof(scanned.timestamps) / sizeof(scanned.timestamps[0]))
+  {
+    scanned.timestamps[scanned.count] = timestamp;
+    memcpy(scanned.values[scanned.count], values, sizeof(scanned.values[0]));
+  }
+  scanned.count++;
+}
+
+static size_t scan(uint32_t from)
+{
+  scanned.count = 0;
+  return historyScan(from, collect, nullptr);
+}
+
+// A minute sample with slowly changing values, i counts the minutes
+static void sample(uint32_t i, float *values)
+{
+  values[SENSOR_TEMP] = 21.5f + 0.01f * (i % 37);
+  values[SENSOR_PRES] = 1013.25f - 0.02f * (i % 50);
+  values[SENSOR_TEMP_OUT] = -3.5f + 0.25f * (i % 8);
+  values[SENSOR_LUX] = (i * 37) % 2000;
+  for (int s = SENSOR_PROBE_1; s < SENSOR_COUNT; s++)
+    values[s] = values[SENSOR_TEMP] - s;
+}
+
+static void appendMinutes(uint32_t first, uint32_t count)
+{
+  float values[SENSOR_COUNT];
+  for (uint32_t i = first; i < first + count; i++)
+  {
+    sample(i, values);
+    TEST_ASSERT_TRUE(historyAppend(T0 + 60 * i, values));
+  }
+}
+
+static void assertSample(uint32_t i, size_t index)
+{
+  float expected[SENSOR_COUNT];
+  sample(i, expected);
+  TEST_ASSERT_EQUAL(T0 + 60 * i, scanned.timestamps[index]);
+  for (int s = 0; s < SENSOR_COUNT; s++)
+    TEST_ASSERT_FLOAT_WITHIN(0.5f / powf(10, SENSORS[s].decimals) + 1e-4f, expected[s], scanned.values[index][s]);
+}
+
+void setUp()
+{
+  memset(SENSORS, 0, sizeof(SENSORS));
+  for (int s = 0; s < SENSOR_COUNT; s++)
+    SENSORS[s].decimals = s == SENSOR_LUX ? 0 : 2;
+  LittleFS.format();
+  historyBegin(SENSORS);
+}
+
+void tearDown() {}
+
+void test_round_trip()
+{
+  appendMinutes(0, 100);
+  TEST_ASSERT_EQUAL(100, scan(0));
+  for (uint32_t i = 0; i < 100; i++)
+    assertSample(i, i);
+}
+
+// Values are stored at the upload precision
+void test_values_are_quantized()
+{
+  float values[SENSOR_COUNT] = {21.234f, 1013.256f, -0.004f, 123.6f};
+  historyAppend(T0, values);
+  scan(0);
+  TEST_ASSERT_EQUAL_FLOAT(21.23f, scanned.values[0][SENSOR_TEMP]);
+  TEST_ASSERT_EQUAL_FLOAT(1013.26f, scanned.values[0][SENSOR_PRES]);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, scanned.values[0][SENSOR_TEMP_OUT]);
+  TEST_ASSERT_EQUAL_FLOAT(124.0f, scanned.values[0][SENSOR_LUX]);
+}
+
+// Missing values and irregular intervals take the escape paths of the codes
+void test_missing_values_and_jumps()
+{
+  const uint32_t times[] = {T0, T0 + 60, T0 + 120, T0 + 125, T0 + 3725, T0 + 3785, T0 + 100000};
+  const float temps[] = {20.0f, NAN, 20.5f, 20.5f, -40.0f, 85.0f, NAN};
+  float values[SENSOR_COUNT] = {0, 1000.0f, 5.0f, 0};
+  for (int i = 0; i < 7; i++)
+  {
+    values[SENSOR_TEMP] = temps[i];
+    values[SENSOR_LUX] = i == 4 ? 65000.0f : 0;
+    TEST_ASSERT_TRUE(historyAppend(times[i], values));
+  }
+  TEST_ASSERT_EQUAL(7, scan(0));
+  for (int i = 0; i < 7; i++)
+  {
+    TEST_ASSERT_EQUAL(times[i], scanned.timestamps[i]);
+    if (isnan(temps[i]))
+      TEST_ASSERT_FLOAT_IS_NAN(scanned.values[i][SENSOR_TEMP]);
+    else
+      TEST_ASSERT_EQUAL_FLOAT(temps[i], scanned.values[i][SENSOR_TEMP]);
+    TEST_ASSERT_EQUAL_FLOAT(i == 4 ? 65000.0f : 0, scanned.values[i][SENSOR_LUX]);
+  }
+}
+
+void test_scan_from_a_time()
+{
+  appendMinutes(0, 2 * HISTORY_SEGMENT_RECORDS + 10);
+  uint32_t first = HISTORY_SEGMENT_RECORDS + 5;
+  TEST_ASSERT_EQUAL(HISTORY_SEGMENT_RECORDS + 5, scan(T0 + 60 * first));
+  assertSample(first, 0);
+  TEST_ASSERT_EQUAL(0, scan(T0 + 60 * (2 * HISTORY_SEGMENT_RECORDS + 10)));
+}
+
+// Records spanning segment files come back in order, and a restart
+// continues the running segment
+void test_segments_survive_a_restart()
+{
+  appendMinutes(0, HISTORY_SEGMENT_RECORDS + 20);
+  historyBegin(SENSORS);
+  appendMinutes(HISTORY_SEGMENT_RECORDS + 20, HISTORY_SEGMENT_RECORDS);
+  uint32_t total = 2 * HISTORY_SEGMENT_RECORDS + 20;
+  TEST_ASSERT_EQUAL(total, scan(0));
+  for (uint32_t i = 0; i < total; i++)
+    assertSample(i, i);
+
+  HistoryUsage usage;
+  historyUsage(usage);
+  TEST_ASSERT_EQUAL(total, usage.records);
+  // Slowly changing minute samples take a few bytes rather than 4 + 4 per value
+  TEST_ASSERT_LESS_THAN(total * (2 + SENSOR_COUNT), usage.bytes);
+}
+
+// A reset during an append leaves part of a record behind, the next
+// append after a restart cuts it off
+void test_torn_record_is_dropped()
+{
+  appendMinutes(0, 10);
+  File f = LittleFS.open("/hist00", "a");
+  const uint8_t partial[] = {0xff, 0xff};
+  f.write(partial, sizeof(partial));
+  f.close();
+
+  historyBegin(SENSORS);
+  appendMinutes(10, 5);
+  TEST_ASSERT_EQUAL(15, scan(0));
+  for (uint32_t i = 0; i < 15; i++)
+    assertSample(i, i);
+}
+
+// The ring starts the oldest file over and never grows past its segments
+void test_ring_drops_the_oldest_segment()
+{
+  uint32_t total = (HISTORY_SEGMENTS + 1) * HISTORY_SEGMENT_RECORDS + 1;
+  appendMinutes(0, total);
+  HistoryUsage usage;
+  historyUsage(usage);
+  TEST_ASSERT_EQUAL((HISTORY_SEGMENTS - 1) * HISTORY_SEGMENT_RECORDS + 1, usage.records);
+  size_t visited = scan(0);
+  TEST_ASSERT_EQUAL(usage.records, visited);
+  TEST_ASSERT_EQUAL(T0 + 60 * (total - visited), scanned.timestamps[0]);
+}
+
+// Segments written with other precisions cannot be decoded and are skipped
+void test_other_layout_is_ignored()
+{
+  appendMinutes(0, 10);
+  SensorDef other[SENSOR_COUNT];
+  memcpy(other, SENSORS, sizeof(other));
+  other[SENSOR_PRES].decimals = 1;
+  historyBegin(other);
+  TEST_ASSERT_EQUAL(0, scan(0));
+  historyBegin(SENSORS);
+  TEST_ASSERT_EQUAL(10, scan(0));
+}
+
+static uint64_t wallNs()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void count(uint32_t, const float *, void *context)
+{
+  (*(size_t *)context)++;
+}
+
+// A week of minute samples, what the graph pages and backfill read from
+void test_benchmark_week()
+{
+  const uint32_t minutes = 7 * 24 * 60;
+  uint64_t start = wallNs();
+  appendMinutes(0, minutes);
+  uint64_t appendNs = wallNs() - start;
+
+  size_t visited = 0;
+  start = wallNs();
+  TEST_ASSERT_EQUAL(minutes, historyScan(0, count, &visited));
+  uint64_t scanNs = wallNs() - start;
+  TEST_ASSERT_EQUAL(minutes, visited);
+
+  HistoryUsage usage;
+  historyUsage(usage);
+  TEST_ASSERT_EQUAL(minutes, usage.records);
+  printf("History: %u records of %d sensors in %u bytes, %.2f bytes per sample, "
+         "%.1f us per append, %.0f us per full scan on the host\n",
+         (unsigned)usage.records, SENSOR_COUNT, (unsigned)usage.bytes,
+         (float)usage.bytes / (usage.records * SENSOR_COUNT), appendNs / 1e3 / minutes, scanNs / 1e3);
+  TEST_ASSERT_LESS_THAN(300 * 1024, usage.bytes);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_round_trip);
+  RUN_TEST(test_values_are_quantized);
+  RUN_TEST(test_missing_values_and_jumps);
+  RUN_TEST(test_scan_from_a_time);
+  RUN_TEST(test_segments_survive_a_restart);
+  RUN_TEST(test_torn_record_is_dropped);
+  RUN_TEST(test_ring_drops_the_oldest_segment);
+  RUN_TEST(test_other_layout_is_ignored);
+  RUN_TEST(test_benchmark_week);
+  return UNITY_END();
+}
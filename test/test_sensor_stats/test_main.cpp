@@ -0,0 +1,108 @@
+#include "sensor_stats.h"
+#include <math.h>
+#include <unity.h>
+
+static SensorStats stats;
+
+void setUp()
+{
+  sensorStatsClear(stats);
+}
+
+void tearDown() {}
+
+static void feed(const float *samples, int count, bool rejectSpikes)
+{
+  for (int i = 0; i < count; i++)
+    sensorStatsAdd(stats, samples[i], rejectSpikes);
+}
+
+void test_window_filling_holds_samples_back()
+{
+  TEST_ASSERT_FLOAT_IS_NAN(sensorStatsAdd(stats, 20.0f, true));
+  TEST_ASSERT_EQUAL(0, stats.count);
+  TEST_ASSERT_FLOAT_IS_NAN(stats.mean);
+  TEST_ASSERT_EQUAL_FLOAT(20.0f, sensorStatsLatest(stats));
+}
+
+void test_spike_in_first_sample()
+{
+  // The DS18B20 power-on value as the very first sample
+  const float samples[] = {85.0f, 12.0f, 12.2f, 12.1f, 12.3f};
+  feed(samples, 5, true);
+  TEST_ASSERT_EQUAL(5 - (SENSOR_STATS_MEDIAN - 1), stats.count);
+  TEST_ASSERT_LESS_THAN(12.5f, stats.max);
+  TEST_ASSERT_LESS_THAN(12.5f, stats.mean);
+  TEST_ASSERT_GREATER_OR_EQUAL(12.0f, stats.min);
+}
+
+void test_spike_mid_stream()
+{
+  const float samples[] = {1013.0f, 1013.1f, 1013.0f, 1013.2f, 850.0f, 1013.1f, 1013.2f, 1013.1f};
+  feed(samples, 8, true);
+  TEST_ASSERT_GREATER_OR_EQUAL(1013.0f, stats.min);
+  TEST_ASSERT_LESS_OR_EQUAL(1013.2f, stats.max);
+  TEST_ASSERT_FLOAT_WITHIN(0.1f, 1013.1f, stats.mean);
+}
+
+void test_step_passes_after_half_the_window()
+{
+  const float samples[] = {10.0f, 10.0f, 10.0f, 20.0f, 20.0f, 20.0f};
+  feed(samples, 6, true);
+  TEST_ASSERT_EQUAL_FLOAT(20.0f, stats.max);
+  TEST_ASSERT_EQUAL_FLOAT(10.0f, stats.min);
+}
+
+void test_nan_input_is_ignored()
+{
+  for (int i = 0; i < SENSOR_STATS_MEDIAN + 2; i++)
+  {
+    sensorStatsAdd(stats, 5.0f, true);
+    TEST_ASSERT_FLOAT_IS_NAN(sensorStatsAdd(stats, NAN, true));
+  }
+  TEST_ASSERT_EQUAL(3, stats.count);
+  TEST_ASSERT_EQUAL_FLOAT(5.0f, stats.mean);
+  TEST_ASSERT_FLOAT_IS_NAN(sensorStatsAdd(stats, NAN, true));
+  TEST_ASSERT_EQUAL_FLOAT(5.0f, sensorStatsLatest(stats));
+}
+
+void test_without_rejection_every_sample_counts()
+{
+  const float samples[] = {100.0f, 300.0f, 200.0f};
+  feed(samples, 3, false);
+  TEST_ASSERT_EQUAL(3, stats.count);
+  TEST_ASSERT_EQUAL_FLOAT(200.0f, stats.mean);
+  TEST_ASSERT_EQUAL_FLOAT(300.0f, stats.max);
+}
+
+void test_reset_keeps_the_window()
+{
+  const float samples[] = {7.0f, 7.0f, 7.0f, 7.0f};
+  feed(samples, 4, true);
+  sensorStatsReset(stats);
+  TEST_ASSERT_EQUAL(0, stats.count);
+  // A spike right after the reset is still caught by the carried-over window
+  TEST_ASSERT_EQUAL_FLOAT(7.0f, sensorStatsAdd(stats, 85.0f, true));
+  TEST_ASSERT_EQUAL_FLOAT(7.0f, stats.max);
+}
+
+void test_mean_keeps_precision_over_a_long_interval()
+{
+  for (int i = 0; i < 60000; i++)
+    sensorStatsAdd(stats, 1000.0f + (i % 2 ? 0.25f : -0.25f), false);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 1000.0f, stats.mean);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_window_filling_holds_samples_back);
+  RUN_TEST(test_spike_in_first_sample);
+  RUN_TEST(test_spike_mid_stream);
+  RUN_TEST(test_step_passes_after_half_the_window);
+  RUN_TEST(test_nan_input_is_ignored);
+  RUN_TEST(test_without_rejection_every_sample_counts);
+  RUN_TEST(test_reset_keeps_the_window);
+  RUN_TEST(test_mean_keeps_precision_over_a_long_interval);
+  return UNITY_END();
+}
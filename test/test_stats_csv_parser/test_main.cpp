@@ -0,0 +1,209 @@
+#include "arena.h"
+#include "http_client.h"
+#include "stats_csv_parser.h"
+#include <ESP8266WiFi.h>
+#include <sim.h>
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+
+#define ID "5a0c2cc89fd3c200111118f0"
+
+static StatsCsvParser parser;
+static float values[4];
+
+void setUp()
+{
+  if (WiFi.status() != WL_CONNECTED)
+  {
+    WiFi.mode(WIFI_STA);
+    WiFi.begin("ssid", "password");
+    while (WiFi.status() != WL_CONNECTED)
+      delay(10);
+  }
+  memset(values, 0, sizeof(values));
+  statsCsvBegin(parser, values, 4);
+}
+
+void tearDown() {}
+
+static void feed(const char *text)
+{
+  statsCsvFeed(parser, (const uint8_t *)text, strlen(text));
+}
+
+void test_values_after_the_header()
+{
+  feed("sensorId,time,value\n" ID ",2024-03-01T10:00:00.000Z,1012.5\n" ID ",2024-03-01T11:00:00.000Z,1013.25\n");
+  TEST_ASSERT_EQUAL(2, parser.count);
+  TEST_ASSERT_EQUAL_FLOAT(1012.5f, values[0]);
+  TEST_ASSERT_EQUAL_FLOAT(1013.25f, values[1]);
+  TEST_ASSERT_EQUAL(0, parser.rejected);
+}
+
+// The HTTP client hands over whatever arrived, lines split anywhere
+void test_byte_by_byte_feed()
+{
+  const char *body = "sensorId,time,value\r\n" ID ",2024-03-01T10:00:00.000Z,1009.75\r\n";
+  for (size_t i = 0; i < strlen(body); i++)
+    statsCsvFeed(parser, (const uint8_t *)body + i, 1);
+  TEST_ASSERT_EQUAL(1, parser.count);
+  TEST_ASSERT_EQUAL_FLOAT(1009.75f, values[0]);
+}
+
+void test_implausible_values_are_rejected()
+{
+  feed(ID ",t,42\n" ID ",t,1500\n" ID ",t,abc\n" ID ",t,\nshort,t,1010\n" ID ",t,1010.5\n");
+  TEST_ASSERT_EQUAL(1, parser.count);
+  TEST_ASSERT_EQUAL_FLOAT(1010.5f, values[0]);
+  TEST_ASSERT_EQUAL(5, parser.rejected);
+}
+
+void test_overlong_line_is_skipped()
+{
+  char line[STATS_CSV_LINE_MAX + 20];
+  memset(line, 'x', sizeof(line) - 1);
+  line[sizeof(line) - 1] = '\0';
+  feed(line);
+  feed(",t,1010\n" ID ",t,1011\n");
+  TEST_ASSERT_EQUAL(1, parser.count);
+  TEST_ASSERT_EQUAL_FLOAT(1011.0f, values[0]);
+}
+
+void test_full_array_drops_the_oldest()
+{
+  for (int i = 0; i < 6; i++)
+  {
+    char line[64];
+    snprintf(line, sizeof(line), ID ",t,%d\n", 1000 + i);
+    feed(line);
+  }
+  TEST_ASSERT_EQUAL(4, parser.count);
+  TEST_ASSERT_EQUAL_FLOAT(1002.0f, values[0]);
+  TEST_ASSERT_EQUAL_FLOAT(1005.0f, values[3]);
+}
+
+void test_finish_flushes_an_unterminated_line()
+{
+  feed(ID ",t,1008");
+  TEST_ASSERT_EQUAL(0, parser.count);
+  statsCsvFinish(parser);
+  TEST_ASSERT_EQUAL(1, parser.count);
+  TEST_ASSERT_EQUAL_FLOAT(1008.0f, values[0]);
+}
+
+void test_parsing_does_not_allocate()
+{
+  size_t before = simHeapInUse();
+  simHeapResetPeak();
+  for (int i = 0; i < 100; i++)
+    feed(ID ",2024-03-01T10:00:00.000Z,1012.5\n");
+  statsCsvFinish(parser);
+  TEST_ASSERT_EQUAL(before, simHeapPeak());
+}
+
+// The firmware asks for 12 hourly means
+#define PRODUCTION_LINES 12
+
+static char response[12 * 1024];
+static uintptr_t deepestStack;
+
+// Statistics API response with lines hourly means, chunked in 256 byte
+// pieces like the simulated server or plain until the connection closes
+static void buildResponse(int lines, bool chunked)
+{
+  static char body[8 * 1024];
+  int length = snprintf(body, sizeof(body), "sensorId,time_start,arithmeticMean_1h\n");
+  for (int i = 0; i < lines; i++)
+    length += snprintf(body + length, sizeof(body) - length, ID ",2024-03-01T%02d:00:00.000Z,%.2f\n", i % 24,
+                       1000 + i * 0.01);
+  int n = snprintf(response, sizeof(response), "HTTP/1.1 200 OK\r\nContent-Type: text/csv\r\n%s\r\n",
+                   chunked ? "Transfer-Encoding: chunked\r\n" : "");
+  if (!chunked)
+  {
+    snprintf(response + n, sizeof(response) - n, "%s", body);
+    return;
+  }
+  for (int at = 0; at < length; at += 256)
+  {
+    int piece = length - at < 256 ? length - at : 256;
+    n += snprintf(response + n, sizeof(response) - n, "%x\r\n%.*s\r\n", piece, piece, body + at);
+  }
+  snprintf(response + n, sizeof(response) - n, "0\r\n\r\n");
+}
+
+static void readBody(const uint8_t *data, size_t length, void *context)
+{
+  uint8_t marker;
+  if ((uintptr_t)&marker < deepestStack)
+    deepestStack = (uintptr_t)&marker;
+  statsCsvFeed(*(StatsCsvParser *)context, data, length);
+}
+
+struct FetchUse
+{
+  size_t heapPeak;
+  size_t arenaHighWater;
+  uintptr_t stackDepth; // below the caller's frame, at the deepest body callback
+};
+
+// The backfill request of the firmware against the given response
+static FetchUse fetch(int lines, bool chunked)
+{
+  buildResponse(lines, chunked);
+  simHttpRespond(response);
+  float means[15];
+  StatsCsvParser fetched;
+  statsCsvBegin(fetched, means, 15);
+  HttpRequest request = {};
+  request.method = "GET";
+  request.host = "api.opensensemap.org";
+  request.port = 80;
+  request.path = "/statistics/descriptive";
+  request.readBody = readBody;
+  request.context = &fetched;
+
+  uint8_t top;
+  deepestStack = (uintptr_t)&top;
+  size_t before = simHeapInUse();
+  simHeapResetPeak();
+  arenaReset();
+  TEST_ASSERT_EQUAL(200, httpSend(request));
+  statsCsvFinish(fetched);
+  TEST_ASSERT_EQUAL(lines + 1, fetched.lines);
+  TEST_ASSERT_EQUAL(lines < 15 ? lines : 15, fetched.count);
+  TEST_ASSERT_EQUAL_FLOAT(1000 + (lines - 1) * 0.01, means[fetched.count - 1]);
+  return {simHeapPeak() - before, arenaHighWater(), (uintptr_t)&top - deepestStack};
+}
+
+// Ten times the production response, chunked or not, takes the memory of one
+void test_memory_is_bounded_by_the_line()
+{
+  fetch(PRODUCTION_LINES, true); // warm up the connection slots
+  for (int chunked = 0; chunked < 2; chunked++)
+  {
+    FetchUse once = fetch(PRODUCTION_LINES, chunked);
+    FetchUse tenfold = fetch(10 * PRODUCTION_LINES, chunked);
+    TEST_ASSERT_GREATER_THAN(9 * strlen(ID ",2024-03-01T00:00:00.000Z,1000.00\n") * PRODUCTION_LINES,
+                             strlen(response));
+    TEST_ASSERT_EQUAL(0, once.heapPeak);
+    TEST_ASSERT_EQUAL(once.heapPeak, tenfold.heapPeak);
+    TEST_ASSERT_EQUAL(once.arenaHighWater, tenfold.arenaHighWater);
+    TEST_ASSERT_EQUAL(once.stackDepth, tenfold.stackDepth);
+    TEST_ASSERT_EQUAL(0, arenaFailures());
+  }
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_values_after_the_header);
+  RUN_TEST(test_byte_by_byte_feed);
+  RUN_TEST(test_implausible_values_are_rejected);
+  RUN_TEST(test_overlong_line_is_skipped);
+  RUN_TEST(test_full_array_drops_the_oldest);
+  RUN_TEST(test_finish_flushes_an_unterminated_line);
+  RUN_TEST(test_parsing_does_not_allocate);
+  RUN_TEST(test_memory_is_bounded_by_the_line);
+  return UNITY_END();
+}
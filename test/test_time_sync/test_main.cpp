@@ -0,0 +1,141 @@
+#include "time_sync.h"
+#include <math.h>
+#include <unity.h>
+
+#define HOUR_MS 3600000UL
+#define MIN_MS 60000UL
+#define MAX_MS (24 * HOUR_MS)
+#define BOUND_MS 1000
+#define EPOCH_MS 1700000000000LL
+
+static TimeSync sync;
+
+void setUp()
+{
+  timeSyncReset(sync);
+}
+
+void tearDown() {}
+
+void test_unknown_drift_uses_the_minimum()
+{
+  TEST_ASSERT_EQUAL(UINT32_MAX, timeSyncPredictedErrorMs(sync, 1000));
+  TEST_ASSERT_EQUAL(MIN_MS, timeSyncNextDelayMs(sync, BOUND_MS, MIN_MS, MAX_MS));
+  timeSyncRecord(sync, 1000, EPOCH_MS);
+  TEST_ASSERT_EQUAL(1, sync.syncs);
+  TEST_ASSERT_EQUAL(MIN_MS, timeSyncNextDelayMs(sync, BOUND_MS, MIN_MS, MAX_MS));
+  TEST_ASSERT_EQUAL(TIME_SYNC_JITTER_MS, timeSyncPredictedErrorMs(sync, 1000));
+}
+
+// A re-sync before TIME_SYNC_MIN_SPAN_MS keeps the older anchor
+void test_short_span_keeps_the_anchor()
+{
+  timeSyncRecord(sync, 1000, EPOCH_MS);
+  timeSyncRecord(sync, 1000 + TIME_SYNC_MIN_SPAN_MS - 1, EPOCH_MS + TIME_SYNC_MIN_SPAN_MS);
+  TEST_ASSERT_EQUAL(1000, sync.anchorLocalMs);
+  TEST_ASSERT_EQUAL(0, sync.uncertaintyPpm);
+  TEST_ASSERT_EQUAL(2, sync.syncs);
+}
+
+void test_drift_sets_the_next_sync()
+{
+  // The local clock gains 360 ms per hour, 100 ppm
+  timeSyncRecord(sync, 0, EPOCH_MS);
+  timeSyncRecord(sync, HOUR_MS, EPOCH_MS + HOUR_MS - 360);
+  TEST_ASSERT_FLOAT_WITHIN(0.1f, 100.0f, sync.driftPpm);
+  float uncertainty = 2.0f * TIME_SYNC_JITTER_MS * 1e6f / HOUR_MS; // ~27.8 ppm
+  TEST_ASSERT_FLOAT_WITHIN(0.1f, uncertainty, sync.uncertaintyPpm);
+
+  uint32_t expected = (uint32_t)((BOUND_MS - TIME_SYNC_JITTER_MS) * 1e6f / (100.0f + uncertainty));
+  uint32_t delay = timeSyncNextDelayMs(sync, BOUND_MS, MIN_MS, MAX_MS);
+  TEST_ASSERT_UINT32_WITHIN(expected / 1000, expected, delay);
+  // The predicted error reaches the bound when the delay is up
+  TEST_ASSERT_UINT32_WITHIN(2, BOUND_MS, timeSyncPredictedErrorMs(sync, HOUR_MS + delay));
+}
+
+void test_slow_clock_is_scheduled_like_a_fast_one()
+{
+  timeSyncRecord(sync, 0, EPOCH_MS);
+  timeSyncRecord(sync, HOUR_MS, EPOCH_MS + HOUR_MS + 360);
+  TEST_ASSERT_FLOAT_WITHIN(0.1f, -100.0f, sync.driftPpm);
+  TimeSync fast;
+  timeSyncReset(fast);
+  timeSyncRecord(fast, 0, EPOCH_MS);
+  timeSyncRecord(fast, HOUR_MS, EPOCH_MS + HOUR_MS - 360);
+  // Only the UTC span the uncertainty is taken over differs slightly
+  uint32_t expected = timeSyncNextDelayMs(fast, BOUND_MS, MIN_MS, MAX_MS);
+  TEST_ASSERT_UINT32_WITHIN(expected / 1000, expected, timeSyncNextDelayMs(sync, BOUND_MS, MIN_MS, MAX_MS));
+}
+
+void test_delay_is_clamped()
+{
+  // A good crystal over a day: next sync only after the maximum
+  timeSyncRecord(sync, 0, EPOCH_MS);
+  timeSyncRecord(sync, MAX_MS, EPOCH_MS + MAX_MS - 5);
+  TEST_ASSERT_EQUAL(MAX_MS, timeSyncNextDelayMs(sync, 60000, MIN_MS, MAX_MS));
+  // A bound within the jitter cannot be kept, sync as often as allowed
+  TEST_ASSERT_EQUAL(MIN_MS, timeSyncNextDelayMs(sync, TIME_SYNC_JITTER_MS, MIN_MS, MAX_MS));
+}
+
+void test_drift_follows_slowly()
+{
+  timeSyncRecord(sync, 0, EPOCH_MS);
+  timeSyncRecord(sync, HOUR_MS, EPOCH_MS + HOUR_MS - 360); // 100 ppm
+  timeSyncRecord(sync, 2 * HOUR_MS, EPOCH_MS + 2 * HOUR_MS - 360 - 180); // then 50 ppm
+  TEST_ASSERT_FLOAT_WITHIN(0.2f, 87.5f, sync.driftPpm);
+}
+
+void test_local_clock_wraparound()
+{
+  uint32_t start = 0xFFFFFFFFUL - HOUR_MS / 2;
+  timeSyncRecord(sync, start, EPOCH_MS);
+  timeSyncRecord(sync, start + HOUR_MS, EPOCH_MS + HOUR_MS - 360);
+  TEST_ASSERT_FLOAT_WITHIN(0.1f, 100.0f, sync.driftPpm);
+  // 6 minutes on, drift and its uncertainty both count
+  uint32_t expected = TIME_SYNC_JITTER_MS + (uint32_t)(360000 * (sync.driftPpm + sync.uncertaintyPpm) * 1e-6f);
+  TEST_ASSERT_UINT32_WITHIN(1, expected, timeSyncPredictedErrorMs(sync, start + HOUR_MS + 360000));
+}
+
+// Syncing on the schedule keeps the real error under the bound, whatever
+// the jitter of the NTP answers within TIME_SYNC_JITTER_MS
+void test_schedule_keeps_the_error_bounded()
+{
+  const double driftPpm = 40;
+  uint32_t seed = 1;
+  double utcMs = 0;
+  uint32_t localMs = 0;
+  double clockErrorMs = 0; // local wall clock minus true time
+  int syncs = 0;
+  while (utcMs < 30.0 * MAX_MS)
+  {
+    seed = seed * 1103515245 + 12345;
+    int jitter = (int)((seed >> 16) % (2 * TIME_SYNC_JITTER_MS + 1)) - TIME_SYNC_JITTER_MS;
+    timeSyncRecord(sync, localMs, EPOCH_MS + (int64_t)utcMs + jitter);
+    clockErrorMs = -jitter;
+    syncs++;
+
+    uint32_t delay = timeSyncNextDelayMs(sync, BOUND_MS, MIN_MS, MAX_MS);
+    localMs += delay;
+    utcMs += delay / (1 + driftPpm * 1e-6);
+    clockErrorMs += delay - delay / (1 + driftPpm * 1e-6);
+    TEST_ASSERT_LESS_OR_EQUAL(BOUND_MS + TIME_SYNC_JITTER_MS, (int)fabs(clockErrorMs));
+  }
+  TEST_ASSERT_FLOAT_WITHIN(5.0f, driftPpm, sync.driftPpm);
+  // Not far above the syncs a known drift would need
+  double ideal = 30.0 * MAX_MS * driftPpm * 1e-6 / (BOUND_MS - TIME_SYNC_JITTER_MS);
+  TEST_ASSERT_LESS_THAN((int)(1.5 * ideal), syncs);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_unknown_drift_uses_the_minimum);
+  RUN_TEST(test_short_span_keeps_the_anchor);
+  RUN_TEST(test_drift_sets_the_next_sync);
+  RUN_TEST(test_slow_clock_is_scheduled_like_a_fast_one);
+  RUN_TEST(test_delay_is_clamped);
+  RUN_TEST(test_drift_follows_slowly);
+  RUN_TEST(test_local_clock_wraparound);
+  RUN_TEST(test_schedule_keeps_the_error_bounded);
+  return UNITY_END();
+}
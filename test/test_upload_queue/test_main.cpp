@@ -0,0 +1,229 @@
+#include "upload_queue.h"
+#include <LittleFS.h>
+#include <unity.h>
+
+// The module's file names, the crash tests lay out the files themselves
+#define QUEUE_LOG "/queue.bin"
+#define QUEUE_POS "/queue.pos"
+#define QUEUE_TMP "/queue.tmp"
+
+// uploadQueuePush() compacts once this many readings were consumed
+#define COMPACT_AT (UPLOAD_QUEUE_MAX_RECORDS / 2)
+
+void setUp()
+{
+  LittleFS.format();
+  uploadQueueBegin();
+}
+
+void tearDown() {}
+
+static QueuedReading reading(uint32_t timestamp)
+{
+  QueuedReading r;
+  r.timestamp = timestamp;
+  for (size_t i = 0; i < SENSOR_COUNT; i++)
+    r.values[i] = timestamp * 0.5f + i;
+  return r;
+}
+
+static void pushRange(uint32_t from, uint32_t to)
+{
+  for (uint32_t t = from; t < to; t++)
+    TEST_ASSERT_TRUE(uploadQueuePush(reading(t)));
+}
+
+static uint32_t front()
+{
+  QueuedReading r;
+  TEST_ASSERT_EQUAL(1, uploadQueuePeek(&r, 1));
+  return r.timestamp;
+}
+
+static size_t fileSize(const char *path)
+{
+  File f = LittleFS.open(path, "r");
+  return f ? f.size() : 0;
+}
+
+static void writeHead(uint32_t head)
+{
+  File f = LittleFS.open(QUEUE_POS, "w");
+  uint32_t pos[2] = {head, sizeof(QueuedReading)};
+  f.write((const uint8_t *)pos, sizeof(pos));
+}
+
+// The copy compactQueue() would make of the log from record first on,
+// cut to count records
+static void writeCopy(uint32_t first, uint32_t count)
+{
+  File in = LittleFS.open(QUEUE_LOG, "r");
+  File out = LittleFS.open(QUEUE_TMP, "w");
+  QueuedReading r;
+  in.seek(first * sizeof(QueuedReading), SeekSet);
+  for (uint32_t i = 0; i < count && in.read((uint8_t *)&r, sizeof(r)) == sizeof(r); i++)
+    out.write((const uint8_t *)&r, sizeof(r));
+}
+
+void test_fifo_order()
+{
+  pushRange(1, 11);
+  QueuedReading r[4];
+  TEST_ASSERT_EQUAL(4, uploadQueuePeek(r, 4));
+  TEST_ASSERT_EQUAL(1, r[0].timestamp);
+  TEST_ASSERT_EQUAL(4, r[3].timestamp);
+  TEST_ASSERT_EQUAL_FLOAT(reading(4).values[0], r[3].values[0]);
+  uploadQueuePop(4);
+  TEST_ASSERT_EQUAL(6, uploadQueueSize());
+  TEST_ASSERT_EQUAL(5, front());
+
+  QueuedReading last;
+  TEST_ASSERT_TRUE(uploadQueueLastSent(last));
+  TEST_ASSERT_EQUAL(4, last.timestamp);
+}
+
+void test_reset_keeps_pending_readings()
+{
+  pushRange(1, 21);
+  uploadQueuePop(7);
+  TEST_ASSERT_TRUE(uploadQueueBegin());
+  TEST_ASSERT_EQUAL(13, uploadQueueSize());
+  TEST_ASSERT_EQUAL(8, front());
+}
+
+void test_torn_append_is_dropped()
+{
+  pushRange(1, 6);
+  File f = LittleFS.open(QUEUE_LOG, "a");
+  f.write((const uint8_t *)"torn", 4);
+  f.close();
+  uploadQueueBegin();
+  TEST_ASSERT_EQUAL(5, uploadQueueSize());
+  TEST_ASSERT_EQUAL(5 * sizeof(QueuedReading), fileSize(QUEUE_LOG));
+  pushRange(6, 7);
+  QueuedReading r[6];
+  TEST_ASSERT_EQUAL(6, uploadQueuePeek(r, 6));
+  TEST_ASSERT_EQUAL(6, r[5].timestamp);
+}
+
+void test_full_queue_drops_oldest()
+{
+  pushRange(1, UPLOAD_QUEUE_MAX_RECORDS + 11);
+  TEST_ASSERT_EQUAL(UPLOAD_QUEUE_MAX_RECORDS, uploadQueueSize());
+  TEST_ASSERT_EQUAL(11, front());
+}
+
+// Readings queued while a batch of the full queue is on its way push its
+// oldest out, the pop after the upload must not take unsent ones with them
+void test_push_during_upload_of_full_queue()
+{
+  pushRange(1, UPLOAD_QUEUE_MAX_RECORDS + 1);
+  QueuedReading batch[5];
+  TEST_ASSERT_EQUAL(5, uploadQueuePeek(batch, 5));
+  pushRange(UPLOAD_QUEUE_MAX_RECORDS + 1, UPLOAD_QUEUE_MAX_RECORDS + 3); // drops 1 and 2
+  uploadQueuePop(5);
+  TEST_ASSERT_EQUAL(UPLOAD_QUEUE_MAX_RECORDS - 3, uploadQueueSize());
+  TEST_ASSERT_EQUAL(6, front());
+  QueuedReading sent;
+  TEST_ASSERT_TRUE(uploadQueueLastSent(sent));
+  TEST_ASSERT_EQUAL(5, sent.timestamp);
+
+  // The whole batch was dropped meanwhile
+  pushRange(UPLOAD_QUEUE_MAX_RECORDS + 3, UPLOAD_QUEUE_MAX_RECORDS + 6);
+  TEST_ASSERT_EQUAL(2, uploadQueuePeek(batch, 2));
+  pushRange(UPLOAD_QUEUE_MAX_RECORDS + 6, UPLOAD_QUEUE_MAX_RECORDS + 9);
+  uploadQueuePop(2);
+  TEST_ASSERT_EQUAL(UPLOAD_QUEUE_MAX_RECORDS, uploadQueueSize());
+  TEST_ASSERT_EQUAL(9, front());
+}
+
+void test_compaction_bounds_the_log()
+{
+  pushRange(1, COMPACT_AT + 21);
+  uploadQueuePop(COMPACT_AT);
+  pushRange(COMPACT_AT + 21, COMPACT_AT + 22);
+  TEST_ASSERT_EQUAL(21, uploadQueueSize());
+  TEST_ASSERT_EQUAL(21 * sizeof(QueuedReading), fileSize(QUEUE_LOG));
+  TEST_ASSERT_FALSE(LittleFS.exists(QUEUE_TMP));
+  TEST_ASSERT_EQUAL(COMPACT_AT + 1, front());
+  uploadQueueBegin();
+  TEST_ASSERT_EQUAL(21, uploadQueueSize());
+  TEST_ASSERT_EQUAL(COMPACT_AT + 1, front());
+}
+
+// Reset while the copy was written: the old log and head still hold
+void test_reset_during_copy_discards_it()
+{
+  pushRange(1, COMPACT_AT + 21);
+  uploadQueuePop(COMPACT_AT);
+  writeCopy(COMPACT_AT, 7);
+  uploadQueueBegin();
+  TEST_ASSERT_FALSE(LittleFS.exists(QUEUE_TMP));
+  TEST_ASSERT_EQUAL(20, uploadQueueSize());
+  TEST_ASSERT_EQUAL(COMPACT_AT + 1, front());
+}
+
+// Reset after the head was reset, before the rename: the copy is the log
+void test_reset_before_rename_completes_it()
+{
+  pushRange(1, COMPACT_AT + 21);
+  uploadQueuePop(COMPACT_AT);
+  writeCopy(COMPACT_AT, 20);
+  writeHead(0);
+  uploadQueueBegin();
+  TEST_ASSERT_FALSE(LittleFS.exists(QUEUE_TMP));
+  TEST_ASSERT_EQUAL(20, uploadQueueSize());
+  TEST_ASSERT_EQUAL(20 * sizeof(QueuedReading), fileSize(QUEUE_LOG));
+  TEST_ASSERT_EQUAL(COMPACT_AT + 1, front());
+}
+
+// A server that fails most uploads and a device that resets now and then:
+// every reading arrives once, in order
+void test_flaky_server_and_resets()
+{
+  uint32_t seed = 12345;
+  auto chance = [&seed](uint32_t percent) {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) % 100 < percent;
+  };
+
+  uint32_t next = 1;     // next reading to push
+  uint32_t expected = 1; // next reading the server should get
+  QueuedReading batch[6];
+  for (int step = 0; step < 5000; step++)
+  {
+    TEST_ASSERT_TRUE(uploadQueuePush(reading(next++)));
+    if (chance(30))
+    {
+      size_t n = uploadQueuePeek(batch, 6);
+      TEST_ASSERT_GREATER_THAN(0, n);
+      for (size_t i = 0; i < n; i++)
+        TEST_ASSERT_EQUAL(expected + i, batch[i].timestamp);
+      if (chance(60))
+      {
+        uploadQueuePop(n);
+        expected += n;
+      }
+    }
+    if (chance(5))
+      TEST_ASSERT_TRUE(uploadQueueBegin());
+    TEST_ASSERT_EQUAL(next - expected, uploadQueueSize());
+  }
+  TEST_ASSERT_GREATER_THAN(2 * COMPACT_AT, expected); // compacted on the way
+  TEST_ASSERT_LESS_THAN(UPLOAD_QUEUE_MAX_RECORDS * sizeof(QueuedReading), fileSize(QUEUE_LOG));
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_fifo_order);
+  RUN_TEST(test_reset_keeps_pending_readings);
+  RUN_TEST(test_torn_append_is_dropped);
+  RUN_TEST(test_full_queue_drops_oldest);
+  RUN_TEST(test_push_during_upload_of_full_queue);
+  RUN_TEST(test_compaction_bounds_the_log);
+  RUN_TEST(test_reset_during_copy_discards_it);
+  RUN_TEST(test_reset_before_rename_completes_it);
+  RUN_TEST(test_flaky_server_and_resets);
+  return UNITY_END();
+}